@@ -0,0 +1,146 @@
+// Benchmark of the aggregate query evaluator: a plant of a few hundred
+// devices of three types with a day of history, queried for total power by
+// device type at 1-minute resolution, max temperature per device and the
+// live plant total from the value cache. Each result is checked against a
+// plain loop over the same samples.
+//
+// Build and run from the repository root:
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/aggregate_query.cc src/aggregate_query.cc src/history_store.cc src/value_cache.cc
+//       src/device_registry.cc src/device_groups.cc src/smadata_request.cc src/channel_codec.cc src/mem_stats.cc
+//       src/plant_lock.cc src/hazard_pointers.cc
+//       -L$YASDI_SDK_PATH/lib -lyasdimaster -lyasdi -o aggregate_query
+//   ./aggregate_query [devices] [hours]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "aggregate_query.h"
+
+static const DWORD START = 1700000000;
+static const DWORD SAMPLE_PERIOD = 10;     // seconds between polls of a device
+static const char* const TYPES[] = { "WR21TL06", "WR25-007", "SB3000" };
+
+static double power(int device, DWORD time) {
+    return 1000 + (device % 7) * 100 + (time % 600);
+}
+
+static double temperature(int device, DWORD time) {
+    return 30 + (device % 13) + ((time / SAMPLE_PERIOD) % 17) * 0.5;
+}
+
+static double run_ms(QueryEvaluator& evaluator, const AggregateQuery& query, const RegistrySnapshot& snapshot,
+                     AggregateResult& result, int repeats) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        evaluator.run(query, snapshot, result);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 300;
+    int hours = argc > 2 ? atoi(argv[2]) : 24;
+    DWORD end = START + hours * 3600;
+
+    std::vector<RegistryDevice> plant;
+    for (int i = 0; i < count; i++) {
+        RegistryDevice device;
+        device.handle = 1 + i;
+        device.name = "WR" + std::to_string(i);
+        device.type = TYPES[i % 3];
+        device.channels.push_back({ (DWORD)(device.handle * 10), "Pac", "W" });
+        device.channels.push_back({ (DWORD)(device.handle * 10 + 1), "Temperatur", "degC" });
+        plant.push_back(device);
+    }
+    DeviceRegistry registry;
+    DeviceRegistry::SnapshotPtr snapshot = registry.publish(plant);
+
+    HistoryStore history(hours * 3600 / SAMPLE_PERIOD + 1);
+    ValueCache values;
+    values.rebuild(*snapshot);
+    DeviceGroups groups;
+
+    size_t stored = 0;
+    for (int i = 0; i < count; i++) {
+        DWORD handle = 1 + i;
+        // Devices are polled one after the other, not all in the same second
+        for (DWORD time = START + i % SAMPLE_PERIOD; time < end; time += SAMPLE_PERIOD) {
+            history.append(handle, "Pac", time, power(i, time));
+            history.append(handle, "Temperatur", time, temperature(i, time));
+            stored += 2;
+        }
+        values.store(handle, { { handle * 10, power(i, end), end } });
+    }
+    printf("%d devices, %d h of history, %zu samples\n", count, hours, stored);
+
+    QueryEvaluator evaluator(history, values, groups);
+    AggregateResult result;
+    int failed = 0;
+
+    // Total power by type per minute
+    AggregateQuery by_type;
+    by_type.channel = "Pac";
+    by_type.functions = { AGG_SUM };
+    by_type.group_by = GROUP_BY_TYPE;
+    by_type.history = true;
+    by_type.from = START;
+    by_type.to = end;
+    by_type.bucket = 60;
+    double ms = run_ms(evaluator, by_type, *snapshot, result, 5);
+
+    double expected = 0;
+    for (int i = 0; i < count; i += 3) {
+        // Every device has six samples in the first minute
+        double sum = 0;
+        for (DWORD time = START + i % SAMPLE_PERIOD; time < START + 60; time += SAMPLE_PERIOD) {
+            sum += power(i, time);
+        }
+        expected += sum / 6;
+    }
+    size_t row = 0;
+    while (row < result.keys.size() && result.keys[row] != TYPES[0]) {
+        row++;
+    }
+    bool ok = row < result.keys.size() && std::fabs(result.columns[0][row] - expected) < 1e-6 * expected &&
+              result.keys.size() == 3 * (size_t)hours * 60;
+    printf("sum of Pac by type, 1 min buckets: %zu rows in %.2f ms %s\n", result.keys.size(), ms, ok ? "" : "WRONG");
+    failed |= !ok;
+
+    // Max temperature per device over the whole range
+    AggregateQuery hottest;
+    hottest.channel = "Temperatur";
+    hottest.functions = { AGG_MAX, AGG_AVG };
+    hottest.group_by = GROUP_BY_DEVICE;
+    hottest.history = true;
+    hottest.from = START;
+    hottest.to = end;
+    ms = run_ms(evaluator, hottest, *snapshot, result, 5);
+    ok = result.keys.size() == (size_t)count && result.columns[0][0] == 30 + 8.0;
+    printf("max Temperatur per device: %zu rows in %.2f ms %s\n", result.keys.size(), ms, ok ? "" : "WRONG");
+    failed |= !ok;
+
+    // Plant total from the live values
+    AggregateQuery live;
+    live.channel = "Pac";
+    live.functions = { AGG_SUM, AGG_COUNT };
+    ms = run_ms(evaluator, live, *snapshot, result, 100);
+    expected = 0;
+    for (int i = 0; i < count; i++) {
+        expected += power(i, end);
+    }
+    ok = result.keys.size() == 1 && result.columns[0][0] == expected && result.columns[1][0] == count;
+    printf("live sum of Pac: %.0f W of %d devices in %.3f ms %s\n",
+           result.keys.empty() ? 0 : result.columns[0][0], count, ms, ok ? "" : "WRONG");
+    failed |= !ok;
+
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
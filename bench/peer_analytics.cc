@@ -0,0 +1,103 @@
+// Benchmark of the peer comparison: a plant of inverters with two string
+// inputs each, in groups of one device type, polled at 1 Hz with passing
+// clouds. One string loses a third of its power part way through; it must
+// be the only input flagged, and no input may be flagged before.
+//
+// Build and run from the repository root:
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/peer_analytics.cc src/peer_analytics.cc src/value_cache.cc src/device_registry.cc
+//       src/hazard_pointers.cc src/mem_stats.cc -o peer_analytics
+//   ./peer_analytics [devices] [polls]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "peer_analytics.h"
+
+static const DWORD START = 1700000000;
+static const int GROUP_SIZE = 40;
+static const int FAULT_DEVICE = 17;
+static const double FAULT_LOSS = 0.33;
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    int polls = argc > 2 ? atoi(argv[2]) : 600;
+    int fault_poll = polls / 2;
+
+    std::vector<RegistryDevice> plant;
+    std::vector<PeerInput> inputs;
+    for (int i = 0; i < count; i++) {
+        RegistryDevice device;
+        device.handle = 1 + i;
+        device.name = "WR" + std::to_string(i);
+        device.channels.push_back({ (DWORD)(device.handle * 10), "A.Ms.Watt", "W" });
+        device.channels.push_back({ (DWORD)(device.handle * 10 + 1), "B.Ms.Watt", "W" });
+        plant.push_back(device);
+
+        // Every tenth device has longer strings
+        double capacity = i % 10 == 0 ? 3000 : 2500;
+        std::string group = "type" + std::to_string(i / GROUP_SIZE);
+        inputs.push_back({ device.handle, device.handle * 10, "A.Ms.Watt", group, capacity });
+        inputs.push_back({ device.handle, device.handle * 10 + 1, "B.Ms.Watt", group, capacity });
+    }
+    DeviceRegistry registry;
+    ValueCache values;
+    values.rebuild(*registry.publish(plant));
+
+    PeerAnalytics analytics;
+    PeerConfig config;
+    analytics.configure(inputs, config);
+
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0, 0.01);
+    std::vector<PeerDeviation> flagged;
+    std::vector<CachedValue> device_values(2);
+    double total_us = 0;
+    int false_alarms = 0;
+    int detected_after = -1;
+
+    for (int poll = 0; poll < polls; poll++) {
+        DWORD time = START + poll;
+        // Clouds move over the plant, each group sees its own irradiance
+        for (int i = 0; i < count; i++) {
+            double irradiance = 0.6 + 0.3 * std::sin((poll + i / GROUP_SIZE * 37) / 40.0);
+            double capacity = i % 10 == 0 ? 3000 : 2500;
+            double a = capacity * irradiance * (1 + noise(random));
+            double b = capacity * irradiance * (1 + noise(random));
+            if (i == FAULT_DEVICE && poll >= fault_poll) {
+                b *= 1 - FAULT_LOSS;
+            }
+            DWORD handle = 1 + i;
+            device_values[0] = { handle * 10, a, time };
+            device_values[1] = { handle * 10 + 1, b, time };
+            values.store(handle, device_values);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        analytics.update(values, flagged);
+        total_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        for (const PeerDeviation& deviation : flagged) {
+            if (deviation.device_handle != 1 + FAULT_DEVICE || deviation.channel != "B.Ms.Watt") {
+                false_alarms++;
+            } else if (detected_after < 0) {
+                detected_after = poll - fault_poll;
+            }
+        }
+    }
+
+    printf("%d inputs in %d groups, %d polls: %.1f us per update\n",
+           count * 2, (count + GROUP_SIZE - 1) / GROUP_SIZE, polls, total_us / polls);
+    printf("fault flagged %d polls after it began, %d false alarms\n", detected_after, false_alarms);
+    bool ok = detected_after >= 0 && false_alarms == 0;
+    printf("%s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+// Discrete-event simulation of a plant on a virtual clock: the real SMAData
+// scheduler and the real power control law run against a simulated RS485
+// bus, inverters and grid meter. Time jumps from event to event, so a day
+// of polling a large plant runs in seconds.
+//
+// The simulated bus replaces yasdiAddIORequest through the scheduler's
+// transport hook and ends requests through their TIORequest callbacks, like
+// YASDI does. Controller metrics are printed with the same keys as
+// getPowerControllerMetrics().
+//
+// Build and run from the repository root (YASDI libraries built as in README):
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/plant_sim.cc src/event_sim.cc src/clock.cc src/smadata_request.cc
+//       src/power_controller.cc src/channel_codec.cc src/mem_stats.cc src/plant_lock.cc
+//       -L$YASDI_SDK_PATH/lib -lyasdimaster -lyasdi -o plant_sim
+//   ./plant_sim [inverters] [hours] [poll interval s] [controller period s] [baud]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "event_sim.h"
+#include "power_controller.h"
+#include "smadata_request.h"
+
+extern "C" {
+    #include "chandef.h"
+}
+
+// SMANet framing: sync, address, control, protocol, CRC and flags
+static const DWORD FRAME_OVERHEAD = 13;
+static const double TURNAROUND = 0.02;      // s until a device answers
+static const DWORD SPOT_ANSWER = 160;       // bytes of a spot value answer
+static const DWORD METER_ANSWER = 16;       // bytes of a single channel answer
+static const WORD METER_ADDR = 1;
+
+struct Plant {
+    std::vector<double> capacity;
+    std::vector<double> efficiency;     // per inverter share of irradiance
+    std::vector<double> limit;
+    double base_load;
+
+    double irradiance(double t) const {
+        double hour = std::fmod(t / 3600.0, 24.0);
+        double sun = std::sin(M_PI * (hour - 6.0) / 12.0);
+        // Passing clouds
+        double clouds = 0.85 + 0.15 * std::sin(t / 97.0) * std::sin(t / 13.0);
+        return sun > 0 ? sun * clouds : 0;
+    }
+
+    double production(double t) const {
+        double total = 0;
+        for (size_t i = 0; i < capacity.size(); i++) {
+            total += std::min(capacity[i] * efficiency[i] * irradiance(t), limit[i]);
+        }
+        return total;
+    }
+
+    double load(double t) const {
+        double hour = std::fmod(t / 3600.0, 24.0);
+        return base_load * (0.7 + 0.3 * std::sin(M_PI * (hour - 8.0) / 12.0) + 0.05 * std::sin(t / 31.0));
+    }
+
+    // Power at the grid connection, import positive
+    double meter(double t) const {
+        return load(t) - production(t);
+    }
+};
+
+class SimulatedBus {
+public:
+    SimulatedBus(EventSimulator& sim, double baud) : sim(sim), byte_time(10.0 / baud) {}
+
+    void transmit(TIORequest* io) {
+        queue.push_back(io);
+        if (!busy) {
+            start_next();
+        }
+    }
+
+    double busy_time = 0;
+    unsigned long long frames = 0;
+
+private:
+    DWORD answer_size(const TIORequest* io) const {
+        if (io->Type == RT_NORCV) {
+            return 0;
+        }
+        return io->DestAddr == METER_ADDR ? METER_ANSWER : SPOT_ANSWER;
+    }
+
+    void start_next() {
+        if (queue.empty()) {
+            busy = false;
+            return;
+        }
+        busy = true;
+
+        TIORequest* io = queue.front();
+        queue.pop_front();
+
+        DWORD answer = answer_size(io);
+        double duration = (FRAME_OVERHEAD + io->TxLength) * byte_time;
+        if (answer > 0) {
+            duration += TURNAROUND + (FRAME_OVERHEAD + answer) * byte_time;
+        }
+        busy_time += duration;
+        frames++;
+
+        sim.after(duration, [this, io, answer] {
+            if (answer > 0) {
+                buffer.assign(answer, 0);
+                TOnReceiveInfo info = {};
+                info.SourceAddr = io->DestAddr;
+                info.Buffer = buffer.data();
+                info.BufferSize = answer;
+                io->OnReceived(io, &info);
+            }
+            io->Status = RS_SUCCESS;
+            // The request may be gone after OnEnd
+            io->OnEnd(io);
+            start_next();
+        });
+    }
+
+    EventSimulator& sim;
+    double byte_time;
+    std::deque<TIORequest*> queue;
+    std::vector<BYTE> buffer;
+    bool busy = false;
+};
+
+struct PollStats {
+    unsigned long long polls = 0;
+    double total_delay = 0;
+    double max_delay = 0;
+};
+
+int main(int argc, char** argv) {
+    int inverters = argc > 1 ? std::atoi(argv[1]) : 200;
+    double hours = argc > 2 ? std::atof(argv[2]) : 24;
+    double poll_interval = argc > 3 ? std::atof(argv[3]) : 300;
+    double period = argc > 4 ? std::atof(argv[4]) : 2;
+    double baud = argc > 5 ? std::atof(argv[5]) : 19200;
+    double duration = hours * 3600;
+
+    auto wall_start = std::chrono::steady_clock::now();
+    EventSimulator sim(1700000000);
+    SimulatedBus bus(sim, baud);
+
+    // One request at a time on the bus, so the priorities decide the order
+    SMADataScheduler& scheduler = SMADataScheduler::instance();
+    scheduler.set_transport([&bus](TIORequest* io) { bus.transmit(io); });
+    scheduler.set_max_in_flight(1);
+
+    Plant plant;
+    PowerControllerConfig config;
+    config.target = 0;
+    config.headroom = 500;
+    config.gain = 0.7;
+    config.ramp = 0;
+    config.deadband = 50;
+    config.period_ms = (DWORD)(period * 1000);
+    srand(1);
+    for (int i = 0; i < inverters; i++) {
+        double capacity = 5000 + 1000 * (i % 5);
+        plant.capacity.push_back(capacity);
+        plant.efficiency.push_back(0.9 + 0.1 * (rand() / (double)RAND_MAX));
+        plant.limit.push_back(capacity);
+        config.inverters.push_back({ (DWORD)(i + 2), capacity });
+    }
+    double total_capacity = 0;
+    for (double capacity : plant.capacity) {
+        total_capacity += capacity;
+    }
+    plant.base_load = 0.4 * total_capacity;
+
+    // Polling: every inverter once per interval, staggered
+    PollStats poll_stats;
+    std::function<void(int, double)> poll = [&](int inverter, double due) {
+        auto request = std::make_shared<SMADataRequest>((WORD)(inverter + 2), CMD_GET_DATA);
+        BYTE payload[3] = { LOBYTE(CH_SPOT | CH_IN | CH_ALL), HIBYTE(CH_SPOT | CH_IN | CH_ALL), 0 };
+        request->set_payload(payload, sizeof(payload));
+        request->set_end_handler([&, due](int code) {
+            double delay = sim.now() - due;
+            poll_stats.polls++;
+            poll_stats.total_delay += delay;
+            poll_stats.max_delay = std::max(poll_stats.max_delay, delay);
+        });
+        scheduler.submit(request, PRIORITY_NORMAL);
+        sim.at(due + poll_interval, [&, inverter, due] { poll(inverter, due + poll_interval); });
+    };
+    for (int i = 0; i < inverters; i++) {
+        double first = poll_interval * i / inverters;
+        sim.at(first, [&, i, first] { poll(i, first); });
+    }
+
+    // Control loop: the same law as PowerController, on the simulated bus
+    PowerControlLaw law(config);
+    PowerControllerMetrics metrics;
+    metrics.running = true;
+    // Like the controller thread, a cycle starts after the previous one
+    // finished, at the earliest one period after the previous start
+    double last_cycle = -period;
+    std::function<void()> cycle;
+    auto cycle_done = [&] {
+        sim.at(std::max(sim.now(), last_cycle + period), cycle);
+    };
+    cycle = [&] {
+        double start = sim.now();
+        double dt = start - last_cycle;
+        last_cycle = start;
+
+        auto read = std::make_shared<SMADataRequest>(METER_ADDR, CMD_GET_DATA);
+        BYTE payload[3] = { LOBYTE(CH_SPOT | CH_ANALOG | CH_IN), HIBYTE(CH_SPOT | CH_ANALOG | CH_IN), 0 };
+        read->set_payload(payload, sizeof(payload));
+        read->set_end_handler([&, start, dt](int code) {
+            double feedback = plant.meter(sim.now());
+            double read_ms = (sim.now() - start) * 1000;
+            size_t suppressed = 0;
+            auto updates = law.step(feedback, dt, suppressed);
+            if (updates.empty()) {
+                metrics.record_cycle(feedback, law.plant_limit(), read_ms, read_ms, 0, suppressed);
+                cycle_done();
+                return;
+            }
+
+            auto pending = std::make_shared<size_t>(updates.size());
+            for (const auto& update : updates) {
+                auto write = std::make_shared<SMADataRequest>((WORD)(update.first + 2), CMD_SET_DATA);
+                BYTE value[9] = { 0 };
+                write->set_payload(value, sizeof(value));
+                write->set_type(RT_NORCV);
+                size_t inverter = update.first;
+                double limit = update.second;
+                size_t count = updates.size();
+                write->set_end_handler([&, pending, inverter, limit, start, read_ms, feedback, count, suppressed](int code) {
+                    plant.limit[inverter] = limit;
+                    law.written(inverter, limit);
+                    if (--*pending == 0) {
+                        metrics.record_cycle(feedback, law.plant_limit(), read_ms, (sim.now() - start) * 1000, count, suppressed);
+                        cycle_done();
+                    }
+                });
+                scheduler.submit(write, PRIORITY_HIGH);
+            }
+        });
+        scheduler.submit(read, PRIORITY_HIGH);
+    };
+    sim.at(0, cycle);
+
+    // Energy exported to the grid, sampled every second
+    double exported_wh = 0;
+    double max_export = 0;
+    std::function<void()> sample = [&] {
+        double exporting = std::max(0.0, -plant.meter(sim.now()));
+        exported_wh += exporting / 3600.0;
+        max_export = std::max(max_export, exporting);
+        sim.after(1, sample);
+    };
+    sim.at(0, sample);
+
+    unsigned long long events = sim.run_until(duration);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    std::printf("simulated %.1f h, %d inverters, %.0f baud, poll every %.0f s, control every %.1f s\n",
+                hours, inverters, baud, poll_interval, period);
+    std::printf("events %llu in %.2f s wall time (%.0fx real time)\n", events, wall, duration / wall);
+    std::printf("bus: %llu frames, utilization %.1f%%\n", bus.frames, 100.0 * bus.busy_time / duration);
+    std::printf("polls: %llu, avg delay %.2f s, max delay %.2f s\n", poll_stats.polls,
+                poll_stats.polls ? poll_stats.total_delay / poll_stats.polls : 0.0, poll_stats.max_delay);
+    std::printf("export: %.1f kWh, max %.0f W\n", exported_wh / 1000, max_export);
+    std::printf("{\"running\":%s,\"cycles\":%llu,\"readFailures\":%llu,\"writes\":%llu,\"suppressed\":%llu,"
+                "\"feedback\":%.1f,\"plantLimit\":%.1f,\"readMs\":%.1f,\"maxReadMs\":%.1f,"
+                "\"latencyMs\":%.1f,\"avgLatencyMs\":%.1f,\"maxLatencyMs\":%.1f}\n",
+                metrics.running ? "true" : "false", metrics.cycles, metrics.read_failures, metrics.writes,
+                metrics.suppressed, metrics.feedback, metrics.plant_limit, metrics.read_ms, metrics.max_read_ms,
+                metrics.latency_ms, metrics.avg_latency_ms, metrics.max_latency_ms);
+    return 0;
+}
@@ -0,0 +1,162 @@
+// Allocation check of the steady-state read path: counts the C++ heap
+// allocations DeviceReader makes per poll of a device, with and without
+// value texts, after the channel lists are cached and the buffers have
+// grown. Any allocation is a regression; the exit code is 1 then.
+// test/native/read_path_test.cc checks the same without a bus in npm test;
+// this bench polls over a real driver and socket.
+//
+// Every operator new on the polling thread is counted, YASDI's own C
+// allocations (os_malloc) are not. The history keeps 16 samples per
+// channel so that its rings are at full size after the warm-up polls.
+//
+// Polls the loopback inverters of bench/udp_plant_loop.cc. Build both and
+// the UDP driver as described there, then from the repository root:
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -Idriver -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/read_path_allocs.cc src/device_reader.cc src/history_store.cc src/value_cache.cc
+//       src/channel_values.cc src/device_registry.cc src/live_table.cc src/receive_times.cc src/mem_stats.cc
+//       src/plant_lock.cc src/hazard_pointers.cc
+//       -L$YASDI_SDK_PATH/lib -lyasdimaster -lyasdi -o read_path_allocs
+//   ./udp_plant_loop serve 4 &
+//   LD_LIBRARY_PATH=.:$YASDI_SDK_PATH/lib ./read_path_allocs [devices] [polls]
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "device_reader.h"
+#include "device_registry.h"
+
+static thread_local unsigned long long allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* memory = std::malloc(size ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+static const int MASTER_PORT = 24274;   // next to udp_plant_loop's own master
+static const int DEVICE_PORT = 24272;
+static const int WARMUP_POLLS = 3;
+
+// As the addon does after detection
+static void publish_registry(DeviceRegistry& registry, ValueCache& values, const std::vector<DWORD>& handles) {
+    DWORD channel_array[500];
+    char name[64];
+    std::vector<RegistryDevice> devices;
+
+    for (DWORD handle : handles) {
+        RegistryDevice device;
+        device.handle = handle;
+        int channel_count = GetChannelHandlesEx(handle, channel_array, 500, ALLCHANNELS);
+        for (int i = 0; i < channel_count; i++) {
+            RegistryChannel channel;
+            channel.handle = channel_array[i];
+            name[0] = 0;
+            GetChannelName(channel.handle, name, sizeof(name) - 1);
+            channel.name = name;
+            device.channels.push_back(channel);
+        }
+        devices.push_back(device);
+    }
+    values.rebuild(*registry.publish(std::move(devices)));
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 4;
+    int polls = argc > 2 ? atoi(argv[2]) : 20;
+
+    // YASDI only takes short ini paths
+    char ini[] = "/tmp/allocsXXXXXX";
+    int ini_fd = mkstemp(ini);
+    dprintf(ini_fd,
+            "[DriverModules]\nDriver0=yasdi_drv_udp\n\n"
+            "[UDP1]\nInterface=127.0.0.1\nPort=%d\nLocalPort=%d\nProtocol=SMANet\n\n"
+            "[Misc]\nChannelListDir=/tmp\n", DEVICE_PORT, MASTER_PORT);
+    close(ini_fd);
+
+    DWORD driver_total = 0;
+    if (yasdiMasterInitialize(ini, &driver_total) != 0 || driver_total == 0) {
+        fprintf(stderr, "yasdi_drv_udp not loaded, is libyasdi_drv_udp.so on the library path?\n");
+        unlink(ini);
+        return 1;
+    }
+    DWORD drivers[4];
+    DWORD driver_count = yasdiMasterGetDriver(drivers, 4);
+    for (DWORD i = 0; i < driver_count; i++) {
+        yasdiMasterSetDriverOnline(drivers[i]);
+    }
+
+    DoStartDeviceDetection(count, TRUE);
+    std::vector<DWORD> devices(count + 1);
+    devices.resize(GetDeviceHandles(devices.data(), (DWORD)devices.size()));
+    printf("detection: %d of %d inverters\n", (int)devices.size(), count);
+    if (devices.empty()) {
+        fprintf(stderr, "no inverters, is \"udp_plant_loop serve\" running?\n");
+        yasdiMasterShutdown();
+        unlink(ini);
+        return 1;
+    }
+
+    HistoryStore history(16);
+    DeviceRegistry registry;
+    ValueCache values;
+    ReceiveTimes receive_times;
+    receive_times.set_drivers(drivers, driver_count);
+    publish_registry(registry, values, devices);
+
+    std::vector<std::string> columns = { "Pac", "Upv-Ist", "E-Total" };
+    std::vector<double> table(LiveTable::required_size(devices.size(), columns.size()) / sizeof(double));
+    LiveTable live_table;
+    live_table.attach(table.data(), table.size() * sizeof(double), devices.size(), columns);
+
+    DeviceReader reader(history, values, live_table, receive_times);
+    std::vector<ChannelData> data;
+
+    int failed = 0;
+    for (bool text : { true, false }) {
+        unsigned long long steady = 0;
+        size_t channels = 0;
+
+        for (int poll = 0; poll < WARMUP_POLLS + polls; poll++) {
+            for (DWORD device : devices) {
+                unsigned long long before = allocations;
+                reader.read(device, text, data);
+                if (poll >= WARMUP_POLLS) {
+                    steady += allocations - before;
+                    channels += data.size();
+                }
+            }
+        }
+
+        double per_poll = (double)steady / (polls * devices.size());
+        printf("%s: %d polls of %d devices, %.1f channels per poll, %llu allocations (%.2f per poll)\n",
+               text ? "with text" : "numeric", polls, (int)devices.size(),
+               (double)channels / (polls * devices.size()), steady, per_poll);
+        if (steady != 0 || channels == 0) {
+            failed = 1;
+        }
+    }
+
+    yasdiMasterShutdown();
+    unlink(ini);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed;
+}
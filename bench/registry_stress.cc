@@ -0,0 +1,176 @@
+// Stress benchmark: concurrent device lookups while detection republishes
+// the device list. Compares the RCU registry with a registry behind one
+// mutex that is held while the list is rebuilt, as a plant lock would be.
+// Lookup times are bucketed by powers of two ns, percentiles are the upper
+// bound of their bucket.
+//
+// Build and run from the repository root:
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/registry_stress.cc src/device_registry.cc src/hazard_pointers.cc src/mem_stats.cc -o registry_stress
+//   ./registry_stress [readers] [seconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_registry.h"
+
+static const int DEVICES = 50;
+static const int CHANNELS = 80;
+
+// Detection asks every device for its channel list over the bus
+static const auto BUS_TIME_PER_DEVICE = std::chrono::microseconds(200);
+
+static std::vector<RegistryDevice> detect(int generation) {
+    std::vector<RegistryDevice> devices;
+    for (int i = 0; i < DEVICES; i++) {
+        RegistryDevice device;
+        device.handle = 1 + i + (generation % 2) * DEVICES;
+        device.name = "WR" + std::to_string(i);
+        device.serial = 2000000 + i;
+        for (int j = 0; j < CHANNELS; j++) {
+            device.channels.push_back({ (DWORD)(device.handle * 1000 + j), "Chan" + std::to_string(j), "W" });
+        }
+        std::this_thread::sleep_for(BUS_TIME_PER_DEVICE);
+        devices.push_back(device);
+    }
+    return devices;
+}
+
+// Lookup times in power of two buckets of ns
+static const int BUCKETS = 40;
+
+struct Result {
+    unsigned long long reads = 0;
+    unsigned long long found = 0;
+    double max_wait_us = 0;
+    unsigned long long waits[BUCKETS] = {};
+    int publishes = 0;
+};
+
+// Upper bound of the bucket holding a share of the lookups, in us
+static double percentile(const Result& result, double share) {
+    unsigned long long seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += result.waits[i];
+        if (seen >= share * result.reads) {
+            return (1ull << i) / 1000.0;
+        }
+    }
+    return result.max_wait_us;
+}
+
+template <typename Lookup, typename Detect>
+static Result run(int readers, int seconds, Lookup lookup, Detect detection) {
+    std::atomic<bool> stop(false);
+    std::vector<Result> per_reader(readers);
+    std::vector<std::thread> threads;
+    Result total;
+
+    for (int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            Result& mine = per_reader[r];
+            unsigned seed = r + 1;
+            while (!stop.load(std::memory_order_relaxed)) {
+                seed = seed * 1103515245 + 12345;
+                std::string name = "WR" + std::to_string((seed >> 8) % DEVICES);
+                std::string channel = "Chan" + std::to_string((seed >> 16) % CHANNELS);
+
+                auto begin = std::chrono::steady_clock::now();
+                if (lookup(name, channel)) {
+                    mine.found++;
+                }
+                double waited = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+                if (waited > mine.max_wait_us) {
+                    mine.max_wait_us = waited;
+                }
+                int bucket = 0;
+                while (bucket < BUCKETS - 1 && (1ull << bucket) < waited * 1000) {
+                    bucket++;
+                }
+                mine.waits[bucket]++;
+                mine.reads++;
+            }
+        });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        detection(total.publishes++);
+    }
+    stop = true;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const Result& result : per_reader) {
+        total.reads += result.reads;
+        total.found += result.found;
+        if (result.max_wait_us > total.max_wait_us) {
+            total.max_wait_us = result.max_wait_us;
+        }
+        for (int i = 0; i < BUCKETS; i++) {
+            total.waits[i] += result.waits[i];
+        }
+    }
+    return total;
+}
+
+// The maximum includes readers preempted mid-lookup, which with more
+// readers than cores is a time slice whatever the registry does; the
+// percentiles show what the registry costs a lookup
+static void report(const char* name, const Result& result, int seconds) {
+    std::printf("%-8s %12.0f lookups/s  found %5.1f%%  p50 %6.2f  p99 %8.2f  p99.9 %9.2f  max %9.1f us  %d publishes\n",
+                name, result.reads / (double)seconds,
+                result.reads ? 100.0 * result.found / result.reads : 0.0,
+                percentile(result, 0.5), percentile(result, 0.99), percentile(result, 0.999),
+                result.max_wait_us, result.publishes);
+}
+
+int main(int argc, char** argv) {
+    int readers = argc > 1 ? std::atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    int seconds = argc > 2 ? std::atoi(argv[2]) : 3;
+    if (readers < 1) {
+        readers = 1;
+    }
+
+    DeviceRegistry registry;
+    registry.publish(detect(0));
+    Result rcu = run(readers, seconds,
+        [&](const std::string& name, const std::string& channel) {
+            DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+            const RegistryDevice* device = snapshot->find_name(name);
+            return device != nullptr && device->find_channel(channel) != nullptr;
+        },
+        [&](int generation) {
+            registry.publish(detect(generation + 1));
+        });
+
+    // Baseline: the list is rebuilt in place while holding the lock
+    std::mutex plant_lock;
+    DeviceRegistry locked;
+    locked.publish(detect(0));
+    Result mutex = run(readers, seconds,
+        [&](const std::string& name, const std::string& channel) {
+            std::lock_guard<std::mutex> lock(plant_lock);
+            DeviceRegistry::SnapshotPtr snapshot = locked.snapshot();
+            const RegistryDevice* device = snapshot->find_name(name);
+            return device != nullptr && device->find_channel(channel) != nullptr;
+        },
+        [&](int generation) {
+            std::lock_guard<std::mutex> lock(plant_lock);
+            locked.publish(detect(generation + 1));
+        });
+
+    std::printf("%d readers, %d s, detection of %d devices running continuously\n", readers, seconds, DEVICES);
+    report("rcu", rcu, seconds);
+    report("mutex", mutex, seconds);
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Failover of a hot standby gateway, two processes on the simulated UDP
+// bus of udp_plant_loop. The active gateway detects the plant and polls it
+// every second while serving its state on a unix socket; the standby, with
+// an empty channel list cache of its own, applies the state without a
+// frame on the bus. The active gateway is then killed and the standby
+// takes over with one broadcast round trip and reads on at once.
+//
+// Build the driver and udp_plant_loop as in bench/udp_plant_loop.cc, then
+// from the repository root:
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -Idriver -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/standby_handoff.cc $(ls src/*.cc | grep -v inverter_wrapper)
+//       -L$YASDI_SDK_PATH/lib -lyasdimaster -lyasdi -o standby_handoff
+//   ./udp_plant_loop serve [inverters] &
+//   LD_LIBRARY_PATH=.:$YASDI_SDK_PATH/lib ./standby_handoff [inverters]
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "inverter_engine.h"
+
+typedef std::chrono::steady_clock SteadyClock;
+
+static const int DEVICE_PORT = 24272;
+static const char* SOCKET_PATH = "/tmp/standby_handoff.sock";
+
+static double seconds_since(SteadyClock::time_point start) {
+    return std::chrono::duration<double>(SteadyClock::now() - start).count();
+}
+
+// YASDI only takes short ini paths; every gateway has its own port and
+// channel list cache
+static std::string write_ini(int local_port, std::string& cache_dir) {
+    char dir[] = "/tmp/handoffXXXXXX";
+    cache_dir = mkdtemp(dir);
+    char ini[] = "/tmp/handoffXXXXXX";
+    int fd = mkstemp(ini);
+    dprintf(fd,
+            "[DriverModules]\nDriver0=yasdi_drv_udp\n\n"
+            "[UDP1]\nInterface=127.0.0.1\nPort=%d\nLocalPort=%d\nProtocol=SMANet\n\n"
+            "[Misc]\nChannelListDir=%s\n", DEVICE_PORT, local_port, cache_dir.c_str());
+    close(fd);
+    return ini;
+}
+
+static double pac(InverterEngine& engine, DWORD device_handle) {
+    DeviceRegistry::SnapshotPtr snapshot = engine.devices();
+    const RegistryDevice* device = snapshot->find(device_handle);
+    const RegistryChannel* channel = device != nullptr ? device->find_channel("Pac") : nullptr;
+    CachedValue value;
+    if (channel == nullptr || !engine.values().load(device_handle, channel->handle, value)) {
+        return -1;
+    }
+    return value.value;
+}
+
+static int run_active(int count) {
+    std::string cache_dir;
+    std::string ini = write_ini(24276, cache_dir);
+    InverterEngine engine;
+    std::string error;
+    if (!engine.initialize(ini, error)) {
+        fprintf(stderr, "active: %s\n", error.c_str());
+        return 1;
+    }
+
+    auto started = SteadyClock::now();
+    engine.detect(count);
+    printf("active:  detected %zu devices with channel lists in %.2f s\n",
+           engine.devices()->devices.size(), seconds_since(started));
+    if (engine.serve_standby(SOCKET_PATH) != YE_OK) {
+        fprintf(stderr, "active: cannot serve %s\n", SOCKET_PATH);
+        return 1;
+    }
+    fflush(stdout);
+
+    // Polled until killed
+    std::vector<ChannelData> data;
+    while (true) {
+        for (const RegistryDevice& device : engine.devices()->devices) {
+            engine.read(device.handle, false, data);
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 4;
+
+    pid_t active = fork();
+    if (active == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        return run_active(count);
+    }
+
+    std::string cache_dir;
+    std::string ini = write_ini(24277, cache_dir);
+    InverterEngine engine;
+    std::string error;
+    if (!engine.initialize(ini, error)) {
+        fprintf(stderr, "standby: %s\n", error.c_str());
+        kill(active, SIGKILL);
+        return 1;
+    }
+    engine.start_standby(SOCKET_PATH);
+
+    // Synced, plus a few polls of the active gateway streamed afterwards
+    auto started = SteadyClock::now();
+    StandbyStatus status = engine.standby_status();
+    bool synced = false;
+    unsigned long long synced_updates = 0;
+    while (seconds_since(started) < 60) {
+        status = engine.standby_status();
+        if (status.synced && !synced && (int)status.devices == count) {
+            synced = true;
+            synced_updates = status.updates;
+            printf("standby: synced after %.2f s, %zu devices, %zu channel lists, %llu value updates\n",
+                   seconds_since(started), status.devices, status.channel_lists, status.updates);
+        }
+        if (synced && status.updates >= synced_updates + 2 * (unsigned long long)count) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    if (!synced) {
+        fprintf(stderr, "standby: not synced, %zu of %d devices\n", status.devices, count);
+        kill(active, SIGKILL);
+        return 1;
+    }
+    DWORD first = status.handles.begin()->second;
+    printf("standby: %llu value updates applied, Pac of device %u is %.1f, version %llu\n",
+           status.updates, first, pac(engine, first), engine.version(first));
+
+    kill(active, SIGKILL);
+    waitpid(active, nullptr, 0);
+    unlink(SOCKET_PATH);
+    printf("active:  killed\n");
+
+    TakeoverResult takeover;
+    started = SteadyClock::now();
+    int code = engine.take_over(1, takeover);
+    printf("standby: took over in %.2f s (code %d), %zu devices confirmed, %zu missing\n",
+           seconds_since(started), code, takeover.confirmed.size(), takeover.missing.size());
+
+    // A read after the max age goes to the bus
+    std::this_thread::sleep_for(std::chrono::seconds(DeviceReader::DEFAULT_MAX_AGE + 1));
+    std::vector<ChannelData> data;
+    unsigned long long version = 0;
+    started = SteadyClock::now();
+    engine.read(first, false, data, &version);
+    printf("standby: bus read of device %u in %.2f s, %zu channels, Pac %.1f, version %llu\n",
+           first, seconds_since(started), data.size(), pac(engine, first), version);
+
+    engine.shutdown();
+    unlink(ini.c_str());
+    return code == YE_OK ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+// Loopback benchmark for the TCP serial-server driver: YASDI sends SMAData
+// frames through libyasdi_drv_tcp to an in-process stand-in for a serial
+// device server, which echoes every byte back like a bus where the frame
+// is answered at once. The stand-in drops the first connection after a few
+// frames, so the reconnect path is exercised as well.
+//
+// Round trips are measured from yasdiSendPacket to the packet listener;
+// frames sent while the driver reconnects are dropped by the driver and
+// counted as lost. YASDI's receiver thread polls the driver's Read(), so
+// the round trip is bounded below by its polling interval, not the socket.
+//
+// Build the driver and the benchmark from the repository root (YASDI
+// libraries built as in README):
+//   gcc -shared -fPIC -O2 -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       driver/tcp_serial.c -L$YASDI_SDK_PATH/lib -lyasdi -o libyasdi_drv_tcp.so
+//   g++ -std=gnu++17 -O2 -pthread -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/tcp_serial_loop.cc -L$YASDI_SDK_PATH/lib -lyasdi -o tcp_serial_loop
+//   LD_LIBRARY_PATH=.:$YASDI_SDK_PATH/lib ./tcp_serial_loop [frames] [port]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern "C" {
+    #include "smadef.h"
+    #include "smadata_layer.h"
+    #include "libyasdi.h"
+}
+
+typedef std::chrono::steady_clock SteadyClock;
+
+static const BYTE CMD_LOOP = 0x40;
+static const int DROP_AFTER_FRAMES = 5;
+
+static std::mutex mutex;
+static std::condition_variable received_cond;
+static int received = 0;
+
+static void on_packet(TSMAData* smadata, BYTE* buffer, DWORD size) {
+    (void)buffer;
+    (void)size;
+    if (smadata->Cmd != CMD_LOOP) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    received++;
+    received_cond.notify_all();
+}
+
+// Serial device server stand-in: echoes the bus, hangs up once
+static void serve(int listener, std::atomic<bool>* running, std::atomic<int>* connects) {
+    while (*running) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        int count = ++*connects;
+
+        BYTE buffer[512];
+        int frames = 0;
+        for (;;) {
+            ssize_t got = read(fd, buffer, sizeof(buffer));
+            if (got <= 0 || write(fd, buffer, got) != got) {
+                break;
+            }
+            // SMANet frames end with the HDLC flag
+            frames += (int)std::count(buffer, buffer + got, 0x7e) / 2;
+            if (count == 1 && frames >= DROP_AFTER_FRAMES) {
+                break;
+            }
+        }
+        close(fd);
+    }
+}
+
+static void stop_server(int listener, std::atomic<bool>* running, std::thread* server) {
+    *running = false;
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    server->join();
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 1000;
+    int port = argc > 2 ? atoi(argv[2]) : 14001;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    std::atomic<bool> running(true);
+    std::atomic<int> connects(0);
+    std::thread server(serve, listener, &running, &connects);
+
+    // YASDI only takes short ini paths
+    char ini[] = "/tmp/tcpserXXXXXX";
+    int ini_fd = mkstemp(ini);
+    dprintf(ini_fd,
+            "[DriverModules]\nDriver0=yasdi_drv_tcp\n\n"
+            "[TCP1]\nHost=127.0.0.1\nPort=%d\nProtocol=SMANet\nReconnectMin=50\n", port);
+    close(ini_fd);
+
+    DWORD drivers = 0;
+    if (yasdiInitialize(ini, &drivers) != 0 || drivers == 0) {
+        fprintf(stderr, "yasdi_drv_tcp not loaded, is libyasdi_drv_tcp.so on the library path?\n");
+        stop_server(listener, &running, &server);
+        unlink(ini);
+        return 1;
+    }
+    DWORD driver_ids[4];
+    yasdiGetDriver(driver_ids, 4);
+    yasdiSetDriverOnline(driver_ids[0]);
+
+    static TPacketRcvListener listener_cb = { on_packet };
+    yasdiAddPaketListener(&listener_cb);
+
+    BYTE payload[16] = { 0 };
+    std::vector<double> round_trips;
+    int lost = 0;
+    auto started = SteadyClock::now();
+
+    for (int i = 0; i < frames; i++) {
+        int expected;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            expected = received + 1;
+        }
+
+        auto sent = SteadyClock::now();
+        yasdiSendPacket(0x0001, 0x0000, CMD_LOOP, payload, sizeof(payload), TS_PROT_SMANET_ONLY);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (received_cond.wait_for(lock, std::chrono::milliseconds(200), [&] { return received >= expected; })) {
+            round_trips.push_back(std::chrono::duration<double, std::micro>(SteadyClock::now() - sent).count());
+        } else {
+            lost++;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(SteadyClock::now() - started).count();
+    std::sort(round_trips.begin(), round_trips.end());
+    auto percentile = [&](double p) {
+        return round_trips.empty() ? 0.0 : round_trips[(size_t)(p * (round_trips.size() - 1))];
+    };
+
+    printf("frames %d, answered %zu, lost %d, connects %d, %.2f s\n",
+           frames, round_trips.size(), lost, connects.load(), seconds);
+    printf("round trip us: p50 %.0f, p99 %.0f, max %.0f\n",
+           percentile(0.5), percentile(0.99), percentile(1.0));
+
+    yasdiShutdown();
+    stop_server(listener, &running, &server);
+    unlink(ini);
+    return 0;
+}
@@ -0,0 +1,498 @@
+// Loopback simulator for the SMAData1 over UDP driver: simulated inverters
+// answer SMAData1 over UDP on the local host, and the YASDI master finds
+// and polls them through libyasdi_drv_udp with the same calls the addon
+// makes.
+//
+// Every simulated inverter listens on the multicast group and has its own
+// unicast address (127.0.0.2, 127.0.0.3, ...). It answers device detection,
+// address configuration, its channel list and spot value requests. All
+// spot values of an inverter come back in one datagram.
+//
+// The benchmark detects the plant and then polls the spot values of all
+// inverters back to back with GET_DATA requests through the addon's
+// SMADataScheduler, as the power controller reads its meter. A round ends
+// when every inverter answered; the master's GetChannelValue path is not
+// used for polling, it adds a SYN_ONLINE and WaitAfterSyncOnline per read.
+// YASDI runs one request at a time and its scheduler ticks every 30 ms, so
+// a round costs about two ticks per inverter, not the network.
+//
+// "serve" only runs the inverters, e.g. for the examples or the Node API
+// with a yasdi.ini like the one written below. With a mirror port every
+// answer is also sent to that port on 127.0.0.1, as a mirror port of a
+// switch would, for a second master listening only (ListenOnly=1 and
+// LocalPort=<mirror port>) next to the one polling.
+//
+// Build the driver and the benchmark from the repository root (YASDI
+// libraries built as in README):
+//   gcc -shared -fPIC -O2 -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       driver/udp_multicast.c -L$YASDI_SDK_PATH/lib -lyasdi -o libyasdi_drv_udp.so
+//   g++ -std=gnu++17 -O2 -pthread -Isrc -I$YASDI_SDK_PATH/include -I$YASDI_SDK_PATH/core
+//       -I$YASDI_SDK_PATH/smalib -I$YASDI_SDK_PATH/os -I$YASDI_SDK_PATH/protocol
+//       -I$YASDI_SDK_PATH/master -I$YASDI_SDK_PATH/libs
+//       -I$YASDI_SDK_PATH/projects/generic-cmake/incprj -I$YASDI_SDK_PATH/projects/generic-cmake/build-gcc
+//       bench/udp_plant_loop.cc src/smadata_request.cc src/mem_stats.cc src/plant_lock.cc
+//       -L$YASDI_SDK_PATH/lib -lyasdimaster -lyasdi -o udp_plant_loop
+//   LD_LIBRARY_PATH=.:$YASDI_SDK_PATH/lib ./udp_plant_loop [inverters] [rounds]
+//   ./udp_plant_loop serve [inverters] [mirror port]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "smadata_request.h"
+
+extern "C" {
+    #include "chandef.h"
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+    #include "master.h"
+}
+
+typedef std::chrono::steady_clock SteadyClock;
+
+static const char* GROUP = "239.255.24.72";     // UDPMC_DEFAULT_GROUP
+static const int DEVICE_PORT = 24272;
+static const int MASTER_PORT = 24273;
+static int mirror_port = 0;
+
+static const BYTE CTRL_ACK = 0x40;
+static const WORD PPP_SMADATA1 = 0x4041;
+
+// HDLC framing of SMANet (RFC 1662 FCS-16)
+static WORD fcs16(const BYTE* data, size_t size) {
+    WORD fcs = 0xffff;
+    for (size_t i = 0; i < size; i++) {
+        fcs ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            fcs = (fcs & 1) ? (WORD)((fcs >> 1) ^ 0x8408) : (WORD)(fcs >> 1);
+        }
+    }
+    return fcs;
+}
+
+struct Frame {
+    WORD source;
+    WORD dest;
+    BYTE ctrl;
+    BYTE cmd;
+    std::vector<BYTE> data;
+};
+
+static void put16(std::vector<BYTE>& out, WORD value) {
+    out.push_back((BYTE)value);
+    out.push_back((BYTE)(value >> 8));
+}
+
+static void put32(std::vector<BYTE>& out, DWORD value) {
+    put16(out, (WORD)value);
+    put16(out, (WORD)(value >> 16));
+}
+
+static void put_float(std::vector<BYTE>& out, float value) {
+    DWORD raw;
+    std::memcpy(&raw, &value, sizeof(raw));
+    put32(out, raw);
+}
+
+static void put_text(std::vector<BYTE>& out, const char* text, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        out.push_back(i < std::strlen(text) ? (BYTE)text[i] : 0);
+    }
+}
+
+static std::vector<BYTE> encode(const Frame& frame) {
+    std::vector<BYTE> raw = { 0xff, 0x03, (BYTE)(PPP_SMADATA1 >> 8), (BYTE)PPP_SMADATA1 };
+    put16(raw, frame.source);
+    put16(raw, frame.dest);
+    raw.push_back(frame.ctrl);
+    raw.push_back(0);
+    raw.push_back(frame.cmd);
+    raw.insert(raw.end(), frame.data.begin(), frame.data.end());
+    put16(raw, (WORD)(fcs16(raw.data(), raw.size()) ^ 0xffff));
+
+    std::vector<BYTE> out = { 0x7e };
+    for (BYTE b : raw) {
+        if (b == 0x7e || b == 0x7d || b < 0x20) {
+            out.push_back(0x7d);
+            out.push_back(b ^ 0x20);
+        } else {
+            out.push_back(b);
+        }
+    }
+    out.push_back(0x7e);
+    return out;
+}
+
+// All SMAData frames in a datagram
+static std::vector<Frame> decode(const BYTE* data, size_t size) {
+    std::vector<Frame> frames;
+    std::vector<BYTE> raw;
+    bool escaped = false;
+
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == 0x7e) {
+            if (raw.size() >= 13 && fcs16(raw.data(), raw.size()) == 0xf0b8 &&
+                raw[0] == 0xff && raw[1] == 0x03 && ((raw[2] << 8) | raw[3]) == PPP_SMADATA1) {
+                Frame frame;
+                frame.source = (WORD)(raw[4] | (raw[5] << 8));
+                frame.dest = (WORD)(raw[6] | (raw[7] << 8));
+                frame.ctrl = raw[8];
+                frame.cmd = raw[10];
+                frame.data.assign(raw.begin() + 11, raw.end() - 2);
+                frames.push_back(std::move(frame));
+            }
+            raw.clear();
+            escaped = false;
+        } else if (data[i] == 0x7d) {
+            escaped = true;
+        } else {
+            raw.push_back(escaped ? (BYTE)(data[i] ^ 0x20) : data[i]);
+            escaped = false;
+        }
+    }
+    return frames;
+}
+
+struct SimChannel {
+    const char* name;
+    const char* unit;
+};
+
+static const SimChannel CHANNELS[] = {
+    { "Pac", "W" }, { "Upv-Ist", "V" }, { "Ipv", "A" }, { "Uac", "V" },
+    { "Iac-Ist", "A" }, { "Fac", "Hz" }, { "E-Total", "kWh" }, { "h-Total", "h" },
+    { "Temperatur", "degC" },
+};
+static const size_t CHANNEL_COUNT = sizeof(CHANNELS) / sizeof(CHANNELS[0]);
+static const WORD SIM_CTYPE = CH_ANALOG | CH_IN | CH_SPOT;
+
+class SimInverter {
+public:
+    SimInverter(int index) : index(index), serial(2100000000u + index), address(0) {
+        snprintf(unicast_ip, sizeof(unicast_ip), "127.0.0.%d", 2 + index);
+    }
+
+    bool open() {
+        multicast_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        unicast_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int on = 1;
+        setsockopt(multicast_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(DEVICE_PORT);
+        inet_pton(AF_INET, GROUP, &addr.sin_addr);
+        if (bind(multicast_fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            return false;
+        }
+        ip_mreq membership = {};
+        inet_pton(AF_INET, GROUP, &membership.imr_multiaddr);
+        inet_pton(AF_INET, "127.0.0.1", &membership.imr_interface);
+        if (setsockopt(multicast_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            return false;
+        }
+
+        inet_pton(AF_INET, unicast_ip, &addr.sin_addr);
+        return bind(unicast_fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    void close_sockets() {
+        close(multicast_fd);
+        close(unicast_fd);
+    }
+
+    // Answers go out of the unicast socket, so the master learns the device
+    void on_datagram(int fd) {
+        BYTE buffer[1500];
+        sockaddr_in from = {};
+        socklen_t from_size = sizeof(from);
+        ssize_t got = recvfrom(fd, buffer, sizeof(buffer), 0, (sockaddr*)&from, &from_size);
+        if (got <= 0) {
+            return;
+        }
+
+        for (const Frame& request : decode(buffer, (size_t)got)) {
+            Frame answer;
+            if (handle(request, &answer)) {
+                std::vector<BYTE> out = encode(answer);
+                sendto(unicast_fd, out.data(), out.size(), 0, (sockaddr*)&from, sizeof(from));
+                if (mirror_port != 0) {
+                    sockaddr_in mirror = {};
+                    mirror.sin_family = AF_INET;
+                    mirror.sin_port = htons(mirror_port);
+                    inet_pton(AF_INET, "127.0.0.1", &mirror.sin_addr);
+                    sendto(unicast_fd, out.data(), out.size(), 0, (sockaddr*)&mirror, sizeof(mirror));
+                }
+                answers++;
+            }
+        }
+    }
+
+    int multicast_fd = -1;
+    int unicast_fd = -1;
+    std::atomic<int> answers{0};
+
+private:
+    bool handle(const Frame& request, Frame* answer) {
+        bool broadcast = (request.ctrl & 0x80) != 0;
+        if (request.ctrl & CTRL_ACK) {
+            return false;
+        }
+        if (!broadcast && request.dest != address) {
+            return false;
+        }
+
+        answer->source = address;
+        answer->dest = request.source;
+        answer->ctrl = CTRL_ACK;
+        answer->cmd = request.cmd;
+
+        switch (request.cmd) {
+        case CMD_GET_NET:
+        case CMD_GET_NET_START:
+            put32(answer->data, serial);
+            put_text(answer->data, "SIM-UDP", 8);
+            return true;
+
+        case CMD_CFG_NETADR:
+            if (request.data.size() < 6 ||
+                (DWORD)(request.data[0] | (request.data[1] << 8) | (request.data[2] << 16) |
+                        ((DWORD)request.data[3] << 24)) != serial) {
+                return false;
+            }
+            address = (WORD)(request.data[4] | (request.data[5] << 8));
+            answer->source = address;
+            put32(answer->data, serial);
+            put_text(answer->data, "SIM-UDP", 8);
+            return true;
+
+        case CMD_GET_CINFO:
+            for (size_t i = 0; i < CHANNEL_COUNT; i++) {
+                answer->data.push_back((BYTE)(i + 1));
+                put16(answer->data, SIM_CTYPE);
+                put16(answer->data, (1 << 8) | CH_FLOAT4);  // one value, float
+                put16(answer->data, 0);
+                put_text(answer->data, CHANNELS[i].name, 16);
+                put_text(answer->data, CHANNELS[i].unit, 8);
+                put_float(answer->data, 1.0f);
+                put_float(answer->data, 0.0f);
+            }
+            return true;
+
+        case CMD_GET_DATA: {
+            if (request.data.size() < 3) {
+                return false;
+            }
+            WORD mask = (WORD)(request.data[0] | (request.data[1] << 8));
+            bool spot = (mask & CH_SPOT) && (mask & CH_ANALOG) && (mask & CH_IN) && !(mask & CH_TEST);
+            put16(answer->data, mask);
+            answer->data.push_back(request.data[2]);
+            put16(answer->data, spot ? 1 : 0);
+            if (mask & CH_SPOT) {
+                put32(answer->data, (DWORD)time(nullptr));
+                put32(answer->data, 1);
+            }
+            if (spot) {
+                polls++;
+                float pac = 1000.0f + 10.0f * index + (float)(polls % 60);
+                float values[CHANNEL_COUNT] = {
+                    pac, 420.0f, pac / 420.0f, 230.0f, pac / 230.0f, 50.0f,
+                    12000.0f + index, 30000.0f + index, 35.0f,
+                };
+                for (float value : values) {
+                    put_float(answer->data, value);
+                }
+            }
+            return true;
+        }
+
+        default:
+            // SYN_ONLINE and everything else needs no answer
+            return false;
+        }
+    }
+
+    int index;
+    char unicast_ip[16];
+    DWORD serial;
+    WORD address;
+    DWORD polls = 0;
+};
+
+static void serve(std::vector<SimInverter*>* inverters, std::atomic<bool>* running) {
+    std::vector<pollfd> fds;
+    for (SimInverter* inverter : *inverters) {
+        fds.push_back({ inverter->multicast_fd, POLLIN, 0 });
+        fds.push_back({ inverter->unicast_fd, POLLIN, 0 });
+    }
+
+    while (*running) {
+        if (poll(fds.data(), fds.size(), 100) <= 0) {
+            continue;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents & POLLIN) {
+                (*inverters)[i / 2]->on_datagram(fds[i].fd);
+            }
+        }
+    }
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (values.size() - 1))];
+}
+
+int main(int argc, char** argv) {
+    bool serve_only = argc > 1 && std::strcmp(argv[1], "serve") == 0;
+    int arg = serve_only ? 2 : 1;
+    int count = argc > arg ? atoi(argv[arg]) : 20;
+    int rounds = argc > arg + 1 ? atoi(argv[arg + 1]) : 5;
+    if (serve_only) {
+        mirror_port = argc > arg + 1 ? atoi(argv[arg + 1]) : 0;
+    }
+
+    std::vector<SimInverter*> inverters;
+    for (int i = 0; i < count; i++) {
+        inverters.push_back(new SimInverter(i));
+        if (!inverters.back()->open()) {
+            perror("simulated inverter");
+            return 1;
+        }
+    }
+
+    std::atomic<bool> running(true);
+    std::thread server(serve, &inverters, &running);
+
+    if (serve_only) {
+        printf("%d inverters on %s:%d, configure yasdi.ini with\n"
+               "[DriverModules]\nDriver0=yasdi_drv_udp\n\n"
+               "[UDP1]\nInterface=127.0.0.1\nProtocol=SMANet\n", count, GROUP, DEVICE_PORT);
+        server.join();
+        return 0;
+    }
+
+    // YASDI only takes short ini paths
+    char ini[] = "/tmp/udpsimXXXXXX";
+    int ini_fd = mkstemp(ini);
+    dprintf(ini_fd,
+            "[DriverModules]\nDriver0=yasdi_drv_udp\n\n"
+            "[UDP1]\nInterface=127.0.0.1\nPort=%d\nLocalPort=%d\nProtocol=SMANet\n\n"
+            "[Misc]\nChannelListDir=/tmp\n", DEVICE_PORT, MASTER_PORT);
+    close(ini_fd);
+
+    DWORD drivers = 0;
+    if (yasdiMasterInitialize(ini, &drivers) != 0 || drivers == 0) {
+        fprintf(stderr, "yasdi_drv_udp not loaded, is libyasdi_drv_udp.so on the library path?\n");
+        unlink(ini);
+        running = false;
+        server.join();
+        return 1;
+    }
+    DWORD driver_ids[4];
+    DWORD driver_count = yasdiMasterGetDriver(driver_ids, 4);
+    for (DWORD i = 0; i < driver_count; i++) {
+        yasdiMasterSetDriverOnline(driver_ids[i]);
+    }
+
+    auto started = SteadyClock::now();
+    int detect = DoStartDeviceDetection(count, TRUE);
+    double detect_s = std::chrono::duration<double>(SteadyClock::now() - started).count();
+
+    std::vector<DWORD> devices(count + 1);
+    DWORD found = GetDeviceHandles(devices.data(), (DWORD)devices.size());
+    devices.resize(found);
+    printf("detection: %d of %d inverters in %.2f s (code %d)\n", (int)found, count, detect_s, detect);
+
+    std::vector<TNetDevice*> targets;
+    std::vector<TChannel*> pac_channels;
+    for (DWORD device : devices) {
+        TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device);
+        TChannel* chan = dev ? TNetDevice_FindChannelName(dev, (char*)"Pac") : NULL;
+        if (chan != NULL) {
+            targets.push_back(dev);
+            pac_channels.push_back(chan);
+        }
+    }
+
+    // All spot values of an inverter: mask[2] index[1], index 0 is every channel
+    WORD mask = CH_SPOT | CH_ANALOG | CH_IN;
+    std::vector<BYTE> payload = { LOBYTE(mask), HIBYTE(mask), 0 };
+    SMADataScheduler::instance().set_max_in_flight(targets.size());
+
+    std::vector<double> round_ms;
+    int failed = 0;
+    double pac_total = 0;
+    auto poll_start = SteadyClock::now();
+    for (int round = 0; round < rounds; round++) {
+        auto round_start = SteadyClock::now();
+        std::vector<std::shared_ptr<bool>> scanned;
+        std::vector<std::future<int>> pending;
+        for (TNetDevice* dev : targets) {
+            auto request = std::make_shared<SMADataRequest>(TNetDevice_GetNetAddr(dev), CMD_GET_DATA);
+            auto ok = std::make_shared<bool>(false);
+            request->set_flags(dev->prodID);
+            request->set_timeout(1, 0);
+            request->set_payload(payload.data(), (DWORD)payload.size());
+            request->set_receive_handler([dev, ok](WORD source, const BYTE* data, DWORD size) {
+                *ok = TStateChanReader_ScanUpdateValue(dev, (BYTE*)data, size) == 0;
+            });
+            scanned.push_back(ok);
+            pending.push_back(SMADataScheduler::instance().submit(request, PRIORITY_NORMAL));
+        }
+
+        pac_total = 0;
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (pending[i].get() != YE_OK || !*scanned[i]) {
+                failed++;
+                continue;
+            }
+            pac_total += TChannel_GetValue(pac_channels[i], targets[i], 0);
+        }
+        round_ms.push_back(std::chrono::duration<double, std::milli>(SteadyClock::now() - round_start).count());
+    }
+    double poll_s = std::chrono::duration<double>(SteadyClock::now() - poll_start).count();
+
+    int answers = 0;
+    for (SimInverter* inverter : inverters) {
+        answers += inverter->answers;
+    }
+
+    printf("poll rounds: %d, inverters per round %d, failed reads %d, %.1f rounds/s\n",
+           rounds, (int)targets.size(), failed, poll_s > 0 ? rounds / poll_s : 0.0);
+    printf("round ms: p50 %.1f, max %.1f (%.2f ms per inverter)\n",
+           percentile(round_ms, 0.5), percentile(round_ms, 1.0),
+           targets.empty() ? 0.0 : percentile(round_ms, 0.5) / targets.size());
+    printf("last plant Pac %.0f W, datagrams answered %d\n", pac_total, answers);
+
+    yasdiMasterShutdown();
+    running = false;
+    server.join();
+    for (SimInverter* inverter : inverters) {
+        inverter->close_sockets();
+        delete inverter;
+    }
+    unlink(ini);
+    return 0;
+}
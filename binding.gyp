@@ -1,10 +1,66 @@
 {
   "targets": [
+    {
+      "target_name": "inverter_engine",
+      "type": "static_library",
+      "sources": [
+        "src/smadata_request.cc",
+        "src/history_store.cc",
+        "src/bulk_transfer.cc",
+        "src/bus_sniffer.cc",
+        "src/change_waiters.cc",
+        "src/channel_codec.cc",
+        "src/channel_values.cc",
+        "src/device_groups.cc",
+        "src/packet_listeners.cc",
+        "src/plant_lock.cc",
+        "src/live_table.cc",
+        "src/device_registry.cc",
+        "src/hazard_pointers.cc",
+        "src/value_cache.cc",
+        "src/work_pool.cc",
+        "src/poll_pipeline.cc",
+        "src/power_controller.cc",
+        "src/freshness_scheduler.cc",
+        "src/clock.cc",
+        "src/event_sim.cc",
+        "src/mem_stats.cc",
+        "src/op_batch.cc",
+        "src/protocol_stats.cc",
+        "src/receive_times.cc",
+        "src/device_reader.cc",
+        "src/aggregate_query.cc",
+        "src/peer_analytics.cc",
+        "src/state_handoff.cc",
+        "src/inverter_engine.cc"
+      ],
+      "include_dirs": [
+        "driver",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/include",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/core",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/smalib",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/os",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/protocol",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/master",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/libs",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/incprj",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/build-gcc"
+      ],
+      "cflags": [ "-fPIC" ],
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "direct_dependent_settings": {
+        "include_dirs": [ "src" ]
+      }
+    },
     {
       "target_name": "inverter_sdk",
-      "sources": [ "src/inverter_wrapper.cc" ],
+      "sources": [
+        "src/inverter_wrapper.cc"
+      ],
       "include_dirs": [
         "<!@(node -p \"require('node-addon-api').include\")",
+        "driver",
         "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/include",
         "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/core",
         "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/smalib",
@@ -16,7 +72,8 @@
         "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/build-gcc"
       ],
       "dependencies": [
-        "<!(node -p \"require('node-addon-api').gyp\")"
+        "<!(node -p \"require('node-addon-api').gyp\")",
+        "inverter_engine"
       ],
       "cflags!": [ "-fno-exceptions" ],
       "cflags_cc!": [ "-fno-exceptions" ],
@@ -26,6 +83,90 @@
         "-lyasdi",
         "-lyasdimaster"
       ]
+    },
+    {
+      "target_name": "yasdi_drv_tcp",
+      "type": "shared_library",
+      "product_prefix": "lib",
+      "sources": [
+        "driver/tcp_serial.c"
+      ],
+      "include_dirs": [
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/include",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/core",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/smalib",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/os",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/protocol",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/incprj",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/build-gcc"
+      ],
+      "libraries": [
+        "-L<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/lib",
+        "-lyasdi",
+        "-lpthread"
+      ]
+    },
+    {
+      "target_name": "yasdi_drv_udp",
+      "type": "shared_library",
+      "product_prefix": "lib",
+      "sources": [
+        "driver/udp_multicast.c"
+      ],
+      "include_dirs": [
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/include",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/core",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/smalib",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/os",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/protocol",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/incprj",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/build-gcc"
+      ],
+      "libraries": [
+        "-L<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/lib",
+        "-lyasdi"
+      ]
+    },
+    {
+      "target_name": "native_tests",
+      "type": "executable",
+      "sources": [
+        "test/native/native_test.cc",
+        "test/native/aggregate_query_test.cc",
+        "test/native/bulk_transfer_test.cc",
+        "test/native/change_waiters_test.cc",
+        "test/native/freshness_plan_test.cc",
+        "test/native/handoff_codec_test.cc",
+        "test/native/live_table_test.cc",
+        "test/native/memory_plant.cc",
+        "test/native/power_control_law_test.cc",
+        "test/native/read_path_test.cc",
+        "test/native/smadata_scheduler_test.cc",
+        "test/native/value_cache_test.cc"
+      ],
+      "include_dirs": [
+        "driver",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/include",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/core",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/smalib",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/os",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/protocol",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/master",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/libs",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/incprj",
+        "<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/projects/generic-cmake/build-gcc"
+      ],
+      "dependencies": [
+        "inverter_engine"
+      ],
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "libraries": [
+        "-L<!(node -p \"process.env.YASDI_SDK_PATH || './yasdi/'\")/lib",
+        "-lyasdimaster",
+        "-lyasdi",
+        "-lpthread"
+      ]
     }
   ]
-}
\ No newline at end of file
+}
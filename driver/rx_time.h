@@ -0,0 +1,30 @@
+#ifndef RX_TIME_H
+#define RX_TIME_H
+
+/*
+ * IoCtrls of the bus drivers in this directory.
+ *
+ * IOCTRL_GET_RX_TIME: when did the bytes of the last Read() arrive. YASDI
+ * parses the bytes of a Read() before it reads again, on the same thread,
+ * so asked from a packet listener this is the receive time of the frame
+ * the listener got.
+ *
+ * IOCTRL_SET_LISTEN_ONLY: while set, Write() drops every frame and the
+ * driver never transmits; it still receives what other masters on the bus
+ * send and get. ListenOnly=1 in the driver's section keeps it set.
+ */
+enum
+{
+   IOCTRL_GET_RX_TIME     = 0x5258, /* params: TRxTime *, returns 0          */
+   IOCTRL_SET_LISTEN_ONLY = 0x4C4F, /* params: DWORD * (0 or 1), returns 0   */
+};
+
+typedef struct
+{
+   unsigned long long qRxTime;      /* ns since the epoch the bytes were received,
+                                       0 before the first Read()                  */
+   unsigned long long qReadTime;    /* CLOCK_MONOTONIC ns of that Read(); tells
+                                       which bus YASDI read from last             */
+} TRxTime;
+
+#endif
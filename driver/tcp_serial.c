@@ -0,0 +1,823 @@
+/**************************************************************************
+*
+*  tcp_serial.c:
+*  YASDI bus driver for RS485 buses behind serial device servers
+*  (RS485-to-Ethernet converters) in raw TCP mode. Replaces a virtual tty
+*  (socat) between YASDI and the converter.
+*
+*  Configuration, one section per converter port (TCP0 ... TCP254):
+*
+*     [DriverModules]
+*     Driver0=yasdi_drv_tcp
+*
+*     [TCP1]
+*     Host=192.168.1.50
+*     Port=4001
+*     Protocol=SMANet
+*     ReconnectMin=250         ; optional, ms
+*     ReconnectMax=30000       ; optional, ms
+*     ListenOnly=0             ; optional, 1: never send, see rx_time.h
+*
+*  One IO thread per bus waits in epoll on the socket. It connects with
+*  TCP_NODELAY, moves received bytes into a ring as soon as they arrive
+*  (YASDI's receiver only polls Read()), flushes pipelined frames when the
+*  socket takes more, and reconnects with a doubling backoff. Write() only
+*  queues the frame and never waits for the network.
+*
+*  Received bytes are stamped when recv() returns them (CLOCK_MONOTONIC
+*  plus the wall clock offset of the connect), not when YASDI polls. The
+*  stamp of the last byte Read() handed out is available through
+*  IoCtrl(IOCTRL_GET_RX_TIME), see rx_time.h.
+*
+*  Listening only (IOCTRL_SET_LISTEN_ONLY or ListenOnly=1), Write() drops
+*  every frame; the server still forwards everything other masters on the
+*  RS485 bus send and get.
+*
+***************************************************************************/
+
+#include "os.h"
+#include "debug.h"
+#include "smadef.h"
+#include "repository.h"
+#include "device.h"
+#include "driver_layer.h"
+#include "netpacket.h"
+#include "tcp_serial.h"
+#include "rx_time.h"
+#include "copyright.h"
+#include "version.h"
+
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+
+/**************************************************************************
+***** LOCAL - Prototyps ***************************************************
+***************************************************************************/
+
+static void * tcpser_thread(void * arg);
+static void tcpser_connect(TDevice * dev);
+static void tcpser_disconnect(TDevice * dev);
+static void tcpser_flush(TDevice * dev);
+static void tcpser_arm(TDevice * dev);
+static void tcpser_mark(TDevice * dev, unsigned long long start);
+
+int (*RegisterDevice)(TDevice * newdev);
+
+
+/**************************************************************************
+***** MACROS  *************************************************************
+***************************************************************************/
+
+#define CREATE_VAR_THIS(d,interface) interface this = (void*)((d)->priv)
+
+
+/**************************************************************************
+***** IMPLEMENTATION ******************************************************
+***************************************************************************/
+
+static unsigned long long tcpser_clock(clockid_t clock)
+{
+   struct timespec ts;
+   clock_gettime(clock, &ts);
+   return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long tcpser_now( void )
+{
+   return tcpser_clock(CLOCK_MONOTONIC) / 1000000;
+}
+
+
+/**************************************************************************
+   Description   : Open this device: start the IO thread, which connects
+                   in the background. Frames written before the
+                   connection is up are dropped, YASDI repeats its requests.
+   Parameter     : dev Instance pointer of Bus driver
+   Return-Value  : TRUE if the IO thread runs
+**************************************************************************/
+SHARED_FUNCTION BOOL tcpser_open(TDevice * dev)
+{
+   struct epoll_event ev;
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   YASDI_DEBUG((VERBOSE_HWL,"TcpSerial::open('%s', %s:%d)\n", dev->cName, this->cHost, this->iPort));
+
+   if (dev->DeviceState == DS_ONLINE)
+   {
+      return TRUE;
+   }
+
+   this->epfd   = epoll_create1(EPOLL_CLOEXEC);
+   this->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (this->epfd < 0 || this->wakefd < 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "TcpSerial: Unable to create epoll instance for '%s'\n", dev->cName));
+      goto err;
+   }
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events  = EPOLLIN;
+   ev.data.fd = this->wakefd;
+   epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->wakefd, &ev);
+
+   this->fd          = -1;
+   this->bConnecting = FALSE;
+   this->rxHead      = 0;
+   this->rxCount     = 0;
+   this->qRxIn       = 0;
+   this->qRxOut      = 0;
+   this->markHead    = 0;
+   this->markCount   = 0;
+   this->qRxTime     = 0;
+   this->qReadTime   = 0;
+   this->txCount     = 0;
+   this->dBackoff    = this->dReconnectMin;
+   this->nextConnect = 0;
+   this->bRunning    = TRUE;
+
+   if (pthread_create(&this->thread, NULL, tcpser_thread, dev) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "TcpSerial: Unable to start IO thread for '%s'\n", dev->cName));
+      this->bRunning = FALSE;
+      goto err;
+   }
+
+   dev->DeviceState = DS_ONLINE;
+   return TRUE;
+
+err:
+   if (this->epfd >= 0)   close(this->epfd);
+   if (this->wakefd >= 0) close(this->wakefd);
+   this->epfd   = -1;
+   this->wakefd = -1;
+   return FALSE;
+}
+
+
+/**************************************************************************
+   Description   : Close Bus Driver: stop the IO thread and the connection
+   Parameter     : dev Instance pointer of Bus driver
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void tcpser_release(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   if (this->bRunning)
+   {
+      uint64_t one = 1;
+      this->bRunning = FALSE;
+      if (write(this->wakefd, &one, sizeof(one)) < 0)
+      {
+         YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: Unable to wake IO thread of '%s'\n", dev->cName));
+      }
+      pthread_join(this->thread, NULL);
+   }
+
+   if (this->fd >= 0)
+   {
+      close(this->fd);
+      this->fd = -1;
+   }
+   if (this->epfd >= 0)   close(this->epfd);
+   if (this->wakefd >= 0) close(this->wakefd);
+   this->epfd   = -1;
+   this->wakefd = -1;
+
+   /* device in state offline now */
+   dev->DeviceState = DS_OFFLINE;
+}
+
+
+/**************************************************************************
+   Description   : Write a frame: queue it behind the frames the socket has
+                   not taken yet and send what the socket takes right now.
+                   The IO thread sends the rest (write pipelining).
+   Parameter     : dev = Driver instance, frame = the frame to send
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void tcpser_write(TDevice * dev,
+                                  struct TNetPacket * frame,
+                                  DWORD DriverDeviceHandle,
+                                  TDriverSendFlags flags)
+{
+   BYTE * framedata = NULL;
+   WORD framedatasize = 0;
+   DWORD size = 0;
+   BOOL queued;
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   UNUSED_VAR(DriverDeviceHandle);
+   UNUSED_VAR(flags);
+
+   if (dev->DeviceState != DS_ONLINE)
+   {
+      YASDI_DEBUG((VERBOSE_HWL,"TcpSerial: Nothing send. Bus driver '%s' is offline.\n", dev->cName));
+      return;
+   }
+
+   FOREACH_IN_BUFFER(frame, framedata, &framedatasize)
+   {
+      size += framedatasize;
+   }
+
+   pthread_mutex_lock(&this->lock);
+
+   if (this->bListenOnly)
+   {
+      this->dFramesSuppressed++;
+      pthread_mutex_unlock(&this->lock);
+      return;
+   }
+
+   if (this->fd < 0 || this->bConnecting || this->txCount + size > TCPSER_TX_SIZE)
+   {
+      this->dBytesDropped += size;
+      pthread_mutex_unlock(&this->lock);
+      YASDI_DEBUG((VERBOSE_HWL,"TcpSerial: Frame of %lu bytes dropped, '%s' is not connected or congested.\n",
+                   (unsigned long)size, dev->cName));
+      return;
+   }
+
+   /* the IO thread already waits for the socket if older frames are queued */
+   queued = this->txCount > 0;
+   FOREACH_IN_BUFFER(frame, framedata, &framedatasize)
+   {
+      memcpy(&this->tx[this->txCount], framedata, framedatasize);
+      this->txCount += framedatasize;
+   }
+
+   if (!queued)
+   {
+      tcpser_flush(dev);
+      if (this->txCount > 0)
+      {
+         tcpser_arm(dev);
+      }
+   }
+
+   pthread_mutex_unlock(&this->lock);
+}
+
+
+/**************************************************************************
+   Description   : Read received bytes; they were already taken from the
+                   socket by the IO thread
+   Parameter     : dev = Driver instance
+                   DestBuffer = pointer to buffer to store bytes in
+                   dBufferSize = max size of buffer
+   Return-Value  : count of bytes read
+**************************************************************************/
+SHARED_FUNCTION DWORD tcpser_read(TDevice * dev,
+                                  BYTE * DestBuffer,
+                                  DWORD dBufferSize,
+                                  DWORD * DriverDevHandle)
+{
+   DWORD count;
+   DWORD first;
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   UNUSED_VAR(DriverDevHandle);
+
+   if (dev->DeviceState != DS_ONLINE)
+   {
+      return 0;
+   }
+
+   pthread_mutex_lock(&this->lock);
+
+   count = min(dBufferSize, this->rxCount);
+   first = min(count, TCPSER_RX_SIZE - this->rxHead);
+   memcpy(DestBuffer, &this->rx[this->rxHead], first);
+   memcpy(DestBuffer + first, this->rx, count - first);
+   this->rxHead   = (this->rxHead + count) % TCPSER_RX_SIZE;
+   this->rxCount -= count;
+   this->qRxOut  += count;
+
+   /* receive time of the last byte handed out */
+   while (count > 0 && this->markCount > 0)
+   {
+      struct TTcpSerialMark * mark = &this->marks[this->markHead];
+      if (mark->qStart >= this->qRxOut)
+      {
+         break;
+      }
+      this->qRxTime = mark->qTime + this->qWallOffset;
+      if (mark->qEnd > this->qRxOut)
+      {
+         break;
+      }
+      this->markHead = (this->markHead + 1) % TCPSER_RX_MARKS;
+      this->markCount--;
+   }
+   if (count > 0)
+   {
+      this->qReadTime = tcpser_clock(CLOCK_MONOTONIC);
+   }
+
+   pthread_mutex_unlock(&this->lock);
+
+   return count;
+}
+
+
+/**************************************************************************
+   Description   : Send queued frames as far as the socket takes them.
+                   Called with the lock held.
+**************************************************************************/
+static void tcpser_flush(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   while (this->txCount > 0)
+   {
+      ssize_t sent = send(this->fd, this->tx, this->txCount, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (sent > 0)
+      {
+         memmove(this->tx, &this->tx[sent], this->txCount - sent);
+         this->txCount         -= (DWORD)sent;
+         this->dBytesSendTotal += (DWORD)sent;
+      }
+      else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+         break;
+      }
+      else if (sent < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      else
+      {
+         /* the IO thread sees the hang up and reconnects */
+         YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: send to '%s' failed (errno=%d)\n", dev->cName, errno));
+         shutdown(this->fd, SHUT_RDWR);
+         this->txCount = 0;
+         break;
+      }
+   }
+}
+
+
+/**************************************************************************
+   Description   : Wait for output space only while frames are queued or
+                   the connect is in progress. Called with the lock held.
+**************************************************************************/
+static void tcpser_arm(TDevice * dev)
+{
+   struct epoll_event ev;
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events  = EPOLLIN | ((this->txCount > 0 || this->bConnecting) ? EPOLLOUT : 0);
+   ev.data.fd = this->fd;
+   epoll_ctl(this->epfd, EPOLL_CTL_MOD, this->fd, &ev);
+}
+
+
+/**************************************************************************
+   Description   : Remember when the bytes from "start" on were received.
+                   Called with the lock held.
+**************************************************************************/
+static void tcpser_mark(TDevice * dev, unsigned long long start)
+{
+   struct TTcpSerialMark * mark;
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   if (this->qRxIn == start)
+   {
+      return;
+   }
+
+   if (this->markCount == TCPSER_RX_MARKS)
+   {
+      /* YASDI is far behind: the newest mark takes the new bytes as well */
+      mark = &this->marks[(this->markHead + this->markCount - 1) % TCPSER_RX_MARKS];
+   }
+   else
+   {
+      mark = &this->marks[(this->markHead + this->markCount) % TCPSER_RX_MARKS];
+      mark->qStart = start;
+      this->markCount++;
+   }
+   mark->qEnd  = this->qRxIn;
+   mark->qTime = tcpser_clock(CLOCK_MONOTONIC);
+}
+
+
+/**************************************************************************
+   Description   : Start a non blocking connect to the serial server.
+                   Runs on the IO thread without the lock, the host name
+                   lookup may block.
+**************************************************************************/
+static void tcpser_connect(TDevice * dev)
+{
+   struct addrinfo hints;
+   struct addrinfo * result = NULL;
+   struct addrinfo * ai;
+   char cPort[8];
+   int fd = -1;
+   BOOL bConnecting = FALSE;
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family   = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   sprintf(cPort, "%d", this->iPort);
+
+   if (getaddrinfo(this->cHost, cPort, &hints, &result) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: Unable to resolve '%s'\n", this->cHost));
+      result = NULL;
+   }
+
+   for (ai = result; ai != NULL; ai = ai->ai_next)
+   {
+      int on = 1;
+      int idle = 10, interval = 5, count = 3;
+
+      fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+      if (fd < 0)
+      {
+         continue;
+      }
+
+      /* every frame goes out at once; dead converters are noticed within ~25s */
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,   &on,       sizeof(on));
+      setsockopt(fd, SOL_SOCKET,  SO_KEEPALIVE,  &on,       sizeof(on));
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE,  &idle,     sizeof(idle));
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+      setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,   &count,    sizeof(count));
+
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+      {
+         break;
+      }
+      if (errno == EINPROGRESS)
+      {
+         bConnecting = TRUE;
+         break;
+      }
+
+      close(fd);
+      fd = -1;
+   }
+
+   if (result)
+   {
+      freeaddrinfo(result);
+   }
+
+   pthread_mutex_lock(&this->lock);
+   if (fd < 0)
+   {
+      tcpser_disconnect(dev);
+   }
+   else
+   {
+      struct epoll_event ev;
+      memset(&ev, 0, sizeof(ev));
+      ev.events  = EPOLLIN | EPOLLOUT;
+      ev.data.fd = fd;
+      epoll_ctl(this->epfd, EPOLL_CTL_ADD, fd, &ev);
+
+      this->fd          = fd;
+      this->bConnecting = bConnecting;
+      this->qWallOffset = (long long)(tcpser_clock(CLOCK_REALTIME) - tcpser_clock(CLOCK_MONOTONIC));
+      if (!bConnecting)
+      {
+         this->dConnects++;
+         this->dBackoff = this->dReconnectMin;
+         tcpser_arm(dev);
+      }
+   }
+   pthread_mutex_unlock(&this->lock);
+}
+
+
+/**************************************************************************
+   Description   : Drop the connection and schedule the next attempt with
+                   a doubled delay. Called with the lock held.
+**************************************************************************/
+static void tcpser_disconnect(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   if (this->fd >= 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: '%s' disconnected, reconnect in %lu ms\n",
+                   dev->cName, (unsigned long)this->dBackoff));
+      epoll_ctl(this->epfd, EPOLL_CTL_DEL, this->fd, NULL);
+      close(this->fd);
+      this->fd = -1;
+   }
+
+   /* half received frames are garbage after a reconnect */
+   this->bConnecting = FALSE;
+   this->txCount     = 0;
+   this->nextConnect = tcpser_now() + this->dBackoff;
+   this->dBackoff    = min(this->dBackoff * 2, this->dReconnectMax);
+}
+
+
+/**************************************************************************
+   Description   : Socket is ready: finish the connect, take the received
+                   bytes, send queued frames. Runs on the IO thread.
+**************************************************************************/
+static void tcpser_on_socket(TDevice * dev, DWORD events)
+{
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   pthread_mutex_lock(&this->lock);
+
+   if (this->bConnecting)
+   {
+      int error = 0;
+      socklen_t len = sizeof(error);
+      getsockopt(this->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+      if (error != 0)
+      {
+         YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: Connect of '%s' to %s:%d failed (errno=%d)\n",
+                      dev->cName, this->cHost, this->iPort, error));
+         tcpser_disconnect(dev);
+         pthread_mutex_unlock(&this->lock);
+         return;
+      }
+      if (events & EPOLLOUT)
+      {
+         YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: '%s' connected to %s:%d\n", dev->cName, this->cHost, this->iPort));
+         this->bConnecting = FALSE;
+         this->dConnects++;
+         this->dBackoff = this->dReconnectMin;
+      }
+   }
+
+   if (events & EPOLLIN)
+   {
+      unsigned long long start = this->qRxIn;
+      for (;;)
+      {
+         BYTE drop[256];
+         DWORD tail = (this->rxHead + this->rxCount) % TCPSER_RX_SIZE;
+         DWORD space = min(TCPSER_RX_SIZE - this->rxCount, TCPSER_RX_SIZE - tail);
+         /* like an UART overrun: bytes nobody picked up in time are lost */
+         BYTE * dest = space > 0 ? &this->rx[tail] : drop;
+         ssize_t got = recv(this->fd, dest, space > 0 ? space : sizeof(drop), MSG_DONTWAIT);
+
+         if (got > 0)
+         {
+            this->dBytesReadTotal += (DWORD)got;
+            if (space > 0)
+            {
+               this->rxCount += (DWORD)got;
+               this->qRxIn   += (DWORD)got;
+            }
+            continue;
+         }
+         if (got < 0 && errno == EINTR)
+         {
+            continue;
+         }
+         if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+         {
+            tcpser_disconnect(dev);
+            pthread_mutex_unlock(&this->lock);
+            return;
+         }
+         break;
+      }
+      tcpser_mark(dev, start);
+   }
+
+   if (events & (EPOLLERR | EPOLLHUP))
+   {
+      tcpser_disconnect(dev);
+      pthread_mutex_unlock(&this->lock);
+      return;
+   }
+
+   if (!this->bConnecting)
+   {
+      tcpser_flush(dev);
+      tcpser_arm(dev);
+   }
+
+   pthread_mutex_unlock(&this->lock);
+}
+
+
+/**************************************************************************
+   Description   : IO thread of one bus: connect, reconnect and move data
+**************************************************************************/
+static void * tcpser_thread(void * arg)
+{
+   TDevice * dev = (TDevice *)arg;
+   struct epoll_event events[4];
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   while (this->bRunning)
+   {
+      int timeout = -1;
+      int i, n;
+
+      /* only this thread changes the socket, no lock needed to look at it */
+      if (this->fd < 0)
+      {
+         unsigned long long now = tcpser_now();
+         if (now >= this->nextConnect)
+         {
+            tcpser_connect(dev);
+            now = tcpser_now();
+         }
+         if (this->fd < 0)
+         {
+            timeout = this->nextConnect > now ? (int)(this->nextConnect - now) : 0;
+         }
+      }
+
+      n = epoll_wait(this->epfd, events, sizeof(events) / sizeof(events[0]), timeout);
+      for (i = 0; i < n; i++)
+      {
+         if (events[i].data.fd == this->wakefd)
+         {
+            continue;
+         }
+         if (events[i].data.fd == this->fd)
+         {
+            tcpser_on_socket(dev, events[i].events);
+         }
+      }
+   }
+
+   return NULL;
+}
+
+
+/**************************************************************************
+   Description   : Driver specific commands, see rx_time.h
+   Parameter     : dev = Driver instance, cmd = command,
+                   params = TRxTime * or DWORD *
+   Return-Value  : 0 or IOCTRL_UNKNOWN_CMD
+**************************************************************************/
+SHARED_FUNCTION int tcpser_ioctrl(TDevice * dev, int cmd, BYTE * params)
+{
+   CREATE_VAR_THIS(dev, struct TTcpSerialPriv *);
+
+   if (params == NULL || (cmd != IOCTRL_GET_RX_TIME && cmd != IOCTRL_SET_LISTEN_ONLY))
+   {
+      return IOCTRL_UNKNOWN_CMD;
+   }
+
+   pthread_mutex_lock(&this->lock);
+   if (cmd == IOCTRL_GET_RX_TIME)
+   {
+      TRxTime * rxtime = (TRxTime *)params;
+      rxtime->qRxTime   = this->qRxTime;
+      rxtime->qReadTime = this->qReadTime;
+   }
+   else
+   {
+      this->bListenOnly = *(DWORD *)params != 0 || this->bListenOnlyConfig;
+   }
+   pthread_mutex_unlock(&this->lock);
+   return 0;
+}
+
+
+/**************************************************************************
+   Description   : Return the "Maximum Transmit Unit" of this bus device
+**************************************************************************/
+int tcpser_GetMTU(TDevice * dev)
+{
+   UNUSED_VAR(dev);
+   return 255;
+}
+
+
+/**************************************************************************
+   Description   : Device constructor: Create ONE instance of device
+   Parameter     : Unit (for identification in profile section)
+   Return-Value  : Pointer to instance or zero
+**************************************************************************/
+TDevice * tcpser_create(DWORD dUnit)
+{
+   TDevice * interface;
+   struct TTcpSerialPriv * priv;
+   char cConfigPath[64];
+
+   interface = (void*)malloc(sizeof( TDevice ));
+   priv      = (void*)malloc(sizeof( struct TTcpSerialPriv ));
+
+   if (interface && priv)
+   {
+      memset(interface, 0, sizeof(TDevice));
+      memset(priv, 0, sizeof(struct TTcpSerialPriv));
+      interface->priv = priv;
+      interface->DeviceState = DS_OFFLINE;
+      priv->fd     = -1;
+      priv->epfd   = -1;
+      priv->wakefd = -1;
+      pthread_mutex_init(&priv->lock, NULL);
+
+      interface->Open   = tcpser_open;
+      interface->Close  = tcpser_release;
+      interface->Write  = tcpser_write;
+      interface->Read   = tcpser_read;
+      interface->GetMTU = tcpser_GetMTU;
+      interface->IoCtrl = tcpser_ioctrl;
+
+      sprintf(interface->cName, "TCP%lu", (unsigned long)dUnit); // bus driver name
+
+      /*
+       * Read Settings from configuration
+       */
+      sprintf(cConfigPath, "%s.Host", interface->cName);
+      TRepository_GetElementStr(cConfigPath, "127.0.0.1", priv->cHost, sizeof(priv->cHost));
+
+      sprintf(cConfigPath, "%s.Port", interface->cName);
+      priv->iPort = TRepository_GetElementInt(cConfigPath, TCPSER_DEFAULT_PORT);
+
+      sprintf(cConfigPath, "%s.ReconnectMin", interface->cName);
+      priv->dReconnectMin = TRepository_GetElementInt(cConfigPath, TCPSER_RECONNECT_MIN);
+
+      sprintf(cConfigPath, "%s.ReconnectMax", interface->cName);
+      priv->dReconnectMax = TRepository_GetElementInt(cConfigPath, TCPSER_RECONNECT_MAX);
+      if (priv->dReconnectMax < priv->dReconnectMin)
+      {
+         priv->dReconnectMax = priv->dReconnectMin;
+      }
+
+      sprintf(cConfigPath, "%s.ListenOnly", interface->cName);
+      priv->bListenOnlyConfig = TRepository_GetElementInt(cConfigPath, 0) != 0;
+      priv->bListenOnly = priv->bListenOnlyConfig;
+
+      YASDI_DEBUG((VERBOSE_HWL, "TcpSerial: %s = %s:%d\n", interface->cName, priv->cHost, priv->iPort));
+
+      /*
+      ** register this new bus device driver in the YASDI core
+      */
+      (*RegisterDevice)( interface );
+   }
+   else
+   {
+      free(interface);
+      free(priv);
+      interface = NULL;
+   }
+
+   return interface;
+}
+
+
+/**************************************************************************
+   Description   : Create all instances configured in the profile
+**************************************************************************/
+void tcpser_create_all()
+{
+   int i;
+
+   for(i = 0; i < 255; i++)
+   {
+      char ConfigPath[50];
+      sprintf(ConfigPath, "TCP%d.Host", i);
+      if (TRepository_GetIsElementExist(ConfigPath))
+      {
+         tcpser_create(i);
+      }
+   }
+}
+
+
+/**************************************************************************
+   Description   : Init driver module
+   Parameter     : ---
+   Return-Value  : == 0 => ok
+**************************************************************************/
+SHARED_FUNCTION int InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback )
+{
+   UNUSED_VAR(eventCallback);
+
+   YASDI_DEBUG((VERBOSE_MESSAGE,"YASDI TCP Serial Server Driver for %s V" LIB_YASDI_VERSION "\n"
+                "Compile time: " __TIME__  " " __DATE__ "\n\n",
+                os_GetOSIdentifier()));
+
+   /* store functions for registration... */
+   RegisterDevice = RegFuncPtr;
+
+   tcpser_create_all();
+
+   return 0; /* 0 => ok */
+}
+
+
+/**************************************************************************
+   Description   : Deinit driver module
+**************************************************************************/
+SHARED_FUNCTION void CleanupYasdiModule(void)
+{
+   YASDI_DEBUG((VERBOSE_HWL,"TCP Serial Server Driver: bye bye...\n"));
+}
@@ -0,0 +1,67 @@
+#ifndef TCP_SERIAL_H
+#define TCP_SERIAL_H
+
+#include <pthread.h>
+
+enum
+{
+   TCPSER_RX_SIZE        = 4096,  /* receive ring, filled by the IO thread        */
+   TCPSER_TX_SIZE        = 4096,  /* frames not yet taken by the socket           */
+   TCPSER_DEFAULT_PORT   = 4001,  /* raw TCP port of most serial device servers   */
+   TCPSER_RECONNECT_MIN  = 250,   /* ms before the first reconnect                */
+   TCPSER_RECONNECT_MAX  = 30000, /* ms, upper bound of the doubling backoff      */
+   TCPSER_RX_MARKS       = 32,    /* receive times of bytes still in the ring     */
+};
+
+/* bytes [qStart, qEnd) of the receive stream came with one wakeup */
+struct TTcpSerialMark
+{
+   unsigned long long qStart;
+   unsigned long long qEnd;
+   unsigned long long qTime;    /* monotonic ns when recv() returned them        */
+};
+
+/* unit structure (Instance of class) */
+struct TTcpSerialPriv
+{
+   char cHost[64];              /* serial server host name or address            */
+   int iPort;                   /* TCP port of the RS485 port on the server      */
+
+   int fd;                      /* socket, -1 while disconnected                 */
+   BOOL bConnecting;            /* non blocking connect in progress              */
+   int epfd;                    /* epoll instance of the IO thread               */
+   int wakefd;                  /* eventfd to stop the IO thread                 */
+   pthread_t thread;            /* IO thread                                     */
+   BOOL bRunning;
+   pthread_mutex_t lock;        /* everything below and the socket               */
+
+   BYTE rx[TCPSER_RX_SIZE];     /* received bytes, ring                          */
+   DWORD rxHead;                /* next byte to hand to YASDI                    */
+   DWORD rxCount;               /* bytes in the ring                             */
+   unsigned long long qRxIn;    /* bytes put into the ring since open            */
+   unsigned long long qRxOut;   /* bytes handed to YASDI since open              */
+   struct TTcpSerialMark marks[TCPSER_RX_MARKS];
+   DWORD markHead;
+   DWORD markCount;
+   long long qWallOffset;       /* CLOCK_REALTIME - CLOCK_MONOTONIC in ns        */
+   unsigned long long qRxTime;  /* receive time of the last byte handed out, ns  */
+   unsigned long long qReadTime;/* monotonic ns of the last Read() with bytes    */
+
+   BYTE tx[TCPSER_TX_SIZE];     /* pipelined frames waiting for the socket       */
+   DWORD txCount;
+   BOOL bListenOnlyConfig;      /* ListenOnly=1, the IoCtrl cannot clear it      */
+   BOOL bListenOnly;            /* Write() drops every frame                     */
+
+   DWORD dBackoff;              /* current reconnect delay in ms                 */
+   DWORD dReconnectMin;
+   DWORD dReconnectMax;
+   unsigned long long nextConnect; /* monotonic ms of the next connect attempt   */
+
+   DWORD dBytesSendTotal;       /* total bytes send                              */
+   DWORD dBytesReadTotal;       /* total bytes received                          */
+   DWORD dBytesDropped;         /* frames dropped while disconnected or full     */
+   DWORD dFramesSuppressed;     /* frames not send while listening only          */
+   DWORD dConnects;             /* successful connects                           */
+};
+
+#endif
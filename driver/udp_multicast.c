@@ -0,0 +1,577 @@
+/**************************************************************************
+*
+*  udp_multicast.c:
+*  YASDI bus driver for SMAData1 over UDP, the framing yasdi_drv_ip uses:
+*  one SMANet frame per datagram. It reaches devices and gateways that
+*  take SMAData1 over IP, and the loopback plant of bench/udp_plant_loop.cc.
+*  It is no Speedwire (SMA-Net2) driver: Speedwire inverters speak
+*  SMAData2+ in their own framing on 239.12.255.254:9522 and do not answer
+*  SMAData1 frames, so YASDI cannot reach them through any driver.
+*
+*  Unlike yasdi_drv_ip, which only knows the devices listed in its
+*  configuration, this driver finds the devices itself. Every broadcast
+*  frame (device detection, SYN_ONLINE, group commands) goes out as one
+*  multicast datagram. The devices that answer are remembered, and frames
+*  for one device are then sent to it directly. The driver joins the group
+*  as well, so frames sent to the group on the local port arrive too.
+*
+*  Configuration, one section per network (UDP0 ... UDP254):
+*
+*     [DriverModules]
+*     Driver0=yasdi_drv_udp
+*
+*     [UDP1]
+*     Group=239.255.24.72       ; optional, multicast group of the devices
+*     Port=24272                ; optional, device port
+*     LocalPort=24273           ; optional, own port the devices answer to
+*     Interface=192.168.1.10    ; optional, local address to multicast from
+*     TTL=1                     ; optional, multicast hops
+*     ListenOnly=0              ; optional, 1: never send, see rx_time.h
+*     Protocol=SMANet
+*
+*  An answer always fits into one datagram, however many channel values
+*  it carries, so unlike a serial bus nothing is fragmented. The whole
+*  datagram is handed to YASDI in one Read().
+*
+*  The kernel stamps every datagram on arrival (SO_TIMESTAMPNS). The
+*  stamp of the datagram Read() handed out last is available through
+*  IoCtrl(IOCTRL_GET_RX_TIME), see rx_time.h.
+*
+*  Listening only (IOCTRL_SET_LISTEN_ONLY or ListenOnly=1), Write() drops
+*  every frame. Other masters' traffic only reaches this driver if the
+*  devices or a switch copy it to the local port, e.g. port mirroring.
+*
+***************************************************************************/
+
+#include "os.h"
+#include "debug.h"
+#include "smadef.h"
+#include "repository.h"
+#include "device.h"
+#include "driver_layer.h"
+#include "netpacket.h"
+#include "udp_multicast.h"
+#include "rx_time.h"
+#include "copyright.h"
+#include "version.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+
+/**************************************************************************
+***** LOCAL - Prototyps ***************************************************
+***************************************************************************/
+
+static DWORD udpmc_peer(TDevice * dev, struct sockaddr_in * addr);
+static void udpmc_send(TDevice * dev, struct sockaddr_in * addr, DWORD size);
+static unsigned long long udpmc_clock(clockid_t clock);
+
+int (*RegisterDevice)(TDevice * newdev);
+
+
+/**************************************************************************
+***** MACROS  *************************************************************
+***************************************************************************/
+
+#define CREATE_VAR_THIS(d,interface) interface this = (void*)((d)->priv)
+
+
+/**************************************************************************
+***** IMPLEMENTATION ******************************************************
+***************************************************************************/
+
+
+/**************************************************************************
+   Description   : Open this device: bind the local port, join the
+                   multicast group and set up sending to it
+   Parameter     : dev Instance pointer of Bus driver
+   Return-Value  : TRUE if the socket is ready
+**************************************************************************/
+SHARED_FUNCTION BOOL udpmc_open(TDevice * dev)
+{
+   struct sockaddr_in local;
+   struct in_addr iface;
+   struct ip_mreq membership;
+   unsigned char ttl;
+   int on = 1;
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   YASDI_DEBUG((VERBOSE_HWL,"UdpMulticast::open('%s', %s:%d)\n", dev->cName, this->cGroup, this->iPort));
+
+   if (dev->DeviceState == DS_ONLINE)
+   {
+      return TRUE;
+   }
+
+   memset(&this->group, 0, sizeof(this->group));
+   this->group.sin_family = AF_INET;
+   this->group.sin_port   = htons(this->iPort);
+   if (inet_pton(AF_INET, this->cGroup, &this->group.sin_addr) != 1 ||
+       !IN_MULTICAST(ntohl(this->group.sin_addr.s_addr)))
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "UdpMulticast: '%s' is no multicast group\n", this->cGroup));
+      return FALSE;
+   }
+
+   this->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+   if (this->fd < 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "UdpMulticast: Unable to create socket for '%s'\n", dev->cName));
+      return FALSE;
+   }
+
+   setsockopt(this->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+   memset(&local, 0, sizeof(local));
+   local.sin_family      = AF_INET;
+   local.sin_addr.s_addr = htonl(INADDR_ANY);
+   local.sin_port        = htons(this->iLocalPort);
+   if (bind(this->fd, (struct sockaddr *)&local, sizeof(local)) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "UdpMulticast: Unable to bind local port %d (errno=%d)\n",
+                   this->iLocalPort, errno));
+      goto err;
+   }
+
+   /* without an interface the routing table decides where multicasts go */
+   iface.s_addr = htonl(INADDR_ANY);
+   if (this->cInterface[0] != 0)
+   {
+      if (inet_pton(AF_INET, this->cInterface, &iface) != 1 ||
+          setsockopt(this->fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) != 0)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING, "UdpMulticast: Unable to multicast from '%s'\n", this->cInterface));
+         goto err;
+      }
+   }
+
+   /* frames sent to the group on the local port, e.g. by devices that
+      answer broadcasts to the group or by a master using the same port */
+   membership.imr_multiaddr = this->group.sin_addr;
+   membership.imr_interface = iface;
+   if (setsockopt(this->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "UdpMulticast: Unable to join %s on '%s' (errno=%d)\n",
+                   this->cGroup, dev->cName, errno));
+      goto err;
+   }
+
+   ttl = (unsigned char)this->iTTL;
+   setsockopt(this->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+   /* devices on the same host (simulators) must see the group too */
+   setsockopt(this->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &on, sizeof(on));
+
+   /* receive time of every datagram, taken by the kernel */
+   setsockopt(this->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+   this->dPeerCount = 0;
+   this->rxPos      = 0;
+   this->rxSize     = 0;
+   this->qRxTime    = 0;
+   this->qReadTime  = 0;
+
+   dev->DeviceState = DS_ONLINE;
+   return TRUE;
+
+err:
+   close(this->fd);
+   this->fd = -1;
+   return FALSE;
+}
+
+
+/**************************************************************************
+   Description   : Close Bus Driver
+   Parameter     : dev Instance pointer of Bus driver
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void udpmc_release(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   if (this->fd >= 0)
+   {
+      close(this->fd);
+      this->fd = -1;
+   }
+
+   /* device in state offline now */
+   dev->DeviceState = DS_OFFLINE;
+}
+
+
+/**************************************************************************
+   Description   : Write a frame. Broadcasts and frames for devices that
+                   did not answer yet go to the whole group, all other
+                   frames to the one device.
+   Parameter     : dev = Driver instance, frame = the frame to send
+                   DriverDeviceHandle = device from Read(), flags = DSF_*
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void udpmc_write(TDevice * dev,
+                                 struct TNetPacket * frame,
+                                 DWORD DriverDeviceHandle,
+                                 TDriverSendFlags flags)
+{
+   DWORD size;
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   if (dev->DeviceState != DS_ONLINE)
+   {
+      YASDI_DEBUG((VERBOSE_HWL,"UdpMulticast: Nothing send. Bus driver '%s' is offline.\n", dev->cName));
+      return;
+   }
+
+   if (this->bListenOnly)
+   {
+      this->dFramesSuppressed++;
+      return;
+   }
+
+   size = TNetPacket_GetFrameLength(frame);
+   if (size > sizeof(this->tx))
+   {
+      YASDI_DEBUG((VERBOSE_WARNING,"UdpMulticast: Frame of %lu bytes is too large, not send.\n",
+                   (unsigned long)size));
+      return;
+   }
+   TNetPacket_CopyFromBuffer(frame, this->tx);
+
+   if (flags == DSF_MONOCAST &&
+       DriverDeviceHandle != INVALID_DRIVER_DEVICE_HANDLE &&
+       DriverDeviceHandle <= this->dPeerCount)
+   {
+      udpmc_send(dev, &this->peers[DriverDeviceHandle - 1], size);
+   }
+   else
+   {
+      /* one datagram reaches every device, known or not */
+      this->dMulticasts++;
+      udpmc_send(dev, &this->group, size);
+   }
+}
+
+
+/**************************************************************************
+   Description   : Read the next datagram, or what is left of the last one
+   Parameter     : dev = Driver instance
+                   DestBuffer = pointer to buffer to store bytes in
+                   dBufferSize = max size of buffer
+                   DriverDeviceHandle = the device that sent the bytes
+   Return-Value  : count of bytes read
+**************************************************************************/
+SHARED_FUNCTION DWORD udpmc_read(TDevice * dev,
+                                 BYTE * DestBuffer,
+                                 DWORD dBufferSize,
+                                 DWORD * DriverDeviceHandle)
+{
+   DWORD count;
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   if (dev->DeviceState != DS_ONLINE)
+   {
+      return 0;
+   }
+
+   if (this->rxPos >= this->rxSize)
+   {
+      struct sockaddr_in source;
+      struct iovec iov;
+      struct msghdr msg;
+      struct cmsghdr * cmsg;
+      char control[CMSG_SPACE(sizeof(struct timespec))];
+      ssize_t got;
+
+      iov.iov_base = this->rx;
+      iov.iov_len  = sizeof(this->rx);
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name       = &source;
+      msg.msg_namelen    = sizeof(source);
+      msg.msg_iov        = &iov;
+      msg.msg_iovlen     = 1;
+      msg.msg_control    = control;
+      msg.msg_controllen = sizeof(control);
+
+      do
+      {
+         got = recvmsg(this->fd, &msg, MSG_DONTWAIT);
+      } while (got < 0 && errno == EINTR);
+
+      if (got <= 0)
+      {
+         return 0;
+      }
+
+      /* without a kernel stamp the datagram is as old as this Read() */
+      this->qRxTime = udpmc_clock(CLOCK_REALTIME);
+      for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+      {
+         if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+         {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            this->qRxTime = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+         }
+      }
+
+      this->rxPos  = 0;
+      this->rxSize = (DWORD)got;
+      this->rxPeer = udpmc_peer(dev, &source);
+      this->dBytesReadTotal += (DWORD)got;
+      this->dDatagramsRead++;
+   }
+
+   count = min(dBufferSize, this->rxSize - this->rxPos);
+   memcpy(DestBuffer, &this->rx[this->rxPos], count);
+   this->rxPos += count;
+   this->qReadTime = udpmc_clock(CLOCK_MONOTONIC);
+
+   if (DriverDeviceHandle != NULL)
+   {
+      *DriverDeviceHandle = this->rxPeer;
+   }
+
+   return count;
+}
+
+
+/**************************************************************************
+   Description   : Driver device handle of a device, the device is added
+                   when it is seen the first time
+   Return-Value  : handle or INVALID_DRIVER_DEVICE_HANDLE if the table is full
+**************************************************************************/
+static DWORD udpmc_peer(TDevice * dev, struct sockaddr_in * addr)
+{
+   DWORD i;
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   for (i = 0; i < this->dPeerCount; i++)
+   {
+      if (this->peers[i].sin_addr.s_addr == addr->sin_addr.s_addr &&
+          this->peers[i].sin_port        == addr->sin_port)
+      {
+         return i + 1;
+      }
+   }
+
+   if (this->dPeerCount >= UDPMC_MAX_PEERS)
+   {
+      return INVALID_DRIVER_DEVICE_HANDLE;
+   }
+
+   this->peers[this->dPeerCount] = *addr;
+   this->dPeerCount++;
+
+   YASDI_DEBUG((VERBOSE_HWL, "UdpMulticast: New device %s:%d on '%s'\n",
+                inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), dev->cName));
+
+   return this->dPeerCount;
+}
+
+
+/**************************************************************************
+   Description   : Send the frame in the transmit buffer
+**************************************************************************/
+static void udpmc_send(TDevice * dev, struct sockaddr_in * addr, DWORD size)
+{
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   if (sendto(this->fd, this->tx, size, 0, (struct sockaddr *)addr, sizeof(*addr)) < 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "UdpMulticast: send to %s:%d failed (errno=%d)\n",
+                   inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), errno));
+      return;
+   }
+
+   this->dBytesSendTotal += size;
+}
+
+
+/**************************************************************************
+   Description   : Nanoseconds of a clock
+**************************************************************************/
+static unsigned long long udpmc_clock(clockid_t clock)
+{
+   struct timespec ts;
+   clock_gettime(clock, &ts);
+   return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/**************************************************************************
+   Description   : Driver specific commands, see rx_time.h
+   Parameter     : dev = Driver instance, cmd = command,
+                   params = TRxTime * or DWORD *
+   Return-Value  : 0 or IOCTRL_UNKNOWN_CMD
+**************************************************************************/
+SHARED_FUNCTION int udpmc_ioctrl(TDevice * dev, int cmd, BYTE * params)
+{
+   CREATE_VAR_THIS(dev, struct TUdpMulticastPriv *);
+
+   if (params == NULL)
+   {
+      return IOCTRL_UNKNOWN_CMD;
+   }
+
+   switch (cmd)
+   {
+      case IOCTRL_GET_RX_TIME:
+      {
+         TRxTime * rxtime = (TRxTime *)params;
+         rxtime->qRxTime   = this->qRxTime;
+         rxtime->qReadTime = this->qReadTime;
+         return 0;
+      }
+
+      case IOCTRL_SET_LISTEN_ONLY:
+         this->bListenOnly = *(DWORD *)params != 0 || this->bListenOnlyConfig;
+         YASDI_DEBUG((VERBOSE_HWL, "UdpMulticast: '%s' %s\n", dev->cName,
+                      this->bListenOnly ? "listens only" : "sends again"));
+         return 0;
+
+      default:
+         return IOCTRL_UNKNOWN_CMD;
+   }
+}
+
+
+/**************************************************************************
+   Description   : Return the "Maximum Transmit Unit" of this bus device
+**************************************************************************/
+int udpmc_GetMTU(TDevice * dev)
+{
+   UNUSED_VAR(dev);
+   return UDPMC_DATAGRAM_SIZE;
+}
+
+
+/**************************************************************************
+   Description   : Device constructor: Create ONE instance of device
+   Parameter     : Unit (for identification in profile section)
+   Return-Value  : Pointer to instance or zero
+**************************************************************************/
+TDevice * udpmc_create(DWORD dUnit)
+{
+   TDevice * interface;
+   struct TUdpMulticastPriv * priv;
+   char cConfigPath[64];
+
+   interface = (void*)malloc(sizeof( TDevice ));
+   priv      = (void*)malloc(sizeof( struct TUdpMulticastPriv ));
+
+   if (interface && priv)
+   {
+      memset(interface, 0, sizeof(TDevice));
+      memset(priv, 0, sizeof(struct TUdpMulticastPriv));
+      interface->priv = priv;
+      interface->DeviceState = DS_OFFLINE;
+      priv->fd = -1;
+
+      interface->Open   = udpmc_open;
+      interface->Close  = udpmc_release;
+      interface->Write  = udpmc_write;
+      interface->Read   = udpmc_read;
+      interface->GetMTU = udpmc_GetMTU;
+      interface->IoCtrl = udpmc_ioctrl;
+
+      sprintf(interface->cName, "UDP%lu", (unsigned long)dUnit); // bus driver name
+
+      /*
+       * Read Settings from configuration
+       */
+      sprintf(cConfigPath, "%s.Group", interface->cName);
+      TRepository_GetElementStr(cConfigPath, UDPMC_DEFAULT_GROUP, priv->cGroup, sizeof(priv->cGroup));
+
+      sprintf(cConfigPath, "%s.Interface", interface->cName);
+      TRepository_GetElementStr(cConfigPath, "", priv->cInterface, sizeof(priv->cInterface));
+
+      sprintf(cConfigPath, "%s.Port", interface->cName);
+      priv->iPort = TRepository_GetElementInt(cConfigPath, UDPMC_DEVICE_PORT);
+
+      sprintf(cConfigPath, "%s.LocalPort", interface->cName);
+      priv->iLocalPort = TRepository_GetElementInt(cConfigPath, UDPMC_MASTER_PORT);
+
+      sprintf(cConfigPath, "%s.TTL", interface->cName);
+      priv->iTTL = TRepository_GetElementInt(cConfigPath, 1);
+
+      sprintf(cConfigPath, "%s.ListenOnly", interface->cName);
+      priv->bListenOnlyConfig = TRepository_GetElementInt(cConfigPath, 0) != 0;
+      priv->bListenOnly = priv->bListenOnlyConfig;
+
+      YASDI_DEBUG((VERBOSE_HWL, "UdpMulticast: %s = %s:%d\n", interface->cName, priv->cGroup, priv->iPort));
+
+      /*
+      ** register this new bus device driver in the YASDI core
+      */
+      (*RegisterDevice)( interface );
+   }
+   else
+   {
+      free(interface);
+      free(priv);
+      interface = NULL;
+   }
+
+   return interface;
+}
+
+
+/**************************************************************************
+   Description   : Create all instances configured in the profile. A
+                   section is configured if it has any of the keys.
+**************************************************************************/
+void udpmc_create_all()
+{
+   static const char * keys[] = { "Group", "Port", "LocalPort", "Interface", "Protocol" };
+   int i;
+   unsigned k;
+
+   for(i = 0; i < 255; i++)
+   {
+      for(k = 0; k < sizeof(keys) / sizeof(keys[0]); k++)
+      {
+         char ConfigPath[50];
+         sprintf(ConfigPath, "UDP%d.%s", i, keys[k]);
+         if (TRepository_GetIsElementExist(ConfigPath))
+         {
+            udpmc_create(i);
+            break;
+         }
+      }
+   }
+}
+
+
+/**************************************************************************
+   Description   : Init driver module
+   Parameter     : ---
+   Return-Value  : == 0 => ok
+**************************************************************************/
+SHARED_FUNCTION int InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback )
+{
+   UNUSED_VAR(eventCallback);
+
+   YASDI_DEBUG((VERBOSE_MESSAGE,"YASDI SMAData1 over UDP Driver for %s V" LIB_YASDI_VERSION "\n"
+                "Compile time: " __TIME__  " " __DATE__ "\n\n",
+                os_GetOSIdentifier()));
+
+   /* store functions for registration... */
+   RegisterDevice = RegFuncPtr;
+
+   udpmc_create_all();
+
+   return 0; /* 0 => ok */
+}
+
+
+/**************************************************************************
+   Description   : Deinit driver module
+**************************************************************************/
+SHARED_FUNCTION void CleanupYasdiModule(void)
+{
+   YASDI_DEBUG((VERBOSE_HWL,"SMAData1 over UDP Driver: bye bye...\n"));
+}
@@ -0,0 +1,53 @@
+#ifndef UDP_MULTICAST_H
+#define UDP_MULTICAST_H
+
+#include <netinet/in.h>
+
+/* IPv4 local scope; SMAData1 over IP has no group of its own, and the
+   Speedwire group 239.12.255.254 belongs to SMAData2+ devices */
+#define UDPMC_DEFAULT_GROUP "239.255.24.72"
+
+enum
+{
+   UDPMC_DATAGRAM_SIZE   = 1500,  /* one Ethernet frame, answers are never split */
+   UDPMC_DEVICE_PORT     = 24272, /* SMAData over IP port of the devices          */
+   UDPMC_MASTER_PORT     = 24273, /* local port, devices answer to it             */
+   UDPMC_MAX_PEERS       = 255,   /* devices answering on one bus                 */
+};
+
+/* unit structure (Instance of class) */
+struct TUdpMulticastPriv
+{
+   char cGroup[16];             /* multicast group all devices listen on         */
+   char cInterface[16];         /* local address to send multicasts from         */
+   int iPort;                   /* device port on the group and unicast          */
+   int iLocalPort;              /* own port                                      */
+   int iTTL;                    /* multicast hops, 1 keeps it on the local net   */
+   BOOL bListenOnlyConfig;      /* ListenOnly=1, the IoCtrl cannot clear it      */
+   BOOL bListenOnly;            /* Write() drops every frame                     */
+
+   int fd;                      /* UDP socket, -1 while offline                  */
+   struct sockaddr_in group;
+
+   /* devices that answered, the driver device handle is the index + 1 */
+   struct sockaddr_in peers[UDPMC_MAX_PEERS];
+   DWORD dPeerCount;
+
+   /* rest of the last datagram, when YASDI read only a part of it */
+   BYTE rx[UDPMC_DATAGRAM_SIZE];
+   DWORD rxPos;
+   DWORD rxSize;
+   DWORD rxPeer;
+   unsigned long long qRxTime;  /* kernel receive time of the datagram, ns     */
+   unsigned long long qReadTime;/* monotonic ns of the last Read() with bytes   */
+
+   BYTE tx[UDPMC_DATAGRAM_SIZE];
+
+   DWORD dBytesSendTotal;       /* total bytes send                              */
+   DWORD dBytesReadTotal;       /* total bytes received                          */
+   DWORD dDatagramsRead;        /* datagrams received                            */
+   DWORD dMulticasts;           /* frames send to the whole group                */
+   DWORD dFramesSuppressed;     /* frames not send while listening only          */
+};
+
+#endif
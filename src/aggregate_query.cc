@@ -0,0 +1,232 @@
+#include "aggregate_query.h"
+
+#include <algorithm>
+#include <limits>
+
+void QueryEvaluator::Cells::reset(size_t buckets) {
+    sum.assign(buckets, 0);
+    min.assign(buckets, std::numeric_limits<double>::infinity());
+    max.assign(buckets, -std::numeric_limits<double>::infinity());
+    samples.assign(buckets, 0);
+    devices.assign(buckets, 0);
+    newest.assign(buckets, 0);
+}
+
+void QueryEvaluator::Runs::clear() {
+    bucket.clear();
+    mean.clear();
+    min.clear();
+    max.clear();
+    samples.clear();
+    newest.clear();
+}
+
+// Reduce the samples [begin, end) of one device, in time order, to one run
+// per bucket
+void QueryEvaluator::reduce(size_t begin, size_t end) {
+    runs.clear();
+    const double* value = samples.data();
+
+    while (begin < end) {
+        size_t bucket = bucket_of[begin];
+        size_t last = begin + 1;
+        while (last < end && bucket_of[last] == bucket) {
+            last++;
+        }
+
+        double sum = 0;
+        double low = value[begin];
+        double high = value[begin];
+        for (size_t i = begin; i < last; i++) {
+            sum += value[i];
+        }
+        for (size_t i = begin; i < last; i++) {
+            low = value[i] < low ? value[i] : low;
+            high = value[i] > high ? value[i] : high;
+        }
+
+        runs.bucket.push_back(bucket);
+        runs.mean.push_back(sum / (last - begin));
+        runs.min.push_back(low);
+        runs.max.push_back(high);
+        runs.samples.push_back((DWORD)(last - begin));
+        runs.newest.push_back(times[last - 1]);
+        begin = last;
+    }
+}
+
+void QueryEvaluator::merge(Cells& group) const {
+    for (size_t r = 0; r < runs.bucket.size(); r++) {
+        size_t k = runs.bucket[r];
+        group.sum[k] += runs.mean[r];
+        group.min[k] = std::min(group.min[k], runs.min[r]);
+        group.max[k] = std::max(group.max[k], runs.max[r]);
+        group.samples[k] += runs.samples[r];
+        group.devices[k]++;
+        group.newest[k] = std::max(group.newest[k], runs.newest[r]);
+    }
+}
+
+int QueryEvaluator::run(const AggregateQuery& query, const RegistrySnapshot& snapshot, AggregateResult& result) {
+    result = AggregateResult();
+    if (query.channel.empty() || query.functions.empty()) {
+        return YE_INVAL_ARGUMENT;
+    }
+    result.columns.resize(query.functions.size());
+
+    // Group addresses of every device, when the query needs them
+    std::map<DWORD, std::vector<WORD>> memberships;
+    if (!query.groups.empty() || query.group_by == GROUP_BY_GROUP) {
+        for (WORD group : groups.groups()) {
+            for (DWORD device : groups.members(group)) {
+                memberships[device].push_back(group);
+            }
+        }
+    }
+
+    // Matching devices with their group keys
+    struct Member {
+        DWORD handle;
+        const RegistryChannel* channel;
+        std::vector<std::string> keys;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Member> members;
+    for (const RegistryDevice& device : snapshot.devices) {
+        if (!query.devices.empty() &&
+            std::find(query.devices.begin(), query.devices.end(), device.handle) == query.devices.end()) {
+            continue;
+        }
+        if (!query.types.empty() &&
+            std::find(query.types.begin(), query.types.end(), device.type) == query.types.end()) {
+            continue;
+        }
+
+        std::vector<WORD> device_groups;
+        auto membership = memberships.find(device.handle);
+        if (membership != memberships.end()) {
+            for (WORD group : membership->second) {
+                if (query.groups.empty() || std::find(query.groups.begin(), query.groups.end(), group) != query.groups.end()) {
+                    device_groups.push_back(group);
+                }
+            }
+        }
+        if (!query.groups.empty() && device_groups.empty()) {
+            continue;
+        }
+
+        const RegistryChannel* channel = device.find_channel(query.channel);
+        if (channel == nullptr) {
+            continue;
+        }
+
+        Member member = { device.handle, channel, {}, 0, 0 };
+        switch (query.group_by) {
+            case GROUP_BY_NONE:
+                member.keys.push_back("all");
+                break;
+            case GROUP_BY_DEVICE:
+                member.keys.push_back(device.name);
+                break;
+            case GROUP_BY_TYPE:
+                member.keys.push_back(device.type);
+                break;
+            case GROUP_BY_GROUP:
+                for (WORD group : device_groups) {
+                    member.keys.push_back(std::to_string(group));
+                }
+                break;
+        }
+        members.push_back(member);
+    }
+    result.matched = members.size();
+
+    // Samples of all members back to back
+    times.clear();
+    samples.clear();
+    for (Member& member : members) {
+        member.begin = times.size();
+        if (query.history) {
+            history.columns(member.handle, query.channel, query.from, query.to, times, samples);
+        } else {
+            CachedValue value;
+            if (values.load(member.handle, member.channel->handle, value)) {
+                times.push_back(value.time);
+                samples.push_back(value.value);
+            }
+        }
+        member.end = times.size();
+    }
+    if (times.empty()) {
+        return YE_OK;
+    }
+
+    // Bucket number of every sample, relative to the first bucket with data
+    DWORD bucket = query.history ? query.bucket : 0;
+    DWORD origin = query.history ? query.from : 0;
+    size_t first = 0;
+    size_t buckets = 1;
+    bucket_of.assign(times.size(), 0);
+    if (bucket > 0) {
+        DWORD oldest = *std::min_element(times.begin(), times.end());
+        DWORD newest = *std::max_element(times.begin(), times.end());
+        first = (oldest - origin) / bucket;
+        buckets = (newest - origin) / bucket - first + 1;
+        const DWORD* time = times.data();
+        size_t* bucket_index = bucket_of.data();
+        for (size_t i = 0; i < times.size(); i++) {
+            bucket_index[i] = (time[i] - origin) / bucket - first;
+        }
+    }
+
+    std::map<std::string, size_t> key_index;
+    for (const Member& member : members) {
+        for (const std::string& key : member.keys) {
+            key_index.emplace(key, 0);
+        }
+    }
+    if (key_index.size() * buckets > MAX_CELLS) {
+        return YE_INVAL_ARGUMENT;
+    }
+    size_t next = 0;
+    for (auto& key : key_index) {
+        key.second = next++;
+    }
+
+    std::vector<Cells> cells(key_index.size());
+    for (Cells& group : cells) {
+        group.reset(buckets);
+    }
+    for (const Member& member : members) {
+        reduce(member.begin, member.end);
+        for (const std::string& key : member.keys) {
+            merge(cells[key_index[key]]);
+        }
+    }
+
+    // Rows of all buckets with data, by key and time
+    for (const auto& key : key_index) {
+        const Cells& group = cells[key.second];
+        for (size_t k = 0; k < buckets; k++) {
+            if (group.devices[k] == 0) {
+                continue;
+            }
+            result.keys.push_back(key.first);
+            result.times.push_back(bucket > 0 ? (DWORD)(origin + (first + k) * bucket) : group.newest[k]);
+            result.devices.push_back(group.devices[k]);
+            for (size_t f = 0; f < query.functions.size(); f++) {
+                double value = 0;
+                switch (query.functions[f]) {
+                    case AGG_SUM:   value = group.sum[k]; break;
+                    case AGG_AVG:   value = group.sum[k] / group.devices[k]; break;
+                    case AGG_MIN:   value = group.min[k]; break;
+                    case AGG_MAX:   value = group.max[k]; break;
+                    case AGG_COUNT: value = group.samples[k]; break;
+                }
+                result.columns[f].push_back(value);
+            }
+        }
+    }
+    return YE_OK;
+}
@@ -0,0 +1,116 @@
+#ifndef AGGREGATE_QUERY_H
+#define AGGREGATE_QUERY_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "device_groups.h"
+#include "device_registry.h"
+#include "history_store.h"
+#include "value_cache.h"
+#include "yasdi_headers.h"
+
+// Per device, the samples of a bucket are first reduced to their mean (or
+// their min and max); the devices of a row are then combined
+enum AggregateFunction {
+    AGG_SUM,    // sum of the device means, e.g. plant power
+    AGG_AVG,    // mean of the device means
+    AGG_MIN,
+    AGG_MAX,
+    AGG_COUNT   // samples in the row
+};
+
+enum AggregateGrouping {
+    GROUP_BY_NONE,
+    GROUP_BY_DEVICE,    // device name
+    GROUP_BY_TYPE,      // device type
+    GROUP_BY_GROUP      // SMAData group address, a device counts in each of its groups
+};
+
+struct AggregateQuery {
+    std::string channel;
+    std::vector<AggregateFunction> functions;
+
+    // Device filters; an empty one passes every device
+    std::vector<DWORD> devices;
+    std::vector<std::string> types;
+    std::vector<WORD> groups;
+
+    AggregateGrouping group_by = GROUP_BY_NONE;
+
+    // Stored history between from and to (seconds since 1970), or else the
+    // latest cached value of every device
+    bool history = false;
+    DWORD from = 0;
+    DWORD to = 0xffffffff;
+    DWORD bucket = 0;   // seconds, buckets start at multiples of it after from; 0: one bucket
+};
+
+// Columnar result, one row per group and bucket with data, ordered by key
+// and time. The time of a row is the start of its bucket, or the newest
+// sample in it without buckets.
+struct AggregateResult {
+    std::vector<std::string> keys;
+    std::vector<DWORD> times;
+    std::vector<DWORD> devices;                 // devices with samples in the row
+    std::vector<std::vector<double>> columns;   // one per function, in query order
+    size_t matched = 0;                         // devices passing the filters with the channel
+};
+
+// Evaluates aggregate queries over the value cache or the history.
+// The samples of all matching devices are copied into contiguous time and
+// value columns, bucket numbers are computed over the whole time column,
+// and every bucket of a device is reduced as one contiguous run of values.
+// The runs are then merged into the bucket columns of the device's groups.
+class QueryEvaluator {
+public:
+    QueryEvaluator(const HistoryStore& history, const ValueCache& values, const DeviceGroups& groups)
+        : history(history), values(values), groups(groups) {}
+
+    // YE_INVAL_ARGUMENT for a query without channel or function, or with
+    // more than MAX_CELLS groups times buckets
+    int run(const AggregateQuery& query, const RegistrySnapshot& snapshot, AggregateResult& result);
+
+    static const size_t MAX_CELLS = 1 << 20;
+
+private:
+    // Bucket columns of one group
+    struct Cells {
+        std::vector<double> sum;        // sum of the device means
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<DWORD> samples;
+        std::vector<DWORD> devices;
+        std::vector<DWORD> newest;
+
+        void reset(size_t buckets);
+    };
+
+    // The buckets of one device that have samples
+    struct Runs {
+        std::vector<size_t> bucket;
+        std::vector<double> mean;
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<DWORD> samples;
+        std::vector<DWORD> newest;
+
+        void clear();
+    };
+
+    void reduce(size_t begin, size_t end);
+    void merge(Cells& group) const;
+
+    const HistoryStore& history;
+    const ValueCache& values;
+    const DeviceGroups& groups;
+
+    // Samples of all matching devices back to back, reused per query
+    std::vector<DWORD> times;
+    std::vector<double> samples;
+    std::vector<size_t> bucket_of;
+    Runs runs;
+};
+
+#endif
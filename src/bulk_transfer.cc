@@ -0,0 +1,241 @@
+#include "bulk_transfer.h"
+#include "smadata_request.h"
+#include "channel_codec.h"
+#include "plant_lock.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+}
+
+static const DWORD BINFO_ENTRY_SIZE = 27;
+static const DWORD RECORD_TIME_SIZE = 4;
+
+static void put_word(std::vector<BYTE>& buf, WORD value) {
+    buf.push_back(LOBYTE(value));
+    buf.push_back(HIBYTE(value));
+}
+
+static void put_dword(std::vector<BYTE>& buf, DWORD value) {
+    buf.push_back((BYTE)(value & 0xff));
+    buf.push_back((BYTE)((value >> 8) & 0xff));
+    buf.push_back((BYTE)((value >> 16) & 0xff));
+    buf.push_back((BYTE)((value >> 24) & 0xff));
+}
+
+static TChannel* find_recorded_channel(TNetDevice* dev, const RecordedChannel& rec) {
+    THandleList* list = TNetDevice_GetChannelList(dev);
+    if (list == NULL) {
+        return NULL;
+    }
+
+    for (DWORD i = 0; i < list->dHandleListCurSize; i++) {
+        TChannel* chan = (TChannel*)TObjManager_GetRef(list->HandleList[i]);
+        if (chan && TChannel_GetIndex(chan) == rec.chan_index &&
+            (TChannel_GetCType(chan) & rec.chan_mask) == rec.chan_mask) {
+            return chan;
+        }
+    }
+    return NULL;
+}
+
+BulkTransfer::BulkTransfer(DWORD chunk_size, DWORD timeout)
+    : chunk_size(chunk_size), timeout(timeout) {
+}
+
+int BulkTransfer::transact(DWORD device_handle, BYTE cmd, const std::vector<BYTE>& payload, DWORD timeout, std::vector<BYTE>& answer) {
+    WORD net_addr;
+    DWORD prot_flags;
+
+    if (!SMADataRequest::resolve_device(device_handle, &net_addr, &prot_flags)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    SMADataRequest request(net_addr, cmd);
+    request.set_flags(prot_flags);
+    request.set_timeout(timeout, 2);
+    if (!payload.empty()) {
+        request.set_payload(payload.data(), (DWORD)payload.size());
+    }
+
+    int result = request.execute(PRIORITY_LOW);
+    if (result != YE_OK) {
+        return result;
+    }
+
+    const PacketBuffer& data = request.responses().front().data;
+    answer.assign(data.begin(), data.end());
+    return YE_OK;
+}
+
+int BulkTransfer::get_binary_info(DWORD device_handle, std::vector<BinaryArea>& areas) {
+    std::vector<BYTE> answer;
+    int result = transact(device_handle, CMD_GET_BINFO, std::vector<BYTE>(), 5, answer);
+    if (result != YE_OK) {
+        return result;
+    }
+
+    areas.clear();
+    for (DWORD pos = 0; pos + BINFO_ENTRY_SIZE <= answer.size(); pos += BINFO_ENTRY_SIZE) {
+        const BYTE* p = &answer[pos];
+        BinaryArea area;
+        area.area = p[0];
+        area.revision = p[1];
+        area.name.assign((const char*)&p[2], strnlen((const char*)&p[2], 16));
+        area.start = read_le_dword(&p[18]);
+        area.size = read_le_dword(&p[22]);
+        area.mode = p[26];
+        areas.push_back(area);
+    }
+    return YE_OK;
+}
+
+int BulkTransfer::get_recording(DWORD device_handle, RecordingConfig& config) {
+    std::vector<BYTE> answer;
+    int result = transact(device_handle, CMD_GET_MTIME, std::vector<BYTE>(), 5, answer);
+    if (result != YE_OK) {
+        return result;
+    }
+    if (answer.size() < 2) {
+        return YE_VALUE_NOT_VALID;
+    }
+
+    config.interval = read_le_word(&answer[0]);
+    config.channels.clear();
+    for (size_t pos = 2; pos + 3 <= answer.size(); pos += 3) {
+        config.channels.push_back({read_le_word(&answer[pos]), answer[pos + 2]});
+    }
+    return YE_OK;
+}
+
+int BulkTransfer::set_recording(DWORD device_handle, const RecordingConfig& config) {
+    std::vector<BYTE> payload;
+    put_word(payload, config.interval);
+    for (const auto& chan : config.channels) {
+        put_word(payload, chan.chan_mask);
+        payload.push_back(chan.chan_index);
+    }
+
+    std::vector<BYTE> answer;
+    return transact(device_handle, CMD_SET_MTIME, payload, 5, answer);
+}
+
+int BulkTransfer::read_area(DWORD device_handle, const BinaryArea& area, std::vector<BYTE>& data) {
+    data.clear();
+    data.reserve(area.size);
+
+    for (DWORD offset = 0; offset < area.size; ) {
+        DWORD length = std::min(chunk_size, area.size - offset);
+
+        std::vector<BYTE> payload;
+        payload.push_back(area.area);
+        put_dword(payload, area.start + offset);
+        put_dword(payload, length);
+
+        std::vector<BYTE> answer;
+        int result = transact(device_handle, CMD_GET_BIN, payload, timeout, answer);
+        if (result != YE_OK) {
+            return result;
+        }
+        if (answer.empty()) {
+            break; // device has no more data in this area
+        }
+
+        data.insert(data.end(), answer.begin(), answer.end());
+        offset += (DWORD)answer.size();
+    }
+    return YE_OK;
+}
+
+int BulkTransfer::backfill(DWORD device_handle, BYTE area_id, DWORD since, HistoryStore& history, BackfillResult& result) {
+    std::memset(&result, 0, sizeof(result));
+
+    std::vector<BinaryArea> areas;
+    int res = get_binary_info(device_handle, areas);
+    if (res != YE_OK) {
+        return res;
+    }
+
+    auto area = std::find_if(areas.begin(), areas.end(),
+                             [area_id](const BinaryArea& a) { return a.area == area_id; });
+    if (area == areas.end()) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    RecordingConfig config;
+    res = get_recording(device_handle, config);
+    if (res != YE_OK) {
+        return res;
+    }
+
+    // Resolve the record layout against the device's channel list. The
+    // plant is not locked during the transfer, which takes minutes; the
+    // columns are kept as handles and looked up again to decode
+    std::vector<DWORD> columns;
+    DWORD record_size = RECORD_TIME_SIZE;
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+        if (dev == NULL) {
+            return YE_UNKNOWN_HANDLE;
+        }
+        for (const auto& rec : config.channels) {
+            TChannel* chan = find_recorded_channel(dev, rec);
+            if (chan == NULL) {
+                return YE_CHAN_TYPE_MISMATCH;
+            }
+            columns.push_back(chan->Handle);
+            record_size += channel_value_width(chan);
+        }
+    }
+
+    std::vector<BYTE> data;
+    res = read_area(device_handle, *area, data);
+    if (res != YE_OK) {
+        return res;
+    }
+    result.bytes = (DWORD)data.size();
+
+    std::map<std::string, std::vector<HistorySample>> samples;
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        if (TObjManager_GetRef(device_handle) == NULL) {
+            return YE_UNKNOWN_HANDLE;
+        }
+        std::vector<TChannel*> channels;
+        for (DWORD handle : columns) {
+            TChannel* chan = (TChannel*)TObjManager_GetRef(handle);
+            if (chan == NULL) {
+                return YE_UNKNOWN_HANDLE;
+            }
+            channels.push_back(chan);
+        }
+
+        for (size_t pos = 0; pos + record_size <= data.size(); pos += record_size) {
+            DWORD time = read_le_dword(&data[pos]);
+            if (time == 0 || time == 0xffffffff || time <= since) {
+                continue;
+            }
+
+            size_t value_pos = pos + RECORD_TIME_SIZE;
+            for (TChannel* chan : channels) {
+                samples[TChannel_GetName(chan)].push_back({time, channel_decode_value(chan, &data[value_pos])});
+                value_pos += channel_value_width(chan);
+            }
+
+            result.records++;
+            if (result.first_time == 0 || time < result.first_time) result.first_time = time;
+            if (time > result.last_time) result.last_time = time;
+        }
+    }
+
+    for (const auto& chan : samples) {
+        result.samples += (DWORD)history.merge(device_handle, chan.first, chan.second);
+    }
+    return YE_OK;
+}
@@ -0,0 +1,73 @@
+#ifndef BULK_TRANSFER_H
+#define BULK_TRANSFER_H
+
+#include <string>
+#include <vector>
+
+#include "history_store.h"
+
+#include "yasdi_headers.h"
+
+// One stored binary area of a device, as announced by CMD_GET_BINFO.
+// Wire layout per entry (27 bytes, little endian):
+//   area[1] revision[1] name[16] start[4] size[4] mode[1]
+struct BinaryArea {
+    BYTE area;
+    BYTE revision;
+    std::string name;
+    DWORD start;
+    DWORD size;
+    BYTE mode;
+};
+
+// A channel recorded by the device into its mean value areas
+struct RecordedChannel {
+    WORD chan_mask;
+    BYTE chan_index;
+};
+
+// Device side recording setup, as exchanged by CMD_GET_MTIME / CMD_SET_MTIME.
+// Wire layout: interval[2] followed by (chan_mask[2] chan_index[1]) per channel.
+struct RecordingConfig {
+    WORD interval;
+    std::vector<RecordedChannel> channels;
+};
+
+struct BackfillResult {
+    DWORD bytes;
+    DWORD records;
+    DWORD samples;
+    DWORD first_time;
+    DWORD last_time;
+};
+
+// Bulk download of device-recorded data with CMD_GET_BINFO / CMD_GET_BIN.
+// A CMD_GET_BIN request carries area[1] offset[4] length[4] and is answered
+// with the raw bytes of that range. Areas are read in large chunks; SMAData
+// fragmentation and reassembly are done by YASDI, so one request moves a
+// whole chunk across the bus.
+//
+// A recorded area is a ring of fixed size records:
+//   time[4] (seconds since 1970) followed by one raw value per recorded
+//   channel, in the order and width of the recording configuration.
+// Empty slots carry a time of 0 or 0xffffffff.
+class BulkTransfer {
+public:
+    explicit BulkTransfer(DWORD chunk_size = 2048, DWORD timeout = 30);
+
+    int get_binary_info(DWORD device_handle, std::vector<BinaryArea>& areas);
+    int get_recording(DWORD device_handle, RecordingConfig& config);
+    int set_recording(DWORD device_handle, const RecordingConfig& config);
+    int read_area(DWORD device_handle, const BinaryArea& area, std::vector<BYTE>& data);
+
+    // Download an area and merge all records newer than "since" into the history
+    int backfill(DWORD device_handle, BYTE area, DWORD since, HistoryStore& history, BackfillResult& result);
+
+private:
+    int transact(DWORD device_handle, BYTE cmd, const std::vector<BYTE>& payload, DWORD timeout, std::vector<BYTE>& answer);
+
+    DWORD chunk_size;
+    DWORD timeout;
+};
+
+#endif
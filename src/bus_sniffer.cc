@@ -0,0 +1,215 @@
+#include "bus_sniffer.h"
+#include "smadata_request.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "objman.h"
+    #include "master.h"
+    #include "plant.h"
+}
+
+BusSniffer::~BusSniffer() {
+    stop();
+}
+
+size_t BusSniffer::start(const std::string& file) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        plant_file = file;
+    }
+    size_t loaded = load();
+
+    bool add;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        listening = true;
+        add = !parked;
+        parked = true;
+    }
+    // Not under the mutex, the YASDI thread may wait for it in handle()
+    if (add) {
+        park();
+    }
+    return loaded;
+}
+
+void BusSniffer::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    listening = false;
+}
+
+bool BusSniffer::active() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return listening;
+}
+
+void BusSniffer::abandon() {
+    std::lock_guard<std::mutex> lock(mutex);
+    parked = false;
+}
+
+// A multi-answer request for a command no device answers: it never
+// completes, it only keeps YASDI in master mode until its timeout
+void BusSniffer::park() {
+    std::memset(&request.io, 0, sizeof(request.io));
+    request.owner = this;
+    request.io.Cmd = PARKED_CMD;
+    request.io.DestAddr = 0;
+    request.io.SourceAddr = SMADataRequest::master_address();
+    request.io.Type = RT_MULTIRCV;
+    request.io.TimeOut = PARKED_TIMEOUT;
+    request.io.Repeats = 0;
+    request.io.OnEnd = &BusSniffer::on_parked_end;
+    yasdiAddIORequest(&request.io);
+}
+
+void BusSniffer::on_parked_end(TIORequest* req) {
+    BusSniffer* self = reinterpret_cast<Parked*>(req)->owner;
+    {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->parked = self->listening;
+        if (!self->parked) {
+            return;
+        }
+    }
+    // YASDI has removed it from its list before, no answer slips through
+    self->park();
+}
+
+void BusSniffer::handle(const TSMAData* packet, const BYTE* data, DWORD size) {
+    if (!(packet->Flags & TS_ANSWER) || !active()) {
+        return;
+    }
+
+    switch (packet->Cmd) {
+        case CMD_GET_NET:
+        case CMD_GET_NET_START:
+        case CMD_CFG_NETADR:
+            learn_device(packet, data, size);
+            break;
+        case CMD_GET_CINFO:
+            learn_channels(packet, data, size);
+            break;
+        case CMD_GET_DATA:
+            learn_values(packet, data, size);
+            break;
+    }
+}
+
+void BusSniffer::learn_device(const TSMAData* packet, const BYTE* data, DWORD size) {
+    BOOL is_new = FALSE;
+    TNetDevice* dev = TPlant_ScanGetNetBuf(&Plant, (BYTE*)data, size, packet->SourceAddr,
+                                           packet->Flags, &is_new, 0);
+    if (dev == NULL) {
+        return;
+    }
+
+    DWORD handle = TNetDevice_GetHandle(dev);
+    bool changed = is_new;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        KnownDevice& device = known[TNetDevice_GetSerNr(dev)];
+        changed = changed || device.address != packet->SourceAddr || device.type.empty();
+        device.address = packet->SourceAddr;
+        device.type = TNetDevice_GetType(dev);
+    }
+
+    if (is_new) {
+        TSMADataMaster_FireAPIEventDeviceDetection(YASDI_EVENT_DEVICE_ADDED, handle, 0);
+    }
+    if (changed && device_handler) {
+        device_handler(handle);
+    }
+}
+
+void BusSniffer::learn_channels(const TSMAData* packet, const BYTE* data, DWORD size) {
+    // A list already present keeps its channel handles
+    TNetDevice* dev = TPlant_FindDevAddr(packet->SourceAddr);
+    if (dev == NULL || TNetDevice_IsChanListPresent(dev)) {
+        return;
+    }
+
+    // Validated, cached for the device type and given to all its devices
+    if (TPlant_StoreChanList((BYTE*)data, size, TNetDevice_GetType(dev)) == 0 && device_handler) {
+        device_handler(TNetDevice_GetHandle(dev));
+    }
+}
+
+void BusSniffer::learn_values(const TSMAData* packet, const BYTE* data, DWORD size) {
+    TNetDevice* dev = TPlant_FindDevAddr(packet->SourceAddr);
+    if (dev == NULL || !TNetDevice_IsChanListPresent(dev)) {
+        return;
+    }
+
+    if (TStateChanReader_ScanUpdateValue(dev, (BYTE*)data, size) == 0 && values_handler) {
+        values_handler(TNetDevice_GetHandle(dev));
+    }
+}
+
+// Add the devices of the plant file YASDI does not know yet
+size_t BusSniffer::load() {
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        file = plant_file;
+    }
+    if (file.empty()) {
+        return 0;
+    }
+
+    std::ifstream in(file);
+    std::string line;
+    size_t loaded = 0;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        DWORD serial = 0;
+        unsigned address = 0;
+        std::string type;
+        if (!(fields >> serial >> address) || !std::getline(fields >> std::ws, type) || type.empty()) {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            known[serial] = { (WORD)address, type };
+        }
+        if (TPlant_FindSN(serial) != NULL) {
+            continue;
+        }
+
+        // Gets its channel list from YASDI's cache, if the type is there
+        std::vector<char> type_name(type.begin(), type.end());
+        type_name.push_back(0);
+        TNetDevice* dev = TNetSWR_Constructor(type_name.data(), serial, (WORD)address);
+        TPlant_AddDevice(&Plant, NULL, dev);
+        TSMADataMaster_FireAPIEventDeviceDetection(YASDI_EVENT_DEVICE_ADDED, TNetDevice_GetHandle(dev), 0);
+        loaded++;
+    }
+    return loaded;
+}
+
+bool BusSniffer::save() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (plant_file.empty()) {
+        return false;
+    }
+
+    // Replaced in one step, a crash never leaves half a file
+    std::string temp = plant_file + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        for (const auto& device : known) {
+            out << device.first << " " << device.second.address << " " << device.second.type << "\n";
+        }
+        if (!out.flush()) {
+            return false;
+        }
+    }
+    return std::rename(temp.c_str(), plant_file.c_str()) == 0;
+}
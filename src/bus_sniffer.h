@@ -0,0 +1,90 @@
+#ifndef BUS_SNIFFER_H
+#define BUS_SNIFFER_H
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "yasdi_headers.h"
+
+// Passive acquisition from the answers other masters on the bus get.
+// Nothing is sent: the drivers are switched to listen only by the caller,
+// and the sniffer decodes the answers it sees into YASDI's plant as if it
+// had asked itself. GET_NET answers add devices, CFG_NETADR answers (the
+// same serial and type, from the new address) move them, GET_CINFO answers
+// give their channel lists, GET_DATA answers their values.
+//
+// YASDI drops answers unless a request of its own is pending, so while
+// listening one request, which no device answers, is kept parked in
+// YASDI's request list; the listen-only drivers swallow its frames.
+//
+// Devices learnt are kept in an optional plant file, one line per device
+// ("serial address type"), so a restart knows them before the other master
+// detects again. Channel lists come from YASDI's channel list cache.
+class BusSniffer {
+public:
+    BusSniffer() = default;
+    ~BusSniffer();
+
+    BusSniffer(const BusSniffer&) = delete;
+    BusSniffer& operator=(const BusSniffer&) = delete;
+
+    // Called on the YASDI thread when a device was added or got its channel
+    // list, and when values of a device were decoded; must not block
+    void set_device_handler(std::function<void(DWORD device_handle)> handler) { device_handler = std::move(handler); }
+    void set_values_handler(std::function<void(DWORD device_handle)> handler) { values_handler = std::move(handler); }
+
+    // Start decoding; devices of the plant file are added to YASDI first.
+    // YASDI must be initialized. Returns the number of devices loaded.
+    size_t start(const std::string& plant_file);
+
+    // Stop decoding. The parked request ends within its timeout, YASDI
+    // holds back requests to every bus until then.
+    void stop();
+    bool active() const;
+
+    // After YASDI shut down, which dropped the parked request
+    void abandon();
+
+    // Packet listener for CMD_GET_NET, CMD_GET_NET_START, CMD_CFG_NETADR,
+    // CMD_GET_CINFO and CMD_GET_DATA, on the YASDI thread
+    void handle(const TSMAData* packet, const BYTE* data, DWORD size);
+
+    // Write the devices learnt to the plant file, if there is one
+    bool save() const;
+
+    static const BYTE PARKED_CMD = 0xFE;    // no SMAData command
+    static const DWORD PARKED_TIMEOUT = 10;
+
+private:
+    struct KnownDevice {
+        WORD address;
+        std::string type;
+    };
+
+    void park();
+    static void on_parked_end(TIORequest* req);
+
+    void learn_device(const TSMAData* packet, const BYTE* data, DWORD size);
+    void learn_channels(const TSMAData* packet, const BYTE* data, DWORD size);
+    void learn_values(const TSMAData* packet, const BYTE* data, DWORD size);
+    size_t load();
+
+    // TIORequest must stay the first member, YASDI only hands back the request
+    struct Parked {
+        TIORequest io;
+        BusSniffer* owner;
+    };
+
+    mutable std::mutex mutex;
+    bool listening = false;
+    bool parked = false;            // the request is in YASDI's list
+    Parked request;
+    std::string plant_file;
+    std::map<DWORD, KnownDevice> known;    // by serial number
+    std::function<void(DWORD)> device_handler;
+    std::function<void(DWORD)> values_handler;
+};
+
+#endif
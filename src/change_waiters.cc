@@ -0,0 +1,151 @@
+#include "change_waiters.h"
+
+#include <chrono>
+
+ChangeWaiters::~ChangeWaiters() {
+    stop();
+}
+
+void ChangeWaiters::wait(DWORD device_handle, unsigned long long since, double timeout, Done done) {
+    unsigned long long version = current_version(device_handle);
+    if (version > since || timeout <= 0) {
+        done(version > since, version);
+        return;
+    }
+
+    unsigned long long id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = next_id++;
+        double deadline = clock.now() + timeout;
+        waiters[id] = { device_handle, since, deadline, std::move(done) };
+        by_device.emplace(device_handle, id);
+        by_deadline.emplace(deadline, id);
+        count++;
+
+        if (!thread.joinable()) {
+            thread = std::thread(&ChangeWaiters::run, this);
+        }
+    }
+    wake.notify_all();
+
+    // A store between the first look and the registration did not see the
+    // waiter; with the fence in changed() one of the two sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    version = current_version(device_handle);
+    if (version <= since) {
+        return;
+    }
+    std::vector<Waiter> completed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = waiters.find(id);
+        if (it != waiters.end()) {
+            remove(it, completed);
+        }
+    }
+    for (Waiter& waiter : completed) {
+        waiter.done(true, version);
+    }
+}
+
+void ChangeWaiters::changed(DWORD device_handle, unsigned long long version) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (count.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    std::vector<Waiter> completed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto range = by_device.equal_range(device_handle);
+        std::vector<unsigned long long> ids;
+        for (auto it = range.first; it != range.second; ++it) {
+            ids.push_back(it->second);
+        }
+        for (unsigned long long id : ids) {
+            auto it = waiters.find(id);
+            if (it->second.since < version) {
+                remove(it, completed);
+            }
+        }
+    }
+    for (Waiter& waiter : completed) {
+        waiter.done(true, version);
+    }
+}
+
+void ChangeWaiters::remove(std::map<unsigned long long, Waiter>::iterator it, std::vector<Waiter>& out) {
+    unsigned long long id = it->first;
+    auto devices = by_device.equal_range(it->second.device_handle);
+    for (auto pos = devices.first; pos != devices.second; ++pos) {
+        if (pos->second == id) {
+            by_device.erase(pos);
+            break;
+        }
+    }
+    auto deadlines = by_deadline.equal_range(it->second.deadline);
+    for (auto pos = deadlines.first; pos != deadlines.second; ++pos) {
+        if (pos->second == id) {
+            by_deadline.erase(pos);
+            break;
+        }
+    }
+    out.push_back(std::move(it->second));
+    waiters.erase(it);
+    count--;
+}
+
+void ChangeWaiters::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (by_deadline.empty()) {
+            wake.wait(lock);
+            continue;
+        }
+
+        double now = clock.now();
+        double next = by_deadline.begin()->first;
+        if (next > now) {
+            wake.wait_for(lock, std::chrono::duration<double>(next - now));
+            continue;
+        }
+
+        std::vector<Waiter> expired;
+        while (!by_deadline.empty() && by_deadline.begin()->first <= now) {
+            remove(waiters.find(by_deadline.begin()->second), expired);
+        }
+
+        lock.unlock();
+        for (Waiter& waiter : expired) {
+            waiter.done(false, current_version(waiter.device_handle));
+        }
+        lock.lock();
+    }
+}
+
+void ChangeWaiters::stop() {
+    std::vector<Waiter> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        while (!waiters.empty()) {
+            remove(waiters.begin(), pending);
+        }
+    }
+    wake.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+    for (Waiter& waiter : pending) {
+        waiter.done(false, current_version(waiter.device_handle));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+}
+
+size_t ChangeWaiters::waiting() const {
+    return count.load();
+}
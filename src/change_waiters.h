@@ -0,0 +1,72 @@
+#ifndef CHANGE_WAITERS_H
+#define CHANGE_WAITERS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "clock.h"
+#include "yasdi_headers.h"
+
+// Callers parked until a device's values have a newer version than the one
+// they saw, e.g. HTTP long polls. A wait costs no thread: it is an entry
+// that the storing thread completes when the version passes it, and one
+// thread completes the waits whose timeout ran out. Every wait completes
+// exactly once, on one of those threads or at once in wait().
+class ChangeWaiters {
+public:
+    // changed: the version passed since; version: the device's version then
+    typedef std::function<void(bool changed, unsigned long long version)> Done;
+
+    // Current version of a device, asked when a wait times out
+    explicit ChangeWaiters(std::function<unsigned long long(DWORD device_handle)> current_version,
+                           Clock& clock = Clock::real())
+        : current_version(std::move(current_version)), clock(clock) {}
+    ~ChangeWaiters();
+
+    ChangeWaiters(const ChangeWaiters&) = delete;
+    ChangeWaiters& operator=(const ChangeWaiters&) = delete;
+
+    // Wait until the version of the device is newer than since, at most
+    // timeout s; completes at once if it already is
+    void wait(DWORD device_handle, unsigned long long since, double timeout, Done done);
+
+    // A store gave the device this version
+    void changed(DWORD device_handle, unsigned long long version);
+
+    // Complete all waits as timed out, e.g. on shutdown; later waits work again
+    void stop();
+
+    size_t waiting() const;
+
+private:
+    struct Waiter {
+        DWORD device_handle;
+        unsigned long long since;
+        double deadline;
+        Done done;
+    };
+
+    void run();
+    // Under the mutex; the waiter is moved to out
+    void remove(std::map<unsigned long long, Waiter>::iterator it, std::vector<Waiter>& out);
+
+    std::function<unsigned long long(DWORD)> current_version;
+    Clock& clock;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::map<unsigned long long, Waiter> waiters;           // by id
+    std::multimap<DWORD, unsigned long long> by_device;
+    std::multimap<double, unsigned long long> by_deadline;
+    unsigned long long next_id = 1;
+    std::atomic<size_t> count{ 0 };     // cheap test for stores while nobody waits
+    std::thread thread;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "channel_codec.h"
+
+#include <cstring>
+
+WORD read_le_word(const BYTE* p) {
+    return (WORD)(p[0] | (p[1] << 8));
+}
+
+DWORD read_le_dword(const BYTE* p) {
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+BYTE channel_value_width(TChannel* chan) {
+    switch (TChannel_GetNType(chan) & CH_FORM) {
+        case CH_BYTE:
+            return 1;
+        case CH_WORD:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+double channel_decode_value(TChannel* chan, const BYTE* raw) {
+    double value;
+    switch (TChannel_GetNType(chan) & CH_FORM) {
+        case CH_BYTE:
+            value = raw[0];
+            break;
+        case CH_WORD:
+            value = read_le_word(raw);
+            break;
+        case CH_DWORD:
+            value = read_le_dword(raw);
+            break;
+        default: {
+            DWORD bits = read_le_dword(raw);
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            value = f;
+            break;
+        }
+    }
+
+    // Parameter channels keep their value range in gain/offset
+    if (!(TChannel_GetCType(chan) & CH_PARA)) {
+        if (TChannel_GetCType(chan) & CH_COUNTER) value = value * (double)TChannel_GetGain(chan);
+        if (TChannel_GetCType(chan) & CH_ANALOG)  value = value * (double)TChannel_GetGain(chan) + (double)TChannel_GetOffset(chan);
+    }
+    return value;
+}
+
+BYTE channel_encode_value(TChannel* chan, double value, BYTE* raw) {
+    if (!(TChannel_GetCType(chan) & CH_PARA) && TChannel_GetGain(chan) != 0) {
+        if (TChannel_GetCType(chan) & CH_COUNTER) value = value / (double)TChannel_GetGain(chan);
+        if (TChannel_GetCType(chan) & CH_ANALOG)  value = (value - (double)TChannel_GetOffset(chan)) / (double)TChannel_GetGain(chan);
+    }
+
+    DWORD bits;
+    switch (TChannel_GetNType(chan) & CH_FORM) {
+        case CH_BYTE:
+            raw[0] = (BYTE)value;
+            return 1;
+        case CH_WORD:
+            raw[0] = LOBYTE((WORD)value);
+            raw[1] = HIBYTE((WORD)value);
+            return 2;
+        case CH_DWORD:
+            bits = (DWORD)value;
+            break;
+        default: {
+            float f = (float)value;
+            std::memcpy(&bits, &f, sizeof(bits));
+            break;
+        }
+    }
+
+    raw[0] = (BYTE)(bits & 0xff);
+    raw[1] = (BYTE)((bits >> 8) & 0xff);
+    raw[2] = (BYTE)((bits >> 16) & 0xff);
+    raw[3] = (BYTE)((bits >> 24) & 0xff);
+    return 4;
+}
+
+void channel_set_data_payload(TChannel* chan, double value, std::vector<BYTE>& payload) {
+    payload.clear();
+    payload.push_back(LOBYTE(TChannel_GetCType(chan)));
+    payload.push_back(HIBYTE(TChannel_GetCType(chan)));
+    payload.push_back(TChannel_GetIndex(chan));
+    payload.push_back(1);
+    payload.push_back(0);
+
+    BYTE raw[4];
+    BYTE width = channel_encode_value(chan, value, raw);
+    payload.insert(payload.end(), raw, raw + width);
+}
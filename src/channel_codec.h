@@ -0,0 +1,28 @@
+#ifndef CHANNEL_CODEC_H
+#define CHANNEL_CODEC_H
+
+#include <vector>
+
+#include "yasdi_headers.h"
+
+extern "C" {
+    #include "netchannel.h"
+}
+
+// Conversion between raw SMAData channel values (little endian, width by
+// the channel's data format) and physical values, with the same gain and
+// offset rules as TChannel_GetValue / TChannel_SetValue.
+
+BYTE channel_value_width(TChannel* chan);
+double channel_decode_value(TChannel* chan, const BYTE* raw);
+BYTE channel_encode_value(TChannel* chan, double value, BYTE* raw);
+
+// CMD_SET_DATA payload for one value, same layout as TSMAData_InitReqSetChannel:
+//   mask[2] index[1] count[2] value
+void channel_set_data_payload(TChannel* chan, double value, std::vector<BYTE>& payload);
+
+// Little endian helpers for SMAData payloads
+WORD read_le_word(const BYTE* p);
+DWORD read_le_dword(const BYTE* p);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CHANNEL_DATA_H
+#define CHANNEL_DATA_H
+
+// Text slots are fixed size, a poll copies into reused buffers without
+// touching the heap
+static const unsigned CHANNEL_TEXT_SIZE = 64;
+
+// Structure to store channel data
+struct ChannelData {
+    char name[CHANNEL_TEXT_SIZE];
+    char units[CHANNEL_TEXT_SIZE];
+    char value[CHANNEL_TEXT_SIZE];      // empty unless the text was requested
+    double numericValue;
+    double receivedAt;      // ms since the epoch the value was received
+};
+
+#endif
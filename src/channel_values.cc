@@ -0,0 +1,166 @@
+#include "channel_values.h"
+#include "plant_lock.h"
+
+#include <cstring>
+#include <vector>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+    #include "master.h"
+    #include "mastercmd.h"
+    #include "ysecurity.h"
+}
+
+namespace {
+
+// Channel classes in the order GetChannelValue tests them
+enum ChannelClass { CLASS_PARA, CLASS_TEST, CLASS_SPOT, CLASS_COUNT, CLASS_NONE = CLASS_COUNT };
+
+const TMasterCmdType CLASS_COMMANDS[CLASS_COUNT] = { MC_GET_PARAMCHANNELS, MC_GET_TESTCHANNELS, MC_GET_SPOTCHANNELS };
+
+ChannelClass channel_class(TChannel* chan) {
+    WORD type = TChannel_GetCType(chan);
+    if (type & CH_PARA) return CLASS_PARA;
+    if (type & CH_TEST) return CLASS_TEST;
+    if (type & CH_SPOT) return CLASS_SPOT;
+    return CLASS_NONE;
+}
+
+struct Entry {
+    TChannel* chan;
+    bool stale;
+};
+
+}  // namespace
+
+int read_channel_values(DWORD device_handle, const DWORD* channel_handles, DWORD count, DWORD max_age,
+                        double* values, DWORD* times, int* status, char* texts, DWORD text_size) {
+    // Grows to the longest channel list once per thread, polls reuse it
+    thread_local std::vector<Entry> entries;
+    entries.resize(count);
+
+    for (DWORD i = 0; i < count; i++) {
+        values[i] = CHANVAL_INVALID;
+        if (times) times[i] = 0;
+        if (texts && text_size) texts[i * text_size] = 0;
+    }
+
+    TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+    if (dev == NULL) {
+        for (DWORD i = 0; i < count; i++) {
+            status[i] = YE_UNKNOWN_HANDLE;
+        }
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    TLevel level = TSecurity_getCurLev();
+    DWORD age_time = os_GetSystemTime(NULL) - max_age;
+    bool check_age = max_age != ANY_VALUE_AGE;
+
+    // The stalest channel of every class decides whether the class is refreshed
+    DWORD stalest[CLASS_COUNT] = { 0, 0, 0 };
+    DWORD stalest_time[CLASS_COUNT] = { 0, 0, 0 };
+
+    for (DWORD i = 0; i < count; i++) {
+        Entry& entry = entries[i];
+        entry.chan = (TChannel*)TObjManager_GetRef(channel_handles[i]);
+        entry.stale = false;
+        if (entry.chan == NULL) {
+            status[i] = YE_UNKNOWN_HANDLE;
+            continue;
+        }
+        if (!TChannel_IsLevel(entry.chan, level, CHECK_READ)) {
+            status[i] = YE_NO_ACCESS_RIGHTS;
+            continue;
+        }
+        status[i] = YE_OK;
+
+        DWORD time = TChannel_GetTimeStamp(entry.chan, dev);
+        if (!check_age || time >= age_time) {
+            continue;
+        }
+        entry.stale = true;
+
+        // No current value of an archive-only channel
+        ChannelClass cls = channel_class(entry.chan);
+        if (cls == CLASS_NONE) {
+            status[i] = YE_VALUE_NOT_VALID;
+            continue;
+        }
+        if (stalest[cls] == 0 || time < stalest_time[cls]) {
+            stalest[cls] = channel_handles[i];
+            stalest_time[cls] = time;
+        }
+    }
+
+    // One master command per stale class; it answers at once if the values
+    // arrived meanwhile, otherwise one request refreshes every channel of the class
+    int res = YE_OK;
+    bool timed_out[CLASS_COUNT] = { false, false, false };
+    bool waited = false;
+    for (int cls = 0; cls < CLASS_COUNT; cls++) {
+        if (stalest[cls] == 0) {
+            continue;
+        }
+        TMasterCmdReq* mc = TMasterCmdFactory_GetMasterCmd(CLASS_COMMANDS[cls]);
+        mc->Param.DevHandle = device_handle;
+        mc->Param.ChanHandle = stalest[cls];
+        mc->Param.dwValueAge = age_time;
+        TSMADataMaster_AddCmd(mc);
+        plant_mutex().unlock();
+        TMasterCmdResult result = TMasterCmd_WaitFor(mc);
+        plant_mutex().lock();
+        TMasterCmdFactory_FreeMasterCmd(mc);
+        waited = true;
+        if (result == MCS_TIMEOUT) {
+            timed_out[cls] = true;
+            res = YE_TIMEOUT;
+        }
+    }
+
+    // The device or its channels may have been removed meanwhile
+    if (waited) {
+        dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+        if (dev == NULL) {
+            for (DWORD i = 0; i < count; i++) {
+                status[i] = YE_UNKNOWN_HANDLE;
+            }
+            return YE_UNKNOWN_HANDLE;
+        }
+        for (DWORD i = 0; i < count; i++) {
+            if (status[i] != YE_OK) {
+                continue;
+            }
+            entries[i].chan = (TChannel*)TObjManager_GetRef(channel_handles[i]);
+            if (entries[i].chan == NULL) {
+                status[i] = YE_UNKNOWN_HANDLE;
+            }
+        }
+    }
+
+    for (DWORD i = 0; i < count; i++) {
+        if (status[i] != YE_OK) {
+            continue;
+        }
+        const Entry& entry = entries[i];
+        if (entry.stale && timed_out[channel_class(entry.chan)]) {
+            status[i] = YE_TIMEOUT;
+            continue;
+        }
+        if (!TChannel_IsValueValid(entry.chan, dev)) {
+            status[i] = YE_VALUE_NOT_VALID;
+            continue;
+        }
+
+        values[i] = TChannel_GetValue(entry.chan, dev, 0);
+        if (times) {
+            times[i] = TChannel_GetTimeStamp(entry.chan, dev);
+        }
+        if (texts && text_size > 1) {
+            TChannel_GetValueText(entry.chan, dev, texts + i * text_size, text_size - 1);
+        }
+    }
+    return res;
+}
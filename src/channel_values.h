@@ -0,0 +1,26 @@
+#ifndef CHANNEL_VALUES_H
+#define CHANNEL_VALUES_H
+
+#include "yasdi_headers.h"
+
+// Bulk counterpart of GetChannelValue for a list of channels of one device.
+// The device handle is resolved once, the access level and system time are
+// read once, and the freshness decision is made per channel class (spot,
+// parameter, test): if any channel of a class is older than max_age, one
+// master command refreshes the whole class, instead of one per channel.
+//
+// For every channel i, values[i], times[i] (YASDI receive time, 0 if none)
+// and status[i] (YE_OK, YE_UNKNOWN_HANDLE, YE_NO_ACCESS_RIGHTS, YE_TIMEOUT or
+// YE_VALUE_NOT_VALID, as GetChannelValue would return) are filled. Value
+// texts are formatted only if texts is given, into text_size bytes per
+// channel. times and texts may be NULL.
+//
+// Returns YE_UNKNOWN_HANDLE for an unknown device, YE_TIMEOUT if a class
+// could not be refreshed, otherwise YE_OK.
+//
+// The caller holds plant_mutex(); it is let go while a master command waits
+// for the bus, and the device and channels are looked up again after.
+int read_channel_values(DWORD device_handle, const DWORD* channel_handles, DWORD count, DWORD max_age,
+                        double* values, DWORD* times, int* status, char* texts = NULL, DWORD text_size = 0);
+
+#endif
@@ -0,0 +1,17 @@
+#include "clock.h"
+
+#include <chrono>
+#include <ctime>
+
+Clock& Clock::real() {
+    static RealClock clock;
+    return clock;
+}
+
+double RealClock::now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DWORD RealClock::unix_time() const {
+    return (DWORD)time(NULL);
+}
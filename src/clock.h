@@ -0,0 +1,46 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "yasdi_headers.h"
+
+// Time source of the native components. Real runs use the system clocks;
+// the discrete-event simulator substitutes a virtual clock that jumps
+// straight to the next event.
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    // Monotonic seconds
+    virtual double now() const = 0;
+    // Seconds since 1970, as YASDI time stamps
+    virtual DWORD unix_time() const = 0;
+
+    static Clock& real();
+};
+
+class RealClock : public Clock {
+public:
+    double now() const override;
+    DWORD unix_time() const override;
+};
+
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(DWORD epoch = 0) : epoch(epoch) {}
+
+    double now() const override { return current; }
+    DWORD unix_time() const override { return epoch + (DWORD)current; }
+
+    // Time never runs backwards
+    void advance_to(double time) {
+        if (time > current) {
+            current = time;
+        }
+    }
+
+private:
+    DWORD epoch;
+    double current = 0;
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "device_groups.h"
+#include "smadata_request.h"
+#include "plant_lock.h"
+#include "channel_codec.h"
+
+#include <algorithm>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+    #include "plant.h"
+    #include "master.h"
+    #include "ysecurity.h"
+    #include "statereadchan.h"
+}
+
+static int send_group_command(DWORD device_handle, BYTE cmd, WORD group) {
+    WORD net_addr;
+    DWORD prot_flags;
+
+    if (!SMADataRequest::resolve_device(device_handle, &net_addr, &prot_flags)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    BYTE payload[2] = { LOBYTE(group), HIBYTE(group) };
+    SMADataRequest request(net_addr, cmd);
+    request.set_flags(prot_flags);
+    request.set_payload(payload, sizeof(payload));
+    return request.execute();
+}
+
+int DeviceGroups::assign(WORD group, const std::vector<DWORD>& devices, std::vector<GroupMemberResult>& results) {
+    std::vector<DWORD> assigned;
+    int res = YE_OK;
+
+    results.clear();
+    for (DWORD device_handle : devices) {
+        int code = send_group_command(device_handle, CMD_SET_GRPADR, group);
+        results.push_back({device_handle, code});
+        if (code == YE_OK) {
+            assigned.push_back(device_handle);
+        } else {
+            res = code;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<DWORD>& members = group_map[group];
+    for (DWORD device_handle : assigned) {
+        if (std::find(members.begin(), members.end(), device_handle) == members.end()) {
+            members.push_back(device_handle);
+        }
+    }
+    return res;
+}
+
+int DeviceGroups::remove(WORD group, std::vector<GroupMemberResult>& results) {
+    std::vector<DWORD> devices;
+    int res = YE_OK;
+
+    results.clear();
+    if (!lookup(group, devices)) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    for (DWORD device_handle : devices) {
+        int code = send_group_command(device_handle, CMD_DEL_GRPADR, group);
+        results.push_back({device_handle, code});
+        if (code != YE_OK) {
+            res = code;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    group_map.erase(group);
+    return res;
+}
+
+std::vector<WORD> DeviceGroups::groups() const {
+    std::vector<WORD> result;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& group : group_map) {
+        result.push_back(group.first);
+    }
+    return result;
+}
+
+std::vector<DWORD> DeviceGroups::members(WORD group) const {
+    std::vector<DWORD> devices;
+    lookup(group, devices);
+    return devices;
+}
+
+bool DeviceGroups::lookup(WORD group, std::vector<DWORD>& devices) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = group_map.find(group);
+    if (it == group_map.end() || it->second.empty()) {
+        return false;
+    }
+    devices = it->second;
+    return true;
+}
+
+int DeviceGroups::send_group_frame(WORD group, BYTE cmd, const std::vector<BYTE>& payload, DWORD prot_flags, DWORD wait) {
+    SMADataRequest request(group, cmd);
+    request.set_flags(prot_flags | (group == 0 ? TS_BROADCAST : 0));
+    request.set_payload(payload.data(), (DWORD)payload.size());
+
+    // No answer is expected; a timeout is used as settle time where needed
+    if (wait > 0) {
+        request.set_timeout(wait, 0);
+        request.execute(PRIORITY_HIGH);
+        return YE_OK;
+    }
+
+    request.set_type(RT_NORCV);
+    return request.execute(PRIORITY_HIGH);
+}
+
+int DeviceGroups::write(WORD group, const std::string& channel_name, double value) {
+    std::vector<DWORD> devices;
+    if (!lookup(group, devices)) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    // All members must agree on the channel layout, the frame is built once;
+    // device and channel handles, looked up again after the frame went out
+    std::vector<std::pair<DWORD, DWORD>> targets;
+    std::vector<BYTE> payload;
+    DWORD prot_flags = 0;
+    std::unique_lock<std::mutex> plant(plant_mutex());
+    for (DWORD device_handle : devices) {
+        TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+        if (dev == NULL) {
+            return YE_UNKNOWN_HANDLE;
+        }
+
+        TChannel* chan = TNetDevice_FindChannelName(dev, (char*)channel_name.c_str());
+        if (chan == NULL) {
+            return YE_UNKNOWN_HANDLE;
+        }
+        if (!targets.empty()) {
+            TChannel* first = (TChannel*)TObjManager_GetRef(targets.front().second);
+            if (TChannel_GetIndex(chan) != TChannel_GetIndex(first) ||
+                TChannel_GetCType(chan) != TChannel_GetCType(first) ||
+                TChannel_GetNType(chan) != TChannel_GetNType(first)) {
+                return YE_CHAN_TYPE_MISMATCH;
+            }
+        }
+        if (!TChannel_IsLevel(chan, TSecurity_getCurLev(), CHECK_WRITE)) {
+            return YE_NO_ACCESS_RIGHTS;
+        }
+        if (targets.empty()) {
+            prot_flags = dev->prodID;
+        }
+        targets.push_back(std::make_pair(device_handle, chan->Handle));
+    }
+
+    TChannel* chan = (TChannel*)TObjManager_GetRef(targets.front().second);
+    double min_value, max_value;
+    if (GetChannelValRange(chan->Handle, &min_value, &max_value) == YE_OK &&
+        (value < min_value || value > max_value)) {
+        return YE_VALUE_NOT_VALID;
+    }
+    channel_set_data_payload(chan, value, payload);
+    plant.unlock();
+
+    int res = send_group_frame(group, CMD_SET_DATA, payload, prot_flags, 0);
+    if (res != YE_OK) {
+        return res;
+    }
+
+    // Like the master's own writer: mark the values outdated so the next
+    // read fetches the value the devices actually took
+    plant.lock();
+    for (const auto& target : targets) {
+        TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(target.first);
+        TChannel* channel = (TChannel*)TObjManager_GetRef(target.second);
+        if (dev != NULL && channel != NULL) {
+            TChannel_SetTimeStamp(channel, dev, 0);
+        }
+    }
+    return YE_OK;
+}
+
+int DeviceGroups::read(WORD group, TChanType type, DWORD timeout, std::vector<DWORD>& answered) {
+    std::vector<DWORD> devices;
+    answered.clear();
+    if (!lookup(group, devices)) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    WORD net_addr;
+    DWORD prot_flags;
+    if (!SMADataRequest::resolve_device(devices.front(), &net_addr, &prot_flags)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    WORD chan_mask;
+    switch (type) {
+        case SPOTCHANNELS:
+            chan_mask = CH_SPOT | CH_IN | CH_ALL;
+            break;
+        case PARAMCHANNELS:
+            chan_mask = CH_PARA | CH_ALL;
+            break;
+        case TESTCHANNELS:
+            chan_mask = CH_SPOT | CH_IN | CH_TEST | CH_ALL;
+            break;
+        default:
+            return YE_INVAL_ARGUMENT;
+    }
+
+    // Spot values are frozen by CMD_SYN_ONLINE; send it to the group and give
+    // the devices the configured settle time
+    if (type != PARAMCHANNELS) {
+        DWORD now = os_GetSystemTime(NULL);
+        std::vector<BYTE> sync = { (BYTE)(now & 0xff), (BYTE)((now >> 8) & 0xff),
+                                   (BYTE)((now >> 16) & 0xff), (BYTE)((now >> 24) & 0xff) };
+        send_group_frame(group, CMD_SYN_ONLINE, sync, prot_flags,
+                         TSMADataMaster_GetInstance()->Timeouts.WaitSecAfterSyncOnline);
+    }
+
+    std::vector<BYTE> payload = { LOBYTE(chan_mask), HIBYTE(chan_mask), 0 };
+    SMADataRequest request(group, CMD_GET_DATA);
+    request.set_flags(prot_flags | (group == 0 ? TS_BROADCAST : 0));
+    request.set_type(RT_MULTIRCV);
+    request.set_timeout(timeout, 0);
+    request.set_payload(payload.data(), (DWORD)payload.size());
+
+    // Scan on the YASDI thread, where the master updates values as well
+    std::vector<DWORD> members = devices;
+    request.set_receive_handler([&answered, members](WORD source, const BYTE* data, DWORD size) {
+        TNetDevice* dev = TPlant_FindDevAddr(source);
+        if (dev == NULL) {
+            return;
+        }
+        DWORD handle = TNetDevice_GetHandle(dev);
+        if (std::find(members.begin(), members.end(), handle) == members.end()) {
+            return;
+        }
+        if (TStateChanReader_ScanUpdateValue(dev, (BYTE*)data, size) == 0) {
+            answered.push_back(handle);
+        }
+    });
+
+    int res = request.execute();
+    if (answered.empty()) {
+        return res == YE_OK ? YE_TIMEOUT : res;
+    }
+    return answered.size() == devices.size() ? YE_OK : YE_TIMEOUT;
+}
@@ -0,0 +1,50 @@
+#ifndef DEVICE_GROUPS_H
+#define DEVICE_GROUPS_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "yasdi_headers.h"
+
+struct GroupMemberResult {
+    DWORD device_handle;
+    int code;
+};
+
+// SMAData group addressing (CMD_SET_GRPADR / CMD_DEL_GRPADR).
+// Devices are assigned to a group address once; afterwards a setpoint write
+// is a single CMD_SET_DATA frame to the group, and a read is one
+// CMD_GET_DATA to the group whose answers are scanned into each member.
+//
+// Both group commands carry the group address[2] as payload. YASDI only sets
+// the SMAData group control bit for broadcasts, so group 0 is sent as a
+// broadcast and any other group to its address.
+class DeviceGroups {
+public:
+    // One unicast CMD_SET_GRPADR per device
+    int assign(WORD group, const std::vector<DWORD>& devices, std::vector<GroupMemberResult>& results);
+    // One unicast CMD_DEL_GRPADR per member, the group is forgotten afterwards
+    int remove(WORD group, std::vector<GroupMemberResult>& results);
+
+    std::vector<WORD> groups() const;
+    std::vector<DWORD> members(WORD group) const;
+
+    // Write one value to a channel of all members with one frame. Group
+    // frames are not answered; the cached values are invalidated instead.
+    int write(WORD group, const std::string& channel_name, double value);
+
+    // Read spot or parameter channels of all members with one request.
+    // Returns YE_TIMEOUT if not every member answered.
+    int read(WORD group, TChanType type, DWORD timeout, std::vector<DWORD>& answered);
+
+private:
+    bool lookup(WORD group, std::vector<DWORD>& devices) const;
+    int send_group_frame(WORD group, BYTE cmd, const std::vector<BYTE>& payload, DWORD prot_flags, DWORD wait);
+
+    mutable std::mutex mutex;
+    std::map<WORD, std::vector<DWORD>> group_map;
+};
+
+#endif
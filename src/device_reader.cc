@@ -0,0 +1,152 @@
+#include "device_reader.h"
+#include "channel_values.h"
+#include "plant_lock.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+static void copy_text(char* slot, const std::string& text) {
+    size_t size = std::min(text.size(), (size_t)CHANNEL_TEXT_SIZE - 1);
+    std::memcpy(slot, text.data(), size);
+    slot[size] = 0;
+}
+
+std::shared_ptr<DeviceReader::DeviceBuffers> DeviceReader::buffers(DWORD device_handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<DeviceBuffers>& device = devices[device_handle];
+    if (!device) {
+        device = std::make_shared<DeviceBuffers>();
+    }
+    return device;
+}
+
+bool DeviceReader::load(DWORD device_handle, DeviceBuffers& device) {
+    DWORD channel_array[500];
+    char channel_name[64];
+    char channel_units[64];
+
+    int channel_count = GetChannelHandlesEx(device_handle, channel_array, 500, SPOTCHANNELS);
+    if (channel_count < 1) {
+        if (debug_level > 0) {
+            std::cout << "Could not get the channel count" << std::endl;
+        }
+        return false;
+    }
+
+    device.channels.clear();
+    for (int i = 0; i < channel_count; i++) {
+        if (GetChannelName(channel_array[i], channel_name, sizeof(channel_name) - 1) != YE_OK) {
+            if (debug_level > 0) {
+                std::cout << "Error reading channel name" << std::endl;
+            }
+            continue;
+        }
+
+        // Units of the reading (e.g., kWh, V, etc.)
+        channel_units[0] = 0;
+        GetChannelUnit(channel_array[i], channel_units, sizeof(channel_units) - 1);
+        device.channels.push_back({ channel_array[i], channel_name, channel_units });
+    }
+
+    size_t count = device.channels.size();
+    device.handles.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        device.handles[i] = device.channels[i].handle;
+    }
+    device.values.resize(count);
+    device.times.resize(count);
+    device.status.resize(count);
+    device.texts.resize(count * CHANNEL_TEXT_SIZE);
+    device.cached.reserve(count);
+    device.loaded = true;
+    return true;
+}
+
+void DeviceReader::read(DWORD device_handle, bool text, std::vector<ChannelData>& data, unsigned long long* version) {
+    read(device_handle, text, max_age.load(), data, version);
+}
+
+int DeviceReader::read(DWORD device_handle, bool text, DWORD age, std::vector<ChannelData>& data,
+                       unsigned long long* version) {
+    data.clear();
+    if (version) {
+        *version = 0;
+    }
+
+    std::shared_ptr<DeviceBuffers> device = buffers(device_handle);
+    std::lock_guard<std::mutex> lock(device->mutex);
+    int result;
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        if (!device->loaded && !load(device_handle, *device)) {
+            return YE_UNKNOWN_HANDLE;
+        }
+
+        // One freshness decision and at most one request per channel class,
+        // value texts only when asked for
+        result = read_channel_values(device_handle, device->handles.data(), (DWORD)device->handles.size(), age,
+                                     device->values.data(), device->times.data(), device->status.data(),
+                                     text ? device->texts.data() : NULL, CHANNEL_TEXT_SIZE);
+    }
+
+    data.resize(device->channels.size());
+    device->cached.clear();
+    size_t count = 0;
+
+    for (size_t i = 0; i < device->channels.size(); i++) {
+        const Channel& channel = device->channels[i];
+        if (device->status[i] != YE_OK) {
+            if (debug_level > 0) {
+                std::cout << "Error reading channel value for channel: " << channel.name << std::endl;
+            }
+            continue;
+        }
+
+        // Keep the value in the history, stamped with the time YASDI received it
+        double value = device->values[i];
+        DWORD value_time = device->times[i];
+        history.append(device_handle, channel.name, value_time, value);
+        device->cached.push_back({ channel.handle, value, value_time });
+
+        ChannelData& entry = data[count];
+        copy_text(entry.name, channel.name);
+        copy_text(entry.units, channel.units);
+        if (text) {
+            std::memcpy(entry.value, &device->texts[i * CHANNEL_TEXT_SIZE], CHANNEL_TEXT_SIZE);
+        } else {
+            entry.value[0] = 0;
+        }
+        entry.numericValue = value;
+        entry.receivedAt = receive_times.lookup(device_handle, channel.handle, value_time);
+        count++;
+    }
+    data.resize(count);
+
+    unsigned long long stored = 0;
+    values.store(device_handle, device->cached, &stored);
+    if (version) {
+        *version = stored;
+    }
+
+    // Publish changed values to worker threads reading the shared table
+    if (live_table.update(device_handle, stored, (uint32_t)time(NULL), data.data(), data.size())) {
+        live_table.publish();
+    }
+
+    if (result == YE_OK && count == 0 && !device->status.empty()) {
+        result = device->status[0];
+    }
+    return result;
+}
+
+void DeviceReader::forget(DWORD device_handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.erase(device_handle);
+}
+
+void DeviceReader::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.clear();
+}
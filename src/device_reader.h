@@ -0,0 +1,89 @@
+#ifndef DEVICE_READER_H
+#define DEVICE_READER_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "channel_data.h"
+#include "history_store.h"
+#include "live_table.h"
+#include "receive_times.h"
+#include "value_cache.h"
+
+#include "yasdi_headers.h"
+
+// Poll path of the spot values of a device. Channel handles, names and
+// units are looked up once per device and kept until the device is
+// forgotten (detected again or removed), and every poll of a device reuses
+// its buffers. A poll of a known device into a buffer of the previous poll
+// makes no heap allocation; test/native/read_path_test.cc counts them.
+class DeviceReader {
+public:
+    DeviceReader(HistoryStore& history, ValueCache& values, LiveTable& live_table, ReceiveTimes& receive_times)
+        : history(history), values(values), live_table(live_table), receive_times(receive_times) {}
+
+    // Read the spot values of a device into data, reusing its capacity.
+    // With text the value text slots are filled, otherwise left empty.
+    // Channels that cannot be read are left out. version gets the value
+    // cache version of the device that the data belongs to. Takes the plant
+    // lock, except while waiting for the bus.
+    void read(DWORD device_handle, bool text, std::vector<ChannelData>& data, unsigned long long* version = nullptr);
+
+    // The same with a maximum age for this read instead of the reader's.
+    // Returns YE_UNKNOWN_HANDLE for an unknown device, YE_TIMEOUT if values
+    // could not be refreshed, the status of the first channel if none could
+    // be read, otherwise YE_OK.
+    int read(DWORD device_handle, bool text, DWORD age, std::vector<ChannelData>& data,
+             unsigned long long* version = nullptr);
+
+    // Drop the channel list of a device, e.g. after detection
+    void forget(DWORD device_handle);
+    void clear();
+
+    void set_debug_level(int level) { debug_level = level; }
+
+    // Maximum age of the values in seconds, older ones are read from the
+    // device; ANY_VALUE_AGE takes what YASDI holds
+    static const DWORD DEFAULT_MAX_AGE = 5;
+    void set_max_age(DWORD seconds) { max_age = seconds; }
+
+private:
+    struct Channel {
+        DWORD handle;
+        std::string name;
+        std::string units;
+    };
+
+    struct DeviceBuffers {
+        std::mutex mutex;               // one poll of a device at a time
+        bool loaded = false;
+        std::vector<Channel> channels;
+        std::vector<CachedValue> cached;
+
+        // Per channel, in channel order, filled by read_channel_values
+        std::vector<DWORD> handles;
+        std::vector<double> values;
+        std::vector<DWORD> times;
+        std::vector<int> status;
+        std::vector<char> texts;
+    };
+
+    std::shared_ptr<DeviceBuffers> buffers(DWORD device_handle);
+    bool load(DWORD device_handle, DeviceBuffers& device);
+
+    HistoryStore& history;
+    ValueCache& values;
+    LiveTable& live_table;
+    ReceiveTimes& receive_times;
+    int debug_level = 0;
+    std::atomic<DWORD> max_age{ DEFAULT_MAX_AGE };
+
+    std::mutex mutex;
+    std::map<DWORD, std::shared_ptr<DeviceBuffers>> devices;
+};
+
+#endif
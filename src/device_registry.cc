@@ -0,0 +1,120 @@
+#include "device_registry.h"
+#include "hazard_pointers.h"
+
+#include <algorithm>
+
+const RegistryChannel* RegistryDevice::find_channel(const std::string& channel_name) const {
+    auto it = channel_index.find(channel_name);
+    return it != channel_index.end() ? &channels[it->second] : nullptr;
+}
+
+const RegistryDevice* RegistrySnapshot::find(DWORD device_handle) const {
+    auto it = by_handle.find(device_handle);
+    return it != by_handle.end() ? &devices[it->second] : nullptr;
+}
+
+const RegistryDevice* RegistrySnapshot::find_name(const std::string& name) const {
+    auto it = by_name.find(name);
+    return it != by_name.end() ? &devices[it->second] : nullptr;
+}
+
+const RegistryDevice* RegistrySnapshot::find_serial(DWORD serial) const {
+    auto it = by_serial.find(serial);
+    return it != by_serial.end() ? &devices[it->second] : nullptr;
+}
+
+DeviceRegistry::DeviceRegistry()
+    : current(new Published{ std::make_shared<RegistrySnapshot>() }) {
+}
+
+DeviceRegistry::~DeviceRegistry() {
+    delete current.load();
+    for (const Published* published : replaced) {
+        delete published;
+    }
+}
+
+DeviceRegistry::SnapshotPtr DeviceRegistry::snapshot() const {
+    std::atomic<const void*>& hazard = thread_hazard(HAZARD_REGISTRY);
+
+    // Once announced and still current, a writer cannot free it anymore
+    const Published* published = protect(current, hazard);
+    SnapshotPtr snapshot = published->snapshot;
+    hazard.store(nullptr, std::memory_order_release);
+    return snapshot;
+}
+
+unsigned long long DeviceRegistry::version() const {
+    return snapshot()->version;
+}
+
+DeviceRegistry::SnapshotPtr DeviceRegistry::publish(std::vector<RegistryDevice> devices) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+
+    SnapshotPtr next = build(std::move(devices), snapshot()->version + 1);
+    replace(next);
+    return next;
+}
+
+DeviceRegistry::SnapshotPtr DeviceRegistry::remove(DWORD device_handle) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+
+    SnapshotPtr previous = snapshot();
+    std::vector<RegistryDevice> devices;
+    devices.reserve(previous->devices.size());
+    for (const RegistryDevice& device : previous->devices) {
+        if (device.handle != device_handle) {
+            devices.push_back(device);
+        }
+    }
+
+    SnapshotPtr next = build(std::move(devices), previous->version + 1);
+    previous.reset();
+    replace(next);
+    return next;
+}
+
+void DeviceRegistry::replace(SnapshotPtr next) {
+    const Published* previous = current.exchange(new Published{ std::move(next) }, std::memory_order_seq_cst);
+    retired.push_back(previous->snapshot);
+    replaced.push_back(previous);
+
+    // A replaced version cannot be picked up anymore; once no reader
+    // announced it, it is gone
+    replaced.erase(std::remove_if(replaced.begin(), replaced.end(),
+                                  [](const Published* published) {
+                                      if (hazardous(published)) {
+                                          return false;
+                                      }
+                                      delete published;
+                                      return true;
+                                  }),
+                   replaced.end());
+
+    // Once only this list holds a snapshot, no reader is left
+    retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                 [](const SnapshotPtr& snapshot) { return snapshot.use_count() == 1; }),
+                  retired.end());
+}
+
+DeviceRegistry::SnapshotPtr DeviceRegistry::build(std::vector<RegistryDevice> devices, unsigned long long version) {
+    auto snapshot = std::make_shared<RegistrySnapshot>();
+    snapshot->version = version;
+    snapshot->devices = std::move(devices);
+
+    for (size_t i = 0; i < snapshot->devices.size(); i++) {
+        RegistryDevice& device = snapshot->devices[i];
+        device.channel_index.clear();
+        for (size_t j = 0; j < device.channels.size(); j++) {
+            device.channel_index[device.channels[j].name] = j;
+        }
+
+        snapshot->by_handle[device.handle] = i;
+        snapshot->by_name[device.name] = i;
+        if (device.serial != 0) {
+            snapshot->by_serial[device.serial] = i;
+        }
+    }
+
+    return snapshot;
+}
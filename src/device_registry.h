@@ -0,0 +1,97 @@
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mem_stats.h"
+#include "yasdi_headers.h"
+
+struct RegistryChannel {
+    DWORD handle;
+    std::string name;
+    std::string unit;
+};
+
+struct RegistryDevice {
+    DWORD handle = 0;
+    std::string name;
+    std::string type;
+    DWORD serial = 0;
+    std::vector<RegistryChannel, TaggedAllocator<RegistryChannel, MEM_CHANNELS>> channels;
+
+    const RegistryChannel* find_channel(const std::string& channel_name) const;
+
+private:
+    friend class DeviceRegistry;
+    std::map<std::string, size_t> channel_index;
+};
+
+// Immutable version of the device and channel lists
+struct RegistrySnapshot {
+    unsigned long long version = 0;
+    std::vector<RegistryDevice> devices;
+
+    const RegistryDevice* find(DWORD device_handle) const;
+    const RegistryDevice* find_name(const std::string& name) const;
+    const RegistryDevice* find_serial(DWORD serial) const;
+
+private:
+    friend class DeviceRegistry;
+    std::map<DWORD, size_t> by_handle;
+    std::map<std::string, size_t> by_name;
+    std::map<DWORD, size_t> by_serial;
+};
+
+// Read-copy-update registry of the plant's devices.
+// Readers take the current snapshot and keep using it as long as they hold
+// the pointer; they never wait for detection or removal. Writers build a
+// complete new version aside and publish it with one atomic pointer swap.
+//
+// Taking a snapshot is lock-free: the reader announces the version it is
+// about to copy in a hazard slot of its thread (hazard_pointers.h), checks
+// that it is still current and copies the shared pointer (an atomic
+// increment). Writers free a replaced version only once no hazard slot
+// names it. Snapshots replaced are retired and freed by a later writer
+// once no reader holds them anymore, so readers never pay for reclamation.
+class DeviceRegistry {
+public:
+    typedef std::shared_ptr<const RegistrySnapshot> SnapshotPtr;
+
+    DeviceRegistry();
+    ~DeviceRegistry();
+
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+
+    SnapshotPtr snapshot() const;
+    unsigned long long version() const;
+
+    // Replace all devices (e.g. after detection)
+    SnapshotPtr publish(std::vector<RegistryDevice> devices);
+
+    // Publish a version without one device
+    SnapshotPtr remove(DWORD device_handle);
+
+private:
+    // What readers find through the current pointer
+    struct Published {
+        SnapshotPtr snapshot;
+    };
+
+    SnapshotPtr build(std::vector<RegistryDevice> devices, unsigned long long version);
+    void replace(SnapshotPtr next);
+
+    std::atomic<const Published*> current;
+
+    // Serializes writers only
+    std::mutex writer_mutex;
+    std::vector<const Published*> replaced;     // freed once no hazard slot names them
+    std::vector<SnapshotPtr> retired;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#include "event_sim.h"
+
+void EventSimulator::at(double time, std::function<void()> action) {
+    if (time < now()) {
+        time = now();
+    }
+    events.push({ time, next_seq++, std::move(action) });
+}
+
+void EventSimulator::after(double delay, std::function<void()> action) {
+    at(now() + delay, std::move(action));
+}
+
+unsigned long long EventSimulator::run_until(double end) {
+    unsigned long long count = 0;
+
+    while (!events.empty() && events.top().time <= end) {
+        Event event = events.top();
+        events.pop();
+
+        virtual_clock.advance_to(event.time);
+        event.action();
+        count++;
+    }
+
+    virtual_clock.advance_to(end);
+    return count;
+}
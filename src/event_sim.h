@@ -0,0 +1,44 @@
+#ifndef EVENT_SIM_H
+#define EVENT_SIM_H
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "clock.h"
+
+// Single threaded discrete-event simulator on a virtual clock.
+// Events run in time order (and in scheduling order for equal times); the
+// clock jumps to each event, so idle time costs nothing.
+class EventSimulator {
+public:
+    explicit EventSimulator(DWORD epoch = 0) : virtual_clock(epoch) {}
+
+    VirtualClock& clock() { return virtual_clock; }
+    double now() const { return virtual_clock.now(); }
+
+    void at(double time, std::function<void()> action);
+    void after(double delay, std::function<void()> action);
+
+    // Run all events up to "end", returns the number of events run
+    unsigned long long run_until(double end);
+
+private:
+    struct Event {
+        double time;
+        unsigned long long seq;
+        std::function<void()> action;
+    };
+
+    struct Later {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+        }
+    };
+
+    VirtualClock virtual_clock;
+    std::priority_queue<Event, std::vector<Event>, Later> events;
+    unsigned long long next_seq = 0;
+};
+
+#endif
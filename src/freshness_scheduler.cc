@@ -0,0 +1,316 @@
+#include "freshness_scheduler.h"
+#include "smadata_request.h"
+#include "plant_lock.h"
+
+#include <algorithm>
+#include <chrono>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+    #include "master.h"
+}
+
+int FreshnessPlan::admit(DWORD id, DWORD device_handle, size_t requests, double max_age, bool degrade,
+                         double now, double& granted) {
+    if (requests == 0 || max_age <= 0) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    double cost = requests * request_cost(device_handle);
+    double free = capacity - utilization();
+    granted = max_age;
+    if (2 * cost / max_age > free) {
+        if (!degrade || free <= 0) {
+            return YE_TOO_MANY_REQUESTS;
+        }
+        granted = 2 * cost / free;
+    }
+
+    Job& job = jobs[id];
+    job.stats.id = id;
+    job.stats.device_handle = device_handle;
+    job.stats.requested_age = max_age;
+    job.stats.max_age = granted;
+    job.stats.degraded = granted > max_age;
+    job.stats.requests = requests;
+    job.release = now;
+    job.deadline = now + granted / 2;
+    return YE_OK;
+}
+
+bool FreshnessPlan::remove(DWORD id) {
+    return jobs.erase(id) > 0;
+}
+
+void FreshnessPlan::clear() {
+    jobs.clear();
+}
+
+DWORD FreshnessPlan::next(double now, double& next_release) const {
+    DWORD best = 0;
+    double best_deadline = 0;
+    next_release = 0;
+
+    for (const auto& entry : jobs) {
+        const Job& job = entry.second;
+        if (job.release > now) {
+            if (next_release == 0 || job.release < next_release) {
+                next_release = job.release;
+            }
+        } else if (best == 0 || job.deadline < best_deadline) {
+            best = entry.first;
+            best_deadline = job.deadline;
+        }
+    }
+    return best;
+}
+
+void FreshnessPlan::completed(DWORD id, bool success, double now, double duration) {
+    auto it = jobs.find(id);
+    if (it == jobs.end()) {
+        return;
+    }
+    Job& job = it->second;
+    double period = job.stats.max_age / 2;
+
+    if (success) {
+        // Moving average over roughly the last 4 refreshes of the device
+        double cost = duration / job.stats.requests;
+        auto known = costs.find(job.stats.device_handle);
+        if (known == costs.end()) {
+            costs[job.stats.device_handle] = cost;
+        } else {
+            known->second += (cost - known->second) / 4;
+        }
+
+        // The first refresh has no age to compare, only its deadline
+        bool met = now <= job.deadline;
+        if (job.last_refresh >= 0) {
+            double age = now - job.last_refresh;
+            job.stats.worst_age = std::max(job.stats.worst_age, age);
+            met = age <= job.stats.max_age;
+        }
+        job.stats.refreshes++;
+        if (met) {
+            job.stats.met++;
+        } else {
+            job.stats.missed++;
+        }
+        job.last_refresh = now;
+    } else {
+        // Retried at the regular pace, a silent device must not take the bus
+        job.stats.failures++;
+    }
+
+    job.release = now + period;
+    job.deadline = job.release + period;
+}
+
+double FreshnessPlan::request_cost(DWORD device_handle) const {
+    auto it = costs.find(device_handle);
+    return it != costs.end() ? it->second : default_cost;
+}
+
+double FreshnessPlan::density(const Job& job) const {
+    return 2 * job.stats.requests * request_cost(job.stats.device_handle) / job.stats.max_age;
+}
+
+double FreshnessPlan::utilization() const {
+    double total = 0;
+    for (const auto& entry : jobs) {
+        total += density(entry.second);
+    }
+    return total;
+}
+
+std::vector<PollJobStats> FreshnessPlan::stats(double now) const {
+    std::vector<PollJobStats> result;
+    for (const auto& entry : jobs) {
+        const Job& job = entry.second;
+        PollJobStats stats = job.stats;
+        stats.cost = job.stats.requests * request_cost(job.stats.device_handle);
+        if (job.last_refresh >= 0) {
+            stats.age = now - job.last_refresh;
+            stats.worst_age = std::max(stats.worst_age, stats.age);
+        }
+        result.push_back(stats);
+    }
+    return result;
+}
+
+FreshnessScheduler::~FreshnessScheduler() {
+    stop();
+}
+
+bool FreshnessScheduler::plan_requests(const PollJobConfig& config, std::vector<Request>& requests) {
+    std::lock_guard<std::mutex> plant(plant_mutex());
+    TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(config.device_handle);
+    if (dev == NULL || config.channels.empty()) {
+        return false;
+    }
+
+    // One request per channel class; within a class the mask selects the
+    // channel types and index 0 all channels of them, a single channel by its index
+    std::map<WORD, std::vector<TChannel*>> classes;
+    for (DWORD handle : config.channels) {
+        TChannel* chan = (TChannel*)TObjManager_GetRef(handle);
+        if (chan == NULL || TNetDevice_FindChannelName(dev, chan->Name) != chan) {
+            return false;
+        }
+        classes[TChannel_GetCType(chan) & (CH_PARA | CH_SPOT | CH_MEAN | CH_TEST)].push_back(chan);
+    }
+
+    requests.clear();
+    for (const auto& entry : classes) {
+        Request request = { 0, 0 };
+        for (TChannel* chan : entry.second) {
+            request.mask |= TChannel_GetCType(chan);
+        }
+        if (entry.second.size() == 1) {
+            request.index = TChannel_GetIndex(entry.second[0]);
+        }
+        requests.push_back(request);
+    }
+    return true;
+}
+
+int FreshnessScheduler::add(const PollJobConfig& config, DWORD& id, double& granted) {
+    JobRead read = { config.device_handle, config.read_timeout, {} };
+    if (!plan_requests(config, read.requests)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    // A stop() in between would join the thread started here, or a thread
+    // still running would see stopping reset
+    std::lock_guard<std::mutex> running(lifecycle);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int res = plan.admit(next_id, config.device_handle, read.requests.size(), config.max_age,
+                             config.degrade, clock.now(), granted);
+        if (res != YE_OK) {
+            return res;
+        }
+        id = next_id++;
+        reads[id] = read;
+        stopping = false;
+
+        if (!thread.joinable()) {
+            thread = std::thread(&FreshnessScheduler::run, this);
+        }
+    }
+    wake.notify_all();
+    return YE_OK;
+}
+
+bool FreshnessScheduler::remove(DWORD id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reads.erase(id);
+    return plan.remove(id);
+}
+
+void FreshnessScheduler::stop() {
+    std::lock_guard<std::mutex> running(lifecycle);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    plan.clear();
+    reads.clear();
+}
+
+void FreshnessScheduler::set_read_handler(std::function<void(DWORD device_handle)> handler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    on_read = handler;
+}
+
+std::vector<PollJobStats> FreshnessScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return plan.stats(clock.now());
+}
+
+double FreshnessScheduler::utilization() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return plan.utilization();
+}
+
+double FreshnessScheduler::capacity() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return plan.bus_capacity();
+}
+
+int FreshnessScheduler::refresh(const JobRead& read, double& duration) {
+    WORD net_addr;
+    DWORD prot_flags;
+    if (!SMADataRequest::resolve_device(read.device_handle, &net_addr, &prot_flags)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    double start = clock.now();
+    for (const Request& entry : read.requests) {
+        // mask[2] index[1]
+        BYTE payload[3] = { LOBYTE(entry.mask), HIBYTE(entry.mask), entry.index };
+        SMADataRequest request(net_addr, CMD_GET_DATA);
+        request.set_flags(prot_flags);
+        request.set_timeout(read.timeout, 0);
+        request.set_payload(payload, sizeof(payload));
+
+        // Scan on the YASDI thread, where the master updates values as well;
+        // the device is looked up there, it may be removed meanwhile
+        bool scanned = false;
+        DWORD device_handle = read.device_handle;
+        request.set_receive_handler([device_handle, &scanned](WORD, const BYTE* data, DWORD size) {
+            TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+            scanned = dev != NULL && TStateChanReader_ScanUpdateValue(dev, (BYTE*)data, size) == 0;
+        });
+
+        int res = request.execute(PRIORITY_NORMAL);
+        if (res != YE_OK) {
+            return res;
+        }
+        if (!scanned) {
+            return YE_VALUE_NOT_VALID;
+        }
+    }
+    duration = clock.now() - start;
+    return YE_OK;
+}
+
+void FreshnessScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!stopping) {
+        double now = clock.now();
+        double next_release = 0;
+        DWORD id = plan.next(now, next_release);
+        if (id == 0) {
+            if (next_release == 0) {
+                wake.wait(lock);
+            } else {
+                wake.wait_for(lock, std::chrono::duration<double>(next_release - now));
+            }
+            continue;
+        }
+
+        JobRead read = reads[id];
+        std::function<void(DWORD)> handler = on_read;
+        lock.unlock();
+
+        double duration = 0;
+        int res = refresh(read, duration);
+        if (res == YE_OK && handler) {
+            handler(read.device_handle);
+        }
+
+        lock.lock();
+        plan.completed(id, res == YE_OK, clock.now(), duration);
+    }
+}
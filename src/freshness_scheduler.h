@@ -0,0 +1,139 @@
+#ifndef FRESHNESS_SCHEDULER_H
+#define FRESHNESS_SCHEDULER_H
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "clock.h"
+
+#include "yasdi_headers.h"
+
+struct PollJobConfig {
+    DWORD device_handle = 0;
+    std::vector<DWORD> channels;    // channel handles of the device
+    double max_age = 0;             // s, values must never be older than this
+    bool degrade = false;           // accept a longer max age instead of a refusal
+    DWORD read_timeout = 1;         // s
+};
+
+struct PollJobStats {
+    DWORD id = 0;
+    DWORD device_handle = 0;
+    double requested_age = 0;       // s
+    double max_age = 0;             // s, granted
+    bool degraded = false;
+    size_t requests = 0;            // GET_DATA requests per refresh
+    double cost = 0;                // s of bus time per refresh, estimated
+    unsigned long long refreshes = 0;
+    unsigned long long failures = 0;
+    unsigned long long met = 0;     // refreshes that came within max age
+    unsigned long long missed = 0;
+    double age = -1;                // s since the last refresh, -1 before the first
+    double worst_age = 0;           // s, oldest the values got before a refresh
+};
+
+// Earliest-deadline-first planning of poll jobs with freshness targets,
+// independent of bus and time source. A job with max age A is released
+// A/2 after its last refresh and is due A/2 after release, so a refresh
+// that meets its deadline keeps the values younger than A even when the
+// previous one finished right at its release. With a read cost C the job
+// needs a share 2C/A of the bus; jobs are admitted while the shares add
+// up to no more than the capacity, the rest of the bus stays free for
+// polls, writes and detection. A job that does not fit is refused, or
+// with degrade granted the largest max age that fits.
+class FreshnessPlan {
+public:
+    explicit FreshnessPlan(double capacity = 0.8, double default_cost = 0.25)
+        : capacity(capacity), default_cost(default_cost) {}
+
+    // YE_OK with the granted max age, YE_TOO_MANY_REQUESTS if the bus cannot carry it
+    int admit(DWORD id, DWORD device_handle, size_t requests, double max_age, bool degrade, double now, double& granted);
+    bool remove(DWORD id);
+    void clear();
+
+    // Released job with the earliest deadline; 0 if none is released yet,
+    // next_release then tells when the next one is
+    DWORD next(double now, double& next_release) const;
+
+    // Outcome of a refresh of a job that took duration s of bus time
+    void completed(DWORD id, bool success, double now, double duration);
+
+    // Measured cost of a single request to a device, s
+    double request_cost(DWORD device_handle) const;
+
+    double utilization() const;
+    double bus_capacity() const { return capacity; }
+    std::vector<PollJobStats> stats(double now) const;
+    bool empty() const { return jobs.empty(); }
+
+private:
+    struct Job {
+        PollJobStats stats;
+        double release = 0;
+        double deadline = 0;
+        double last_refresh = -1;
+    };
+
+    double density(const Job& job) const;
+
+    std::map<DWORD, Job> jobs;
+    std::map<DWORD, double> costs;      // s per request, moving average per device
+    double capacity;
+    double default_cost;
+};
+
+// Keeps poll jobs within their freshness targets in a native thread. Each
+// refresh reads the job's channels with one CMD_GET_DATA per channel class
+// (parameter, spot, mean, test) of that device, back to back through the
+// SMAData scheduler, and measures the bus time per request for the cost
+// estimate of that device. The read handler is called after every
+// successful refresh, on the scheduler thread.
+class FreshnessScheduler {
+public:
+    explicit FreshnessScheduler(Clock& clock = Clock::real()) : clock(clock) {}
+    ~FreshnessScheduler();
+
+    int add(const PollJobConfig& config, DWORD& id, double& granted);
+    bool remove(DWORD id);
+    void stop();
+
+    void set_read_handler(std::function<void(DWORD device_handle)> handler);
+
+    std::vector<PollJobStats> stats() const;
+    double utilization() const;
+    double capacity() const;
+
+private:
+    struct Request {
+        WORD mask;
+        BYTE index;
+    };
+
+    struct JobRead {
+        DWORD device_handle;
+        DWORD timeout;
+        std::vector<Request> requests;
+    };
+
+    void run();
+    int refresh(const JobRead& read, double& duration);
+    static bool plan_requests(const PollJobConfig& config, std::vector<Request>& requests);
+
+    Clock& clock;
+    FreshnessPlan plan;
+    std::map<DWORD, JobRead> reads;
+    std::function<void(DWORD)> on_read;
+    DWORD next_id = 1;
+
+    std::mutex lifecycle;               // starting and stopping the thread
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "hazard_pointers.h"
+
+// Hazard slots, one per thread that ever announced a pointer. Slots are
+// never freed, a thread that ends hands its slot to the next new thread.
+namespace {
+    struct HazardSlot {
+        std::atomic<const void*> pointers[HAZARD_USERS];
+        std::atomic<bool> taken{ false };
+        HazardSlot* next = nullptr;
+
+        HazardSlot() {
+            for (std::atomic<const void*>& pointer : pointers) {
+                pointer.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    std::atomic<HazardSlot*> hazard_slots{ nullptr };
+
+    HazardSlot* claim_slot() {
+        for (HazardSlot* slot = hazard_slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            bool expected = false;
+            if (!slot->taken.load(std::memory_order_relaxed) &&
+                slot->taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return slot;
+            }
+        }
+
+        HazardSlot* slot = new HazardSlot;
+        slot->taken.store(true, std::memory_order_relaxed);
+        HazardSlot* head = hazard_slots.load(std::memory_order_relaxed);
+        do {
+            slot->next = head;
+        } while (!hazard_slots.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+        return slot;
+    }
+
+    struct ThreadHazard {
+        HazardSlot* slot = claim_slot();
+
+        ~ThreadHazard() {
+            for (std::atomic<const void*>& pointer : slot->pointers) {
+                pointer.store(nullptr, std::memory_order_release);
+            }
+            slot->taken.store(false, std::memory_order_release);
+        }
+    };
+}
+
+std::atomic<const void*>& thread_hazard(HazardUser user) {
+    static thread_local ThreadHazard hazard;
+    return hazard.slot->pointers[user];
+}
+
+bool hazardous(const void* pointer) {
+    for (HazardSlot* slot = hazard_slots.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+        for (const std::atomic<const void*>& announced : slot->pointers) {
+            if (announced.load(std::memory_order_seq_cst) == pointer) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+#ifndef HAZARD_POINTERS_H
+#define HAZARD_POINTERS_H
+
+#include <atomic>
+
+// Hazard pointers of the lock-free readers. A reader announces the shared
+// object it is about to use in a slot of its thread and checks that the
+// object is still current; a writer frees an object it replaced only once
+// no slot names it. Every thread has one pointer per user, so a reader of
+// one structure may read the other meanwhile.
+enum HazardUser { HAZARD_REGISTRY, HAZARD_VALUE_CACHE, HAZARD_USERS };
+
+std::atomic<const void*>& thread_hazard(HazardUser user);
+
+// Whether a thread announced pointer
+bool hazardous(const void* pointer);
+
+// Announce the object current points to; once it is still current after the
+// announcement, no writer frees it until the hazard is cleared
+template <typename T>
+const T* protect(const std::atomic<const T*>& current, std::atomic<const void*>& hazard) {
+    const T* pointer = current.load(std::memory_order_acquire);
+    for (;;) {
+        hazard.store(pointer, std::memory_order_seq_cst);
+        const T* again = current.load(std::memory_order_seq_cst);
+        if (again == pointer) {
+            return pointer;
+        }
+        pointer = again;
+    }
+}
+
+#endif
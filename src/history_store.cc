@@ -0,0 +1,162 @@
+#include "history_store.h"
+
+#include <algorithm>
+
+size_t SampleRing::lower_bound(DWORD time) const {
+    size_t first = 0;
+    size_t last = count;
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+        if ((*this)[middle].time < time) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+void SampleRing::insert(size_t index, const HistorySample& sample, size_t capacity) {
+    if (count >= capacity) {
+        // Older than everything kept, or make room by dropping the oldest
+        if (index == 0 || capacity == 0) {
+            return;
+        }
+        head = (head + 1) % slots.size();
+        count--;
+        index--;
+    } else if (count == slots.size()) {
+        grow(capacity);
+    }
+
+    for (size_t i = count; i > index; i--) {
+        (*this)[i] = (*this)[i - 1];
+    }
+    count++;
+    (*this)[index] = sample;
+}
+
+void SampleRing::grow(size_t capacity) {
+    decltype(slots) larger(std::min(capacity, std::max<size_t>(16, slots.size() * 2)));
+    for (size_t i = 0; i < count; i++) {
+        larger[i] = (*this)[i];
+    }
+    slots.swap(larger);
+    head = 0;
+}
+
+HistoryStore::HistoryStore(size_t max_samples_per_series)
+    : capacity(max_samples_per_series) {
+}
+
+void HistoryStore::append(DWORD device_handle, const std::string& channel, DWORD time, double value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Series& series = devices[device_handle][channel];
+
+    // Fast path, live values arrive in order
+    if (series.empty() || series.back().time < time) {
+        series.insert(series.size(), {time, value}, capacity);
+    } else if (series.back().time == time) {
+        series.back().value = value;
+    } else {
+        insert(series, time, value);
+    }
+}
+
+size_t HistoryStore::merge(DWORD device_handle, const std::string& channel, const std::vector<HistorySample>& samples) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Series& series = devices[device_handle][channel];
+    size_t inserted = 0;
+
+    for (const auto& sample : samples) {
+        if (insert(series, sample.time, sample.value)) {
+            inserted++;
+        }
+    }
+    return inserted;
+}
+
+bool HistoryStore::insert(Series& series, DWORD time, double value) {
+    size_t pos = series.lower_bound(time);
+    if (pos < series.size() && series[pos].time == time) {
+        return false;
+    }
+    series.insert(pos, {time, value}, capacity);
+    return true;
+}
+
+std::vector<HistorySample> HistoryStore::query(DWORD device_handle, const std::string& channel, DWORD from, DWORD to) const {
+    std::vector<HistorySample> result;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto dev = devices.find(device_handle);
+    if (dev == devices.end()) {
+        return result;
+    }
+    auto chan = dev->second.find(channel);
+    if (chan == dev->second.end()) {
+        return result;
+    }
+
+    const Series& series = chan->second;
+    for (size_t i = series.lower_bound(from); i < series.size() && series[i].time <= to; i++) {
+        result.push_back(series[i]);
+    }
+    return result;
+}
+
+size_t HistoryStore::columns(DWORD device_handle, const std::string& channel, DWORD from, DWORD to,
+                             std::vector<DWORD>& times, std::vector<double>& values) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto dev = devices.find(device_handle);
+    if (dev == devices.end()) {
+        return 0;
+    }
+    auto chan = dev->second.find(channel);
+    if (chan == dev->second.end()) {
+        return 0;
+    }
+
+    const Series& series = chan->second;
+    size_t appended = 0;
+    for (size_t i = series.lower_bound(from); i < series.size() && series[i].time <= to; i++) {
+        times.push_back(series[i].time);
+        values.push_back(series[i].value);
+        appended++;
+    }
+    return appended;
+}
+
+std::vector<std::string> HistoryStore::channels(DWORD device_handle) const {
+    std::vector<std::string> result;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto dev = devices.find(device_handle);
+    if (dev != devices.end()) {
+        for (const auto& chan : dev->second) {
+            result.push_back(chan.first);
+        }
+    }
+    return result;
+}
+
+DWORD HistoryStore::last_time(DWORD device_handle) const {
+    DWORD newest = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto dev = devices.find(device_handle);
+    if (dev != devices.end()) {
+        for (const auto& chan : dev->second) {
+            if (!chan.second.empty()) {
+                newest = std::max(newest, chan.second.back().time);
+            }
+        }
+    }
+    return newest;
+}
+
+void HistoryStore::clear(DWORD device_handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.erase(device_handle);
+}
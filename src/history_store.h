@@ -0,0 +1,80 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mem_stats.h"
+#include "yasdi_headers.h"
+
+// One stored value of a channel (time in seconds since 1970)
+struct HistorySample {
+    DWORD time;
+    double value;
+};
+
+// Samples of one channel in time order. The ring grows up to the series
+// capacity; once full, a new sample takes the slot of the oldest one, so
+// live polls append without allocating.
+class SampleRing {
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    HistorySample& operator[](size_t index) { return slots[(head + index) % slots.size()]; }
+    const HistorySample& operator[](size_t index) const { return slots[(head + index) % slots.size()]; }
+    HistorySample& back() { return (*this)[count - 1]; }
+    const HistorySample& back() const { return (*this)[count - 1]; }
+
+    // Index of the first sample not older than time
+    size_t lower_bound(DWORD time) const;
+
+    // Insert before index; when full the oldest sample is dropped
+    void insert(size_t index, const HistorySample& sample, size_t capacity);
+
+private:
+    void grow(size_t capacity);
+
+    std::vector<HistorySample, TaggedAllocator<HistorySample, MEM_HISTORY>> slots;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// In-memory time series of channel values per device.
+// Live polls append at the end, backfilled records are merged in time order.
+class HistoryStore {
+public:
+    explicit HistoryStore(size_t max_samples_per_series = 10080);
+
+    void append(DWORD device_handle, const std::string& channel, DWORD time, double value);
+
+    // Merge samples in any order; samples with an already stored time stamp
+    // are skipped. Returns the number of samples inserted.
+    size_t merge(DWORD device_handle, const std::string& channel, const std::vector<HistorySample>& samples);
+
+    std::vector<HistorySample> query(DWORD device_handle, const std::string& channel, DWORD from, DWORD to) const;
+
+    // Like query, appended to separate time and value columns. Returns the
+    // number of samples appended.
+    size_t columns(DWORD device_handle, const std::string& channel, DWORD from, DWORD to,
+                   std::vector<DWORD>& times, std::vector<double>& values) const;
+    std::vector<std::string> channels(DWORD device_handle) const;
+
+    // Time stamp of the newest sample of a device, 0 if none is stored
+    DWORD last_time(DWORD device_handle) const;
+
+    void clear(DWORD device_handle);
+
+private:
+    typedef SampleRing Series;
+
+    bool insert(Series& series, DWORD time, double value);
+
+    mutable std::mutex mutex;
+    std::map<DWORD, std::map<std::string, Series>> devices;
+    size_t capacity;
+};
+
+#endif
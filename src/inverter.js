@@ -1,4 +1,5 @@
 const { InverterWrapper } = require("../build/Release/inverter_sdk");
+const { liveTableSize, LiveTableReader } = require("./live_table");
 
 class SMInverter {
   constructor(options = {}) {
@@ -7,6 +8,7 @@ class SMInverter {
     this.wrapper = new InverterWrapper(this.debugLevel);
     this.initialized = false;
     this.deviceMap = new Map();
+    this.liveTable = null;
   }
 
   /**
@@ -58,12 +60,39 @@ class SMInverter {
     }
   }
 
+  /**
+   * Remove a device from the plant, e.g. after it was replaced
+   * @param {number|string} deviceHandle Device handle or name
+   * @returns {Promise<Object>} Result with success status
+   */
+  async removeDevice(deviceHandle) {
+    this._checkInitialized();
+
+    try {
+      if (typeof deviceHandle === "string") {
+        const name = deviceHandle;
+        deviceHandle = await this._resolveDeviceHandle(name);
+        this.deviceMap.delete(name);
+      }
+      return this.wrapper.removeDevice(deviceHandle);
+    } catch (error) {
+      console.error(`Failed to remove device ${deviceHandle}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
   /**
    * Get live data from a specific inverter device
    * @param {number|string} deviceHandle Device handle or name
-   * @returns {Promise<Object>} Inverter data
+   * @param {Object} [options] { text: false } reads numeric values only, value texts stay empty;
+   *   { ifNewerThan: version } returns { notModified: true, version } if the values read have not changed since
+   * @returns {Promise<Object>} Inverter data, with the version of its values
    */
-  async getDeviceData(deviceHandle) {
+  async getDeviceData(deviceHandle, options = {}) {
     this._checkInitialized();
 
     // If a string is provided, look up the device handle
@@ -82,9 +111,12 @@ class SMInverter {
     }
 
     try {
-      const data = this.wrapper.getDeviceData(deviceHandle);
+      const data = this.wrapper.getDeviceData(deviceHandle, options);
+      if (data.notModified) {
+        return { notModified: true, version: data.version };
+      }
       // Add timestamp
-      data.timestamp = new Date().toISOString();
+      data.timestamp = this._sampleTime(data);
       return this._processData(data);
     } catch (error) {
       console.error(`Failed to get data for device ${deviceHandle}:`, error);
@@ -92,6 +124,97 @@ class SMInverter {
     }
   }
 
+  /**
+   * Poll several devices at once. Decoding and encoding run on native worker
+   * threads while the next device is on the bus.
+   * @param {Array<number|string>} deviceHandles Device handles or names
+   * @returns {Promise<Object[]>} Processed data per device, as from getDeviceData
+   */
+  async pollDevices(deviceHandles) {
+    this._checkInitialized();
+
+    try {
+      const handles = [];
+      for (const device of deviceHandles) {
+        handles.push(
+          typeof device === "string"
+            ? await this._resolveDeviceHandle(device)
+            : device
+        );
+      }
+
+      const results = await this.wrapper.pollDevices(handles);
+
+      return results.map((result) => {
+        result.data.timestamp = this._sampleTime(result.data);
+        return { handle: result.handle, ...this._processData(result.data) };
+      });
+    } catch (error) {
+      console.error("Failed to poll devices:", error);
+      return [];
+    }
+  }
+
+  /**
+   * Execute a batch of operations in one native call. Operations are grouped
+   * by device; per device, info operations run first and the others keep
+   * their order.
+   * @param {Object[]} ops { op: "read" | "get" | "write" | "info", device, channel, value, maxAge }
+   * @returns {Promise<Object[]>} One { success, code, error } per operation, in order, with
+   *   data (read), value/text/units (get), validRange (rejected write) or channel info (info)
+   */
+  async exec(ops) {
+    this._checkInitialized();
+
+    const resolved = [];
+    for (const op of ops) {
+      resolved.push(
+        typeof op.device === "string"
+          ? { ...op, device: await this._resolveDeviceHandle(op.device) }
+          : op
+      );
+    }
+
+    const results = await this.wrapper.exec(resolved);
+
+    return results.map((result, i) => {
+      if (resolved[i].op === "read") {
+        result.data.timestamp = this._sampleTime(result.data);
+        result.data = this._processData(result.data);
+      }
+      return result;
+    });
+  }
+
+  /**
+   * Get the latest known values of a device without bus traffic.
+   * Values come from polls and group reads.
+   * @param {number|string} deviceHandle Device handle or name
+   * @returns {Promise<Object|null>} { channelName: { value, time, receivedAt } } or null if unknown
+   */
+  async getCachedValues(deviceHandle) {
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+    return this.wrapper.getCachedValues(deviceHandle);
+  }
+
+  /**
+   * Wait until the values of a device change, e.g. for an HTTP long poll.
+   * Values change through polls, group reads and listening; no thread waits.
+   * @param {number|string} deviceHandle Device handle or name
+   * @param {number} version Version last seen, e.g. from getDeviceData
+   * @param {number} [timeout=30000] Longest wait in ms
+   * @returns {Promise<Object>} { changed, version }, changed is false after the timeout
+   */
+  async waitForChange(deviceHandle, version, timeout = 30000) {
+    this._checkInitialized();
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+    return this.wrapper.waitForChange(deviceHandle, version, timeout);
+  }
+
   /**
    * Get information about a specific channel including valid value range
    * @param {number|string} deviceHandle Device handle or name
@@ -146,6 +269,584 @@ class SMInverter {
     }
   }
 
+  /**
+   * Get the binary storage areas of a device
+   * @param {number|string} deviceHandle Device handle or name
+   * @returns {Promise<Array>} Areas with area id, name, start, size and mode
+   */
+  async getBinaryInfo(deviceHandle) {
+    this._checkInitialized();
+
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+
+    try {
+      return await this.wrapper.getBinaryInfo(deviceHandle);
+    } catch (error) {
+      console.error(`Failed to get binary info for device ${deviceHandle}:`, error);
+      return [];
+    }
+  }
+
+  /**
+   * Get the device side recording setup
+   * @param {number|string} deviceHandle Device handle or name
+   * @returns {Promise<Object>} Recording interval and recorded channels ({ mask, index })
+   */
+  async getRecording(deviceHandle) {
+    this._checkInitialized();
+
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+
+    try {
+      return await this.wrapper.getRecording(deviceHandle);
+    } catch (error) {
+      console.error(`Failed to get recording setup for device ${deviceHandle}:`, error);
+      return null;
+    }
+  }
+
+  /**
+   * Set which channels the device records and how often
+   * @param {number|string} deviceHandle Device handle or name
+   * @param {Object} recording Recording interval and channels ({ mask, index })
+   * @returns {Promise<Object>} Result of the operation
+   */
+  async setRecording(deviceHandle, recording) {
+    this._checkInitialized();
+
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+
+    try {
+      return await this.wrapper.setRecording(deviceHandle, recording);
+    } catch (error) {
+      console.error(`Failed to set recording setup for device ${deviceHandle}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Download data recorded by the device and merge it into the history
+   * @param {number|string} deviceHandle Device handle or name
+   * @param {number} area Binary area to read (see getBinaryInfo)
+   * @param {Date|number} [since] Only merge records newer than this, defaults to the newest stored sample
+   * @returns {Promise<Object>} Transfer statistics (bytes, records, samples, from, to)
+   */
+  async backfill(deviceHandle, area, since) {
+    this._checkInitialized();
+
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+
+    try {
+      if (since === undefined) {
+        return await this.wrapper.backfill(deviceHandle, area);
+      }
+      return await this.wrapper.backfill(deviceHandle, area, this._toSeconds(since));
+    } catch (error) {
+      console.error(`Failed to backfill device ${deviceHandle}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Get stored values of a channel, from live polls and backfills
+   * @param {number|string} deviceHandle Device handle or name
+   * @param {string} channelName Name of the channel
+   * @param {Date|number} [from] Start of the time range
+   * @param {Date|number} [to] End of the time range
+   * @returns {Promise<Array>} Samples ({ time, value }), time in seconds since 1970
+   */
+  async getHistory(deviceHandle, channelName, from = 0, to = 0xffffffff) {
+    if (typeof deviceHandle === "string") {
+      deviceHandle = await this._resolveDeviceHandle(deviceHandle);
+    }
+
+    return this.wrapper.getHistory(
+      deviceHandle,
+      channelName,
+      this._toSeconds(from),
+      this._toSeconds(to)
+    );
+  }
+
+  /**
+   * Assign devices to an SMAData group address
+   * @param {number} group Group address
+   * @param {Array<number|string>} devices Device handles or names
+   * @returns {Promise<Object>} Result with per device status
+   */
+  async assignGroup(group, devices) {
+    this._checkInitialized();
+
+    const handles = [];
+    for (const device of devices) {
+      handles.push(
+        typeof device === "string"
+          ? await this._resolveDeviceHandle(device)
+          : device
+      );
+    }
+
+    try {
+      return await this.wrapper.assignGroup(group, handles);
+    } catch (error) {
+      console.error(`Failed to assign group ${group}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Remove a group address from all its members
+   * @param {number} group Group address
+   * @returns {Promise<Object>} Result with per device status
+   */
+  async removeGroup(group) {
+    this._checkInitialized();
+
+    try {
+      return await this.wrapper.removeGroup(group);
+    } catch (error) {
+      console.error(`Failed to remove group ${group}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Get all assigned groups and their members
+   * @returns {Promise<Array>} Groups ({ group, devices })
+   */
+  async getGroups() {
+    return this.wrapper.getGroups();
+  }
+
+  /**
+   * Set a channel value on all members of a group with one bus frame
+   * @param {number} group Group address
+   * @param {string} channelName Name of the channel to set
+   * @param {number} value Value to set for the channel
+   * @returns {Promise<Object>} Result of the operation
+   */
+  async setGroupValue(group, channelName, value) {
+    this._checkInitialized();
+
+    try {
+      return await this.wrapper.setGroupValue(group, channelName, value);
+    } catch (error) {
+      console.error(`Failed to set group value for ${channelName}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Read the channels of all members of a group with one bus request.
+   * The values are cached, getDeviceData returns them without bus traffic.
+   * @param {number} group Group address
+   * @param {string} [channelType] "spot", "param" or "test"
+   * @param {number} [timeout] Seconds to collect answers
+   * @returns {Promise<Object>} Result with the handles of all devices that answered
+   */
+  async readGroup(group, channelType = "spot", timeout = 5) {
+    this._checkInitialized();
+
+    try {
+      return await this.wrapper.readGroup(group, channelType, timeout);
+    } catch (error) {
+      console.error(`Failed to read group ${group}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+        devices: [],
+      };
+    }
+  }
+
+  /**
+   * Send a raw SMAData command, for commands not covered by the channel API.
+   * Requests share YASDI's scheduler with the built-in commands.
+   * @param {Object} options Request options
+   * @param {number|string} [options.device] Device handle or name
+   * @param {number} [options.dest] Raw SMAData destination address
+   * @param {boolean} [options.broadcast] Send to all devices
+   * @param {number} options.cmd SMAData command (0-255)
+   * @param {Buffer|number[]} [options.data] Payload
+   * @param {string} [options.type] "mono", "multi" or "none" (answers expected)
+   * @param {number} [options.timeout] Seconds per try
+   * @param {number} [options.repeats] Number of retries
+   * @param {string} [options.priority] "high", "normal" or "low"
+   * @returns {Promise<Object>} Result with the answers as { source, data }
+   */
+  async sendRequest(options) {
+    this._checkInitialized();
+
+    try {
+      const request = { ...options };
+      if (typeof request.device === "string") {
+        request.device = await this._resolveDeviceHandle(request.device);
+      }
+      return await this.wrapper.sendRequest(request);
+    } catch (error) {
+      console.error(`Failed to send command ${options && options.cmd}:`, error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+        responses: [],
+      };
+    }
+  }
+
+  /**
+   * Listen for received SMAData packets, including answers to other requests
+   * @param {Object} filter Match on cmd, source and dest (omit for any)
+   * @param {Function} callback Called with { source, dest, cmd, flags, data }
+   * @returns {number} Listener id for removePacketListener
+   */
+  addPacketListener(filter, callback) {
+    return this.wrapper.addPacketListener(filter || {}, callback);
+  }
+
+  /**
+   * Remove a packet listener
+   * @param {number} id Listener id returned by addPacketListener
+   * @returns {boolean} True if the listener existed
+   */
+  removePacketListener(id) {
+    return this.wrapper.removePacketListener(id);
+  }
+
+  /**
+   * Acquire passively from the answers another master on the bus gets
+   * (e.g. a Sunny WebBox): the drivers never send, devices, channel lists
+   * and values are learnt from what is heard. Poll jobs and the power
+   * controller stop; detection, writes, poll jobs and raw requests are
+   * refused while listening, device data holds the values last heard.
+   * Every driver must support listening only (SMAData1 over UDP, TCP serial).
+   * @param {Object} [options] Listening options
+   * @param {string} [options.plantFile] File keeping the devices learnt across restarts
+   * @returns {Object} Result with success status
+   */
+  startListening(options = {}) {
+    this._checkInitialized();
+    return this.wrapper.startListening(options);
+  }
+
+  /**
+   * Stop listening only, the drivers send again
+   */
+  stopListening() {
+    this.wrapper.stopListening();
+  }
+
+  /**
+   * Stream the plant state (devices, channel lists, handles, values) to
+   * standby gateways on this machine, which connect to a unix socket
+   * @param {string} socketPath Socket path, e.g. "/run/inverter-standby.sock"
+   * @returns {Object} Result with success status
+   */
+  serveStandby(socketPath) {
+    this._checkInitialized();
+    return this.wrapper.serveStandby(socketPath);
+  }
+
+  /**
+   * Stop serving standby gateways
+   */
+  stopServingStandby() {
+    this.wrapper.stopServingStandby();
+  }
+
+  /**
+   * Stand by for the gateway serving socketPath: its state is applied as it
+   * changes, nothing is sent. Refused is what listening only refuses;
+   * device data and cached values are the active gateway's.
+   * @param {string} socketPath Socket path the active gateway serves
+   * @returns {Object} Result with success status
+   */
+  startStandby(socketPath) {
+    this._checkInitialized();
+    return this.wrapper.startStandby(socketPath);
+  }
+
+  /**
+   * State of the standby, and the standbys connected when serving
+   * @returns {Object} { active, connected, synced, devices, channelLists, updates, handles, standbys };
+   *   handles maps device handles of the active gateway to the own ones
+   */
+  getStandbyStatus() {
+    return this.wrapper.getStandbyStatus();
+  }
+
+  /**
+   * Take over from the active gateway: the drivers send again and one
+   * broadcast round trip confirms the devices of the plant taken over
+   * @param {number} [timeout=3] Round trip timeout in seconds
+   * @returns {Promise<Object>} Result with success status, confirmed and missing device handles
+   */
+  async takeOver(timeout = 3) {
+    this._checkInitialized();
+    const result = await this.wrapper.takeOver(timeout);
+    // Devices the round trip found, without those the active gateway had removed
+    this.deviceMap.clear();
+    await this.getDevices();
+    return result;
+  }
+
+  /**
+   * Start the native closed-loop power controller (e.g. zero export).
+   * Reads the meter at high priority and distributes the plant limit across
+   * the inverters proportional to their capacity.
+   * @param {Object} config Controller configuration
+   * @param {number|string} config.meter Meter device handle or name
+   * @param {string} config.feedbackChannel Grid power channel of the meter (W, import positive)
+   * @param {string} config.limitChannel Active power limit channel of the inverters (W)
+   * @param {Array<{device: number|string, capacity: number}>} config.inverters Controlled inverters
+   * @param {number} [config.target] Feedback setpoint in W (default: 0)
+   * @param {number} [config.headroom] Import margin in W
+   * @param {number} [config.gain] Share of the error corrected per cycle (default: 0.7)
+   * @param {number} [config.ramp] Max plant limit change in W/s
+   * @param {number} [config.deadband] Limit changes below this (W) are not written
+   * @param {number} [config.refresh] Seconds after which a limit is written again even within the deadband,
+   *   since limit writes are not acknowledged (default: 60, 0: never)
+   * @param {number} [config.period] Cycle time in ms (default: 1000)
+   * @returns {Promise<Object>} Result with success status
+   */
+  async startPowerController(config) {
+    this._checkInitialized();
+
+    try {
+      const resolve = (device) =>
+        typeof device === "string" ? this._resolveDeviceHandle(device) : device;
+      const options = { ...config, meter: await resolve(config.meter) };
+      options.inverters = [];
+      for (const inverter of config.inverters) {
+        options.inverters.push({
+          device: await resolve(inverter.device),
+          capacity: inverter.capacity,
+        });
+      }
+      return this.wrapper.startPowerController(options);
+    } catch (error) {
+      console.error("Failed to start power controller:", error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Stop the power controller, the last written limits stay in effect
+   */
+  stopPowerController() {
+    this.wrapper.stopPowerController();
+  }
+
+  /**
+   * Loop timing and state of the power controller
+   * @returns {Object} Cycles, writes, latencies in ms, feedback and plant limit
+   */
+  getPowerControllerMetrics() {
+    return this.wrapper.getPowerControllerMetrics();
+  }
+
+  /**
+   * Keep channels of a device no older than a maximum age. Jobs are read
+   * earliest deadline first against the measured bus time of each device;
+   * a job the bus cannot carry next to the others is refused, or with
+   * degrade granted the shortest max age that fits.
+   * @param {Object} job Poll job
+   * @param {number|string} job.device Device handle or name
+   * @param {string[]} [job.channels] Channel names (default: all spot channels)
+   * @param {number} job.maxAge Maximum value age in ms
+   * @param {boolean} [job.degrade] Accept a longer max age instead of a refusal
+   * @param {number} [job.readTimeout] Timeout per request in s (default: 1)
+   * @returns {Promise<Object>} { success, code, id, maxAge, degraded }
+   */
+  async addPollJob(job) {
+    this._checkInitialized();
+
+    try {
+      const device =
+        typeof job.device === "string" ? await this._resolveDeviceHandle(job.device) : job.device;
+      return this.wrapper.addPollJob({ ...job, device });
+    } catch (error) {
+      console.error("Failed to add poll job:", error);
+      return {
+        success: false,
+        error: error.message,
+        code: -1,
+      };
+    }
+  }
+
+  /**
+   * Stop keeping the channels of a poll job fresh
+   * @param {number} id Poll job id
+   * @returns {boolean} Whether the job existed
+   */
+  removePollJob(id) {
+    return this.wrapper.removePollJob(id);
+  }
+
+  /**
+   * Freshness attainment per poll job; read the values with getCachedValues
+   * @returns {Object} { utilization, capacity, jobs: [{ id, device, requestedMaxAge, maxAge, degraded,
+   *   requests, costMs, refreshes, failures, met, missed, attainment, age, worstAge }] }
+   */
+  getPollJobs() {
+    return this.wrapper.getPollJobs();
+  }
+
+  /**
+   * Compare power channels (e.g. the A.Ms.Watt and B.Ms.Watt inputs) of
+   * devices with their peers, normalized by capacity. Devices are peers of
+   * the others of their group, by default the others of their device type
+   * @param {Object} config { channels, devices: [{ device, capacity (W per input), group }],
+   *   window (updates, default 60), threshold (z-score, default 2.5),
+   *   minRatio (default 0.05), minPeers (default 3) }
+   * @returns {Promise<number>} Number of inputs compared
+   */
+  async setPeerAnalytics(config) {
+    this._checkInitialized();
+
+    const devices = await Promise.all(
+      config.devices.map(async (entry) =>
+        typeof entry.device === "string"
+          ? { ...entry, device: await this._resolveDeviceHandle(entry.device) }
+          : entry
+      )
+    );
+    return this.wrapper.setPeerAnalytics({ ...config, devices });
+  }
+
+  /**
+   * Run the peer comparison over the latest cached values, e.g. after every
+   * poll. Only inputs whose rolling z-score fell below -threshold are returned
+   * @returns {Array<Object>} [{ device, channel, group, ratio, peerRatio, z, score }]
+   */
+  analyzePeers() {
+    return this.wrapper.analyzePeers();
+  }
+
+  /**
+   * Aggregate a channel across devices, natively over the value cache or,
+   * with from/to/bucket, over the stored history. Per device the samples of a
+   * bucket are reduced to their mean (min/max: their min/max), then combined
+   * per group: sum and avg of the device means, min, max, count of samples
+   * @param {Object} spec { channel, aggregate: "sum" | ["sum", "max", ...],
+   *   where: { devices, type, group }, groupBy: "device" | "type" | "group",
+   *   from, to (seconds or Date), bucket (seconds) }
+   * @returns {Promise<Object>} { success, code, matched, rows, columns: { key, time, devices, <aggregate> } }
+   */
+  async query(spec) {
+    this._checkInitialized();
+
+    const where = spec.where || {};
+    const list = (value) =>
+      value === undefined ? undefined : Array.isArray(value) ? value : [value];
+    const devices = list(where.devices);
+    const history =
+      spec.from !== undefined || spec.to !== undefined || spec.bucket !== undefined;
+
+    return this.wrapper.query({
+      channel: spec.channel,
+      aggregate: list(spec.aggregate),
+      devices: devices
+        ? await Promise.all(
+            devices.map((device) =>
+              typeof device === "string"
+                ? this._resolveDeviceHandle(device)
+                : device
+            )
+          )
+        : undefined,
+      types: list(where.type),
+      groups: list(where.group),
+      groupBy: spec.groupBy || "none",
+      history,
+      from: history ? this._toSeconds(spec.from || 0) : undefined,
+      to: spec.to !== undefined ? this._toSeconds(spec.to) : undefined,
+      bucket: spec.bucket,
+    });
+  }
+
+  /**
+   * Native metrics: heap bytes per subsystem (packets, requests, channels,
+   * history, caches, marshal) with current, peak and allocation count, and
+   * the request scheduler queue, and received frames per transport protocol
+   * with the protocol all buses locked in to (null while none or mixed)
+   * @param {Object} [options] { resetPeaks } restarts the high-water marks after reading
+   * @returns {Object} { memory: { <tag>: { current, peak, allocations } }, scheduler: { queued, inFlight },
+   *   protocols: { smanet, sunnynet, locked, mismatches, sources: { <address>: { smanet, sunnynet } } } }
+   */
+  getMetrics(options = {}) {
+    return this.wrapper.getMetrics(options);
+  }
+
+  /**
+   * Keep the latest values of all devices in shared memory for worker threads.
+   * Reads, poll jobs, the sniffer, group reads and a standby replica update the
+   * table, and workers waiting in waitForUpdate wake when values changed; post the
+   * returned descriptor to workers and read it there with LiveTableReader, without
+   * copies or messages.
+   * @param {string[]} channels Channel names, one column each
+   * @param {number} [capacity] Maximum number of devices
+   * @returns {Object} Descriptor { buffer, channels, capacity }
+   */
+  createLiveTable(channels, capacity = 32) {
+    const buffer = new SharedArrayBuffer(liveTableSize(capacity, channels.length));
+    this.wrapper.attachLiveTable(new Int32Array(buffer), capacity, channels);
+
+    this.liveTable = {
+      buffer,
+      channels: channels.slice(),
+      capacity,
+    };
+    return { buffer, channels: this.liveTable.channels, capacity };
+  }
+
+  /**
+   * Convert a Date or seconds value to seconds since 1970
+   * @param {Date|number} time Time to convert
+   * @returns {number} Seconds since 1970
+   * @private
+   */
+  _toSeconds(time) {
+    if (time instanceof Date) {
+      return Math.floor(time.getTime() / 1000);
+    }
+    return time;
+  }
+
   /**
    * Helper method to resolve a device name to its handle
    * @param {string} deviceName Name of the device
@@ -175,6 +876,7 @@ class SMInverter {
   _processData(rawData) {
     const result = {
       timestamp: rawData.timestamp,
+      version: rawData.version,
       dc: {
         string1: {
           current: this._extractValue(rawData, [
@@ -234,6 +936,21 @@ class SMInverter {
     return result;
   }
 
+  /**
+   * Time of the newest value in a device's data, as received from the bus
+   * @param {Object} rawData Raw data object, { channelName: { receivedAt } }
+   * @returns {string} ISO timestamp, the current time if no value has one
+   */
+  _sampleTime(rawData) {
+    let newest = 0;
+    for (const channel of Object.values(rawData)) {
+      if (channel && channel.receivedAt > newest) {
+        newest = channel.receivedAt;
+      }
+    }
+    return new Date(newest > 0 ? newest : Date.now()).toISOString();
+  }
+
   /**
    * Extract a value from rawData given possible key names
    * @param {Object} rawData Raw data object
@@ -257,9 +974,9 @@ class SMInverter {
     if (!this.initialized) return true;
 
     try {
-      const result = this.wrapper.shutdown();
-      this.initialized = !result;
-      return result;
+      // New calls fail from here on, the native shutdown runs in the background
+      this.initialized = false;
+      return await this.wrapper.shutdown();
     } catch (error) {
       console.error("Failed to shutdown YASDI:", error);
       return false;
@@ -278,3 +995,4 @@ class SMInverter {
 }
 
 module.exports = SMInverter;
+module.exports.LiveTableReader = LiveTableReader;
@@ -0,0 +1,772 @@
+#include "inverter_engine.h"
+#include "channel_values.h"
+#include "packet_listeners.h"
+#include "plant_lock.h"
+#include "smadata_request.h"
+
+extern "C" {
+    #include "rx_time.h"
+    #include "netdevice.h"
+    #include "master.h"
+    #include "plant.h"
+}
+
+#include <condition_variable>
+#include <ctime>
+#include <iostream>
+#include <set>
+#include <thread>
+
+// Background shutdowns still running; never destroyed, so that they may
+// finish during static destruction
+struct ShutdownThreads {
+    std::mutex mutex;
+    std::condition_variable idle;
+    size_t running = 0;
+};
+
+static ShutdownThreads& shutdown_threads() {
+    static ShutdownThreads* threads = new ShutdownThreads();
+    return *threads;
+}
+
+static const size_t IO_THREADS = 4;
+
+InverterEngine::InverterEngine()
+    : change_waiters([this](DWORD device_handle) { return value_cache.version(device_handle); }),
+      protocol_stats(std::make_shared<ProtocolStats>()),
+      receive_times(std::make_shared<ReceiveTimes>()),
+      sniffer(std::make_shared<BusSniffer>()),
+      handoff(registry, value_cache),
+      reader(history_store, value_cache, table, *receive_times) {
+    // Once the buses proved to carry a single protocol, requests that name
+    // none are no longer sent once per configured protocol; one lock for all
+    // drivers, see ProtocolStats
+    protocol_stats->set_change_handler([](DWORD locked) {
+        SMADataScheduler::instance().set_default_protocol(locked);
+    });
+
+    // Waiters for newer values are completed by the thread that stored them,
+    // a standby gets them from the handoff thread
+    value_cache.set_change_handler([this](DWORD device_handle, unsigned long long version) {
+        change_waiters.changed(device_handle, version);
+        handoff.values_changed(device_handle);
+    });
+
+    // Poll jobs keep the value cache as fresh as they promise
+    poll_jobs.set_read_handler([this](DWORD device_handle) {
+        cache_device_values(device_handle);
+    });
+
+    // Values heard on the bus are cached as they come, on the YASDI thread,
+    // unless the plant is locked: its holder may be waiting for this thread,
+    // the work pool caches them then. New devices and channel lists are
+    // published from the work pool, once per burst of detection answers
+    sniffer->set_values_handler([this](DWORD device_handle) {
+        std::unique_lock<std::mutex> plant(plant_mutex(), std::try_to_lock);
+        if (plant.owns_lock()) {
+            cache_device_values(device_handle, plant);
+        } else if (ready) {
+            work_pool().submit([this, device_handle] {
+                cache_device_values(device_handle);
+            });
+        }
+    });
+    sniffer->set_device_handler([this](DWORD) {
+        if (!ready || refresh_queued.exchange(true)) {
+            return;
+        }
+        work_pool().submit([this] {
+            refresh_queued = false;
+            refresh_registry();
+            sniffer->save();
+        });
+    });
+}
+
+InverterEngine::~InverterEngine() {
+    shutdown();
+
+    if (protocol_listener != 0) {
+        PacketListeners::instance().remove(protocol_listener);
+    }
+    protocol_stats->reset();
+    if (receive_listener != 0) {
+        PacketListeners::instance().remove(receive_listener);
+    }
+    for (DWORD id : sniffer_listeners) {
+        PacketListeners::instance().remove(id);
+    }
+}
+
+void InverterEngine::set_debug_level(int level) {
+    debug_level = level;
+    reader.set_debug_level(level);
+}
+
+bool InverterEngine::initialize(const std::string& config_path, std::string& error) {
+    // A background shutdown of this engine has to finish first
+    std::lock_guard<std::mutex> lock(lifecycle);
+    SMADataScheduler::instance().open();
+
+    // Initialize YASDI library
+    DWORD result = yasdiMasterInitialize(config_path.c_str(), &driver_count);
+
+    if (debug_level > 0) {
+        std::cout << "YASDI initialization returned: " << result << std::endl;
+        std::cout << "Found " << driver_count << " drivers" << std::endl;
+    }
+
+    if (driver_count == 0) {
+        error = "No YASDI drivers found";
+        return false;
+    }
+
+    // Get all drivers
+    driver_count = yasdiMasterGetDriver(drivers, 10);
+
+    // Switch all drivers online
+    bool any_driver_online = false;
+    for (DWORD i = 0; i < driver_count; i++) {
+        char driverName[64];
+        yasdiGetDriverName(drivers[i], driverName, sizeof(driverName) - 1);
+
+        if (debug_level > 0) {
+            std::cout << "Switching on driver: " << driverName << std::endl;
+        }
+
+        if (yasdiSetDriverOnline(drivers[i])) {
+            any_driver_online = true;
+        }
+    }
+
+    if (!any_driver_online) {
+        error = "No drivers could be set online";
+        return false;
+    }
+
+    // YASDI forgets its packet listeners on every initialization
+    PacketListeners::instance().attach();
+    refresh_registry();
+
+    // The buses may be configured differently now
+    protocol_stats->reset();
+    if (protocol_listener == 0) {
+        std::shared_ptr<ProtocolStats> stats = protocol_stats;
+        protocol_listener = PacketListeners::instance().add(PacketFilter(), [stats](const TSMAData* packet, const BYTE*, DWORD) {
+            stats->record(packet->SourceAddr, packet->Flags);
+        });
+    }
+
+    // Answers of other masters, decoded while listening only; before the
+    // receive times, which look up the values they carry
+    if (sniffer_listeners.empty()) {
+        std::shared_ptr<BusSniffer> decoder = sniffer;
+        for (int cmd : { CMD_GET_NET, CMD_GET_NET_START, CMD_CFG_NETADR, CMD_GET_CINFO, CMD_GET_DATA }) {
+            PacketFilter filter;
+            filter.cmd = cmd;
+            sniffer_listeners.push_back(PacketListeners::instance().add(filter, [decoder](const TSMAData* packet, const BYTE* data, DWORD size) {
+                decoder->handle(packet, data, size);
+            }));
+        }
+    }
+
+    // Value answers, whoever asked for them
+    receive_times->set_drivers(drivers, driver_count);
+    receive_times->clear();
+    if (receive_listener == 0) {
+        std::shared_ptr<ReceiveTimes> times = receive_times;
+        PacketFilter filter;
+        filter.cmd = CMD_GET_DATA;
+        receive_listener = PacketListeners::instance().add(filter, [times](const TSMAData* packet, const BYTE* data, DWORD size) {
+            if (packet->Flags & TS_ANSWER) {
+                times->record(packet->SourceAddr, data, size);
+            }
+        });
+    }
+
+    ready = true;
+    return true;
+}
+
+void InverterEngine::stop_workers() {
+    // Pool tasks, poll jobs and the controller call into YASDI, let them finish first
+    power_controller.stop();
+    poll_jobs.stop();
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pool.reset();
+    io.reset();
+}
+
+void InverterEngine::shutdown() {
+    std::lock_guard<std::mutex> lock(lifecycle);
+    bool was_ready = ready.exchange(false);
+    sniffer->stop();
+    handoff.stop();
+    replica.stop();
+
+    // Unblock workers waiting for queued requests, and refuse new ones
+    if (was_ready) {
+        SMADataScheduler::instance().close();
+    }
+    stop_workers();
+    change_waiters.stop();
+    if (!was_ready) {
+        return;
+    }
+
+    // Shutdown all YASDI drivers
+    for (DWORD i = 0; i < driver_count; i++) {
+        yasdiSetDriverOffline(drivers[i]);
+    }
+
+    // Shutdown YASDI
+    yasdiMasterShutdown();
+    SMADataScheduler::instance().abandon();
+
+    // A new YASDI instance sends again
+    sniffer->abandon();
+    SMADataScheduler::instance().set_listen_only(false);
+    reader.set_max_age(DeviceReader::DEFAULT_MAX_AGE);
+}
+
+void InverterEngine::shutdown_async(std::function<void()> done) {
+    ShutdownThreads& threads = shutdown_threads();
+    {
+        std::lock_guard<std::mutex> lock(threads.mutex);
+        threads.running++;
+    }
+
+    std::shared_ptr<InverterEngine> self = shared_from_this();
+    std::thread([self, done]() mutable {
+        self->shutdown();
+        if (done) {
+            done();
+        }
+        // The last owner may be this thread
+        self.reset();
+
+        ShutdownThreads& threads = shutdown_threads();
+        std::lock_guard<std::mutex> lock(threads.mutex);
+        threads.running--;
+        threads.idle.notify_all();
+    }).detach();
+}
+
+void InverterEngine::wait_for_shutdowns() {
+    ShutdownThreads& threads = shutdown_threads();
+    std::unique_lock<std::mutex> lock(threads.mutex);
+    threads.idle.wait(lock, [&threads] { return threads.running == 0; });
+}
+
+WorkPool& InverterEngine::work_pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool) {
+        pool.reset(new WorkPool());
+    }
+    return *pool;
+}
+
+// A few threads that mostly wait for the bus, so that a takeover or a group
+// write is not queued behind a long transfer
+WorkPool& InverterEngine::io_pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!io) {
+        io.reset(new WorkPool(IO_THREADS));
+    }
+    return *io;
+}
+
+bool InverterEngine::detect(int device_count) {
+    if (passive()) {
+        std::cout << "Error: Listening only or standing by, no detection" << std::endl;
+        return false;
+    }
+
+    if (debug_level > 0) {
+        std::cout << "Trying to detect " << device_count << " devices" << std::endl;
+    }
+
+    // Blocking call to detect devices
+    int error = DoStartDeviceDetection(device_count, TRUE);
+
+    // Publish what was found, even if not all devices answered
+    if (error != YE_DEV_DETECT_IN_PROGRESS) {
+        refresh_registry();
+    }
+
+    switch (error) {
+        case YE_OK:
+            return true;
+        case YE_DEV_DETECT_IN_PROGRESS:
+            std::cout << "Error: Detection in progress" << std::endl;
+            return false;
+        case YE_NOT_ALL_DEVS_FOUND:
+            std::cout << "Error: Not all devices were found" << std::endl;
+            return false;
+        default:
+            std::cout << "Error: Unknown YASDI error" << std::endl;
+            return false;
+    }
+}
+
+std::map<DWORD, std::string> InverterEngine::device_names() const {
+    std::map<DWORD, std::string> device_map;
+    DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+
+    if (snapshot->devices.empty() && debug_level > 0) {
+        std::cout << "No devices have been found" << std::endl;
+    }
+
+    for (const RegistryDevice& device : snapshot->devices) {
+        std::string device_name = device.name;
+        // Replace spaces with underscores for easier handling
+        size_t pos;
+        while ((pos = device_name.find(" ")) != std::string::npos) {
+            device_name.replace(pos, 1, "_");
+        }
+
+        // Add it to the map
+        device_map[device.handle] = device_name;
+    }
+
+    return device_map;
+}
+
+// Read the device and channel lists from YASDI and publish them as a new
+// registry version; API calls keep reading the previous version meanwhile
+void InverterEngine::refresh_registry() {
+    DWORD handles_array[50];
+    DWORD channel_array[500];
+    char namebuf[64] = "";
+    std::vector<RegistryDevice> devices;
+    std::unique_lock<std::mutex> plant(plant_mutex());
+
+    // Get all device handles
+    DWORD count = GetDeviceHandles(handles_array, 50);
+
+    for (DWORD i = 0; i < count; i++) {
+        RegistryDevice device;
+        device.handle = handles_array[i];
+
+        // Get the name of this device
+        namebuf[0] = 0;
+        GetDeviceName(device.handle, namebuf, sizeof(namebuf) - 1);
+        device.name = namebuf;
+        namebuf[0] = 0;
+        GetDeviceType(device.handle, namebuf, sizeof(namebuf) - 1);
+        device.type = namebuf;
+        GetDeviceSN(device.handle, &device.serial);
+
+        if (debug_level > 0) {
+            std::cout << "Found device with a handle of: " << device.handle
+                      << " and a name of: " << device.name << std::endl;
+        }
+
+        int channel_count = GetChannelHandlesEx(device.handle, channel_array, 500, ALLCHANNELS);
+        for (int j = 0; j < channel_count; j++) {
+            RegistryChannel channel;
+            channel.handle = channel_array[j];
+
+            namebuf[0] = 0;
+            if (GetChannelName(channel.handle, namebuf, sizeof(namebuf) - 1) != YE_OK) {
+                continue;
+            }
+            channel.name = namebuf;
+            namebuf[0] = 0;
+            GetChannelUnit(channel.handle, namebuf, sizeof(namebuf) - 1);
+            channel.unit = namebuf;
+            device.channels.push_back(channel);
+        }
+
+        devices.push_back(device);
+    }
+    plant.unlock();
+
+    value_cache.rebuild(*registry.publish(std::move(devices)));
+
+    // Detected devices may come with other channel lists
+    reader.clear();
+    handoff.registry_changed();
+}
+
+// Copy the values YASDI already holds for a device into the value cache,
+// without bus traffic
+void InverterEngine::cache_device_values(DWORD device_handle) {
+    std::unique_lock<std::mutex> plant(plant_mutex());
+    cache_device_values(device_handle, plant);
+}
+
+// Lets go of the plant before storing
+void InverterEngine::cache_device_values(DWORD device_handle, std::unique_lock<std::mutex>& plant) {
+    DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+    const RegistryDevice* device = snapshot->find(device_handle);
+    if (device == nullptr) {
+        return;
+    }
+
+    size_t count = device->channels.size();
+    std::vector<DWORD> handles(count);
+    for (size_t i = 0; i < count; i++) {
+        handles[i] = device->channels[i].handle;
+    }
+    std::vector<double> values(count);
+    std::vector<DWORD> times(count);
+    std::vector<int> status(count);
+    read_channel_values(device_handle, handles.data(), (DWORD)count, ANY_VALUE_AGE,
+                        values.data(), times.data(), status.data());
+    plant.unlock();
+
+    std::vector<CachedValue> cached;
+    std::vector<LiveTable::Value> live;
+    for (size_t i = 0; i < count; i++) {
+        if (status[i] == YE_OK && times[i] != 0) {
+            cached.push_back({ handles[i], values[i], times[i] });
+            live.push_back({ device->channels[i].name.c_str(), values[i] });
+        }
+    }
+    unsigned long long version = 0;
+    value_cache.store(device_handle, cached, &version);
+
+    // Values of poll jobs, the sniffer, group reads and the replica reach
+    // the shared table as well as those of a read
+    if (table.update(device_handle, version, (uint32_t)time(NULL), live.data(), live.size())) {
+        table.publish();
+    }
+}
+
+// Remove a device from the plant, e.g. after it was replaced
+int InverterEngine::remove_device(DWORD device_handle) {
+    // Readers must not see the device anymore before YASDI frees it
+    value_cache.rebuild(*registry.remove(device_handle));
+    reader.forget(device_handle);
+    handoff.registry_changed();
+    std::lock_guard<std::mutex> plant(plant_mutex());
+    return ::RemoveDevice(device_handle);
+}
+
+// Channel handle by name, 0 if the device has no such channel
+DWORD InverterEngine::find_channel(DWORD device_handle, const std::string& channel_name) {
+    DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+    const RegistryDevice* device = snapshot->find(device_handle);
+    if (device != nullptr) {
+        const RegistryChannel* channel = device->find_channel(channel_name);
+        return channel != nullptr ? channel->handle : 0;
+    }
+
+    // Not in the registry (yet), ask YASDI
+    DWORD channel_array[500];
+    char name_buffer[64];
+    std::lock_guard<std::mutex> plant(plant_mutex());
+
+    int channel_count = GetChannelHandlesEx(device_handle, channel_array, 500, ALLCHANNELS);
+
+    if (channel_count < 1) {
+        if (debug_level > 0) {
+            std::cout << "Could not get channel handles" << std::endl;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < channel_count; i++) {
+        int result = GetChannelName(channel_array[i], name_buffer, sizeof(name_buffer) - 1);
+
+        if (result == YE_OK && channel_name == name_buffer) {
+            return channel_array[i];
+        }
+    }
+
+    return 0; // Channel not found
+}
+
+int InverterEngine::channel_info(DWORD device_handle, const std::string& channel_name, ChannelInfo& info) {
+    info.handle = find_channel(device_handle, channel_name);
+    if (info.handle == 0) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    std::lock_guard<std::mutex> plant(plant_mutex());
+    int result = GetChannelValRange(info.handle, &info.min_value, &info.max_value);
+    if (result != YE_OK) {
+        if (debug_level > 0) {
+            std::cout << "Error getting channel value range: " << result << std::endl;
+        }
+        return result;
+    }
+
+    char channel_units[64] = "";
+    GetChannelUnit(info.handle, channel_units, sizeof(channel_units) - 1);
+    info.units = channel_units;
+    return YE_OK;
+}
+
+void InverterEngine::read(DWORD device_handle, bool text, std::vector<ChannelData>& data, unsigned long long* version) {
+    reader.read(device_handle, text, data, version);
+}
+
+std::future<std::vector<ChannelData>> InverterEngine::read_async(DWORD device_handle, bool text) {
+    auto promise = std::make_shared<std::promise<std::vector<ChannelData>>>();
+    work_pool().submit([this, promise, device_handle, text] {
+        std::vector<ChannelData> data;
+        read(device_handle, text, data);
+        promise->set_value(std::move(data));
+    });
+    return promise->get_future();
+}
+
+WriteResult InverterEngine::write(DWORD device_handle, const std::string& channel_name, double value) {
+    WriteResult result;
+    if (passive()) {
+        result.code = YE_NOT_SUPPORTED;
+        return result;
+    }
+
+    // Find the channel handle by name
+    DWORD channel_handle = find_channel(device_handle, channel_name);
+    if (channel_handle == 0) {
+        result.code = YE_UNKNOWN_HANDLE;
+        return result;
+    }
+
+    // Check if value is within valid range
+    std::lock_guard<std::mutex> plant(plant_mutex());
+    if (GetChannelValRange(channel_handle, &result.min_value, &result.max_value) == YE_OK &&
+        (value < result.min_value || value > result.max_value)) {
+        if (debug_level > 0) {
+            std::cout << "Value out of range. Valid range: [" << result.min_value << ", " << result.max_value << "]" << std::endl;
+        }
+        result.code = YE_VALUE_NOT_VALID;
+        result.has_range = true;
+        return result;
+    }
+
+    // Set the channel value
+    result.code = ::SetChannelValue(channel_handle, device_handle, value);
+    if (result.code != YE_OK && debug_level > 0) {
+        std::cout << "Error setting channel value (code: " << result.code << ")" << std::endl;
+    }
+    return result;
+}
+
+std::future<WriteResult> InverterEngine::write_async(DWORD device_handle, const std::string& channel_name, double value) {
+    auto promise = std::make_shared<std::promise<WriteResult>>();
+    work_pool().submit([this, promise, device_handle, channel_name, value] {
+        promise->set_value(write(device_handle, channel_name, value));
+    });
+    return promise->get_future();
+}
+
+void InverterEngine::poll(const std::vector<DWORD>& devices, PollPipeline::Done done) {
+    PollPipeline pipeline(work_pool());
+    pipeline.run(devices,
+        [this](DWORD device_handle, std::vector<ChannelData>& channels) {
+            read(device_handle, true, channels);
+        },
+        std::move(done));
+}
+
+void InverterEngine::exec(const std::vector<BatchOp>& ops, std::function<void(std::vector<BatchResult>)> done) {
+    auto batch = std::make_shared<OpBatch>(ops);
+    work_pool().submit([this, batch, done] {
+        OpBatch::Backend backend;
+        backend.read_device = [this](DWORD device_handle, DWORD max_age, std::vector<ChannelData>& channels) {
+            return reader.read(device_handle, true, max_age, channels);
+        };
+        backend.find_channel = [this](DWORD device_handle, const std::string& channel) {
+            return find_channel(device_handle, channel);
+        };
+        backend.listen_only = passive();
+        done(batch->run(backend));
+    });
+}
+
+void InverterEngine::run_async(std::function<void()> work) {
+    io_pool().submit(std::move(work));
+}
+
+int InverterEngine::subscribe(const PollJobConfig& config, DWORD& id, double& granted) {
+    if (passive()) {
+        return YE_NOT_SUPPORTED;
+    }
+    return poll_jobs.add(config, id, granted);
+}
+
+// Switch the listen-only IoCtrl of every driver; false if one refused
+bool InverterEngine::set_listen_only(bool listen_only) {
+    bool all = true;
+    for (DWORD i = 0; i < driver_count; i++) {
+        DWORD param = listen_only ? 1 : 0;
+        if (yasdiMasterDoDriverIoCtrl(drivers[i], IOCTRL_SET_LISTEN_ONLY, (BYTE*)&param) != 0) {
+            all = false;
+        }
+    }
+    return all;
+}
+
+int InverterEngine::start_listening(const ListenConfig& config) {
+    std::lock_guard<std::mutex> lock(lifecycle);
+    if (!ready) {
+        return YE_SHUTDOWN;
+    }
+    if (standby()) {
+        return YE_NOT_SUPPORTED;
+    }
+
+    // Not a single frame may leave, e.g. YASDI's serial driver cannot be held
+    if (!set_listen_only(true)) {
+        set_listen_only(false);
+        return YE_NOT_SUPPORTED;
+    }
+
+    // Whatever would still ask the bus stops; reads take what was heard
+    SMADataScheduler::instance().set_listen_only(true);
+    stop_workers();
+    reader.set_max_age(ANY_VALUE_AGE);
+
+    size_t loaded = sniffer->start(config.plant_file);
+    if (debug_level > 0) {
+        std::cout << "Listening only, " << loaded << " devices from the plant file" << std::endl;
+    }
+    if (loaded > 0) {
+        refresh_registry();
+    }
+    return YE_OK;
+}
+
+void InverterEngine::stop_listening() {
+    std::lock_guard<std::mutex> lock(lifecycle);
+    if (!ready || !sniffer->active()) {
+        return;
+    }
+
+    sniffer->stop();
+    reader.set_max_age(DeviceReader::DEFAULT_MAX_AGE);
+    SMADataScheduler::instance().set_listen_only(false);
+    set_listen_only(false);
+}
+
+int InverterEngine::serve_standby(const std::string& socket_path) {
+    std::lock_guard<std::mutex> lock(lifecycle);
+    if (!ready) {
+        return YE_SHUTDOWN;
+    }
+    // A standby has nothing of its own to hand on
+    if (standby()) {
+        return YE_NOT_SUPPORTED;
+    }
+    return handoff.start(socket_path) ? YE_OK : YE_INVAL_ARGUMENT;
+}
+
+int InverterEngine::start_standby(const std::string& socket_path) {
+    std::lock_guard<std::mutex> lock(lifecycle);
+    if (!ready) {
+        return YE_SHUTDOWN;
+    }
+    if (listening() || handoff.active()) {
+        return YE_NOT_SUPPORTED;
+    }
+
+    // Nothing asks the bus until the takeover; drivers that can listen only
+    // are held silent as well
+    set_listen_only(true);
+    SMADataScheduler::instance().set_listen_only(true);
+    stop_workers();
+    reader.set_max_age(ANY_VALUE_AGE);
+
+    StandbyReplica::Target target;
+    target.refresh = [this] {
+        refresh_registry();
+        return registry.snapshot();
+    };
+    target.remove = [this](DWORD device_handle) {
+        remove_device(device_handle);
+    };
+    target.values = [this](DWORD device_handle) {
+        cache_device_values(device_handle);
+    };
+    replica.start(socket_path, target);
+    return YE_OK;
+}
+
+int InverterEngine::take_over(DWORD timeout, TakeoverResult& result) {
+    result = TakeoverResult();
+    {
+        std::lock_guard<std::mutex> lock(lifecycle);
+        if (!ready) {
+            return YE_SHUTDOWN;
+        }
+        if (!replica.active()) {
+            return YE_INVAL_ARGUMENT;
+        }
+
+        // The plant as last streamed is the one taken over
+        replica.stop();
+        reader.set_max_age(DeviceReader::DEFAULT_MAX_AGE);
+        SMADataScheduler::instance().set_listen_only(false);
+        set_listen_only(false);
+    }
+
+    // One broadcast round trip: every device answers GET_NET from its
+    // current address, which also corrects addresses changed meanwhile
+    std::set<DWORD> answered;
+    SMADataRequest request(0, CMD_GET_NET);
+    request.set_flags(TS_BROADCAST);
+    request.set_type(RT_MULTIRCV);
+    request.set_timeout(timeout, 0);
+    request.set_receive_handler([&answered](WORD source, const BYTE* data, DWORD size) {
+        BOOL is_new = FALSE;
+        TNetDevice* dev = TPlant_ScanGetNetBuf(&Plant, (BYTE*)data, size, source, 0, &is_new, 0);
+        if (dev == NULL) {
+            return;
+        }
+        if (is_new) {
+            TSMADataMaster_FireAPIEventDeviceDetection(YASDI_EVENT_DEVICE_ADDED, TNetDevice_GetHandle(dev), 0);
+        }
+        answered.insert(TNetDevice_GetSerNr(dev));
+    });
+    int code = request.execute(PRIORITY_HIGH);
+
+    // Devices the active gateway had not detected yet answered as well
+    refresh_registry();
+    for (const RegistryDevice& device : registry.snapshot()->devices) {
+        (answered.count(device.serial) ? result.confirmed : result.missing).push_back(device.handle);
+    }
+    if (result.missing.empty()) {
+        return YE_OK;
+    }
+    return code != YE_OK ? code : YE_NOT_ALL_DEVS_FOUND;
+}
+
+bool InverterEngine::unsubscribe(DWORD id) {
+    return poll_jobs.remove(id);
+}
+
+int InverterEngine::query(const AggregateQuery& query, AggregateResult& result) {
+    QueryEvaluator evaluator(history_store, value_cache, device_groups);
+    return evaluator.run(query, *registry.snapshot(), result);
+}
+
+size_t InverterEngine::configure_peers(const std::vector<PeerDevice>& devices, const std::vector<std::string>& channels,
+                                       const PeerConfig& config) {
+    DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+    std::vector<PeerInput> inputs;
+    for (const PeerDevice& peer : devices) {
+        const RegistryDevice* device = snapshot->find(peer.device_handle);
+        if (device == nullptr) {
+            continue;
+        }
+        for (const std::string& name : channels) {
+            const RegistryChannel* channel = device->find_channel(name);
+            if (channel != nullptr) {
+                inputs.push_back({ device->handle, channel->handle, name,
+                                   peer.group.empty() ? device->type : peer.group, peer.capacity });
+            }
+        }
+    }
+    peers.configure(inputs, config);
+    return inputs.size();
+}
+
+double InverterEngine::received_at(DWORD device_handle, DWORD channel_handle, DWORD value_time) const {
+    return receive_times->lookup(device_handle, channel_handle, value_time);
+}
@@ -0,0 +1,227 @@
+#ifndef INVERTER_ENGINE_H
+#define INVERTER_ENGINE_H
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "aggregate_query.h"
+#include "bulk_transfer.h"
+#include "bus_sniffer.h"
+#include "change_waiters.h"
+#include "channel_data.h"
+#include "device_groups.h"
+#include "device_reader.h"
+#include "device_registry.h"
+#include "freshness_scheduler.h"
+#include "history_store.h"
+#include "live_table.h"
+#include "op_batch.h"
+#include "peer_analytics.h"
+#include "poll_pipeline.h"
+#include "power_controller.h"
+#include "protocol_stats.h"
+#include "receive_times.h"
+#include "state_handoff.h"
+#include "value_cache.h"
+#include "work_pool.h"
+
+#include "yasdi_headers.h"
+
+struct ChannelInfo {
+    DWORD handle = 0;
+    std::string units;
+    double min_value = 0;
+    double max_value = 0;
+};
+
+// Outcome of a channel write; a value outside the channel's range is not
+// sent and comes back with YE_VALUE_NOT_VALID and the range
+struct WriteResult {
+    int code = YE_OK;
+    bool has_range = false;
+    double min_value = 0;
+    double max_value = 0;
+};
+
+// Passive acquisition, see BusSniffer
+struct ListenConfig {
+    std::string plant_file;     // devices learnt, kept across restarts; none if empty
+};
+
+// Outcome of a standby taking over: devices of the replicated plant that
+// answered the takeover round trip, and those that did not
+struct TakeoverResult {
+    std::vector<DWORD> confirmed;
+    std::vector<DWORD> missing;
+};
+
+// The inverter plant behind YASDI for any C++ program: drivers, detection
+// and the device registry, spot value reads, channel writes, poll jobs
+// (subscriptions with a freshness target), the power controller and the
+// stores the reads feed (history, value cache, live table). inverter_sdk
+// is a binding over it; all methods return YASDI error codes and are safe
+// to call from any thread unless noted.
+class InverterEngine : public std::enable_shared_from_this<InverterEngine> {
+public:
+    InverterEngine();
+    ~InverterEngine();
+
+    // Load the drivers of a yasdi.ini and switch them online; error tells
+    // why the engine is not usable otherwise
+    bool initialize(const std::string& config_path, std::string& error);
+    bool initialized() const { return ready.load(); }
+
+    // Stop everything that calls into YASDI, then YASDI itself. Queued bus
+    // requests are cancelled, requests on the bus end within their timeout.
+    void shutdown();
+
+    // shutdown() on a background thread, which keeps the engine alive until
+    // done ran there. The engine must be owned by a shared_ptr.
+    void shutdown_async(std::function<void()> done = nullptr);
+
+    // Wait until all background shutdowns of the process have finished
+    static void wait_for_shutdowns();
+
+    void set_debug_level(int level);
+
+    // Device registry
+    bool detect(int device_count);
+    DeviceRegistry::SnapshotPtr devices() const { return registry.snapshot(); }
+    std::map<DWORD, std::string> device_names() const;    // spaces replaced by underscores
+    int remove_device(DWORD device_handle);
+    DWORD find_channel(DWORD device_handle, const std::string& channel_name);
+    int channel_info(DWORD device_handle, const std::string& channel_name, ChannelInfo& info);
+
+    // Spot values of a device, into a buffer whose capacity is reused, and
+    // the version of the device's values they belong to.
+    // read_async and write_async run on the work pool.
+    void read(DWORD device_handle, bool text, std::vector<ChannelData>& data, unsigned long long* version = nullptr);
+    std::future<std::vector<ChannelData>> read_async(DWORD device_handle, bool text = true);
+    WriteResult write(DWORD device_handle, const std::string& channel_name, double value);
+    std::future<WriteResult> write_async(DWORD device_handle, const std::string& channel_name, double value);
+
+    // Poll devices as a pipeline on the work pool, done gets the JSON of
+    // all devices on a pool thread
+    void poll(const std::vector<DWORD>& devices, PollPipeline::Done done);
+
+    // Run a batch on the work pool, done gets one result per operation in order
+    void exec(const std::vector<BatchOp>& ops, std::function<void(std::vector<BatchResult>)> done);
+
+    // Run any other call on the I/O threads, for callers that must not wait
+    // for its bus round trips; such calls never hold a work pool thread.
+    // Queued work still runs on shutdown.
+    void run_async(std::function<void()> work);
+
+    // Copy the values YASDI already holds for a device into the value cache
+    void cache_device_values(DWORD device_handle);
+
+    // Version of a device's cached values, bumped only when a value changes
+    unsigned long long version(DWORD device_handle) const { return value_cache.version(device_handle); }
+    // done runs once the version is newer than since, or after timeout s
+    // (changed false); pending waits end as timed out on shutdown
+    void wait_for_change(DWORD device_handle, unsigned long long since, double timeout, ChangeWaiters::Done done) {
+        change_waiters.wait(device_handle, since, timeout, std::move(done));
+    }
+
+    // Subscriptions: poll jobs that keep channels within a max age, their
+    // values are in the value cache
+    int subscribe(const PollJobConfig& config, DWORD& id, double& granted);
+    bool unsubscribe(DWORD id);
+    std::vector<PollJobStats> subscriptions() const { return poll_jobs.stats(); }
+    double bus_utilization() const { return poll_jobs.utilization(); }
+    double bus_capacity() const { return poll_jobs.capacity(); }
+
+    // Aggregate a channel across devices, over the value cache or the history
+    int query(const AggregateQuery& query, AggregateResult& result);
+
+    // Compare power channels of devices with their peers; channels a device
+    // does not have are left out. Returns the number of inputs compared.
+    size_t configure_peers(const std::vector<PeerDevice>& devices, const std::vector<std::string>& channels,
+                           const PeerConfig& config);
+    // One peer comparison over the cached values, e.g. after every poll
+    size_t analyze_peers(std::vector<PeerDeviation>& flagged) { return peers.update(value_cache, flagged); }
+
+    // Listen only: the drivers never send, devices and values come from the
+    // answers another master on the bus gets. Poll jobs and the controller
+    // are stopped; detection, writes, subscriptions and raw requests are
+    // refused with YE_NOT_SUPPORTED, reads return the last values heard.
+    // YE_NOT_SUPPORTED if a driver cannot listen only.
+    int start_listening(const ListenConfig& config);
+    void stop_listening();
+    bool listening() const { return sniffer->active(); }
+
+    // Hot standby, see HandoffServer and StandbyReplica. The active gateway
+    // serves its state on a unix socket; a standby applies it and sends
+    // nothing, refusing what listening only refuses, until it takes over
+    // with one broadcast round trip (timeout s) that confirms the devices.
+    int serve_standby(const std::string& socket_path);
+    void stop_serving_standby() { handoff.stop(); }
+    size_t standbys_connected() const { return handoff.standbys(); }
+    int start_standby(const std::string& socket_path);
+    int take_over(DWORD timeout, TakeoverResult& result);
+    bool standby() const { return replica.active(); }
+    StandbyStatus standby_status() const { return replica.status(); }
+
+    // Receive time in ms of a value YASDI stamped with value_time
+    double received_at(DWORD device_handle, DWORD channel_handle, DWORD value_time) const;
+
+    HistoryStore& history() { return history_store; }
+    BulkTransfer& bulk() { return bulk_transfer; }
+    DeviceGroups& groups() { return device_groups; }
+    ValueCache& values() { return value_cache; }
+    LiveTable& live_table() { return table; }
+    PowerController& controller() { return power_controller; }
+    ProtocolStats& protocols() { return *protocol_stats; }
+
+private:
+    void refresh_registry();
+    void cache_device_values(DWORD device_handle, std::unique_lock<std::mutex>& plant);
+    WorkPool& work_pool();
+    WorkPool& io_pool();
+    void stop_workers();
+    bool set_listen_only(bool listen_only);
+    // Nothing may be sent: listening only or standing by
+    bool passive() const { return listening() || standby(); }
+
+    std::mutex lifecycle;           // initialize and shutdown
+    std::atomic<bool> ready{ false };
+    DWORD drivers[10]; // Assuming max 10 drivers
+    DWORD driver_count = 0;
+    int debug_level = 0;
+
+    HistoryStore history_store;
+    BulkTransfer bulk_transfer;
+    DeviceGroups device_groups;
+    DeviceRegistry registry;
+    ValueCache value_cache;
+    ChangeWaiters change_waiters;
+    LiveTable table;
+    // Shared with the packet handlers, which may still run while they are removed
+    std::shared_ptr<ProtocolStats> protocol_stats;
+    DWORD protocol_listener = 0;
+    // Sample times of channel values, recorded on the YASDI thread
+    std::shared_ptr<ReceiveTimes> receive_times;
+    DWORD receive_listener = 0;
+    // Decodes other masters' answers while listening only
+    std::shared_ptr<BusSniffer> sniffer;
+    std::vector<DWORD> sniffer_listeners;
+    std::atomic<bool> refresh_queued{ false };
+    HandoffServer handoff;
+    StandbyReplica replica;
+    DeviceReader reader;
+    PowerController power_controller;
+    FreshnessScheduler poll_jobs;
+    PeerAnalytics peers;
+
+    std::mutex pool_mutex;
+    std::unique_ptr<WorkPool> pool;     // created by the first asynchronous call
+    std::unique_ptr<WorkPool> io;       // bus-bound calls, see run_async
+};
+
+#endif
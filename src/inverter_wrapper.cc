@@ -1,22 +1,61 @@
 #include <napi.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
-// Include YASDI SDK headers
-extern "C" {
-    #include "libyasdi.h"
-    #include "libyasdimaster.h"
-    #include "tools.h"
-}
+#include "yasdi_headers.h"
+#include "inverter_engine.h"
+#include "smadata_request.h"
+#include "packet_listeners.h"
+#include "plant_lock.h"
+#include "mem_stats.h"
+
+
+// JS callback of a packet listener; YASDI may still deliver a packet while
+// the listener is removed, so calls are guarded by the active flag
+struct ListenerSink {
+    Napi::ThreadSafeFunction callback;
+    std::mutex mutex;
+    bool active = true;
+};
+
+// Wakes JS workers waiting on the live table generation; engine threads
+// publish while the wrapper goes away, so calls are guarded by the active
+// flag. A wake already queued covers every generation published before it
+// runs.
+struct LiveTableWaker {
+    Napi::ThreadSafeFunction notify;    // Atomics.notify bound to the table header
+    std::mutex mutex;
+    bool active = true;
+    std::atomic<bool> pending{ false };
+};
+
+// Copy of a received packet, handed to the JS thread
+struct ReceivedPacket {
+    TSMAData header;
+    PacketBuffer data;
+};
 
-// Structure to store channel data
-struct ChannelData {
-    std::string name;
-    std::string units;
-    std::string value;
-    double numericValue;
+// Outcome of a raw request, handed to the JS thread with its promise
+struct RequestCompletion {
+    Napi::Promise::Deferred deferred;
+    int code = YE_OK;
+    std::vector<SMADataResponse> responses;
+
+    explicit RequestCompletion(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+};
+
+// Member results of a group assignment or removal
+struct GroupOutcome {
+    int code = YE_OK;
+    std::vector<GroupMemberResult> results;
 };
 
 class InverterWrapper : public Napi::ObjectWrap<InverterWrapper> {
@@ -32,22 +71,65 @@ private:
     Napi::Value Initialize(const Napi::CallbackInfo& info);
     Napi::Value DetectDevices(const Napi::CallbackInfo& info);
     Napi::Value GetDevices(const Napi::CallbackInfo& info);
+    Napi::Value RemoveDevice(const Napi::CallbackInfo& info);
+    Napi::Value GetCachedValues(const Napi::CallbackInfo& info);
     Napi::Value GetDeviceData(const Napi::CallbackInfo& info);
+    Napi::Value WaitForChange(const Napi::CallbackInfo& info);
+    Napi::Value PollDevices(const Napi::CallbackInfo& info);
+    Napi::Value Exec(const Napi::CallbackInfo& info);
+    Napi::Value StartPowerController(const Napi::CallbackInfo& info);
+    Napi::Value StopPowerController(const Napi::CallbackInfo& info);
+    Napi::Value GetPowerControllerMetrics(const Napi::CallbackInfo& info);
+    Napi::Value AddPollJob(const Napi::CallbackInfo& info);
+    Napi::Value RemovePollJob(const Napi::CallbackInfo& info);
+    Napi::Value GetPollJobs(const Napi::CallbackInfo& info);
+    Napi::Value Query(const Napi::CallbackInfo& info);
+    Napi::Value SetPeerAnalytics(const Napi::CallbackInfo& info);
+    Napi::Value AnalyzePeers(const Napi::CallbackInfo& info);
+    Napi::Value GetMetrics(const Napi::CallbackInfo& info);
     Napi::Value SetChannelValue(const Napi::CallbackInfo& info);
     Napi::Value GetChannelInfo(const Napi::CallbackInfo& info);
+    Napi::Value GetBinaryInfo(const Napi::CallbackInfo& info);
+    Napi::Value GetRecording(const Napi::CallbackInfo& info);
+    Napi::Value SetRecording(const Napi::CallbackInfo& info);
+    Napi::Value Backfill(const Napi::CallbackInfo& info);
+    Napi::Value GetHistory(const Napi::CallbackInfo& info);
+    Napi::Value AssignGroup(const Napi::CallbackInfo& info);
+    Napi::Value RemoveGroup(const Napi::CallbackInfo& info);
+    Napi::Value GetGroups(const Napi::CallbackInfo& info);
+    Napi::Value SetGroupValue(const Napi::CallbackInfo& info);
+    Napi::Value ReadGroup(const Napi::CallbackInfo& info);
+    Napi::Value SendRequest(const Napi::CallbackInfo& info);
+    Napi::Value AddPacketListener(const Napi::CallbackInfo& info);
+    Napi::Value RemovePacketListener(const Napi::CallbackInfo& info);
+    Napi::Value StartListening(const Napi::CallbackInfo& info);
+    Napi::Value StopListening(const Napi::CallbackInfo& info);
+    Napi::Value ServeStandby(const Napi::CallbackInfo& info);
+    Napi::Value StopServingStandby(const Napi::CallbackInfo& info);
+    Napi::Value StartStandby(const Napi::CallbackInfo& info);
+    Napi::Value GetStandbyStatus(const Napi::CallbackInfo& info);
+    Napi::Value TakeOver(const Napi::CallbackInfo& info);
+    Napi::Value AttachLiveTable(const Napi::CallbackInfo& info);
     Napi::Value Shutdown(const Napi::CallbackInfo& info);
     
     // Internal helper methods
-    bool detect_devices(int device_count);
-    std::map<DWORD, std::string> get_device_map();
-    std::vector<ChannelData> fetch_channel_data(DWORD device_handle);
-    DWORD find_channel_handle(DWORD device_handle, const std::string& channel_name);
+    static void cleanup(void* arg);
+    static std::string error_message(int code);
+    static Napi::Array member_results(Napi::Env env, const std::vector<GroupMemberResult>& results);
+    static void settle_group(Napi::Env env, Napi::Promise::Deferred& deferred, GroupOutcome& done);
+    static Napi::Object batch_result(Napi::Env env, const BatchOp& op, const BatchResult& result);
     
     // Member variables
-    bool initialized = false;
-    DWORD drivers[10]; // Assuming max 10 drivers
-    DWORD driver_count = 0;
+    // Shared with a background shutdown, which may outlive this object
+    std::shared_ptr<InverterEngine> engine = std::make_shared<InverterEngine>();
+    napi_env cleanup_env = nullptr;     // set while the environment cleanup hook is registered
     int debug_level = 0;
+    std::map<DWORD, std::shared_ptr<ListenerSink>> listeners;
+    std::vector<ChannelData> device_data;   // reused by every getDeviceData
+    Napi::ObjectReference live_table_memory;
+    std::shared_ptr<LiveTableWaker> live_table_waker;
+    
+    void stop_waking_workers();
 };
 
 Napi::FunctionReference InverterWrapper::constructor;
@@ -59,9 +141,45 @@ Napi::Object InverterWrapper::Init(Napi::Env env, Napi::Object exports) {
         InstanceMethod("initialize", &InverterWrapper::Initialize),
         InstanceMethod("detectDevices", &InverterWrapper::DetectDevices),
         InstanceMethod("getDevices", &InverterWrapper::GetDevices),
+        InstanceMethod("removeDevice", &InverterWrapper::RemoveDevice),
+        InstanceMethod("getCachedValues", &InverterWrapper::GetCachedValues),
         InstanceMethod("getDeviceData", &InverterWrapper::GetDeviceData),
+        InstanceMethod("waitForChange", &InverterWrapper::WaitForChange),
+        InstanceMethod("pollDevices", &InverterWrapper::PollDevices),
+        InstanceMethod("exec", &InverterWrapper::Exec),
+        InstanceMethod("startPowerController", &InverterWrapper::StartPowerController),
+        InstanceMethod("stopPowerController", &InverterWrapper::StopPowerController),
+        InstanceMethod("getPowerControllerMetrics", &InverterWrapper::GetPowerControllerMetrics),
+        InstanceMethod("addPollJob", &InverterWrapper::AddPollJob),
+        InstanceMethod("removePollJob", &InverterWrapper::RemovePollJob),
+        InstanceMethod("getPollJobs", &InverterWrapper::GetPollJobs),
+        InstanceMethod("query", &InverterWrapper::Query),
+        InstanceMethod("setPeerAnalytics", &InverterWrapper::SetPeerAnalytics),
+        InstanceMethod("analyzePeers", &InverterWrapper::AnalyzePeers),
+        InstanceMethod("getMetrics", &InverterWrapper::GetMetrics),
         InstanceMethod("setChannelValue", &InverterWrapper::SetChannelValue),
         InstanceMethod("getChannelInfo", &InverterWrapper::GetChannelInfo),
+        InstanceMethod("getBinaryInfo", &InverterWrapper::GetBinaryInfo),
+        InstanceMethod("getRecording", &InverterWrapper::GetRecording),
+        InstanceMethod("setRecording", &InverterWrapper::SetRecording),
+        InstanceMethod("backfill", &InverterWrapper::Backfill),
+        InstanceMethod("getHistory", &InverterWrapper::GetHistory),
+        InstanceMethod("assignGroup", &InverterWrapper::AssignGroup),
+        InstanceMethod("removeGroup", &InverterWrapper::RemoveGroup),
+        InstanceMethod("getGroups", &InverterWrapper::GetGroups),
+        InstanceMethod("setGroupValue", &InverterWrapper::SetGroupValue),
+        InstanceMethod("readGroup", &InverterWrapper::ReadGroup),
+        InstanceMethod("sendRequest", &InverterWrapper::SendRequest),
+        InstanceMethod("addPacketListener", &InverterWrapper::AddPacketListener),
+        InstanceMethod("removePacketListener", &InverterWrapper::RemovePacketListener),
+        InstanceMethod("startListening", &InverterWrapper::StartListening),
+        InstanceMethod("stopListening", &InverterWrapper::StopListening),
+        InstanceMethod("serveStandby", &InverterWrapper::ServeStandby),
+        InstanceMethod("stopServingStandby", &InverterWrapper::StopServingStandby),
+        InstanceMethod("startStandby", &InverterWrapper::StartStandby),
+        InstanceMethod("getStandbyStatus", &InverterWrapper::GetStandbyStatus),
+        InstanceMethod("takeOver", &InverterWrapper::TakeOver),
+        InstanceMethod("attachLiveTable", &InverterWrapper::AttachLiveTable),
         InstanceMethod("shutdown", &InverterWrapper::Shutdown)
     });
     
@@ -78,19 +196,60 @@ InverterWrapper::InverterWrapper(const Napi::CallbackInfo& info)
     Napi::Env env = info.Env();
     Napi::HandleScope scope(env);
     
+    // Objects still alive when the environment goes away are not finalized
+    // reliably, their engine is shut down by the cleanup hook instead
+    if (napi_add_env_cleanup_hook(env, &InverterWrapper::cleanup, this) == napi_ok) {
+        cleanup_env = env;
+    }
+    
     if (info.Length() > 0 && info[0].IsNumber()) {
-        this->debug_level = info[0].As<Napi::Number>().Int32Value();
+        debug_level = info[0].As<Napi::Number>().Int32Value();
     }
+    engine->set_debug_level(debug_level);
 }
 
 InverterWrapper::~InverterWrapper() {
-    if (initialized) {
-        // Shutdown YASDI if still initialized
-        for (DWORD i = 0; i < driver_count; i++) {
-            yasdiSetDriverOffline(drivers[i]);
-        }
-        yasdiMasterShutdown();
+    if (cleanup_env != nullptr) {
+        napi_remove_env_cleanup_hook(cleanup_env, &InverterWrapper::cleanup, this);
+    }
+    
+    for (auto& listener : listeners) {
+        PacketListeners::instance().remove(listener.first);
+        std::lock_guard<std::mutex> lock(listener.second->mutex);
+        listener.second->active = false;
+        listener.second->callback.Release();
+    }
+    
+    // The shared memory is released with this object, while the background
+    // shutdown and pool tasks still running could write into it
+    engine->live_table().detach();
+    stop_waking_workers();
+    
+    // This may run in a GC finalizer, where waiting for requests on the bus
+    // and closing drivers would stall the event loop
+    engine->shutdown_async();
+}
+
+// The environment is torn down (process exit, worker termination): shut
+// down YASDI, and wait for every shutdown still running, so that no YASDI
+// thread outlives the addon
+void InverterWrapper::cleanup(void* arg) {
+    InverterWrapper* self = static_cast<InverterWrapper*>(arg);
+    self->cleanup_env = nullptr;
+    self->engine->live_table().detach();
+    self->stop_waking_workers();
+    self->engine->shutdown_async();
+    InverterEngine::wait_for_shutdowns();
+}
+
+// Publishes still running may hold the waker, they find it inactive
+void InverterWrapper::stop_waking_workers() {
+    if (live_table_waker) {
+        std::lock_guard<std::mutex> lock(live_table_waker->mutex);
+        live_table_waker->active = false;
+        live_table_waker->notify.Release();
     }
+    live_table_waker.reset();
 }
 
 Napi::Value InverterWrapper::Initialize(const Napi::CallbackInfo& info) {
@@ -102,50 +261,19 @@ Napi::Value InverterWrapper::Initialize(const Napi::CallbackInfo& info) {
     }
     
     std::string config_path = info[0].As<Napi::String>().Utf8Value();
-    // Initialize YASDI library
-    DWORD result = yasdiMasterInitialize(config_path.c_str(), &driver_count);
-    
-    if (this->debug_level > 0) {
-        std::cout << "YASDI initialization returned: " << result << std::endl;
-        std::cout << "Found " << driver_count << " drivers" << std::endl;
-    }
-    
-    if (driver_count == 0) {
-        Napi::Error::New(env, "No YASDI drivers found").ThrowAsJavaScriptException();
-        return Napi::Boolean::New(env, false);
-    }
-    
-    // Get all drivers
-    driver_count = yasdiMasterGetDriver(drivers, 10);
-    
-    // Switch all drivers online
-    bool any_driver_online = false;
-    for (DWORD i = 0; i < driver_count; i++) {
-        char driverName[64];
-        yasdiGetDriverName(drivers[i], driverName, sizeof(driverName) - 1);
-        
-        if (this->debug_level > 0) {
-            std::cout << "Switching on driver: " << driverName << std::endl;
-        }
-        
-        if (yasdiSetDriverOnline(drivers[i])) {
-            any_driver_online = true;
-        }
-    }
-    
-    if (!any_driver_online) {
-        Napi::Error::New(env, "No drivers could be set online").ThrowAsJavaScriptException();
+    std::string error;
+    if (!engine->initialize(config_path, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
         return Napi::Boolean::New(env, false);
     }
     
-    this->initialized = true;
     return Napi::Boolean::New(env, true);
 }
 
 Napi::Value InverterWrapper::DetectDevices(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (!initialized) {
+    if (!engine->initialized()) {
         Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
         return env.Null();
     }
@@ -155,42 +283,19 @@ Napi::Value InverterWrapper::DetectDevices(const Napi::CallbackInfo& info) {
         device_count = info[0].As<Napi::Number>().Int32Value();
     }
     
-    bool success = detect_devices(device_count);
+    bool success = engine->detect(device_count);
     return Napi::Boolean::New(env, success);
 }
 
-bool InverterWrapper::detect_devices(int device_count) {
-    if (this->debug_level > 0) {
-        std::cout << "Trying to detect " << device_count << " devices" << std::endl;
-    }
-    
-    // Blocking call to detect devices
-    int error = DoStartDeviceDetection(device_count, TRUE);
-    
-    switch (error) {
-        case YE_OK:
-            return true;
-        case YE_DEV_DETECT_IN_PROGRESS:
-            std::cout << "Error: Detection in progress" << std::endl;
-            return false;
-        case YE_NOT_ALL_DEVS_FOUND:
-            std::cout << "Error: Not all devices were found" << std::endl;
-            return false;
-        default:
-            std::cout << "Error: Unknown YASDI error" << std::endl;
-            return false;
-    }
-}
-
 Napi::Value InverterWrapper::GetDevices(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (!initialized) {
+    if (!engine->initialized()) {
         Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    std::map<DWORD, std::string> device_map = get_device_map();
+    std::map<DWORD, std::string> device_map = engine->device_names();
     
     Napi::Array devices = Napi::Array::New(env);
     int i = 0;
@@ -205,47 +310,39 @@ Napi::Value InverterWrapper::GetDevices(const Napi::CallbackInfo& info) {
     return devices;
 }
 
-std::map<DWORD, std::string> InverterWrapper::get_device_map() {
-    DWORD handles_array[50];
-    char namebuf[64] = "";
-    std::map<DWORD, std::string> device_map;
+// Remove a device from the plant, e.g. after it was replaced
+Napi::Value InverterWrapper::RemoveDevice(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    // Get all device handles
-    DWORD count = GetDeviceHandles(handles_array, 50);
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
     
-    if (count > 0) {
-        for (DWORD device = 0; device < count; device++) {
-            // Get the name of this device
-            GetDeviceName(handles_array[device], namebuf, sizeof(namebuf) - 1);
-            
-            if (this->debug_level > 0) {
-                std::cout << "Found device with a handle of: " << handles_array[device] 
-                          << " and a name of: " << namebuf << std::endl;
-            }
-            
-            std::string device_name = std::string(namebuf);
-            // Replace spaces with underscores for easier handling
-            size_t pos;
-            while ((pos = device_name.find(" ")) != std::string::npos) {
-                device_name.replace(pos, 1, "_");
-            }
-            
-            // Add it to the map
-            device_map[handles_array[device]] = device_name;
-        }
-    } else {
-        if (this->debug_level > 0) {
-            std::cout << "No devices have been found" << std::endl;
-        }
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Device handle expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    return device_map;
+    DWORD device_handle = info[0].As<Napi::Number>().Uint32Value();
+    
+    int code = engine->remove_device(device_handle);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+    }
+    return result;
 }
 
+// Read the spot values of a device. Optional argument { text: false } skips
+// the value texts, only numeric values are read then.
 Napi::Value InverterWrapper::GetDeviceData(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (!initialized) {
+    if (!engine->initialized()) {
         Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
         return env.Null();
     }
@@ -256,16 +353,41 @@ Napi::Value InverterWrapper::GetDeviceData(const Napi::CallbackInfo& info) {
     }
     
     DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
-    std::vector<ChannelData> channel_data = fetch_channel_data(device_handle);
+    bool text = true;
+    bool conditional = false;
+    unsigned long long if_newer_than = 0;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object options = info[1].As<Napi::Object>();
+        text = !options.Has("text") || options.Get("text").ToBoolean().Value();
+        if (options.Get("ifNewerThan").IsNumber()) {
+            conditional = true;
+            if_newer_than = (unsigned long long)options.Get("ifNewerThan").As<Napi::Number>().DoubleValue();
+        }
+    }
+    
+    // The read is what brings newer values; it takes values within the
+    // reader's max age from memory, so polling conditionally costs no more
+    // bus traffic than polling plainly
+    unsigned long long version = 0;
+    engine->read(device_handle, text, device_data, &version);
     
+    // Nothing changed since the caller's version: no channel objects at all
     Napi::Object result = Napi::Object::New(env);
+    if (conditional && version <= if_newer_than) {
+        result.Set("notModified", Napi::Boolean::New(env, true));
+        result.Set("version", Napi::Number::New(env, (double)version));
+        return result;
+    }
+    
     result.Set("timestamp", Napi::String::New(env, ""));  // We'll set this in JS
+    result.Set("version", Napi::Number::New(env, (double)version));
     
-    for (const auto& data : channel_data) {
+    for (const auto& data : device_data) {
         Napi::Object channelObj = Napi::Object::New(env);
         channelObj.Set("value", Napi::String::New(env, data.value));
         channelObj.Set("units", Napi::String::New(env, data.units));
         channelObj.Set("numericValue", Napi::Number::New(env, data.numericValue));
+        channelObj.Set("receivedAt", Napi::Number::New(env, data.receivedAt));
         
         result.Set(data.name, channelObj);
     }
@@ -273,91 +395,50 @@ Napi::Value InverterWrapper::GetDeviceData(const Napi::CallbackInfo& info) {
     return result;
 }
 
-std::vector<ChannelData> InverterWrapper::fetch_channel_data(DWORD device_handle) {
-    DWORD channel_array[500];
-    char channel_name[64];
-    char channel_units[64];
-    char channel_value[64];
-    double double_val = 0;
-    std::vector<ChannelData> data_vector;
-    DWORD max_age = 5;  // Maximum age of the channel value in seconds
-    
-    int channel_count = GetChannelHandlesEx(device_handle, channel_array, 500, SPOTCHANNELS);
-    
-    if (channel_count < 1) {
-        if (this->debug_level > 0) {
-            std::cout << "Could not get the channel count" << std::endl;
-        }
-        return data_vector;
-    }
+// Resolve once the values of a device have a newer version than the one
+// given, or after the timeout; no thread waits meanwhile.
+// Arguments: deviceHandle, version, timeout (ms). Resolves with { changed, version }
+Napi::Value InverterWrapper::WaitForChange(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    // Process each channel
-    for (int i = 0; i < channel_count; i++) {
-        int result = GetChannelName(channel_array[i], channel_name, sizeof(channel_name) - 1);
-        
-        if (result != YE_OK) {
-            if (this->debug_level > 0) {
-                std::cout << "Error reading channel name" << std::endl;
-            }
-            continue;
-        }
-        
-        // Get the units of the reading (e.g., kWh, V, etc.)
-        GetChannelUnit(channel_array[i], channel_units, sizeof(channel_units) - 1);
-        
-        // Get the channel value
-        result = GetChannelValue(channel_array[i], device_handle, &double_val, channel_value, sizeof(channel_value) - 1, max_age);
-        
-        if (result != YE_OK) {
-            if (this->debug_level > 0) {
-                std::cout << "Error reading channel value for channel: " << channel_name << std::endl;
-            }
-            continue;
-        }
-        
-        // Store the data
-        ChannelData data;
-        data.name = channel_name;
-        data.units = channel_units;
-        data.value = channel_value;
-        data.numericValue = double_val;
-        
-        data_vector.push_back(data);
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    return data_vector;
-}
-
-// Helper function to find a channel handle by name
-DWORD InverterWrapper::find_channel_handle(DWORD device_handle, const std::string& channel_name) {
-    DWORD channel_array[500];
-    char name_buffer[64];
-    
-    int channel_count = GetChannelHandlesEx(device_handle, channel_array, 500, ALLCHANNELS);
-    
-    if (channel_count < 1) {
-        if (this->debug_level > 0) {
-            std::cout << "Could not get channel handles" << std::endl;
-        }
-        return 0;
+    if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber()) {
+        Napi::TypeError::New(env, "Expected arguments: deviceHandle (number), version (number), timeout (number)").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    for (int i = 0; i < channel_count; i++) {
-        int result = GetChannelName(channel_array[i], name_buffer, sizeof(name_buffer) - 1);
-        
-        if (result == YE_OK && channel_name == name_buffer) {
-            return channel_array[i];
-        }
-    }
+    DWORD device_handle = info[0].As<Napi::Number>().Uint32Value();
+    unsigned long long since = (unsigned long long)info[1].As<Napi::Number>().DoubleValue();
+    double timeout = info[2].As<Napi::Number>().DoubleValue() / 1000;
+    
+    Napi::Promise::Deferred* deferred = new Napi::Promise::Deferred(Napi::Promise::Deferred::New(env));
+    Napi::Promise promise = deferred->Promise();
+    Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), "waitForChange", 0, 1);
+    
+    engine->wait_for_change(device_handle, since, timeout, [deferred, tsfn](bool changed, unsigned long long version) mutable {
+        tsfn.NonBlockingCall([deferred, changed, version](Napi::Env env, Napi::Function) {
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("changed", Napi::Boolean::New(env, changed));
+            result.Set("version", Napi::Number::New(env, (double)version));
+            deferred->Resolve(result);
+            delete deferred;
+        });
+        tsfn.Release();
+    });
     
-    return 0; // Channel not found
+    return promise;
 }
 
 // New method to get channel information (including range)
 Napi::Value InverterWrapper::GetChannelInfo(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (!initialized) {
+    if (!engine->initialized()) {
         Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
         return env.Null();
     }
@@ -370,34 +451,25 @@ Napi::Value InverterWrapper::GetChannelInfo(const Napi::CallbackInfo& info) {
     DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
     std::string channel_name = info[1].As<Napi::String>().Utf8Value();
     
-    DWORD channel_handle = find_channel_handle(device_handle, channel_name);
+    ChannelInfo channel;
+    int result = engine->channel_info(device_handle, channel_name, channel);
     
-    if (channel_handle == 0) {
+    if (result == YE_UNKNOWN_HANDLE) {
         Napi::Error::New(env, "Channel not found").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    double min_value, max_value;
-    int result = GetChannelValRange(channel_handle, &min_value, &max_value);
-    
     if (result != YE_OK) {
-        if (this->debug_level > 0) {
-            std::cout << "Error getting channel value range: " << result << std::endl;
-        }
-        
         Napi::Error::New(env, "Failed to get channel value range").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    char channel_units[64];
-    GetChannelUnit(channel_handle, channel_units, sizeof(channel_units) - 1);
-    
     Napi::Object channelInfo = Napi::Object::New(env);
-    channelInfo.Set("handle", Napi::Number::New(env, channel_handle));
+    channelInfo.Set("handle", Napi::Number::New(env, channel.handle));
     channelInfo.Set("name", Napi::String::New(env, channel_name));
-    channelInfo.Set("minValue", Napi::Number::New(env, min_value));
-    channelInfo.Set("maxValue", Napi::Number::New(env, max_value));
-    channelInfo.Set("units", Napi::String::New(env, channel_units));
+    channelInfo.Set("minValue", Napi::Number::New(env, channel.min_value));
+    channelInfo.Set("maxValue", Napi::Number::New(env, channel.max_value));
+    channelInfo.Set("units", Napi::String::New(env, channel.units));
     
     return channelInfo;
 }
@@ -406,7 +478,7 @@ Napi::Value InverterWrapper::GetChannelInfo(const Napi::CallbackInfo& info) {
 Napi::Value InverterWrapper::SetChannelValue(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (!initialized) {
+    if (!engine->initialized()) {
         Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
         return env.Null();
     }
@@ -421,92 +493,1638 @@ Napi::Value InverterWrapper::SetChannelValue(const Napi::CallbackInfo& info) {
     std::string channel_name = info[1].As<Napi::String>().Utf8Value();
     double value = info[2].As<Napi::Number>().DoubleValue();
     
-    // Find the channel handle by name
-    DWORD channel_handle = find_channel_handle(device_handle, channel_name);
+    WriteResult written = engine->write(device_handle, channel_name, value);
     
-    if (channel_handle == 0) {
+    if (written.code == YE_UNKNOWN_HANDLE) {
         Napi::Error::New(env, "Channel not found").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    // Check if value is within valid range
-    double min_value, max_value;
-    int range_result = GetChannelValRange(channel_handle, &min_value, &max_value);
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, written.code == YE_OK));
     
-    if (range_result == YE_OK && (value < min_value || value > max_value)) {
-        if (this->debug_level > 0) {
-            std::cout << "Value out of range. Valid range: [" << min_value << ", " << max_value << "]" << std::endl;
-        }
-        
-        Napi::Object result = Napi::Object::New(env);
-        result.Set("success", Napi::Boolean::New(env, false));
+    if (written.code == YE_VALUE_NOT_VALID && written.has_range) {
         result.Set("error", Napi::String::New(env, "Value out of range"));
         result.Set("code", Napi::Number::New(env, YE_VALUE_NOT_VALID));
         result.Set("validRange", Napi::Object::New(env));
-        result.Get("validRange").As<Napi::Object>().Set("min", Napi::Number::New(env, min_value));
-        result.Get("validRange").As<Napi::Object>().Set("max", Napi::Number::New(env, max_value));
+        result.Get("validRange").As<Napi::Object>().Set("min", Napi::Number::New(env, written.min_value));
+        result.Get("validRange").As<Napi::Object>().Set("max", Napi::Number::New(env, written.max_value));
         return result;
     }
     
-    // Set the channel value
-    int set_result = ::SetChannelValue(channel_handle, device_handle, value);
-    
-    Napi::Object result = Napi::Object::New(env);
-    result.Set("success", Napi::Boolean::New(env, set_result == YE_OK));
-    result.Set("code", Napi::Number::New(env, set_result));
+    result.Set("code", Napi::Number::New(env, written.code));
     
     // Handle error cases
-    if (set_result != YE_OK) {
-        std::string error_message;
-        
-        switch (set_result) {
-            case INVALID_HANDLE:
-                error_message = "Invalid channel handle";
-                break;
-            case YE_SHUTDOWN:
-                error_message = "YASDI is in shutdown mode";
-                break;
-            case YE_TIMEOUT:
-                error_message = "Device did not respond (timeout)";
-                break;
-            case YE_VALUE_NOT_VALID:
-                error_message = "Channel value not within valid range";
-                break;
-            case YE_NO_ACCESS_RIGHTS:
-                error_message = "Not enough access rights to write to channel";
-                break;
-            default:
-                error_message = "Unknown error";
-                break;
-        }
-        
-        result.Set("error", Napi::String::New(env, error_message));
-        
-        if (this->debug_level > 0) {
-            std::cout << "Error setting channel value: " << error_message << " (code: " << set_result << ")" << std::endl;
-        }
+    if (written.code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(written.code)));
     }
     
     return result;
 }
 
-Napi::Value InverterWrapper::Shutdown(const Napi::CallbackInfo& info) {
+std::string InverterWrapper::error_message(int code) {
+    switch (code) {
+        case INVALID_HANDLE:
+            return "Invalid channel handle";
+        case YE_SHUTDOWN:
+            return "YASDI is in shutdown mode";
+        case YE_TIMEOUT:
+            return "Device did not respond (timeout)";
+        case YE_VALUE_NOT_VALID:
+            return "Channel value not within valid range";
+        case YE_NO_ACCESS_RIGHTS:
+            return "Not enough access rights to write to channel";
+        case YE_UNKNOWN_HANDLE:
+            return "Unknown device or channel handle";
+        case YE_CHAN_TYPE_MISMATCH:
+            return "Channel type mismatch";
+        case YE_INVAL_ARGUMENT:
+            return "Invalid argument";
+        case YE_TOO_MANY_REQUESTS:
+            return "Bus cannot carry the request";
+        case YE_NOT_SUPPORTED:
+            return "Not supported while listening only or standing by";
+        default:
+            return "Unknown error";
+    }
+}
+
+// Run a call that waits for bus round trips on an I/O thread; settle
+// resolves or rejects the promise with its result on the JS thread. Neither
+// may use the wrapper, which can be collected meanwhile.
+template <typename Result>
+static Napi::Promise run_on_io(Napi::Env env, InverterEngine& engine, const char* name,
+                                 std::function<void(Result&)> work,
+                                 std::function<void(Napi::Env, Napi::Promise::Deferred&, Result&)> settle) {
+    Napi::Promise::Deferred* deferred = new Napi::Promise::Deferred(Napi::Promise::Deferred::New(env));
+    Napi::Promise promise = deferred->Promise();
+    Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), name, 0, 1);
+    
+    engine.run_async([work, settle, deferred, tsfn]() mutable {
+        auto result = std::make_shared<Result>();
+        work(*result);
+        tsfn.NonBlockingCall([settle, result, deferred](Napi::Env env, Napi::Function) {
+            settle(env, *deferred, *result);
+            delete deferred;
+        });
+        tsfn.Release();
+    });
+    
+    return promise;
+}
+
+// Get the binary areas a device stores (CMD_GET_BINFO), on an I/O thread
+Napi::Value InverterWrapper::GetBinaryInfo(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (!initialized) {
-        return Napi::Boolean::New(env, true);
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    // Shutdown all YASDI drivers
-    for (DWORD i = 0; i < driver_count; i++) {
-        yasdiSetDriverOffline(drivers[i]);
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Device handle expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    // Shutdown YASDI
-    yasdiMasterShutdown();
+    DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
     
-    initialized = false;
-    return Napi::Boolean::New(env, true);
+    struct BinaryInfo {
+        int code = YE_OK;
+        std::vector<BinaryArea> areas;
+    };
+    InverterEngine* bus = engine.get();
+    return run_on_io<BinaryInfo>(env, *engine, "getBinaryInfo",
+        [bus, device_handle](BinaryInfo& done) {
+            done.code = bus->bulk().get_binary_info(device_handle, done.areas);
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, BinaryInfo& done) {
+            if (done.code != YE_OK) {
+                deferred.Reject(Napi::Error::New(env, "Failed to get binary info: " + error_message(done.code)).Value());
+                return;
+            }
+            
+            Napi::Array list = Napi::Array::New(env, done.areas.size());
+            for (size_t i = 0; i < done.areas.size(); i++) {
+                const BinaryArea& binary = done.areas[i];
+                Napi::Object area = Napi::Object::New(env);
+                area.Set("area", Napi::Number::New(env, binary.area));
+                area.Set("revision", Napi::Number::New(env, binary.revision));
+                area.Set("name", Napi::String::New(env, binary.name));
+                area.Set("start", Napi::Number::New(env, binary.start));
+                area.Set("size", Napi::Number::New(env, binary.size));
+                area.Set("mode", Napi::Number::New(env, binary.mode));
+                list[i] = area;
+            }
+            deferred.Resolve(list);
+        });
+}
+
+// Get the channels the device records and the recording interval
+// (CMD_GET_MTIME), on an I/O thread
+Napi::Value InverterWrapper::GetRecording(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Device handle expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
+    
+    struct Recording {
+        int code = YE_OK;
+        RecordingConfig config;
+    };
+    InverterEngine* bus = engine.get();
+    return run_on_io<Recording>(env, *engine, "getRecording",
+        [bus, device_handle](Recording& done) {
+            done.code = bus->bulk().get_recording(device_handle, done.config);
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, Recording& done) {
+            if (done.code != YE_OK) {
+                deferred.Reject(Napi::Error::New(env, "Failed to get recording setup: " + error_message(done.code)).Value());
+                return;
+            }
+            
+            const RecordingConfig& config = done.config;
+            Napi::Array channels = Napi::Array::New(env, config.channels.size());
+            for (size_t i = 0; i < config.channels.size(); i++) {
+                Napi::Object chan = Napi::Object::New(env);
+                chan.Set("mask", Napi::Number::New(env, config.channels[i].chan_mask));
+                chan.Set("index", Napi::Number::New(env, config.channels[i].chan_index));
+                channels[i] = chan;
+            }
+            
+            Napi::Object recording = Napi::Object::New(env);
+            recording.Set("interval", Napi::Number::New(env, config.interval));
+            recording.Set("channels", channels);
+            deferred.Resolve(recording);
+        });
+}
+
+// Set the channels the device records (CMD_SET_MTIME), on an I/O thread
+Napi::Value InverterWrapper::SetRecording(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected arguments: deviceHandle (number), recording (object)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
+    Napi::Object recording = info[1].As<Napi::Object>();
+    
+    RecordingConfig config;
+    config.interval = (WORD)recording.Get("interval").ToNumber().Uint32Value();
+    if (recording.Get("channels").IsArray()) {
+        Napi::Array channels = recording.Get("channels").As<Napi::Array>();
+        for (uint32_t i = 0; i < channels.Length(); i++) {
+            Napi::Object chan = channels.Get(i).ToObject();
+            config.channels.push_back({(WORD)chan.Get("mask").ToNumber().Uint32Value(),
+                                       (BYTE)chan.Get("index").ToNumber().Uint32Value()});
+        }
+    }
+    
+    InverterEngine* bus = engine.get();
+    return run_on_io<int>(env, *engine, "setRecording",
+        [bus, device_handle, config](int& code) {
+            code = bus->bulk().set_recording(device_handle, config);
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, int& code) {
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+            result.Set("code", Napi::Number::New(env, code));
+            if (code != YE_OK) {
+                result.Set("error", Napi::String::New(env, error_message(code)));
+            }
+            deferred.Resolve(result);
+        });
+}
+
+// Download device recorded data and merge it into the history on an I/O
+// thread; at 1200 baud a transfer takes minutes
+Napi::Value InverterWrapper::Backfill(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected arguments: deviceHandle (number), area (number), [since (number)]").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
+    BYTE area = (BYTE)info[1].As<Napi::Number>().Uint32Value();
+    
+    // By default only fetch what is newer than the history already holds
+    DWORD since = engine->history().last_time(device_handle);
+    if (info.Length() > 2 && info[2].IsNumber()) {
+        since = info[2].As<Napi::Number>().Uint32Value();
+    }
+    
+    struct Backfilled {
+        int code = YE_OK;
+        BackfillResult backfill;
+    };
+    InverterEngine* bus = engine.get();
+    int debug = debug_level;
+    return run_on_io<Backfilled>(env, *engine, "backfill",
+        [bus, device_handle, area, since, debug](Backfilled& done) {
+            done.code = bus->bulk().backfill(device_handle, area, since, bus->history(), done.backfill);
+            if (debug > 0) {
+                std::cout << "Backfill of device " << device_handle << " returned " << done.code
+                          << ": " << done.backfill.records << " records, " << done.backfill.bytes << " bytes" << std::endl;
+            }
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, Backfilled& done) {
+            const BackfillResult& backfill = done.backfill;
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("success", Napi::Boolean::New(env, done.code == YE_OK));
+            result.Set("code", Napi::Number::New(env, done.code));
+            result.Set("bytes", Napi::Number::New(env, backfill.bytes));
+            result.Set("records", Napi::Number::New(env, backfill.records));
+            result.Set("samples", Napi::Number::New(env, backfill.samples));
+            result.Set("from", Napi::Number::New(env, backfill.first_time));
+            result.Set("to", Napi::Number::New(env, backfill.last_time));
+            if (done.code != YE_OK) {
+                result.Set("error", Napi::String::New(env, error_message(done.code)));
+            }
+            deferred.Resolve(result);
+        });
+}
+
+// Read stored values of one channel in a time range (seconds since 1970)
+Napi::Value InverterWrapper::GetHistory(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected arguments: deviceHandle (number), channelName (string), [from (number)], [to (number)]").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD device_handle = info[0].As<Napi::Number>().Int32Value();
+    std::string channel_name = info[1].As<Napi::String>().Utf8Value();
+    DWORD from = 0;
+    DWORD to = 0xffffffff;
+    if (info.Length() > 2 && info[2].IsNumber()) {
+        from = info[2].As<Napi::Number>().Uint32Value();
+    }
+    if (info.Length() > 3 && info[3].IsNumber()) {
+        to = info[3].As<Napi::Number>().Uint32Value();
+    }
+    
+    std::vector<HistorySample> samples = engine->history().query(device_handle, channel_name, from, to);
+    
+    Napi::Array list = Napi::Array::New(env, samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        Napi::Object sample = Napi::Object::New(env);
+        sample.Set("time", Napi::Number::New(env, samples[i].time));
+        sample.Set("value", Napi::Number::New(env, samples[i].value));
+        list[i] = sample;
+    }
+    
+    return list;
+}
+
+Napi::Array InverterWrapper::member_results(Napi::Env env, const std::vector<GroupMemberResult>& results) {
+    Napi::Array list = Napi::Array::New(env, results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        Napi::Object member = Napi::Object::New(env);
+        member.Set("handle", Napi::Number::New(env, results[i].device_handle));
+        member.Set("success", Napi::Boolean::New(env, results[i].code == YE_OK));
+        member.Set("code", Napi::Number::New(env, results[i].code));
+        list[i] = member;
+    }
+    return list;
+}
+
+void InverterWrapper::settle_group(Napi::Env env, Napi::Promise::Deferred& deferred, GroupOutcome& done) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, done.code == YE_OK));
+    result.Set("code", Napi::Number::New(env, done.code));
+    result.Set("devices", member_results(env, done.results));
+    deferred.Resolve(result);
+}
+
+// Assign devices to an SMAData group address (CMD_SET_GRPADR) on an I/O thread
+Napi::Value InverterWrapper::AssignGroup(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsArray()) {
+        Napi::TypeError::New(env, "Expected arguments: group (number), deviceHandles (array)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    WORD group = (WORD)info[0].As<Napi::Number>().Uint32Value();
+    Napi::Array handles = info[1].As<Napi::Array>();
+    std::vector<DWORD> devices;
+    for (uint32_t i = 0; i < handles.Length(); i++) {
+        devices.push_back(handles.Get(i).ToNumber().Uint32Value());
+    }
+    
+    InverterEngine* bus = engine.get();
+    return run_on_io<GroupOutcome>(env, *engine, "assignGroup",
+        [bus, group, devices](GroupOutcome& done) {
+            done.code = bus->groups().assign(group, devices, done.results);
+        },
+        settle_group);
+}
+
+// Remove a group from all its members (CMD_DEL_GRPADR) on an I/O thread
+Napi::Value InverterWrapper::RemoveGroup(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Group address expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    WORD group = (WORD)info[0].As<Napi::Number>().Uint32Value();
+    InverterEngine* bus = engine.get();
+    return run_on_io<GroupOutcome>(env, *engine, "removeGroup",
+        [bus, group](GroupOutcome& done) {
+            done.code = bus->groups().remove(group, done.results);
+        },
+        settle_group);
+}
+
+Napi::Value InverterWrapper::GetGroups(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::vector<WORD> group_list = engine->groups().groups();
+    Napi::Array list = Napi::Array::New(env, group_list.size());
+    
+    for (size_t i = 0; i < group_list.size(); i++) {
+        std::vector<DWORD> members = engine->groups().members(group_list[i]);
+        Napi::Array handles = Napi::Array::New(env, members.size());
+        for (size_t j = 0; j < members.size(); j++) {
+            handles[j] = Napi::Number::New(env, members[j]);
+        }
+        
+        Napi::Object group = Napi::Object::New(env);
+        group.Set("group", Napi::Number::New(env, group_list[i]));
+        group.Set("devices", handles);
+        list[i] = group;
+    }
+    
+    return list;
+}
+
+// Write a channel value to all members of a group with one frame, on an
+// I/O thread
+Napi::Value InverterWrapper::SetGroupValue(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsString() || !info[2].IsNumber()) {
+        Napi::TypeError::New(env, "Expected arguments: group (number), channelName (string), value (number)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    WORD group = (WORD)info[0].As<Napi::Number>().Uint32Value();
+    std::string channel_name = info[1].As<Napi::String>().Utf8Value();
+    double value = info[2].As<Napi::Number>().DoubleValue();
+    
+    InverterEngine* bus = engine.get();
+    int debug = debug_level;
+    return run_on_io<int>(env, *engine, "setGroupValue",
+        [bus, group, channel_name, value, debug](int& code) {
+            code = bus->groups().write(group, channel_name, value);
+            if (code != YE_OK && debug > 0) {
+                std::cout << "Error setting group value: " << error_message(code) << " (code: " << code << ")" << std::endl;
+            }
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, int& code) {
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+            result.Set("code", Napi::Number::New(env, code));
+            if (code != YE_OK) {
+                result.Set("error", Napi::String::New(env, error_message(code)));
+            }
+            deferred.Resolve(result);
+        });
+}
+
+// Read the channels of all members of a group with one request on an I/O
+// thread; the values are cached and returned by getDeviceData afterwards
+Napi::Value InverterWrapper::ReadGroup(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected arguments: group (number), [channelType (string)], [timeout (number)]").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    WORD group = (WORD)info[0].As<Napi::Number>().Uint32Value();
+    TChanType type = SPOTCHANNELS;
+    if (info.Length() > 1 && info[1].IsString()) {
+        std::string type_name = info[1].As<Napi::String>().Utf8Value();
+        if (type_name == "param") {
+            type = PARAMCHANNELS;
+        } else if (type_name == "test") {
+            type = TESTCHANNELS;
+        }
+    }
+    DWORD timeout = 5;
+    if (info.Length() > 2 && info[2].IsNumber()) {
+        timeout = info[2].As<Napi::Number>().Uint32Value();
+    }
+    
+    struct GroupRead {
+        int code = YE_OK;
+        std::vector<DWORD> answered;
+    };
+    InverterEngine* bus = engine.get();
+    return run_on_io<GroupRead>(env, *engine, "readGroup",
+        [bus, group, type, timeout](GroupRead& done) {
+            done.code = bus->groups().read(group, type, timeout, done.answered);
+            for (DWORD handle : done.answered) {
+                bus->cache_device_values(handle);
+            }
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, GroupRead& done) {
+            Napi::Array handles = Napi::Array::New(env, done.answered.size());
+            for (size_t i = 0; i < done.answered.size(); i++) {
+                handles[i] = Napi::Number::New(env, done.answered[i]);
+            }
+            
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("success", Napi::Boolean::New(env, done.code == YE_OK));
+            result.Set("code", Napi::Number::New(env, done.code));
+            result.Set("devices", handles);
+            if (done.code != YE_OK) {
+                result.Set("error", Napi::String::New(env, error_message(done.code)));
+            }
+            deferred.Resolve(result);
+        });
+}
+
+static bool read_bytes(const Napi::Value& value, std::vector<BYTE>& bytes) {
+    if (value.IsBuffer()) {
+        Napi::Buffer<BYTE> buffer = value.As<Napi::Buffer<BYTE>>();
+        bytes.assign(buffer.Data(), buffer.Data() + buffer.Length());
+        return true;
+    }
+    if (value.IsArray()) {
+        Napi::Array array = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            bytes.push_back((BYTE)array.Get(i).ToNumber().Uint32Value());
+        }
+        return true;
+    }
+    return false;
+}
+
+static int optional_int(const Napi::Object& object, const char* key, int fallback) {
+    if (!object.Has(key) || !object.Get(key).IsNumber()) {
+        return fallback;
+    }
+    return object.Get(key).As<Napi::Number>().Int32Value();
+}
+
+// Send a raw SMAData command through YASDI's request scheduler.
+// Options: { device | dest, cmd, data, type, timeout, repeats, priority, broadcast }
+// Resolves with { success, code, responses: [{ source, data }] }
+Napi::Value InverterWrapper::SendRequest(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Request options object expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    int cmd = optional_int(options, "cmd", -1);
+    if (cmd < 0 || cmd > 255) {
+        Napi::TypeError::New(env, "Option cmd (0-255) expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    WORD dest = 0;
+    DWORD flags = 0;
+    bool broadcast = options.Has("broadcast") && options.Get("broadcast").ToBoolean().Value();
+    if (options.Has("device") && options.Get("device").IsNumber()) {
+        DWORD device_handle = options.Get("device").As<Napi::Number>().Uint32Value();
+        if (!SMADataRequest::resolve_device(device_handle, &dest, &flags)) {
+            Napi::Error::New(env, error_message(YE_UNKNOWN_HANDLE)).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    } else if (options.Has("dest") && options.Get("dest").IsNumber()) {
+        dest = (WORD)options.Get("dest").As<Napi::Number>().Uint32Value();
+    } else if (!broadcast) {
+        Napi::TypeError::New(env, "Option device, dest or broadcast expected").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (broadcast) {
+        dest = 0;
+        flags |= TS_BROADCAST;
+    }
+    
+    std::vector<BYTE> payload;
+    if (options.Has("data") && !read_bytes(options.Get("data"), payload)) {
+        Napi::TypeError::New(env, "Option data must be a Buffer or an array of bytes").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    TReqType type = broadcast ? RT_MULTIRCV : RT_MONORCV;
+    SMADataPriority priority = PRIORITY_NORMAL;
+    if (options.Has("type") && options.Get("type").IsString()) {
+        std::string type_name = options.Get("type").As<Napi::String>().Utf8Value();
+        if (type_name == "multi") {
+            type = RT_MULTIRCV;
+        } else if (type_name == "none") {
+            type = RT_NORCV;
+        }
+    }
+    if (options.Has("priority") && options.Get("priority").IsString()) {
+        std::string priority_name = options.Get("priority").As<Napi::String>().Utf8Value();
+        if (priority_name == "high") {
+            priority = PRIORITY_HIGH;
+        } else if (priority_name == "low") {
+            priority = PRIORITY_LOW;
+        }
+    }
+    
+    auto request = std::make_shared<SMADataRequest>(dest, (BYTE)cmd);
+    request->set_flags(flags);
+    request->set_type(type);
+    request->set_payload(payload.data(), (DWORD)payload.size());
+    request->set_timeout(optional_int(options, "timeout", 5), optional_int(options, "repeats", 3));
+    
+    RequestCompletion* completion = new RequestCompletion(env);
+    Napi::Promise promise = completion->deferred.Promise();
+    Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), "sendRequest", 0, 1);
+    
+    // The scheduler owns the request until this handler returned
+    SMADataRequest* raw = request.get();
+    request->set_end_handler([raw, completion, tsfn](int code) mutable {
+        completion->code = code;
+        completion->responses = raw->responses();
+        tsfn.NonBlockingCall(completion, [](Napi::Env env, Napi::Function, RequestCompletion* done) {
+            Napi::Array responses = Napi::Array::New(env, done->responses.size());
+            for (size_t i = 0; i < done->responses.size(); i++) {
+                const SMADataResponse& response = done->responses[i];
+                Napi::Object answer = Napi::Object::New(env);
+                answer.Set("source", Napi::Number::New(env, response.source));
+                answer.Set("data", Napi::Buffer<BYTE>::Copy(env, response.data.data(), response.data.size()));
+                responses[i] = answer;
+            }
+            
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("success", Napi::Boolean::New(env, done->code == YE_OK));
+            result.Set("code", Napi::Number::New(env, done->code));
+            result.Set("responses", responses);
+            if (done->code != YE_OK) {
+                result.Set("error", Napi::String::New(env, error_message(done->code)));
+            }
+            done->deferred.Resolve(result);
+            delete done;
+        });
+        tsfn.Release();
+    });
+    
+    SMADataScheduler::instance().submit(request, priority);
+    return promise;
+}
+
+// Register a callback for received SMAData packets matching { cmd, source, dest }
+Napi::Value InverterWrapper::AddPacketListener(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction()) {
+        Napi::TypeError::New(env, "Expected arguments: filter (object), callback (function)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    PacketFilter filter;
+    filter.cmd = optional_int(options, "cmd", -1);
+    filter.source = optional_int(options, "source", -1);
+    filter.dest = optional_int(options, "dest", -1);
+    
+    auto sink = std::make_shared<ListenerSink>();
+    sink->callback = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "packetListener", 0, 1);
+    // A listener alone must not keep the process alive
+    sink->callback.Unref(env);
+    
+    DWORD id = PacketListeners::instance().add(filter, [sink](const TSMAData* packet, const BYTE* data, DWORD size) {
+        std::lock_guard<std::mutex> lock(sink->mutex);
+        if (!sink->active) {
+            return;
+        }
+        
+        ReceivedPacket* copy = new ReceivedPacket;
+        copy->header = *packet;
+        copy->data.assign(data, data + size);
+        napi_status status = sink->callback.NonBlockingCall(copy, [](Napi::Env env, Napi::Function callback, ReceivedPacket* received) {
+            Napi::Object packet = Napi::Object::New(env);
+            packet.Set("source", Napi::Number::New(env, received->header.SourceAddr));
+            packet.Set("dest", Napi::Number::New(env, received->header.DestAddr));
+            packet.Set("cmd", Napi::Number::New(env, received->header.Cmd));
+            packet.Set("flags", Napi::Number::New(env, received->header.Flags));
+            packet.Set("data", Napi::Buffer<BYTE>::Copy(env, received->data.data(), received->data.size()));
+            delete received;
+            callback.Call({ packet });
+        });
+        if (status != napi_ok) {
+            delete copy;
+        }
+    });
+    listeners[id] = sink;
+    
+    return Napi::Number::New(env, id);
+}
+
+Napi::Value InverterWrapper::RemovePacketListener(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Listener id expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD id = info[0].As<Napi::Number>().Uint32Value();
+    auto it = listeners.find(id);
+    if (it == listeners.end()) {
+        return Napi::Boolean::New(env, false);
+    }
+    
+    PacketListeners::instance().remove(id);
+    {
+        std::lock_guard<std::mutex> lock(it->second->mutex);
+        it->second->active = false;
+        it->second->callback.Release();
+    }
+    listeners.erase(it);
+    return Napi::Boolean::New(env, true);
+}
+
+// Acquire passively from the answers another master gets, without sending.
+// Argument: optional options object { plantFile }
+Napi::Value InverterWrapper::StartListening(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    ListenConfig config;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value plant_file = info[0].As<Napi::Object>().Get("plantFile");
+        if (plant_file.IsString()) {
+            config.plant_file = plant_file.As<Napi::String>().Utf8Value();
+        }
+    }
+    
+    int code = engine->start_listening(config);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code == YE_NOT_SUPPORTED) {
+        result.Set("error", Napi::String::New(env, "A driver cannot listen only"));
+    } else if (code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+    }
+    return result;
+}
+
+Napi::Value InverterWrapper::StopListening(const Napi::CallbackInfo& info) {
+    engine->stop_listening();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+// Stream the plant state to standby gateways connecting to a unix socket.
+// Argument: socketPath
+Napi::Value InverterWrapper::ServeStandby(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected arguments: socketPath (string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int code = engine->serve_standby(info[0].As<Napi::String>().Utf8Value());
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code == YE_INVAL_ARGUMENT) {
+        result.Set("error", Napi::String::New(env, "Cannot listen on the socket path"));
+    } else if (code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+    }
+    return result;
+}
+
+Napi::Value InverterWrapper::StopServingStandby(const Napi::CallbackInfo& info) {
+    engine->stop_serving_standby();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+// Stand by: apply the state an active gateway serves, send nothing.
+// Argument: socketPath
+Napi::Value InverterWrapper::StartStandby(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected arguments: socketPath (string)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int code = engine->start_standby(info[0].As<Napi::String>().Utf8Value());
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+    }
+    return result;
+}
+
+Napi::Value InverterWrapper::GetStandbyStatus(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    StandbyStatus status = engine->standby_status();
+    
+    Napi::Object handles = Napi::Object::New(env);
+    for (const auto& handle : status.handles) {
+        handles.Set(std::to_string(handle.first), Napi::Number::New(env, handle.second));
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("active", Napi::Boolean::New(env, status.active));
+    result.Set("connected", Napi::Boolean::New(env, status.connected));
+    result.Set("synced", Napi::Boolean::New(env, status.synced));
+    result.Set("devices", Napi::Number::New(env, status.devices));
+    result.Set("channelLists", Napi::Number::New(env, status.channel_lists));
+    result.Set("updates", Napi::Number::New(env, (double)status.updates));
+    result.Set("handles", handles);
+    result.Set("standbys", Napi::Number::New(env, engine->standbys_connected()));
+    return result;
+}
+
+// Take over from the active gateway with one broadcast round trip on an
+// I/O thread, the event loop keeps running meanwhile.
+// Argument: optional timeout (s) of the round trip
+Napi::Value InverterWrapper::TakeOver(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD timeout = 3;
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        timeout = info[0].As<Napi::Number>().Uint32Value();
+    }
+    
+    struct Takeover {
+        int code = YE_OK;
+        TakeoverResult result;
+    };
+    InverterEngine* bus = engine.get();
+    return run_on_io<Takeover>(env, *engine, "takeOver",
+        [bus, timeout](Takeover& done) {
+            done.code = bus->take_over(timeout, done.result);
+        },
+        [](Napi::Env env, Napi::Promise::Deferred& deferred, Takeover& done) {
+            const TakeoverResult& takeover = done.result;
+            Napi::Array confirmed = Napi::Array::New(env, takeover.confirmed.size());
+            for (size_t i = 0; i < takeover.confirmed.size(); i++) {
+                confirmed[i] = Napi::Number::New(env, takeover.confirmed[i]);
+            }
+            Napi::Array missing = Napi::Array::New(env, takeover.missing.size());
+            for (size_t i = 0; i < takeover.missing.size(); i++) {
+                missing[i] = Napi::Number::New(env, takeover.missing[i]);
+            }
+            
+            int code = done.code;
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+            result.Set("code", Napi::Number::New(env, code));
+            result.Set("confirmed", confirmed);
+            result.Set("missing", missing);
+            if (code == YE_INVAL_ARGUMENT) {
+                result.Set("error", Napi::String::New(env, "Not standing by"));
+            } else if (code == YE_NOT_ALL_DEVS_FOUND) {
+                result.Set("error", Napi::String::New(env, "Not all devices answered"));
+            } else if (code != YE_OK) {
+                result.Set("error", Napi::String::New(env, error_message(code)));
+            }
+            deferred.Resolve(result);
+        });
+}
+
+// Keep the latest values of all devices in a SharedArrayBuffer.
+// Arguments: view (Int32Array over the SharedArrayBuffer), capacity (rows), channels (column names)
+Napi::Value InverterWrapper::AttachLiveTable(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 3 || !info[0].IsTypedArray() || !info[1].IsNumber() || !info[2].IsArray()) {
+        Napi::TypeError::New(env, "Expected arguments: view (Int32Array), capacity (number), channels (array)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    // N-API has no SharedArrayBuffer accessor, a typed array view exposes its memory
+    Napi::TypedArray view = info[0].As<Napi::TypedArray>();
+    napi_typedarray_type type;
+    size_t length;
+    void* memory = nullptr;
+    napi_value buffer;
+    size_t offset;
+    if (napi_get_typedarray_info(env, view, &type, &length, &memory, &buffer, &offset) != napi_ok) {
+        Napi::TypeError::New(env, "Live table view is not accessible").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    size_t capacity = info[1].As<Napi::Number>().Uint32Value();
+    
+    Napi::Array names = info[2].As<Napi::Array>();
+    std::vector<std::string> columns;
+    for (uint32_t i = 0; i < names.Length(); i++) {
+        columns.push_back(names.Get(i).ToString().Utf8Value());
+    }
+    
+    if (!engine->live_table().attach(memory, view.ByteLength(), capacity, columns)) {
+        Napi::RangeError::New(env, "Live table buffer too small or not 8 byte aligned").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    // The table memory must stay alive while native code writes to it
+    live_table_memory = Napi::Persistent(view.As<Napi::Object>());
+    
+    // Whichever thread stored the values publishes the generation; only the
+    // JS thread can wake workers waiting in Atomics.wait
+    Napi::Object atomics = env.Global().Get("Atomics").As<Napi::Object>();
+    Napi::Function notify = atomics.Get("notify").As<Napi::Function>();
+    Napi::Function bound = notify.Get("bind").As<Napi::Function>().Call(
+        notify, { atomics, view, Napi::Number::New(env, LiveTable::GENERATION_FIELD) }).As<Napi::Function>();
+    stop_waking_workers();
+    auto waker = std::make_shared<LiveTableWaker>();
+    waker->notify = Napi::ThreadSafeFunction::New(env, bound, "liveTable", 0, 1);
+    // Waiting workers alone must not keep the process alive
+    waker->notify.Unref(env);
+    live_table_waker = waker;
+    
+    engine->live_table().set_publish_handler([waker](int32_t) {
+        if (waker->pending.exchange(true)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(waker->mutex);
+        if (!waker->active) {
+            return;
+        }
+        napi_status status = waker->notify.NonBlockingCall([waker](Napi::Env, Napi::Function notify) {
+            waker->pending = false;
+            notify.Call({});
+        });
+        if (status != napi_ok) {
+            waker->pending = false;
+        }
+    });
+    return Napi::Boolean::New(env, true);
+}
+
+// Latest known values of a device from the value cache, without calling into YASDI.
+// Returns { channelName: { value, time } }
+Napi::Value InverterWrapper::GetCachedValues(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Device handle expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    DWORD device_handle = info[0].As<Napi::Number>().Uint32Value();
+    DeviceRegistry::SnapshotPtr snapshot = engine->devices();
+    const RegistryDevice* device = snapshot->find(device_handle);
+    std::vector<CachedValue> cached;
+    if (device == nullptr || !engine->values().load(device_handle, cached)) {
+        return env.Null();
+    }
+    
+    // Cached values come in registry channel order
+    Napi::Object result = Napi::Object::New(env);
+    size_t channel = 0;
+    for (const CachedValue& value : cached) {
+        while (channel < device->channels.size() && device->channels[channel].handle != value.channel) {
+            channel++;
+        }
+        if (channel == device->channels.size()) {
+            break;
+        }
+        
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("value", Napi::Number::New(env, value.value));
+        entry.Set("time", Napi::Number::New(env, value.time));
+        entry.Set("receivedAt", Napi::Number::New(env, engine->received_at(device_handle, value.channel, value.time)));
+        result.Set(device->channels[channel].name, entry);
+    }
+    
+    return result;
+}
+
+// Poll several devices on the work pool; decoding and encoding run in
+// parallel to the bus transfers and only the finished result returns to JS.
+// Resolves with [{ handle, data }] where data has the getDeviceData layout
+Napi::Value InverterWrapper::PollDevices(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Array of device handles expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Array handles = info[0].As<Napi::Array>();
+    std::vector<DWORD> devices;
+    for (uint32_t i = 0; i < handles.Length(); i++) {
+        devices.push_back(handles.Get(i).ToNumber().Uint32Value());
+    }
+    
+    Napi::Promise::Deferred* deferred = new Napi::Promise::Deferred(Napi::Promise::Deferred::New(env));
+    Napi::Promise promise = deferred->Promise();
+    Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), "pollDevices", 0, 1);
+    
+    engine->poll(devices,
+        [deferred, tsfn](PollPipeline::Json json) mutable {
+            PollPipeline::Json* result = new PollPipeline::Json(std::move(json));
+            tsfn.NonBlockingCall(result, [deferred](Napi::Env env, Napi::Function, PollPipeline::Json* done) {
+                Napi::Object json_object = env.Global().Get("JSON").As<Napi::Object>();
+                Napi::Function parse = json_object.Get("parse").As<Napi::Function>();
+                deferred->Resolve(parse.Call(json_object, { Napi::String::New(env, done->data(), done->size()) }));
+                delete done;
+                delete deferred;
+            });
+            tsfn.Release();
+        });
+    
+    return promise;
+}
+
+static double optional_double(const Napi::Object& object, const char* key, double fallback) {
+    if (!object.Has(key) || !object.Get(key).IsNumber()) {
+        return fallback;
+    }
+    return object.Get(key).As<Napi::Number>().DoubleValue();
+}
+
+static bool parse_batch_op(const Napi::Value& value, BatchOp& op) {
+    if (!value.IsObject()) {
+        return false;
+    }
+    Napi::Object object = value.As<Napi::Object>();
+    if (!object.Get("op").IsString() || !object.Get("device").IsNumber()) {
+        return false;
+    }
+    
+    std::string kind = object.Get("op").As<Napi::String>().Utf8Value();
+    if (kind == "read") {
+        op.kind = OP_READ;
+    } else if (kind == "get") {
+        op.kind = OP_GET;
+    } else if (kind == "write") {
+        op.kind = OP_WRITE;
+    } else if (kind == "info") {
+        op.kind = OP_INFO;
+    } else {
+        return false;
+    }
+    
+    op.device_handle = object.Get("device").As<Napi::Number>().Uint32Value();
+    if (op.kind != OP_READ) {
+        if (!object.Get("channel").IsString()) {
+            return false;
+        }
+        op.channel = object.Get("channel").As<Napi::String>().Utf8Value();
+    }
+    if (op.kind == OP_WRITE) {
+        if (!object.Get("value").IsNumber()) {
+            return false;
+        }
+        op.value = object.Get("value").As<Napi::Number>().DoubleValue();
+    }
+    op.max_age = (DWORD)optional_int(object, "maxAge", 5);
+    return true;
+}
+
+Napi::Object InverterWrapper::batch_result(Napi::Env env, const BatchOp& op, const BatchResult& result) {
+    Napi::Object entry = Napi::Object::New(env);
+    entry.Set("success", Napi::Boolean::New(env, result.code == YE_OK));
+    entry.Set("code", Napi::Number::New(env, result.code));
+    if (result.code != YE_OK) {
+        entry.Set("error", Napi::String::New(env, error_message(result.code)));
+    }
+    
+    switch (op.kind) {
+        case OP_READ: {
+            Napi::Object data = Napi::Object::New(env);
+            for (const ChannelData& channel : result.data) {
+                Napi::Object channelObj = Napi::Object::New(env);
+                channelObj.Set("value", Napi::String::New(env, channel.value));
+                channelObj.Set("units", Napi::String::New(env, channel.units));
+                channelObj.Set("numericValue", Napi::Number::New(env, channel.numericValue));
+                channelObj.Set("receivedAt", Napi::Number::New(env, channel.receivedAt));
+                data.Set(channel.name, channelObj);
+            }
+            entry.Set("data", data);
+            break;
+        }
+        case OP_GET:
+            if (result.code == YE_OK) {
+                entry.Set("value", Napi::Number::New(env, result.value));
+                entry.Set("text", Napi::String::New(env, result.text));
+                entry.Set("units", Napi::String::New(env, result.units));
+            }
+            break;
+        case OP_WRITE:
+            if (result.code == YE_VALUE_NOT_VALID && result.has_range) {
+                Napi::Object range = Napi::Object::New(env);
+                range.Set("min", Napi::Number::New(env, result.min_value));
+                range.Set("max", Napi::Number::New(env, result.max_value));
+                entry.Set("validRange", range);
+            }
+            break;
+        case OP_INFO:
+            if (result.code == YE_OK) {
+                entry.Set("handle", Napi::Number::New(env, result.channel_handle));
+                entry.Set("name", Napi::String::New(env, op.channel));
+                entry.Set("minValue", Napi::Number::New(env, result.min_value));
+                entry.Set("maxValue", Napi::Number::New(env, result.max_value));
+                entry.Set("units", Napi::String::New(env, result.units));
+            }
+            break;
+    }
+    return entry;
+}
+
+// Execute a packed array of { op: "read" | "get" | "write" | "info", device,
+// channel, value, maxAge } in one native call on the work pool. Resolves
+// with one { success, code, ... } per operation, in the given order
+Napi::Value InverterWrapper::Exec(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Array of operations expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Array list = info[0].As<Napi::Array>();
+    std::vector<BatchOp> ops(list.Length());
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        if (!parse_batch_op(list.Get(i), ops[i])) {
+            Napi::TypeError::New(env, "Invalid operation at index " + std::to_string(i)).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    
+    auto batch = std::make_shared<std::vector<BatchOp>>(ops);
+    
+    Napi::Promise::Deferred* deferred = new Napi::Promise::Deferred(Napi::Promise::Deferred::New(env));
+    Napi::Promise promise = deferred->Promise();
+    Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), "exec", 0, 1);
+    
+    engine->exec(ops, [batch, deferred, tsfn](std::vector<BatchResult> done) mutable {
+        auto results = std::make_shared<std::vector<BatchResult>>(std::move(done));
+        tsfn.NonBlockingCall([batch, results, deferred](Napi::Env env, Napi::Function) {
+            Napi::Array list = Napi::Array::New(env, results->size());
+            for (size_t i = 0; i < results->size(); i++) {
+                list.Set((uint32_t)i, batch_result(env, (*batch)[i], (*results)[i]));
+            }
+            deferred->Resolve(list);
+            delete deferred;
+        });
+        tsfn.Release();
+    });
+    
+    return promise;
+}
+
+// Start the native closed-loop power controller.
+// Config: { meter, feedbackChannel, limitChannel, inverters: [{ device, capacity }],
+//           target, headroom, gain, ramp, deadband, refresh, period, readTimeout }
+Napi::Value InverterWrapper::StartPowerController(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Controller config object expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (!options.Get("meter").IsNumber() || !options.Get("feedbackChannel").IsString() ||
+        !options.Get("limitChannel").IsString() || !options.Get("inverters").IsArray()) {
+        Napi::TypeError::New(env, "Config needs meter, feedbackChannel, limitChannel and inverters").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    PowerControllerConfig config;
+    config.meter_device = options.Get("meter").As<Napi::Number>().Uint32Value();
+    config.feedback_channel = options.Get("feedbackChannel").As<Napi::String>().Utf8Value();
+    config.limit_channel = options.Get("limitChannel").As<Napi::String>().Utf8Value();
+    config.target = optional_double(options, "target", config.target);
+    config.headroom = optional_double(options, "headroom", config.headroom);
+    config.gain = optional_double(options, "gain", config.gain);
+    config.ramp = optional_double(options, "ramp", config.ramp);
+    config.deadband = optional_double(options, "deadband", config.deadband);
+    config.refresh = optional_double(options, "refresh", config.refresh);
+    config.period_ms = (DWORD)optional_double(options, "period", config.period_ms);
+    config.read_timeout = (DWORD)optional_double(options, "readTimeout", config.read_timeout);
+    
+    Napi::Array inverters = options.Get("inverters").As<Napi::Array>();
+    for (uint32_t i = 0; i < inverters.Length(); i++) {
+        Napi::Value entry = inverters.Get(i);
+        if (!entry.IsObject()) {
+            continue;
+        }
+        Napi::Object inverter = entry.As<Napi::Object>();
+        config.inverters.push_back({ (DWORD)optional_double(inverter, "device", 0), optional_double(inverter, "capacity", 0) });
+    }
+    
+    int code = engine->listening() || engine->standby() ? YE_NOT_SUPPORTED : engine->controller().start(config);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+    }
+    return result;
+}
+
+Napi::Value InverterWrapper::StopPowerController(const Napi::CallbackInfo& info) {
+    engine->controller().stop();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+Napi::Value InverterWrapper::GetPowerControllerMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    PowerControllerMetrics metrics = engine->controller().metrics();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("running", Napi::Boolean::New(env, metrics.running));
+    result.Set("cycles", Napi::Number::New(env, (double)metrics.cycles));
+    result.Set("readFailures", Napi::Number::New(env, (double)metrics.read_failures));
+    result.Set("writes", Napi::Number::New(env, (double)metrics.writes));
+    result.Set("suppressed", Napi::Number::New(env, (double)metrics.suppressed));
+    result.Set("feedback", Napi::Number::New(env, metrics.feedback));
+    result.Set("plantLimit", Napi::Number::New(env, metrics.plant_limit));
+    result.Set("readMs", Napi::Number::New(env, metrics.read_ms));
+    result.Set("maxReadMs", Napi::Number::New(env, metrics.max_read_ms));
+    result.Set("latencyMs", Napi::Number::New(env, metrics.latency_ms));
+    result.Set("avgLatencyMs", Napi::Number::New(env, metrics.avg_latency_ms));
+    result.Set("maxLatencyMs", Napi::Number::New(env, metrics.max_latency_ms));
+    return result;
+}
+
+// Keep channels of a device within a maximum age.
+// Config: { device, channels (names, default: all spot channels), maxAge (ms),
+//           degrade, readTimeout (s) }
+// Refused with YE_TOO_MANY_REQUESTS if the bus cannot refresh them that often,
+// with degrade the job runs at the shortest max age the bus can carry instead
+Napi::Value InverterWrapper::AddPollJob(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Poll job object expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (!options.Get("device").IsNumber() || !options.Get("maxAge").IsNumber()) {
+        Napi::TypeError::New(env, "Poll job needs device and maxAge").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    PollJobConfig config;
+    config.device_handle = options.Get("device").As<Napi::Number>().Uint32Value();
+    config.max_age = options.Get("maxAge").As<Napi::Number>().DoubleValue() / 1000;
+    config.degrade = options.Has("degrade") && options.Get("degrade").ToBoolean().Value();
+    config.read_timeout = (DWORD)optional_double(options, "readTimeout", config.read_timeout);
+    
+    int code = YE_OK;
+    if (options.Get("channels").IsArray()) {
+        Napi::Array channels = options.Get("channels").As<Napi::Array>();
+        for (uint32_t i = 0; i < channels.Length(); i++) {
+            DWORD handle = engine->find_channel(config.device_handle, channels.Get(i).ToString().Utf8Value());
+            if (handle == 0) {
+                code = YE_UNKNOWN_HANDLE;
+                break;
+            }
+            config.channels.push_back(handle);
+        }
+    } else {
+        DWORD channel_array[500];
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        int channel_count = GetChannelHandlesEx(config.device_handle, channel_array, 500, SPOTCHANNELS);
+        config.channels.assign(channel_array, channel_array + std::max(channel_count, 0));
+    }
+    
+    DWORD id = 0;
+    double granted = 0;
+    if (code == YE_OK) {
+        code = engine->subscribe(config, id, granted);
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code == YE_OK) {
+        result.Set("id", Napi::Number::New(env, id));
+        result.Set("maxAge", Napi::Number::New(env, granted * 1000));
+        result.Set("degraded", Napi::Boolean::New(env, granted > config.max_age));
+    } else {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+    }
+    return result;
+}
+
+Napi::Value InverterWrapper::RemovePollJob(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Poll job id expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    return Napi::Boolean::New(env, engine->unsubscribe(info[0].As<Napi::Number>().Uint32Value()));
+}
+
+// Freshness target attainment per poll job, times in ms
+Napi::Value InverterWrapper::GetPollJobs(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::vector<PollJobStats> stats = engine->subscriptions();
+    
+    Napi::Array jobs = Napi::Array::New(env, stats.size());
+    for (size_t i = 0; i < stats.size(); i++) {
+        const PollJobStats& job = stats[i];
+        unsigned long long judged = job.met + job.missed;
+        
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("id", Napi::Number::New(env, job.id));
+        entry.Set("device", Napi::Number::New(env, job.device_handle));
+        entry.Set("requestedMaxAge", Napi::Number::New(env, job.requested_age * 1000));
+        entry.Set("maxAge", Napi::Number::New(env, job.max_age * 1000));
+        entry.Set("degraded", Napi::Boolean::New(env, job.degraded));
+        entry.Set("requests", Napi::Number::New(env, (double)job.requests));
+        entry.Set("costMs", Napi::Number::New(env, job.cost * 1000));
+        entry.Set("refreshes", Napi::Number::New(env, (double)job.refreshes));
+        entry.Set("failures", Napi::Number::New(env, (double)job.failures));
+        entry.Set("met", Napi::Number::New(env, (double)job.met));
+        entry.Set("missed", Napi::Number::New(env, (double)job.missed));
+        entry.Set("attainment", judged > 0 ? Napi::Number::New(env, (double)job.met / judged) : env.Null());
+        entry.Set("age", job.age >= 0 ? Napi::Number::New(env, job.age * 1000) : env.Null());
+        entry.Set("worstAge", Napi::Number::New(env, job.worst_age * 1000));
+        jobs[i] = entry;
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("utilization", Napi::Number::New(env, engine->bus_utilization()));
+    result.Set("capacity", Napi::Number::New(env, engine->bus_capacity()));
+    result.Set("jobs", jobs);
+    return result;
+}
+
+static const char* const AGGREGATE_NAMES[] = { "sum", "avg", "min", "max", "count" };
+
+// Aggregate a channel across devices.
+// Query: { channel, aggregate: [sum | avg | min | max | count], devices, types,
+//          groups, groupBy (none | device | type | group), history, from, to, bucket (s) }
+// Returns { success, code, matched, rows, columns: { key, time, devices, <aggregate> } },
+// numeric columns as typed arrays
+Napi::Value InverterWrapper::Query(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Query object expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (!options.Get("channel").IsString() || !options.Get("aggregate").IsArray()) {
+        Napi::TypeError::New(env, "Query needs channel and aggregate").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    AggregateQuery query;
+    query.channel = options.Get("channel").As<Napi::String>().Utf8Value();
+    
+    Napi::Array aggregate = options.Get("aggregate").As<Napi::Array>();
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < aggregate.Length(); i++) {
+        std::string name = aggregate.Get(i).ToString().Utf8Value();
+        const char* const* known = std::find(std::begin(AGGREGATE_NAMES), std::end(AGGREGATE_NAMES), name);
+        if (known == std::end(AGGREGATE_NAMES)) {
+            Napi::TypeError::New(env, "Unknown aggregate: " + name).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        query.functions.push_back((AggregateFunction)(known - std::begin(AGGREGATE_NAMES)));
+        names.push_back(name);
+    }
+    
+    if (options.Get("devices").IsArray()) {
+        Napi::Array devices = options.Get("devices").As<Napi::Array>();
+        for (uint32_t i = 0; i < devices.Length(); i++) {
+            query.devices.push_back(devices.Get(i).ToNumber().Uint32Value());
+        }
+    }
+    if (options.Get("types").IsArray()) {
+        Napi::Array types = options.Get("types").As<Napi::Array>();
+        for (uint32_t i = 0; i < types.Length(); i++) {
+            query.types.push_back(types.Get(i).ToString().Utf8Value());
+        }
+    }
+    if (options.Get("groups").IsArray()) {
+        Napi::Array groups = options.Get("groups").As<Napi::Array>();
+        for (uint32_t i = 0; i < groups.Length(); i++) {
+            query.groups.push_back((WORD)groups.Get(i).ToNumber().Uint32Value());
+        }
+    }
+    
+    std::string group_by = options.Get("groupBy").IsString() ? options.Get("groupBy").As<Napi::String>().Utf8Value() : "none";
+    if (group_by == "device") {
+        query.group_by = GROUP_BY_DEVICE;
+    } else if (group_by == "type") {
+        query.group_by = GROUP_BY_TYPE;
+    } else if (group_by == "group") {
+        query.group_by = GROUP_BY_GROUP;
+    } else if (group_by != "none") {
+        Napi::TypeError::New(env, "groupBy must be none, device, type or group").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    query.history = options.Has("history") && options.Get("history").ToBoolean().Value();
+    query.from = (DWORD)optional_double(options, "from", query.from);
+    query.to = (DWORD)optional_double(options, "to", query.to);
+    query.bucket = (DWORD)optional_double(options, "bucket", query.bucket);
+    
+    AggregateResult rows;
+    int code = engine->query(query, rows);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("success", Napi::Boolean::New(env, code == YE_OK));
+    result.Set("code", Napi::Number::New(env, code));
+    if (code != YE_OK) {
+        result.Set("error", Napi::String::New(env, error_message(code)));
+        return result;
+    }
+    
+    size_t count = rows.keys.size();
+    Napi::Array keys = Napi::Array::New(env, count);
+    Napi::Uint32Array times = Napi::Uint32Array::New(env, count);
+    Napi::Uint32Array devices = Napi::Uint32Array::New(env, count);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = Napi::String::New(env, rows.keys[i]);
+        times[i] = rows.times[i];
+        devices[i] = rows.devices[i];
+    }
+    
+    Napi::Object columns = Napi::Object::New(env);
+    columns.Set("key", keys);
+    columns.Set("time", times);
+    columns.Set("devices", devices);
+    for (size_t f = 0; f < names.size(); f++) {
+        Napi::Float64Array column = Napi::Float64Array::New(env, count);
+        std::copy(rows.columns[f].begin(), rows.columns[f].end(), column.Data());
+        columns.Set(names[f], column);
+    }
+    
+    result.Set("matched", Napi::Number::New(env, (double)rows.matched));
+    result.Set("rows", Napi::Number::New(env, (double)count));
+    result.Set("columns", columns);
+    return result;
+}
+
+// Compare power channels of devices with their peers.
+// Config: { channels (names), devices: [{ device, capacity (W per input), group }],
+//           window, threshold, minRatio, minPeers }
+// Returns the number of inputs compared
+Napi::Value InverterWrapper::SetPeerAnalytics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (!engine->initialized()) {
+        Napi::Error::New(env, "YASDI not initialized. Call initialize() first").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Peer analytics config expected as argument").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    if (!options.Get("channels").IsArray() || !options.Get("devices").IsArray()) {
+        Napi::TypeError::New(env, "Peer analytics needs channels and devices").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    std::vector<std::string> channels;
+    Napi::Array channel_list = options.Get("channels").As<Napi::Array>();
+    for (uint32_t i = 0; i < channel_list.Length(); i++) {
+        channels.push_back(channel_list.Get(i).ToString().Utf8Value());
+    }
+    
+    std::vector<PeerDevice> devices;
+    Napi::Array device_list = options.Get("devices").As<Napi::Array>();
+    for (uint32_t i = 0; i < device_list.Length(); i++) {
+        if (!device_list.Get(i).IsObject()) {
+            Napi::TypeError::New(env, "Invalid device at index " + std::to_string(i)).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        Napi::Object device = device_list.Get(i).As<Napi::Object>();
+        if (!device.Get("device").IsNumber() || !device.Get("capacity").IsNumber()) {
+            Napi::TypeError::New(env, "Invalid device at index " + std::to_string(i)).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        PeerDevice peer;
+        peer.device_handle = device.Get("device").As<Napi::Number>().Uint32Value();
+        peer.capacity = device.Get("capacity").As<Napi::Number>().DoubleValue();
+        if (device.Get("group").IsString() || device.Get("group").IsNumber()) {
+            peer.group = device.Get("group").ToString().Utf8Value();
+        }
+        devices.push_back(peer);
+    }
+    
+    PeerConfig config;
+    config.window = (size_t)std::max(1, optional_int(options, "window", (int)config.window));
+    config.threshold = optional_double(options, "threshold", config.threshold);
+    config.min_ratio = optional_double(options, "minRatio", config.min_ratio);
+    config.min_peers = (size_t)std::max(1, optional_int(options, "minPeers", (int)config.min_peers));
+    
+    return Napi::Number::New(env, (double)engine->configure_peers(devices, channels, config));
+}
+
+// One peer comparison over the cached values; returns only the inputs
+// flagged as underperforming: [{ device, channel, group, ratio, peerRatio, z, score }]
+Napi::Value InverterWrapper::AnalyzePeers(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    std::vector<PeerDeviation> flagged;
+    engine->analyze_peers(flagged);
+    
+    Napi::Array list = Napi::Array::New(env, flagged.size());
+    for (size_t i = 0; i < flagged.size(); i++) {
+        const PeerDeviation& deviation = flagged[i];
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("device", Napi::Number::New(env, deviation.device_handle));
+        entry.Set("channel", Napi::String::New(env, deviation.channel));
+        entry.Set("group", Napi::String::New(env, deviation.group));
+        entry.Set("ratio", Napi::Number::New(env, deviation.ratio));
+        entry.Set("peerRatio", Napi::Number::New(env, deviation.peer_ratio));
+        entry.Set("z", Napi::Number::New(env, deviation.z));
+        entry.Set("score", Napi::Number::New(env, deviation.score));
+        list[i] = entry;
+    }
+    return list;
+}
+
+// Memory per subsystem, request scheduler state and received frames per
+// transport protocol with the lock-in state; optional argument
+// { resetPeaks: true } restarts the high-water marks after reading them
+Napi::Value InverterWrapper::GetMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    Napi::Object memory = Napi::Object::New(env);
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+        MemTagStats stats = MemStats::get((MemTag)i);
+        Napi::Object tag = Napi::Object::New(env);
+        tag.Set("current", Napi::Number::New(env, (double)stats.current));
+        tag.Set("peak", Napi::Number::New(env, (double)stats.peak));
+        tag.Set("allocations", Napi::Number::New(env, (double)stats.allocations));
+        memory.Set(MemStats::name((MemTag)i), tag);
+    }
+    
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object options = info[0].As<Napi::Object>();
+        if (options.Has("resetPeaks") && options.Get("resetPeaks").ToBoolean().Value()) {
+            MemStats::reset_peaks();
+        }
+    }
+    
+    Napi::Object scheduler = Napi::Object::New(env);
+    scheduler.Set("queued", Napi::Number::New(env, (double)SMADataScheduler::instance().queued()));
+    scheduler.Set("inFlight", Napi::Number::New(env, (double)SMADataScheduler::instance().in_flight()));
+    
+    ProtocolSummary summary = engine->protocols().summary();
+    Napi::Object protocol = Napi::Object::New(env);
+    protocol.Set("smanet", Napi::Number::New(env, (double)summary.total.smanet));
+    protocol.Set("sunnynet", Napi::Number::New(env, (double)summary.total.sunnynet));
+    protocol.Set("mismatches", Napi::Number::New(env, (double)summary.mismatches));
+    if (summary.locked == TS_PROT_SMANET_ONLY) {
+        protocol.Set("locked", Napi::String::New(env, "SMANet"));
+    } else if (summary.locked == TS_PROT_SUNNYNET_ONLY) {
+        protocol.Set("locked", Napi::String::New(env, "SunnyNet"));
+    } else {
+        protocol.Set("locked", env.Null());
+    }
+    Napi::Object sources = Napi::Object::New(env);
+    for (const auto& source : summary.sources) {
+        Napi::Object counts = Napi::Object::New(env);
+        counts.Set("smanet", Napi::Number::New(env, (double)source.second.smanet));
+        counts.Set("sunnynet", Napi::Number::New(env, (double)source.second.sunnynet));
+        sources.Set(std::to_string(source.first), counts);
+    }
+    protocol.Set("sources", sources);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("memory", memory);
+    result.Set("scheduler", scheduler);
+    result.Set("protocols", protocol);
+    return result;
+}
+
+// Shut down on a background thread: queued bus requests are cancelled,
+// requests on the bus end within their timeout, then the drivers close.
+// Resolves with true once YASDI is down.
+Napi::Value InverterWrapper::Shutdown(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    Napi::Promise::Deferred* deferred = new Napi::Promise::Deferred(Napi::Promise::Deferred::New(env));
+    Napi::Promise promise = deferred->Promise();
+    Napi::ThreadSafeFunction tsfn = Napi::ThreadSafeFunction::New(
+        env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), "shutdown", 0, 1);
+    
+    engine->shutdown_async([deferred, tsfn]() mutable {
+        tsfn.NonBlockingCall([deferred](Napi::Env env, Napi::Function) {
+            deferred->Resolve(Napi::Boolean::New(env, true));
+            delete deferred;
+        });
+        tsfn.Release();
+    });
+    
+    return promise;
 }
 
 // Initialize the native addon
@@ -0,0 +1,171 @@
+#include "live_table.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Int32Array elements of the header, see live_table.js
+enum {
+    HDR_MAGIC = 0,
+    HDR_VERSION = 1,
+    HDR_GENERATION = LiveTable::GENERATION_FIELD,
+    HDR_CAPACITY = 3,
+    HDR_ROWS_USED = 4,
+    HDR_COLUMNS = 5
+};
+
+// JS reads these fields with Atomics; a lock-free std::atomic<int32_t> has
+// the same representation as the plain int32 in the buffer
+static std::atomic<int32_t>* atomic_at(void* address) {
+    static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "atomic int32 must be plain int32");
+    return reinterpret_cast<std::atomic<int32_t>*>(address);
+}
+
+size_t LiveTable::required_size(size_t capacity, size_t columns) {
+    return HEADER_SIZE + capacity * (ROW_HEADER_SIZE + 8 * columns);
+}
+
+bool LiveTable::attach(void* target, size_t size, size_t rows_capacity, const std::vector<std::string>& columns) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (target == nullptr || reinterpret_cast<uintptr_t>(target) % 8 != 0 ||
+        size < required_size(rows_capacity, columns.size())) {
+        return false;
+    }
+
+    memory = static_cast<uint8_t*>(target);
+    capacity = rows_capacity;
+    row_size = ROW_HEADER_SIZE + 8 * columns.size();
+    column_index.clear();
+    rows.clear();
+    for (size_t i = 0; i < columns.size(); i++) {
+        column_index[columns[i]] = i;
+    }
+
+    std::memset(memory, 0, required_size(capacity, columns.size()));
+    int32_t* hdr = header();
+    hdr[HDR_VERSION] = VERSION;
+    hdr[HDR_CAPACITY] = (int32_t)capacity;
+    hdr[HDR_COLUMNS] = (int32_t)columns.size();
+    atomic_at(&hdr[HDR_MAGIC])->store(MAGIC, std::memory_order_release);
+    return true;
+}
+
+void LiveTable::detach() {
+    std::lock_guard<std::mutex> lock(mutex);
+    memory = nullptr;
+    rows.clear();
+    publish_handler.reset();
+}
+
+bool LiveTable::attached() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory != nullptr;
+}
+
+uint8_t* LiveTable::row(size_t index) const {
+    return memory + HEADER_SIZE + index * row_size;
+}
+
+LiveTable::Row* LiveTable::row_of(uint32_t device_handle) {
+    auto it = rows.find(device_handle);
+    if (it != rows.end()) {
+        return &it->second;
+    }
+    if (rows.size() >= capacity) {
+        return nullptr;
+    }
+
+    Row& added = rows[device_handle];
+    added = { rows.size() - 1, 0 };
+    atomic_at(&header()[HDR_ROWS_USED])->store((int32_t)rows.size(), std::memory_order_release);
+    return &added;
+}
+
+static const char* entry_name(const ChannelData& entry) { return entry.name; }
+static double entry_value(const ChannelData& entry) { return entry.numericValue; }
+static const char* entry_name(const LiveTable::Value& entry) { return entry.name; }
+static double entry_value(const LiveTable::Value& entry) { return entry.value; }
+
+template <typename Entry>
+bool LiveTable::write_row(uint32_t device_handle, unsigned long long version, uint32_t time,
+                          const Entry* entries, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (memory == nullptr) {
+        return false;
+    }
+
+    Row* state = row_of(device_handle);
+    // Nothing changed since the row was written, or a store that raced
+    // with a newer one arrives late
+    if (state == nullptr || (version != 0 && version <= state->version)) {
+        return false;
+    }
+    state->version = version;
+
+    uint8_t* target = row(state->index);
+    int32_t* fields = reinterpret_cast<int32_t*>(target);
+    double* slots = reinterpret_cast<double*>(target + ROW_HEADER_SIZE);
+    std::atomic<int32_t>* seq = atomic_at(&fields[0]);
+
+    // Odd sequence: row is being written
+    int32_t start = seq->load(std::memory_order_relaxed);
+    seq->store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int32_t valid = 0;
+    for (size_t i = 0; i < column_index.size(); i++) {
+        slots[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    for (size_t i = 0; i < count; i++) {
+        auto column = column_index.find(entry_name(entries[i]));
+        if (column != column_index.end()) {
+            slots[column->second] = entry_value(entries[i]);
+            valid++;
+        }
+    }
+    fields[1] = (int32_t)device_handle;
+    fields[2] = (int32_t)time;
+    fields[3] = valid;
+
+    seq->store(start + 2, std::memory_order_release);
+    return true;
+}
+
+bool LiveTable::update(uint32_t device_handle, unsigned long long version, uint32_t time,
+                       const ChannelData* channels, size_t count) {
+    return write_row(device_handle, version, time, channels, count);
+}
+
+bool LiveTable::update(uint32_t device_handle, unsigned long long version, uint32_t time,
+                       const Value* values, size_t count) {
+    return write_row(device_handle, version, time, values, count);
+}
+
+int32_t LiveTable::publish() {
+    int32_t generation;
+    std::shared_ptr<const std::function<void(int32_t)>> handler;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (memory == nullptr) {
+            return 0;
+        }
+        generation = atomic_at(&header()[HDR_GENERATION])->fetch_add(1, std::memory_order_acq_rel) + 1;
+        handler = publish_handler;
+    }
+
+    if (handler) {
+        (*handler)(generation);
+    }
+    return generation;
+}
+
+void LiveTable::set_publish_handler(std::function<void(int32_t generation)> handler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handler) {
+        publish_handler = std::make_shared<const std::function<void(int32_t)>>(std::move(handler));
+    } else {
+        publish_handler.reset();
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef LIVE_TABLE_H
+#define LIVE_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "channel_data.h"
+
+// Latest values of all devices in memory shared with JS worker threads
+// (a SharedArrayBuffer owned by JS). The layout must match src/live_table.js.
+//
+// All fields are little endian, offsets in bytes:
+//   header (32):  magic[4] version[4] generation[4] capacity[4]
+//                 rows_used[4] columns[4] reserved[8]
+//   row (16 + 8 * columns):
+//                 seq[4] device_handle[4] time[4] valid[4] value[8] * columns
+//
+// A row is written under a seqlock: seq is odd while the row is being
+// written and even once it is coherent. Readers retry while seq is odd or
+// changed during their read. The generation counter is bumped after every
+// store that changed a row; the publish handler wakes workers waiting on it.
+// Columns without a value in the last written store are NaN.
+class LiveTable {
+public:
+    static const int32_t MAGIC = 0x4c414d53;    // "SMAL"
+    static const int32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 32;
+    static const size_t ROW_HEADER_SIZE = 16;
+    static const size_t GENERATION_FIELD = 2;   // Int32Array element of the generation
+
+    static size_t required_size(size_t capacity, size_t columns);
+
+    // Use the given memory with a fixed set of columns (channel names).
+    // Returns false if the memory is too small or misaligned.
+    bool attach(void* memory, size_t size, size_t capacity, const std::vector<std::string>& columns);
+    void detach();
+    bool attached() const;
+
+    // A channel value by name, for stores without ChannelData
+    struct Value {
+        const char* name;
+        double value;
+    };
+
+    // Write the latest values of a device into its row; channels without
+    // a column are skipped. version is the device's value cache version: a
+    // row that holds it or a newer one already is left alone, 0 always
+    // writes. Returns whether the row was written. Allocates only for the
+    // first row of a device.
+    bool update(uint32_t device_handle, unsigned long long version, uint32_t time,
+                const ChannelData* channels, size_t count);
+    bool update(uint32_t device_handle, unsigned long long version, uint32_t time,
+                const Value* values, size_t count);
+
+    // Start a new generation and hand it to the publish handler, returns
+    // its number
+    int32_t publish();
+
+    // Called by the publishing thread, without the table locked
+    void set_publish_handler(std::function<void(int32_t generation)> handler);
+
+private:
+    int32_t* header() const { return reinterpret_cast<int32_t*>(memory); }
+    struct Row {
+        size_t index;
+        unsigned long long version;    // of the values in the row, 0: written unversioned
+    };
+
+    uint8_t* row(size_t index) const;
+    Row* row_of(uint32_t device_handle);
+    template <typename Entry>
+    bool write_row(uint32_t device_handle, unsigned long long version, uint32_t time,
+                   const Entry* entries, size_t count);
+
+    mutable std::mutex mutex;
+    uint8_t* memory = nullptr;
+    size_t capacity = 0;
+    size_t row_size = 0;
+    std::map<std::string, size_t, std::less<>> column_index;   // found by char* without a copy
+    std::map<uint32_t, Row> rows;
+    // Copied by publish without an allocation
+    std::shared_ptr<const std::function<void(int32_t)>> publish_handler;
+};
+
+#endif
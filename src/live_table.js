@@ -0,0 +1,143 @@
+// Layout of the shared live value table, must match src/live_table.h
+const MAGIC = 0x4c414d53; // "SMAL"
+const VERSION = 1;
+const HEADER_SIZE = 32;
+const ROW_HEADER_SIZE = 16;
+
+// Int32Array indexes of the header fields
+const HDR_MAGIC = 0;
+const HDR_VERSION = 1;
+const HDR_GENERATION = 2;
+const HDR_CAPACITY = 3;
+const HDR_ROWS_USED = 4;
+const HDR_COLUMNS = 5;
+
+/**
+ * Size in bytes of a table with the given number of rows and columns
+ * @param {number} capacity Maximum number of devices
+ * @param {number} columns Number of channels per device
+ * @returns {number} Size in bytes
+ */
+function liveTableSize(capacity, columns) {
+  return HEADER_SIZE + capacity * (ROW_HEADER_SIZE + 8 * columns);
+}
+
+/**
+ * Read-only view of a live value table, usable in any worker thread.
+ * Pass it the descriptor returned by SMInverter.createLiveTable().
+ */
+class LiveTableReader {
+  /**
+   * @param {Object} descriptor Table descriptor
+   * @param {SharedArrayBuffer} descriptor.buffer Shared memory of the table
+   * @param {string[]} descriptor.channels Channel name of each column
+   */
+  constructor(descriptor) {
+    this.buffer = descriptor.buffer;
+    this.channels = descriptor.channels;
+    this.header = new Int32Array(this.buffer, 0, HEADER_SIZE / 4);
+
+    if (Atomics.load(this.header, HDR_MAGIC) !== MAGIC || this.header[HDR_VERSION] !== VERSION) {
+      throw new Error("Buffer does not hold a live value table");
+    }
+
+    this.capacity = this.header[HDR_CAPACITY];
+    this.rowSize = ROW_HEADER_SIZE + 8 * this.channels.length;
+    this.rowFields = [];
+    this.rowValues = [];
+    for (let i = 0; i < this.capacity; i++) {
+      const offset = HEADER_SIZE + i * this.rowSize;
+      this.rowFields.push(new Int32Array(this.buffer, offset, ROW_HEADER_SIZE / 4));
+      this.rowValues.push(new Float64Array(this.buffer, offset + ROW_HEADER_SIZE, this.channels.length));
+    }
+  }
+
+  /**
+   * Current generation, increases whenever a device's values changed
+   * @returns {number} Generation counter
+   */
+  generation() {
+    return Atomics.load(this.header, HDR_GENERATION);
+  }
+
+  /**
+   * Block until the table changed (worker threads only)
+   * @param {number} generation Last generation seen
+   * @param {number} [timeout] Milliseconds to wait
+   * @returns {number} The new generation
+   */
+  waitForUpdate(generation, timeout = Infinity) {
+    Atomics.wait(this.header, HDR_GENERATION, generation, timeout);
+    return this.generation();
+  }
+
+  /**
+   * Coherent copy of one row
+   * @param {number} index Row index
+   * @returns {Object|null} { device, time, values } or null if the row is unused
+   */
+  readRow(index) {
+    const fields = this.rowFields[index];
+    const slots = this.rowValues[index];
+
+    for (;;) {
+      const seq = Atomics.load(fields, 0);
+      if (seq === 0) {
+        return null;
+      }
+      if (seq & 1) {
+        continue;
+      }
+
+      const device = fields[1] >>> 0;
+      const time = fields[2] >>> 0;
+      const values = {};
+      for (let i = 0; i < this.channels.length; i++) {
+        if (!Number.isNaN(slots[i])) {
+          values[this.channels[i]] = slots[i];
+        }
+      }
+
+      if (Atomics.load(fields, 0) === seq) {
+        return { device, time, values };
+      }
+    }
+  }
+
+  /**
+   * Latest values of one device
+   * @param {number} deviceHandle Device handle
+   * @returns {Object|null} { device, time, values } or null if unknown
+   */
+  read(deviceHandle) {
+    const used = Atomics.load(this.header, HDR_ROWS_USED);
+    for (let i = 0; i < used; i++) {
+      if (this.rowFields[i][1] >>> 0 === deviceHandle) {
+        return this.readRow(i);
+      }
+    }
+    return null;
+  }
+
+  /**
+   * Latest values of all devices
+   * @returns {Object[]} One { device, time, values } per device
+   */
+  readAll() {
+    const rows = [];
+    const used = Atomics.load(this.header, HDR_ROWS_USED);
+    for (let i = 0; i < used; i++) {
+      const row = this.readRow(i);
+      if (row) {
+        rows.push(row);
+      }
+    }
+    return rows;
+  }
+}
+
+module.exports = {
+  HDR_GENERATION,
+  liveTableSize,
+  LiveTableReader,
+};
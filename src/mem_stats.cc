@@ -0,0 +1,30 @@
+#include "mem_stats.h"
+
+MemStats::Counters MemStats::tags[MEM_TAG_COUNT];
+
+MemTagStats MemStats::get(MemTag tag) {
+    const Counters& counters = tags[tag];
+    MemTagStats stats;
+    stats.current = counters.current.load(std::memory_order_relaxed);
+    stats.peak = counters.peak.load(std::memory_order_relaxed);
+    stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+const char* MemStats::name(MemTag tag) {
+    switch (tag) {
+        case MEM_PACKETS:  return "packets";
+        case MEM_REQUESTS: return "requests";
+        case MEM_CHANNELS: return "channels";
+        case MEM_HISTORY:  return "history";
+        case MEM_CACHES:   return "caches";
+        case MEM_MARSHAL:  return "marshal";
+        default:           return "unknown";
+    }
+}
+
+void MemStats::reset_peaks() {
+    for (Counters& counters : tags) {
+        counters.peak.store(counters.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
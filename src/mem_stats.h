@@ -0,0 +1,92 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+// Subsystems whose heap usage is accounted
+enum MemTag {
+    MEM_PACKETS = 0,    // received SMAData frames and copies for listeners
+    MEM_REQUESTS,       // payloads of queued SMAData requests
+    MEM_CHANNELS,       // device and channel lists of the registry
+    MEM_HISTORY,        // stored channel history
+    MEM_CACHES,         // value cache slots
+    MEM_MARSHAL,        // JSON built for JavaScript
+    MEM_TAG_COUNT
+};
+
+struct MemTagStats {
+    size_t current;     // bytes allocated now
+    size_t peak;        // high-water mark of current
+    size_t allocations; // number of allocations so far
+};
+
+// Per-tag allocation counters, cheap enough for release builds: an
+// allocation costs two relaxed atomic adds, the peak is only written when
+// it grows.
+class MemStats {
+public:
+    static void allocated(MemTag tag, size_t bytes) {
+        Counters& counters = tags[tag];
+        size_t current = counters.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+
+        size_t peak = counters.peak.load(std::memory_order_relaxed);
+        while (current > peak && !counters.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+    }
+
+    static void released(MemTag tag, size_t bytes) {
+        tags[tag].current.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    static MemTagStats get(MemTag tag);
+    static const char* name(MemTag tag);
+
+    // Restart the high-water marks at the current usage
+    static void reset_peaks();
+
+private:
+    struct Counters {
+        std::atomic<size_t> current{0};
+        std::atomic<size_t> peak{0};
+        std::atomic<size_t> allocations{0};
+    };
+
+    static Counters tags[MEM_TAG_COUNT];
+};
+
+// Standard allocator that accounts its memory to a tag, e.g.
+//   std::vector<BYTE, TaggedAllocator<BYTE, MEM_PACKETS>>
+template <class T, MemTag Tag>
+struct TaggedAllocator {
+    typedef T value_type;
+
+    template <class U>
+    struct rebind {
+        typedef TaggedAllocator<U, Tag> other;
+    };
+
+    TaggedAllocator() noexcept {}
+    template <class U>
+    TaggedAllocator(const TaggedAllocator<U, Tag>&) noexcept {}
+
+    T* allocate(size_t count) {
+        T* memory = static_cast<T*>(::operator new(count * sizeof(T)));
+        MemStats::allocated(Tag, count * sizeof(T));
+        return memory;
+    }
+
+    void deallocate(T* memory, size_t count) noexcept {
+        MemStats::released(Tag, count * sizeof(T));
+        ::operator delete(memory);
+    }
+};
+
+template <class T, class U, MemTag Tag>
+bool operator==(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return true; }
+template <class T, class U, MemTag Tag>
+bool operator!=(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return false; }
+
+#endif
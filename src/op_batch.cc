@@ -0,0 +1,109 @@
+#include "op_batch.h"
+#include "channel_values.h"
+#include "plant_lock.h"
+
+#include <map>
+
+OpBatch::OpBatch(std::vector<BatchOp> batch_ops)
+    : ops(std::move(batch_ops)) {
+    std::vector<DWORD> devices;
+    std::map<DWORD, std::vector<size_t>> info;
+    std::map<DWORD, std::vector<size_t>> bus;
+
+    for (size_t i = 0; i < ops.size(); i++) {
+        DWORD device_handle = ops[i].device_handle;
+        if (info.find(device_handle) == info.end() && bus.find(device_handle) == bus.end()) {
+            devices.push_back(device_handle);
+        }
+        if (ops[i].kind == OP_INFO) {
+            info[device_handle].push_back(i);
+        } else {
+            bus[device_handle].push_back(i);
+        }
+    }
+
+    schedule.reserve(ops.size());
+    for (DWORD device_handle : devices) {
+        const std::vector<size_t>& first = info[device_handle];
+        const std::vector<size_t>& then = bus[device_handle];
+        schedule.insert(schedule.end(), first.begin(), first.end());
+        schedule.insert(schedule.end(), then.begin(), then.end());
+    }
+}
+
+std::vector<BatchResult> OpBatch::run(const Backend& backend) const {
+    std::vector<BatchResult> results(ops.size());
+    std::map<std::pair<DWORD, std::string>, DWORD> channels;
+
+    for (size_t index : schedule) {
+        const BatchOp& op = ops[index];
+
+        DWORD channel_handle = 0;
+        if (op.kind != OP_READ) {
+            auto key = std::make_pair(op.device_handle, op.channel);
+            auto it = channels.find(key);
+            if (it == channels.end()) {
+                it = channels.emplace(key, backend.find_channel(op.device_handle, op.channel)).first;
+            }
+            channel_handle = it->second;
+            if (channel_handle == 0) {
+                results[index].code = YE_UNKNOWN_HANDLE;
+                continue;
+            }
+        }
+
+        execute(op, channel_handle, backend, results[index]);
+    }
+
+    return results;
+}
+
+void OpBatch::execute(const BatchOp& op, DWORD channel_handle, const Backend& backend, BatchResult& result) const {
+    char text[64];
+
+    result.channel_handle = channel_handle;
+    switch (op.kind) {
+        case OP_READ:
+            result.code = backend.read_device(op.device_handle, backend.listen_only ? ANY_VALUE_AGE : op.max_age,
+                                              result.data);
+            break;
+
+        case OP_GET: {
+            // GetChannelValue, without holding the plant while waiting for the bus
+            std::lock_guard<std::mutex> plant(plant_mutex());
+            read_channel_values(op.device_handle, &channel_handle, 1, backend.listen_only ? ANY_VALUE_AGE : op.max_age,
+                                &result.value, NULL, &result.code, text, sizeof(text));
+            result.text = text;
+            if (GetChannelUnit(channel_handle, text, sizeof(text) - 1) == YE_OK) {
+                result.units = text;
+            }
+            break;
+        }
+
+        case OP_WRITE: {
+            if (backend.listen_only) {
+                result.code = YE_NOT_SUPPORTED;
+                break;
+            }
+            std::lock_guard<std::mutex> plant(plant_mutex());
+            result.has_range = GetChannelValRange(channel_handle, &result.min_value, &result.max_value) == YE_OK;
+            if (result.has_range && (op.value < result.min_value || op.value > result.max_value)) {
+                result.code = YE_VALUE_NOT_VALID;
+                break;
+            }
+            result.value = op.value;
+            result.code = SetChannelValue(channel_handle, op.device_handle, op.value);
+            break;
+        }
+
+        case OP_INFO: {
+            std::lock_guard<std::mutex> plant(plant_mutex());
+            result.code = GetChannelValRange(channel_handle, &result.min_value, &result.max_value);
+            result.has_range = result.code == YE_OK;
+            if (GetChannelUnit(channel_handle, text, sizeof(text) - 1) == YE_OK) {
+                result.units = text;
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef OP_BATCH_H
+#define OP_BATCH_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "channel_data.h"
+#include "yasdi_headers.h"
+
+enum BatchOpKind {
+    OP_READ,    // all spot channels of a device, as getDeviceData
+    OP_GET,     // one channel value
+    OP_WRITE,   // one channel value, range checked as setChannelValue
+    OP_INFO     // channel handle, range and unit, no bus traffic
+};
+
+struct BatchOp {
+    BatchOpKind kind;
+    DWORD device_handle;
+    std::string channel;
+    double value = 0;
+    DWORD max_age = 5;
+};
+
+struct BatchResult {
+    int code = YE_OK;
+    DWORD channel_handle = 0;
+    double value = 0;
+    std::string text;
+    std::string units;
+    double min_value = 0;
+    double max_value = 0;
+    bool has_range = false;
+    std::vector<ChannelData> data;      // OP_READ
+};
+
+// A packed list of operations executed in one native call.
+// Channel names are resolved once per device and channel. Operations are
+// grouped by device, in the order devices first appear, so a device's
+// values fetched by one read serve the following reads from YASDI's cache.
+// Within a device info operations run first (they need no bus); reads and
+// writes keep their order, so a read after a write sees the written value.
+class OpBatch {
+public:
+    struct Backend {
+        // Result code as DeviceReader::read
+        std::function<int(DWORD device_handle, DWORD max_age, std::vector<ChannelData>& channels)> read_device;
+        std::function<DWORD(DWORD device_handle, const std::string& channel)> find_channel;
+        bool listen_only = false;   // values as last heard, no writes
+    };
+
+    explicit OpBatch(std::vector<BatchOp> ops);
+
+    const BatchOp& op(size_t index) const { return ops[index]; }
+    size_t size() const { return ops.size(); }
+
+    // Indexes into the operations in execution order
+    const std::vector<size_t>& order() const { return schedule; }
+
+    // Results in the order the operations were given
+    std::vector<BatchResult> run(const Backend& backend) const;
+
+private:
+    void execute(const BatchOp& op, DWORD channel_handle, const Backend& backend, BatchResult& result) const;
+
+    std::vector<BatchOp> ops;
+    std::vector<size_t> schedule;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "packet_listeners.h"
+
+#include <algorithm>
+#include <mutex>
+
+PacketListeners& PacketListeners::instance() {
+    static PacketListeners listeners;
+    return listeners;
+}
+
+void PacketListeners::attach() {
+    // YASDI keeps the pointer, the listener lives as long as the process
+    static TPacketRcvListener listener = { &PacketListeners::on_packet };
+    yasdiAddPaketListener(&listener);
+}
+
+DWORD PacketListeners::add(const PacketFilter& filter, PacketHandler handler) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    int bucket = (filter.cmd >= 0 && filter.cmd < ANY_CMD) ? filter.cmd : ANY_CMD;
+    DWORD id = next_id++;
+
+    Entry entry;
+    entry.id = id;
+    entry.filter = filter;
+    entry.handler = std::make_shared<PacketHandler>(std::move(handler));
+    buckets[bucket].push_back(std::move(entry));
+    bucket_of[id] = bucket;
+    return id;
+}
+
+bool PacketListeners::remove(DWORD id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    auto it = bucket_of.find(id);
+    if (it == bucket_of.end()) {
+        return false;
+    }
+
+    std::vector<Entry>& bucket = buckets[it->second];
+    bucket.erase(std::remove_if(bucket.begin(), bucket.end(),
+                                [id](const Entry& entry) { return entry.id == id; }),
+                 bucket.end());
+    bucket_of.erase(it);
+    return true;
+}
+
+size_t PacketListeners::count() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return bucket_of.size();
+}
+
+void PacketListeners::on_packet(TSMAData* packet, BYTE* data, DWORD size) {
+    instance().dispatch(packet, data, size);
+}
+
+void PacketListeners::dispatch(const TSMAData* packet, const BYTE* data, DWORD size) {
+    // Collect the matching handlers first, so a handler may add or remove
+    // listeners without deadlocking
+    std::vector<std::shared_ptr<PacketHandler>> matched;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        for (const std::vector<Entry>* bucket : { &buckets[packet->Cmd], &buckets[ANY_CMD] }) {
+            for (const Entry& entry : *bucket) {
+                if (entry.filter.source >= 0 && entry.filter.source != packet->SourceAddr) {
+                    continue;
+                }
+                if (entry.filter.dest >= 0 && entry.filter.dest != packet->DestAddr) {
+                    continue;
+                }
+                matched.push_back(entry.handler);
+            }
+        }
+    }
+
+    for (const auto& handler : matched) {
+        (*handler)(packet, data, size);
+    }
+}
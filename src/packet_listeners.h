@@ -0,0 +1,56 @@
+#ifndef PACKET_LISTENERS_H
+#define PACKET_LISTENERS_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+#include "yasdi_headers.h"
+
+// Filter for received SMAData packets, -1 matches any value
+struct PacketFilter {
+    int cmd = -1;
+    int source = -1;
+    int dest = -1;
+};
+
+typedef std::function<void(const TSMAData* packet, const BYTE* data, DWORD size)> PacketHandler;
+
+// Fan-out of YASDI's packet listener interface.
+// YASDI only supports adding listeners, so a single listener is registered
+// per YASDI instance and dispatches to the handlers whose filter matches.
+// Handlers are indexed by command, a packet only visits its own bucket and
+// the wildcard bucket. Handlers run on the YASDI thread and must not block.
+class PacketListeners {
+public:
+    static PacketListeners& instance();
+
+    // Register the dispatcher with YASDI, needed after every yasdiMasterInitialize
+    void attach();
+
+    DWORD add(const PacketFilter& filter, PacketHandler handler);
+    bool remove(DWORD id);
+    size_t count() const;
+
+private:
+    struct Entry {
+        DWORD id;
+        PacketFilter filter;
+        std::shared_ptr<PacketHandler> handler;
+    };
+
+    static void on_packet(TSMAData* packet, BYTE* data, DWORD size);
+    void dispatch(const TSMAData* packet, const BYTE* data, DWORD size);
+
+    // Index 256 holds listeners for any command
+    static const int ANY_CMD = 256;
+
+    mutable std::shared_mutex mutex;
+    std::vector<Entry> buckets[ANY_CMD + 1];
+    std::map<DWORD, int> bucket_of;
+    DWORD next_id = 1;
+};
+
+#endif
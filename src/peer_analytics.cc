@@ -0,0 +1,118 @@
+#include "peer_analytics.h"
+
+#include <algorithm>
+#include <cmath>
+
+void PeerAnalytics::configure(const std::vector<PeerInput>& configured, const PeerConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    settings = config;
+    inputs = configured;
+    std::stable_sort(inputs.begin(), inputs.end(), [](const PeerInput& a, const PeerInput& b) {
+        return a.group < b.group;
+    });
+
+    groups.clear();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (groups.empty() || groups.back().name != inputs[i].group) {
+            groups.push_back({ inputs[i].group, i, i });
+        }
+        groups.back().end = i + 1;
+    }
+
+    size_t count = inputs.size();
+    inverse_capacity.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        inverse_capacity[i] = inputs[i].capacity > 0 ? 1 / inputs[i].capacity : 0;
+    }
+    power.assign(count, 0);
+    fresh.assign(count, 0);
+    last_time.assign(count, 0);
+    ratio.assign(count, 0);
+    peer_ratio.assign(count, 0);
+    z.assign(count, 0);
+    score.assign(count, 0);
+    updates.assign(count, 0);
+}
+
+void PeerAnalytics::clear() {
+    configure({}, PeerConfig());
+}
+
+size_t PeerAnalytics::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return inputs.size();
+}
+
+void PeerAnalytics::update_group(const Group& group) {
+    size_t begin = group.begin;
+    size_t count = group.end - group.begin;
+    const double* inverse = inverse_capacity.data() + begin;
+    const double* watts = power.data() + begin;
+    const double* is_fresh = fresh.data() + begin;
+    double* r = ratio.data() + begin;
+    double* peers = peer_ratio.data() + begin;
+    double* deviation = z.data() + begin;
+
+    double n = 0;
+    double sum = 0;
+    double squares = 0;
+    for (size_t i = 0; i < count; i++) {
+        r[i] = watts[i] * inverse[i];
+        n += is_fresh[i];
+        sum += is_fresh[i] * r[i];
+        squares += is_fresh[i] * r[i] * r[i];
+    }
+
+    // Too few peers, or too little light to tell a fault from noise
+    if (n < settings.min_peers + 1 || sum / n < settings.min_ratio) {
+        return;
+    }
+
+    // Leave-one-out mean and variance of the peers of every input
+    for (size_t i = 0; i < count; i++) {
+        double others = n - is_fresh[i];
+        double mean = (sum - is_fresh[i] * r[i]) / others;
+        double variance = (squares - is_fresh[i] * r[i] * r[i]) / others - mean * mean;
+        double deviation_of_peers = std::sqrt(std::max(variance, 1e-12));
+        peers[i] = mean;
+        deviation[i] = (r[i] - mean) / deviation_of_peers;
+    }
+
+    // Rolling score over fresh updates only
+    double alpha = 2.0 / (settings.window + 1);
+    double* rolling = score.data() + begin;
+    DWORD* counted = updates.data() + begin;
+    for (size_t i = 0; i < count; i++) {
+        rolling[i] += alpha * is_fresh[i] * (deviation[i] - rolling[i]);
+        counted[i] += (DWORD)is_fresh[i];
+    }
+}
+
+size_t PeerAnalytics::update(const ValueCache& values, std::vector<PeerDeviation>& flagged) {
+    std::lock_guard<std::mutex> lock(mutex);
+    flagged.clear();
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        CachedValue value;
+        bool loaded = values.load(inputs[i].device_handle, inputs[i].channel_handle, value);
+        fresh[i] = loaded && value.time != last_time[i] ? 1 : 0;
+        if (loaded) {
+            power[i] = value.value;
+            last_time[i] = value.time;
+        }
+    }
+
+    for (const Group& group : groups) {
+        update_group(group);
+    }
+
+    for (const Group& group : groups) {
+        for (size_t i = group.begin; i < group.end; i++) {
+            if (updates[i] >= settings.window && score[i] <= -settings.threshold) {
+                flagged.push_back({ inputs[i].device_handle, inputs[i].channel, group.name,
+                                    ratio[i], peer_ratio[i], z[i], score[i] });
+            }
+        }
+    }
+    return flagged.size();
+}
@@ -0,0 +1,89 @@
+#ifndef PEER_ANALYTICS_H
+#define PEER_ANALYTICS_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "value_cache.h"
+#include "yasdi_headers.h"
+
+// One monitored input: a power channel of a device (e.g. A.Ms.Watt) with
+// the DC capacity behind it, compared against the others of its group
+struct PeerInput {
+    DWORD device_handle;
+    DWORD channel_handle;
+    std::string channel;
+    std::string group;
+    double capacity;    // W
+};
+
+// A device of the plant with the DC capacity behind each monitored input
+struct PeerDevice {
+    DWORD device_handle;
+    double capacity;    // W per input
+    std::string group;  // empty: the device type
+};
+
+struct PeerConfig {
+    size_t window = 60;         // updates the rolling score spans
+    double threshold = 2.5;     // flag at a rolling z-score of -threshold or below
+    double min_ratio = 0.05;    // no update while the group produces less (low light)
+    size_t min_peers = 3;       // fresh inputs besides the one compared
+};
+
+// An input that produces clearly less than its peers
+struct PeerDeviation {
+    DWORD device_handle;
+    std::string channel;
+    std::string group;
+    double ratio;       // power / capacity
+    double peer_ratio;  // mean of the other inputs of the group
+    double z;           // of this update
+    double score;       // rolling z-score
+};
+
+// Underperformance detection across peer inputs. Inputs are packed into
+// arrays sorted by group, so every group is one contiguous range; an update
+// loads the latest cached values and computes the capacity-normalized
+// ratios, leave-one-out peer means and deviations, and z-scores of a group
+// with loops over these arrays. A rolling (exponentially weighted) z-score
+// per input smooths clouds and lag between polls; only inputs whose score
+// falls below -threshold after a full window are reported.
+class PeerAnalytics {
+public:
+    void configure(const std::vector<PeerInput>& inputs, const PeerConfig& config);
+    void clear();
+    size_t size() const;
+
+    // One update from the value cache; inputs without a newer value since
+    // the last update keep their score. Returns the number of flagged inputs.
+    size_t update(const ValueCache& values, std::vector<PeerDeviation>& flagged);
+
+private:
+    struct Group {
+        std::string name;
+        size_t begin;
+        size_t end;
+    };
+
+    void update_group(const Group& group);
+
+    mutable std::mutex mutex;
+    PeerConfig settings;
+    std::vector<Group> groups;
+
+    // Per input, in group order
+    std::vector<PeerInput> inputs;
+    std::vector<double> inverse_capacity;
+    std::vector<double> power;
+    std::vector<double> fresh;          // 1 if a newer value arrived, else 0
+    std::vector<DWORD> last_time;
+    std::vector<double> ratio;
+    std::vector<double> peer_ratio;
+    std::vector<double> z;
+    std::vector<double> score;
+    std::vector<DWORD> updates;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#include "plant_lock.h"
+
+// Never destroyed, so that background shutdowns may still take it during
+// static destruction
+std::mutex& plant_mutex() {
+    static std::mutex* mutex = new std::mutex();
+    return *mutex;
+}
@@ -0,0 +1,14 @@
+#ifndef PLANT_LOCK_H
+#define PLANT_LOCK_H
+
+#include <mutex>
+
+// YASDI's device and channel lists, one plant per process. Held by every
+// walk of them from the addon's threads and around YASDI's synchronous
+// calls, which walk them too; read_channel_values lets go of it while it
+// waits for the bus. Never held across SMADataRequest::execute, and never
+// taken on the YASDI thread, which changes the plant on its own (detection
+// answers) and which a holder may be waiting for.
+std::mutex& plant_mutex();
+
+#endif
@@ -0,0 +1,114 @@
+#include "poll_pipeline.h"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+PollPipeline::PollPipeline(WorkPool& pool)
+    : pool(pool) {
+}
+
+void PollPipeline::append_json_string(Json& out, const char* value) {
+    out += '"';
+    for (; *value != 0; value++) {
+        unsigned char c = (unsigned char)*value;
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    out += '"';
+}
+
+static void append_device(PollPipeline::Json& out, DWORD device_handle, const std::vector<ChannelData>& channels) {
+    char number[32];
+
+    snprintf(number, sizeof(number), "%lu", (unsigned long)device_handle);
+    out += "{\"handle\":";
+    out += number;
+    out += ",\"data\":{";
+
+    for (size_t i = 0; i < channels.size(); i++) {
+        const ChannelData& channel = channels[i];
+        if (i > 0) {
+            out += ',';
+        }
+        PollPipeline::append_json_string(out, channel.name);
+        out += ":{\"value\":";
+        PollPipeline::append_json_string(out, channel.value);
+        out += ",\"units\":";
+        PollPipeline::append_json_string(out, channel.units);
+        out += ",\"numericValue\":";
+        if (std::isfinite(channel.numericValue)) {
+            snprintf(number, sizeof(number), "%.17g", channel.numericValue);
+            out += number;
+        } else {
+            out += "null";
+        }
+        snprintf(number, sizeof(number), "%.3f", channel.receivedAt);
+        out += ",\"receivedAt\":";
+        out += number;
+        out += '}';
+    }
+
+    out += "}}";
+}
+
+void PollPipeline::run(const std::vector<DWORD>& devices, Fetch fetch, Done done) {
+    struct Slot {
+        std::vector<ChannelData> channels;
+        PollPipeline::Json json;
+    };
+    auto slots = std::make_shared<std::vector<Slot>>(devices.size());
+    auto shared_fetch = std::make_shared<Fetch>(std::move(fetch));
+
+    std::vector<WorkPool::TaskHandle> encoded;
+    WorkPool::TaskHandle previous_poll;
+
+    for (size_t i = 0; i < devices.size(); i++) {
+        DWORD device_handle = devices[i];
+
+        WorkPool::TaskHandle poll = pool.submit([slots, shared_fetch, i, device_handle] {
+            (*shared_fetch)(device_handle, (*slots)[i].channels);
+        }, { previous_poll });
+
+        encoded.push_back(pool.submit([slots, i, device_handle] {
+            Slot& slot = (*slots)[i];
+            append_device(slot.json, device_handle, slot.channels);
+            slot.channels.clear();
+        }, { poll }));
+
+        previous_poll = poll;
+    }
+
+    pool.submit([slots, done] {
+        size_t size = 2;
+        for (const Slot& slot : *slots) {
+            size += slot.json.size() + 1;
+        }
+
+        PollPipeline::Json json;
+        json.reserve(size);
+        json += '[';
+        for (size_t i = 0; i < slots->size(); i++) {
+            if (i > 0) {
+                json += ',';
+            }
+            json += (*slots)[i].json;
+        }
+        json += ']';
+
+        done(std::move(json));
+    }, encoded);
+}
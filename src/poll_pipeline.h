@@ -0,0 +1,44 @@
+#ifndef POLL_PIPELINE_H
+#define POLL_PIPELINE_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "channel_data.h"
+#include "mem_stats.h"
+#include "work_pool.h"
+
+#include "yasdi_headers.h"
+
+// Polls a set of devices as a task graph on the work pool:
+//
+//   poll(1) -> poll(2) -> ... -> poll(n)      one at a time per pipeline
+//      |          |                |
+//   encode(1)  encode(2)   ...  encode(n)
+//       \         |               /
+//                join
+//
+// While device n is on the bus, earlier devices are already encoded on
+// other cores. Other pipelines, reads, batches, poll jobs and the power
+// controller call YASDI meanwhile: their walks of the plant are serialized
+// by the plant lock (src/plant_lock.h), their bus round trips overlap. The join hands one JSON document to the caller:
+//   [{"handle":1,"data":{"<channel>":{"value":"..","units":"..","numericValue":1.5}}}, ...]
+class PollPipeline {
+public:
+    typedef std::basic_string<char, std::char_traits<char>, TaggedAllocator<char, MEM_MARSHAL>> Json;
+    typedef std::function<void(DWORD device_handle, std::vector<ChannelData>& channels)> Fetch;
+    typedef std::function<void(Json json)> Done;
+
+    explicit PollPipeline(WorkPool& pool);
+
+    // Returns immediately, "done" runs on a pool thread
+    void run(const std::vector<DWORD>& devices, Fetch fetch, Done done);
+
+    static void append_json_string(Json& out, const char* value);
+
+private:
+    WorkPool& pool;
+};
+
+#endif
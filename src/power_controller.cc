@@ -0,0 +1,306 @@
+#include "power_controller.h"
+#include "smadata_request.h"
+#include "plant_lock.h"
+#include "channel_codec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <memory>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+    #include "master.h"
+}
+
+static bool resolve_channel(DWORD device_handle, const std::string& name, TNetDevice** dev, TChannel** chan) {
+    *dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+    if (*dev == NULL) {
+        return false;
+    }
+    *chan = TNetDevice_FindChannelName(*dev, (char*)name.c_str());
+    return *chan != NULL;
+}
+
+void PowerControllerMetrics::record_failure() {
+    cycles++;
+    read_failures++;
+}
+
+void PowerControllerMetrics::record_cycle(double new_feedback, double new_plant_limit, double new_read_ms,
+                                          double new_latency_ms, size_t new_writes, size_t new_suppressed) {
+    cycles++;
+    feedback = new_feedback;
+    plant_limit = new_plant_limit;
+    read_ms = new_read_ms;
+    max_read_ms = std::max(max_read_ms, new_read_ms);
+    latency_ms = new_latency_ms;
+    max_latency_ms = std::max(max_latency_ms, new_latency_ms);
+    // Exponential moving average over roughly the last 16 cycles
+    avg_latency_ms = avg_latency_ms == 0 ? new_latency_ms : avg_latency_ms + (new_latency_ms - avg_latency_ms) / 16;
+    writes += new_writes;
+    suppressed += new_suppressed;
+}
+
+PowerControlLaw::PowerControlLaw(const PowerControllerConfig& new_config)
+    : config(new_config), sent(new_config.inverters.size(), -1), sent_age(new_config.inverters.size(), 0) {
+    for (const ControlledInverter& inverter : config.inverters) {
+        capacity += inverter.capacity;
+    }
+    limit = capacity;
+}
+
+std::vector<std::pair<size_t, double>> PowerControlLaw::step(double feedback, double dt, size_t& suppressed) {
+    std::vector<std::pair<size_t, double>> updates;
+    suppressed = 0;
+    if (capacity <= 0) {
+        return updates;
+    }
+
+    // Import above the setpoint: allow more production, export: less
+    double change = config.gain * (feedback - (config.target + config.headroom));
+    if (config.ramp > 0) {
+        double max_change = config.ramp * dt;
+        change = std::max(-max_change, std::min(max_change, change));
+    }
+    limit = std::max(0.0, std::min(capacity, limit + change));
+
+    // Split proportional to capacity, skip changes within the deadband
+    // unless the limit is due to be written again
+    std::vector<std::pair<double, size_t>> due;     // (age, inverter)
+    for (size_t i = 0; i < config.inverters.size(); i++) {
+        double share = limit * config.inverters[i].capacity / capacity;
+        sent_age[i] += dt;
+        if (sent[i] >= 0 && std::fabs(share - sent[i]) <= config.deadband) {
+            if (config.refresh > 0 && sent_age[i] >= config.refresh) {
+                due.push_back(std::make_pair(sent_age[i], i));
+            } else {
+                suppressed++;
+            }
+        } else {
+            updates.push_back(std::make_pair(i, share));
+        }
+    }
+
+    // Refreshes are spread over the refresh time, oldest first, so that a
+    // plant written at once is not written again at once
+    size_t budget = (size_t)std::ceil(config.inverters.size() * dt / std::max(config.refresh, dt));
+    std::sort(due.begin(), due.end(), std::greater<std::pair<double, size_t>>());
+    for (size_t i = 0; i < due.size(); i++) {
+        if (i < budget) {
+            updates.push_back(std::make_pair(due[i].second, limit * config.inverters[due[i].second].capacity / capacity));
+        } else {
+            suppressed++;
+        }
+    }
+    return updates;
+}
+
+void PowerControlLaw::written(size_t inverter, double value) {
+    if (inverter < sent.size()) {
+        sent[inverter] = value;
+        sent_age[inverter] = 0;
+    }
+}
+
+PowerController::~PowerController() {
+    stop();
+}
+
+int PowerController::start(const PowerControllerConfig& new_config) {
+    stop();
+
+    if (new_config.inverters.empty() || new_config.period_ms == 0) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    TNetDevice* dev;
+    TChannel* chan;
+    if (!resolve_channel(new_config.meter_device, new_config.feedback_channel, &dev, &chan)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    double total_capacity = 0;
+    for (const ControlledInverter& inverter : new_config.inverters) {
+        if (!resolve_channel(inverter.device_handle, new_config.limit_channel, &dev, &chan)) {
+            return YE_UNKNOWN_HANDLE;
+        }
+        total_capacity += inverter.capacity;
+    }
+    if (total_capacity <= 0) {
+        return YE_INVAL_ARGUMENT;
+    }
+
+    config = new_config;
+    law = PowerControlLaw(config);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        stats = PowerControllerMetrics();
+        stats.plant_limit = law.plant_limit();
+        stats.running = true;
+    }
+
+    thread = std::thread(&PowerController::run, this);
+    return YE_OK;
+}
+
+void PowerController::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.running = false;
+}
+
+bool PowerController::running() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats.running;
+}
+
+PowerControllerMetrics PowerController::metrics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+int PowerController::read_feedback(double& value) {
+    TNetDevice* dev;
+    TChannel* chan;
+    std::unique_lock<std::mutex> plant(plant_mutex());
+    if (!resolve_channel(config.meter_device, config.feedback_channel, &dev, &chan)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+
+    // Only this channel: mask[2] index[1]
+    std::vector<BYTE> payload = { LOBYTE(TChannel_GetCType(chan)), HIBYTE(TChannel_GetCType(chan)), TChannel_GetIndex(chan) };
+    SMADataRequest request(TNetDevice_GetNetAddr(dev), CMD_GET_DATA);
+    request.set_flags(dev->prodID);
+    request.set_timeout(config.read_timeout, 0);
+    request.set_payload(payload.data(), (DWORD)payload.size());
+    plant.unlock();
+
+    // Scan on the YASDI thread, where the master updates values as well;
+    // the meter is looked up there, it may be removed meanwhile
+    bool scanned = false;
+    DWORD meter = config.meter_device;
+    request.set_receive_handler([meter, &scanned](WORD, const BYTE* data, DWORD size) {
+        TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(meter);
+        scanned = dev != NULL && TStateChanReader_ScanUpdateValue(dev, (BYTE*)data, size) == 0;
+    });
+
+    int res = request.execute(PRIORITY_HIGH);
+    if (res != YE_OK) {
+        return res;
+    }
+    if (!scanned) {
+        return YE_VALUE_NOT_VALID;
+    }
+
+    plant.lock();
+    if (!resolve_channel(config.meter_device, config.feedback_channel, &dev, &chan)) {
+        return YE_UNKNOWN_HANDLE;
+    }
+    value = TChannel_GetValue(chan, dev, 0);
+    return YE_OK;
+}
+
+size_t PowerController::write_limits(const std::vector<std::pair<size_t, double>>& updates) {
+    std::vector<std::shared_ptr<SMADataRequest>> requests;
+    std::vector<std::future<int>> pending;
+    std::vector<std::pair<size_t, double>> queued;
+
+    std::unique_lock<std::mutex> plant(plant_mutex());
+    for (const auto& update : updates) {
+        TNetDevice* dev;
+        TChannel* chan;
+        if (!resolve_channel(config.inverters[update.first].device_handle, config.limit_channel, &dev, &chan)) {
+            continue;
+        }
+
+        std::vector<BYTE> payload;
+        channel_set_data_payload(chan, update.second, payload);
+
+        auto request = std::make_shared<SMADataRequest>(TNetDevice_GetNetAddr(dev), CMD_SET_DATA);
+        request->set_flags(dev->prodID);
+        request->set_type(RT_NORCV);
+        request->set_payload(payload.data(), (DWORD)payload.size());
+        requests.push_back(request);
+        queued.push_back(update);
+    }
+    plant.unlock();
+
+    // All writes are queued at once, the scheduler sends them back to back
+    for (const auto& request : requests) {
+        pending.push_back(SMADataScheduler::instance().submit(request, PRIORITY_HIGH));
+    }
+
+    // Only limits that went out count as written, the others stay due
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i].get() == YE_OK) {
+            law.written(queued[i].first, queued[i].second);
+        }
+    }
+
+    // Like the master's own writer: the next read fetches the value the device took
+    plant.lock();
+    for (const auto& update : queued) {
+        TNetDevice* dev;
+        TChannel* chan;
+        if (resolve_channel(config.inverters[update.first].device_handle, config.limit_channel, &dev, &chan)) {
+            TChannel_SetTimeStamp(chan, dev, 0);
+        }
+    }
+    return pending.size();
+}
+
+void PowerController::run() {
+    double last_cycle = clock.now();
+
+    for (;;) {
+        double cycle_start = clock.now();
+        double dt = std::max(cycle_start - last_cycle, config.period_ms / 1000.0);
+        last_cycle = cycle_start;
+
+        double feedback = 0;
+        int res = read_feedback(feedback);
+        double read_done = clock.now();
+
+        size_t writes = 0;
+        size_t suppressed = 0;
+        if (res == YE_OK) {
+            std::vector<std::pair<size_t, double>> updates = law.step(feedback, dt, suppressed);
+            if (!updates.empty()) {
+                writes = write_limits(updates);
+            }
+        }
+        double actuated = clock.now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (res == YE_OK) {
+            stats.record_cycle(feedback, law.plant_limit(), (read_done - cycle_start) * 1000,
+                               (actuated - cycle_start) * 1000, writes, suppressed);
+        } else {
+            stats.record_failure();
+        }
+
+        double wait = config.period_ms / 1000.0 - (clock.now() - cycle_start);
+        if (wait > 0) {
+            wake.wait_for(lock, std::chrono::duration<double>(wait), [this] { return stopping; });
+        }
+        if (stopping) {
+            return;
+        }
+    }
+}
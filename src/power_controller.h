@@ -0,0 +1,115 @@
+#ifndef POWER_CONTROLLER_H
+#define POWER_CONTROLLER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clock.h"
+
+#include "yasdi_headers.h"
+
+struct ControlledInverter {
+    DWORD device_handle;
+    double capacity;            // W
+};
+
+struct PowerControllerConfig {
+    DWORD meter_device = 0;
+    std::string feedback_channel;   // power at the grid connection in W, import positive
+    std::string limit_channel;      // active power limit of each inverter in W
+    double target = 0;              // feedback setpoint, 0: zero export
+    double headroom = 0;            // W kept as import margin, regulates to target + headroom
+    double gain = 0.7;              // share of the error corrected per cycle
+    double ramp = 0;                // max plant limit change in W/s, 0: unlimited
+    double deadband = 0;            // W, smaller limit changes are not written
+    double refresh = 60;            // s, a limit is written again after this even within the deadband, 0: never
+    DWORD period_ms = 1000;
+    DWORD read_timeout = 1;         // s
+    std::vector<ControlledInverter> inverters;
+};
+
+struct PowerControllerMetrics {
+    unsigned long long cycles = 0;
+    unsigned long long read_failures = 0;
+    unsigned long long writes = 0;
+    unsigned long long suppressed = 0;  // limit changes within the deadband
+    double feedback = 0;
+    double plant_limit = 0;
+    double read_ms = 0;                 // last feedback read
+    double max_read_ms = 0;
+    double latency_ms = 0;              // last feedback request to all writes sent
+    double avg_latency_ms = 0;
+    double max_latency_ms = 0;
+    bool running = false;
+
+    void record_failure();
+    void record_cycle(double feedback, double plant_limit, double read_ms, double latency_ms, size_t writes, size_t suppressed);
+};
+
+// The control law of the controller, independent of bus and time source
+// so that the simulator runs exactly the same computation.
+class PowerControlLaw {
+public:
+    PowerControlLaw() {}
+    explicit PowerControlLaw(const PowerControllerConfig& config);
+
+    // New limits for a feedback value, dt seconds after the previous one.
+    // Returns (inverter index, limit) for every limit outside the deadband,
+    // and for limits last written refresh s ago or more: writes are not
+    // acknowledged, a lost frame would leave the inverter on a stale limit.
+    std::vector<std::pair<size_t, double>> step(double feedback, double dt, size_t& suppressed);
+
+    // Remember a limit that went out to an inverter
+    void written(size_t inverter, double limit);
+
+    double plant_limit() const { return limit; }
+    double total_capacity() const { return capacity; }
+
+private:
+    PowerControllerConfig config;
+    std::vector<double> sent;           // last limit written per inverter, < 0: none yet
+    std::vector<double> sent_age;       // s since then
+    double limit = 0;
+    double capacity = 0;
+};
+
+// Closed-loop active power control (e.g. zero export) in a native thread.
+// Each cycle reads the feedback channel of the meter with a single
+// CMD_GET_DATA at high priority, corrects the plant limit by
+// gain * (feedback - target - headroom) within the ramp limit, splits it
+// across the inverters proportional to their capacity and writes every
+// limit that moved by more than the deadband, or was last written refresh
+// s ago, with CMD_SET_DATA. All
+// requests go through the SMAData scheduler ahead of normal traffic, so the
+// feedback to actuation latency is the bus time of those frames.
+class PowerController {
+public:
+    explicit PowerController(Clock& clock = Clock::real()) : clock(clock) {}
+    ~PowerController();
+
+    int start(const PowerControllerConfig& config);
+    void stop();
+    bool running() const;
+
+    PowerControllerMetrics metrics() const;
+
+private:
+    void run();
+    int read_feedback(double& value);
+    size_t write_limits(const std::vector<std::pair<size_t, double>>& updates);
+
+    Clock& clock;
+    PowerControllerConfig config;
+    PowerControlLaw law;
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    PowerControllerMetrics stats;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "protocol_stats.h"
+
+ProtocolStats::ProtocolStats(unsigned long long lock_in)
+    : lock(0), lock_in(lock_in) {
+}
+
+void ProtocolStats::record(WORD source, DWORD flags) {
+    std::function<void(DWORD)> handler;
+    DWORD changed;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        ProtocolCounts& counts = stats.sources[source];
+        if (flags & TS_PROT_SMANET_ONLY) {
+            counts.smanet++;
+            stats.total.smanet++;
+        } else if (flags & TS_PROT_SUNNYNET_ONLY) {
+            counts.sunnynet++;
+            stats.total.sunnynet++;
+        } else {
+            return;
+        }
+
+        DWORD protocol = flags & (TS_PROT_SMANET_ONLY | TS_PROT_SUNNYNET_ONLY);
+        if (stats.locked != 0 && stats.locked != protocol) {
+            stats.mismatches++;
+            stats.locked = 0;
+        } else if (stats.locked == 0 &&
+                   ((stats.total.sunnynet == 0 && stats.total.smanet >= lock_in) ||
+                    (stats.total.smanet == 0 && stats.total.sunnynet >= lock_in))) {
+            stats.locked = protocol;
+        } else {
+            return;
+        }
+
+        changed = stats.locked;
+        lock.store(changed, std::memory_order_relaxed);
+        handler = on_change;
+    }
+
+    if (handler) {
+        handler(changed);
+    }
+}
+
+void ProtocolStats::set_change_handler(std::function<void(DWORD locked)> handler) {
+    std::lock_guard<std::mutex> guard(mutex);
+    on_change = std::move(handler);
+}
+
+ProtocolSummary ProtocolStats::summary() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return stats;
+}
+
+void ProtocolStats::reset() {
+    std::function<void(DWORD)> handler;
+    bool was_locked;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        was_locked = stats.locked != 0;
+        stats = ProtocolSummary();
+        lock.store(0, std::memory_order_relaxed);
+        handler = on_change;
+    }
+
+    if (was_locked && handler) {
+        handler(0);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef PROTOCOL_STATS_H
+#define PROTOCOL_STATS_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include "yasdi_headers.h"
+
+struct ProtocolCounts {
+    unsigned long long smanet = 0;
+    unsigned long long sunnynet = 0;
+};
+
+struct ProtocolSummary {
+    ProtocolCounts total;
+    std::map<WORD, ProtocolCounts> sources;
+    DWORD locked = 0;                   // TS_PROT_*_ONLY flag, 0 if not locked
+    unsigned long long mismatches = 0;  // frames of another protocol after lock-in
+};
+
+// Transport protocol statistics of received SMAData frames.
+// YASDI sends every frame without an explicit transport protocol once per
+// protocol configured for the bus (SMANet and SunnyNet). After "lock_in"
+// frames of only one protocol the bus is considered single-protocol and
+// the locked protocol is reported through the change handler. A frame of
+// the other protocol proves a mixed bus and releases the lock until reset().
+//
+// There is one lock for all bus drivers, not one per driver. YASDI sends
+// every frame out of every online driver (TSMAData_SendRawPacket takes no
+// driver, a TIORequest names none) and packet listeners are not told the
+// driver a frame came from, so a protocol cannot be chosen per bus. With
+// several drivers, a SunnyNet frame on any of them keeps all of them on both
+// protocols. The per-read scan of every protocol of a driver
+// (TProtLayer_ScanInput) is YASDI's and unchanged.
+class ProtocolStats {
+public:
+    explicit ProtocolStats(unsigned long long lock_in = 50);
+
+    // Called with the received packet flags (TS_PROT_SMANET_ONLY / TS_PROT_SUNNYNET_ONLY)
+    void record(WORD source, DWORD flags);
+
+    // Called outside the lock with the new TS_PROT_*_ONLY flag, 0 when released
+    void set_change_handler(std::function<void(DWORD locked)> handler);
+
+    DWORD locked() const { return lock.load(std::memory_order_relaxed); }
+    ProtocolSummary summary() const;
+    void reset();
+
+private:
+    mutable std::mutex mutex;
+    ProtocolSummary stats;
+    std::atomic<DWORD> lock;
+    std::function<void(DWORD)> on_change;
+    unsigned long long lock_in;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "receive_times.h"
+
+#include <chrono>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "plant.h"
+    #include "rx_time.h"
+}
+
+void ReceiveTimes::set_drivers(const DWORD* ids, DWORD count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    drivers.assign(ids, ids + count);
+}
+
+double ReceiveTimes::receive_ms() const {
+    // The bus YASDI read from last is the one the answer came from
+    TRxTime best = { 0, 0 };
+    for (DWORD driver : drivers) {
+        TRxTime rx = { 0, 0 };
+        if (yasdiMasterDoDriverIoCtrl(driver, IOCTRL_GET_RX_TIME, (BYTE*)&rx) == 0 &&
+            rx.qRxTime != 0 && rx.qReadTime > best.qReadTime) {
+            best = rx;
+        }
+    }
+    if (best.qRxTime != 0) {
+        return best.qRxTime / 1e6;
+    }
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration<double, std::milli>(now).count();
+}
+
+void ReceiveTimes::record(WORD source, const BYTE* data, DWORD size) {
+    // mask[2] index[1] ...
+    if (size <= 3) {
+        return;
+    }
+    WORD mask = (WORD)(data[0] | (data[1] << 8));
+    BYTE index = data[2];
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    TNetDevice* dev = TPlant_FindDevAddr(source);
+    if (dev == NULL) {
+        return;
+    }
+    double unix_ms = receive_ms();
+
+    // The same channels the master just stored the answer into
+    TNewChanListFilter filter;
+    TNewChanListFilter_Init(&filter, mask, index, LEV_IGNORE);
+    TChannel* chan;
+    int i;
+    FOREACH_CHANNEL(i, TNetDevice_GetChannelList(dev), chan, &filter) {
+        ReceiveTime& time = times[std::make_pair((DWORD)dev->Handle, (DWORD)chan->Handle)];
+        time.value_time = TChannel_GetTimeStamp(chan, dev);
+        time.unix_ms = unix_ms;
+    }
+}
+
+double ReceiveTimes::lookup(DWORD device_handle, DWORD channel_handle, DWORD value_time) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = times.find(std::make_pair(device_handle, channel_handle));
+    if (it != times.end() && it->second.value_time == value_time) {
+        return it->second.unix_ms;
+    }
+    return value_time * 1000.0;
+}
+
+void ReceiveTimes::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    times.clear();
+}
@@ -0,0 +1,45 @@
+#ifndef RECEIVE_TIMES_H
+#define RECEIVE_TIMES_H
+
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "yasdi_headers.h"
+
+// Receive time of the answer a channel value came with
+struct ReceiveTime {
+    DWORD value_time = 0;   // YASDI's timestamp of that value (whole seconds)
+    double unix_ms = 0;     // when the answer arrived, ms since the epoch
+};
+
+// Sample times of channel values, as close to the wire as the bus driver
+// can tell. YASDI stamps values with whole seconds when its thread gets to
+// them. For every GET_DATA answer the drivers are asked for the receive
+// time of the bytes they handed to YASDI last (IOCTRL_GET_RX_TIME): the
+// answer is parsed on the thread that read it, right after the master
+// stored its values. Drivers without the command (YASDI's own) give the
+// time the answer was parsed.
+class ReceiveTimes {
+public:
+    void set_drivers(const DWORD* drivers, DWORD count);
+
+    // Called on the YASDI thread with every GET_DATA answer
+    void record(WORD source, const BYTE* data, DWORD size);
+
+    // Receive time in ms of the value YASDI stamped with value_time;
+    // value_time in ms if that value did not come with a recorded answer
+    double lookup(DWORD device_handle, DWORD channel_handle, DWORD value_time) const;
+
+    void clear();
+
+private:
+    double receive_ms() const;
+
+    mutable std::mutex mutex;
+    std::vector<DWORD> drivers;
+    std::map<std::pair<DWORD, DWORD>, ReceiveTime> times;
+};
+
+#endif
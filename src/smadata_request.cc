@@ -0,0 +1,352 @@
+#include "smadata_request.h"
+#include "plant_lock.h"
+
+#include <cstring>
+
+extern "C" {
+    #include "netdevice.h"
+    #include "objman.h"
+    #include "master.h"
+}
+
+SMADataRequest::SMADataRequest(WORD dest, BYTE cmd) {
+    std::memset(&slot.io, 0, sizeof(slot.io));
+    slot.owner = this;
+
+    slot.io.Cmd = cmd;
+    slot.io.DestAddr = dest;
+    slot.io.SourceAddr = master_address();
+    slot.io.Type = RT_MONORCV;
+    slot.io.TimeOut = 5;
+    slot.io.Repeats = 3;
+    slot.io.OnReceived = &SMADataRequest::on_received;
+    slot.io.OnEnd = &SMADataRequest::on_end;
+}
+
+void SMADataRequest::set_payload(const BYTE* data, DWORD size) {
+    payload.assign(data, data + size);
+}
+
+void SMADataRequest::set_timeout(DWORD seconds, DWORD repeats) {
+    slot.io.TimeOut = seconds;
+    slot.io.Repeats = repeats;
+}
+
+void SMADataRequest::set_type(TReqType type) {
+    slot.io.Type = type;
+}
+
+void SMADataRequest::set_flags(DWORD tx_flags) {
+    flags = tx_flags;
+}
+
+void SMADataRequest::set_receive_handler(std::function<void(WORD source, const BYTE* data, DWORD size)> handler) {
+    receive_handler = std::move(handler);
+}
+
+void SMADataRequest::set_end_handler(std::function<void(int code)> handler) {
+    end_handler = std::move(handler);
+}
+
+int SMADataRequest::execute(SMADataPriority priority) {
+    SMADataScheduler::instance().submit(this, priority);
+
+    // YASDI always ends a request, at the latest after TimeOut * (Repeats + 1)
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [this] { return done; });
+
+    return completion_code();
+}
+
+void SMADataRequest::start(const std::function<void(TIORequest*)>& transport, DWORD protocol) {
+    slot.io.TxFlags = flags;
+    if ((flags & (TS_PROT_SMANET_ONLY | TS_PROT_SUNNYNET_ONLY)) == 0) {
+        slot.io.TxFlags |= protocol;
+    }
+    slot.io.TxData = payload.empty() ? nullptr : payload.data();
+    slot.io.TxLength = (DWORD)payload.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        response_list.clear();
+        done = false;
+        cancelled = false;
+    }
+
+    if (transport) {
+        transport(&slot.io);
+    } else {
+        yasdiAddIORequest(&slot.io);
+    }
+}
+
+// End a request that never reached YASDI
+void SMADataRequest::cancel(int code) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        cancel_code = code;
+    }
+
+    if (end_handler) {
+        end_handler(completion_code());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    done_cond.notify_all();
+}
+
+int SMADataRequest::completion_code() const {
+    if (cancelled) {
+        return cancel_code;
+    }
+    if (slot.io.Status == RS_SUCCESS || !response_list.empty()) {
+        return YE_OK;
+    }
+    return YE_TIMEOUT;
+}
+
+void SMADataRequest::on_received(TIORequest* req, TOnReceiveInfo* info) {
+    SMADataRequest* self = reinterpret_cast<Slot*>(req)->owner;
+
+    if (self->receive_handler) {
+        self->receive_handler(info->SourceAddr, info->Buffer, info->BufferSize);
+    }
+
+    SMADataResponse response;
+    response.source = info->SourceAddr;
+    response.data.assign(info->Buffer, info->Buffer + info->BufferSize);
+
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->response_list.push_back(std::move(response));
+}
+
+void SMADataRequest::on_end(TIORequest* req) {
+    SMADataRequest* self = reinterpret_cast<Slot*>(req)->owner;
+    unsigned long long submission = self->submission;
+
+    if (self->end_handler) {
+        self->end_handler(self->completion_code());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->done = true;
+        self->done_cond.notify_all();
+    }
+
+    // A waiting owner may already have released the request, or even
+    // submitted another one at the same address; only the pointer value
+    // and the submission it ended are used from here on
+    SMADataScheduler::instance().request_ended(self, submission);
+}
+
+WORD SMADataRequest::master_address() {
+    return TSMADataMaster_GetInstance()->SrcAddr;
+}
+
+bool SMADataRequest::resolve_device(DWORD device_handle, WORD* net_addr, DWORD* prot_flags) {
+    std::lock_guard<std::mutex> plant(plant_mutex());
+    TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+    if (dev == NULL) {
+        return false;
+    }
+
+    *net_addr = TNetDevice_GetNetAddr(dev);
+    *prot_flags = dev->prodID;
+    return true;
+}
+
+SMADataScheduler& SMADataScheduler::instance() {
+    static SMADataScheduler scheduler;
+    return scheduler;
+}
+
+void SMADataScheduler::submit(SMADataRequest* request, SMADataPriority priority) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (closed || listening) {
+        reject(request, lock);
+        return;
+    }
+    queues[priority].push_back(request);
+    dispatch(lock);
+}
+
+std::future<int> SMADataScheduler::submit(std::shared_ptr<SMADataRequest> request, SMADataPriority priority) {
+    auto promise = std::make_shared<std::promise<int>>();
+    std::future<int> future = promise->get_future();
+
+    std::function<void(int)> handler = request->end_handler;
+    request->set_end_handler([promise, handler](int code) {
+        if (handler) {
+            handler(code);
+        }
+        promise->set_value(code);
+    });
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (closed || listening) {
+        reject(request.get(), lock);
+        return future;
+    }
+    owned[request.get()] = request;
+    queues[priority].push_back(request.get());
+    dispatch(lock);
+    return future;
+}
+
+void SMADataScheduler::set_transport(Transport new_transport) {
+    std::lock_guard<std::mutex> lock(mutex);
+    transport = std::move(new_transport);
+}
+
+void SMADataScheduler::set_default_protocol(DWORD protocol) {
+    std::lock_guard<std::mutex> lock(mutex);
+    default_protocol = protocol;
+}
+
+void SMADataScheduler::set_max_in_flight(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex);
+    max_in_flight = count > 0 ? count : 1;
+    dispatch(lock);
+}
+
+size_t SMADataScheduler::queued() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto& queue : queues) {
+        count += queue.size();
+    }
+    return count;
+}
+
+size_t SMADataScheduler::in_flight() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+void SMADataScheduler::close() {
+    std::unique_lock<std::mutex> lock(mutex);
+    closed = true;
+    cancel_queued(YE_SHUTDOWN, lock);
+}
+
+void SMADataScheduler::set_listen_only(bool listen_only) {
+    std::unique_lock<std::mutex> lock(mutex);
+    listening = listen_only;
+    if (listening) {
+        cancel_queued(YE_NOT_SUPPORTED, lock);
+    }
+}
+
+bool SMADataScheduler::listen_only() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return listening;
+}
+
+void SMADataScheduler::cancel_queued(int code, std::unique_lock<std::mutex>& lock) {
+    std::vector<SMADataRequest*> cancelled;
+    std::vector<std::shared_ptr<SMADataRequest>> released;
+
+    for (auto& queue : queues) {
+        for (SMADataRequest* request : queue) {
+            cancelled.push_back(request);
+            auto it = owned.find(request);
+            if (it != owned.end()) {
+                released.push_back(std::move(it->second));
+                owned.erase(it);
+            }
+        }
+        queue.clear();
+    }
+
+    // End handlers may submit again, they are rejected then
+    lock.unlock();
+    for (SMADataRequest* request : cancelled) {
+        request->cancel(code);
+    }
+    released.clear();
+    lock.lock();
+}
+
+void SMADataScheduler::abandon() {
+    std::vector<SMADataRequest*> abandoned;
+    std::vector<std::shared_ptr<SMADataRequest>> released;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (const auto& entry : started) {
+        abandoned.push_back(entry.second);
+    }
+    for (SMADataRequest* request : abandoned) {
+        auto it = owned.find(request);
+        if (it != owned.end()) {
+            released.push_back(std::move(it->second));
+            owned.erase(it);
+        }
+    }
+    started.clear();
+    running = 0;
+
+    lock.unlock();
+    for (SMADataRequest* request : abandoned) {
+        request->cancel();
+    }
+}
+
+void SMADataScheduler::open() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = false;
+}
+
+void SMADataScheduler::reject(SMADataRequest* request, std::unique_lock<std::mutex>& lock) {
+    int code = closed ? YE_SHUTDOWN : YE_NOT_SUPPORTED;
+    lock.unlock();
+    request->cancel(code);
+    lock.lock();
+}
+
+void SMADataScheduler::request_ended(SMADataRequest* request, unsigned long long submission) {
+    std::shared_ptr<SMADataRequest> released;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Abandoned at shutdown already
+    if (started.erase(submission) == 0) {
+        return;
+    }
+    auto it = owned.find(request);
+    if (it != owned.end() && it->second->submission == submission) {
+        released = std::move(it->second);
+        owned.erase(it);
+    }
+    if (running > 0) {
+        running--;
+    }
+    dispatch(lock);
+
+    // Destroy the released request outside the lock
+    lock.unlock();
+}
+
+void SMADataScheduler::dispatch(std::unique_lock<std::mutex>& lock) {
+    std::vector<SMADataRequest*> ready;
+
+    for (auto& queue : queues) {
+        while (running < max_in_flight && !queue.empty()) {
+            SMADataRequest* request = queue.front();
+            request->submission = ++submissions;
+            ready.push_back(request);
+            started[request->submission] = request;
+            queue.pop_front();
+            running++;
+        }
+    }
+
+    // yasdiAddIORequest only enqueues, YASDI's thread picks the request up
+    Transport current = transport;
+    DWORD protocol = default_protocol;
+    lock.unlock();
+    for (SMADataRequest* request : ready) {
+        request->start(current, protocol);
+    }
+    lock.lock();
+}
@@ -0,0 +1,158 @@
+#ifndef SMADATA_REQUEST_H
+#define SMADATA_REQUEST_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mem_stats.h"
+#include "yasdi_headers.h"
+
+typedef std::vector<BYTE, TaggedAllocator<BYTE, MEM_PACKETS>> PacketBuffer;
+
+// One answer frame received for a request (already defragmented by YASDI)
+struct SMADataResponse {
+    WORD source;
+    PacketBuffer data;
+};
+
+enum SMADataPriority {
+    PRIORITY_HIGH = 0,      // control actions
+    PRIORITY_NORMAL = 1,
+    PRIORITY_LOW = 2,       // bulk transfers
+    PRIORITY_COUNT = 3
+};
+
+// SMAData transaction on top of YASDI's IORequest list.
+// The request is queued with yasdiAddIORequest, so it is scheduled,
+// fragmented and matched by the same code paths as the master's own
+// commands. Requests are handed to YASDI by the SMADataScheduler.
+class SMADataRequest {
+public:
+    SMADataRequest(WORD dest, BYTE cmd);
+
+    void set_payload(const BYTE* data, DWORD size);
+    void set_timeout(DWORD seconds, DWORD repeats);
+    void set_type(TReqType type);
+    void set_flags(DWORD flags);
+
+    // Called on the YASDI thread for every answer, before it is stored
+    void set_receive_handler(std::function<void(WORD source, const BYTE* data, DWORD size)> handler);
+
+    // Called on the YASDI thread once the request has ended
+    void set_end_handler(std::function<void(int code)> handler);
+
+    // Send the request and wait for completion.
+    // Returns YE_OK, YE_TIMEOUT, or YE_SHUTDOWN if the scheduler was closed
+    // before the request reached YASDI (YE_NOT_SUPPORTED while listening only).
+    int execute(SMADataPriority priority = PRIORITY_NORMAL);
+
+    const std::vector<SMADataResponse>& responses() const { return response_list; }
+    BYTE cmd() const { return slot.io.Cmd; }
+
+    // SMAData source address of the master and transport protocol of a
+    // device; resolve_device takes the plant lock
+    static WORD master_address();
+    static bool resolve_device(DWORD device_handle, WORD* net_addr, DWORD* prot_flags);
+
+private:
+    friend class SMADataScheduler;
+
+    // TIORequest must stay the first member, YASDI callbacks only hand back
+    // the request pointer
+    struct Slot {
+        TIORequest io;
+        SMADataRequest* owner;
+    };
+
+    void start(const std::function<void(TIORequest*)>& transport, DWORD protocol);
+    void cancel(int code = YE_SHUTDOWN);
+    int completion_code() const;
+
+    static void on_received(TIORequest* req, TOnReceiveInfo* info);
+    static void on_end(TIORequest* req);
+
+    Slot slot;
+    unsigned long long submission = 0;     // set by the scheduler on dispatch
+    DWORD flags = 0;
+    std::vector<BYTE, TaggedAllocator<BYTE, MEM_REQUESTS>> payload;
+    std::function<void(WORD, const BYTE*, DWORD)> receive_handler;
+    std::function<void(int)> end_handler;
+    std::vector<SMADataResponse> response_list;
+    std::mutex mutex;
+    std::condition_variable done_cond;
+    bool done = false;
+    bool cancelled = false;
+    int cancel_code = YE_SHUTDOWN;
+};
+
+// Hands requests of the addon to YASDI by priority, with a bounded number
+// in flight so the master's own commands are never starved.
+class SMADataScheduler {
+public:
+    static SMADataScheduler& instance();
+
+    // Queue a request owned by the caller, which must keep it alive until
+    // its end handler ran (execute() does this by waiting)
+    void submit(SMADataRequest* request, SMADataPriority priority);
+
+    // Queue a request owned by the scheduler until it ended
+    std::future<int> submit(std::shared_ptr<SMADataRequest> request, SMADataPriority priority);
+
+    // Where dispatched requests go: yasdiAddIORequest unless replaced, e.g.
+    // by a simulated bus that ends them through the TIORequest callbacks
+    typedef std::function<void(TIORequest* io)> Transport;
+    void set_transport(Transport transport);
+
+    // Transport protocol (TS_PROT_SMANET_ONLY / TS_PROT_SUNNYNET_ONLY) for
+    // requests that do not name one; 0 lets YASDI send them with every
+    // protocol of the bus. Applies to all drivers, YASDI sends each request
+    // out of every one of them.
+    void set_default_protocol(DWORD protocol);
+
+    void set_max_in_flight(size_t count);
+    size_t queued() const;
+    size_t in_flight() const;
+
+    // Before YASDI shuts down: queued requests end with YE_SHUTDOWN, and so
+    // does every request submitted until open(). Requests already handed to
+    // YASDI still end normally, within their timeout.
+    void close();
+    void open();
+
+    // Listening only, nothing may be sent: queued requests end with
+    // YE_NOT_SUPPORTED, and so does every request submitted until cleared
+    void set_listen_only(bool listen_only);
+    bool listen_only() const;
+
+    // After YASDI shut down: it never ends the requests it still held, they
+    // end with YE_SHUTDOWN instead
+    void abandon();
+
+private:
+    friend class SMADataRequest;
+
+    void request_ended(SMADataRequest* request, unsigned long long submission);
+    void dispatch(std::unique_lock<std::mutex>& lock);
+    void reject(SMADataRequest* request, std::unique_lock<std::mutex>& lock);
+    void cancel_queued(int code, std::unique_lock<std::mutex>& lock);
+
+    mutable std::mutex mutex;
+    std::deque<SMADataRequest*> queues[PRIORITY_COUNT];
+    std::map<SMADataRequest*, std::shared_ptr<SMADataRequest>> owned;
+    std::map<unsigned long long, SMADataRequest*> started;     // handed to YASDI, not ended yet, by submission
+    unsigned long long submissions = 0;
+    Transport transport;
+    DWORD default_protocol = 0;
+    size_t running = 0;
+    size_t max_in_flight = 4;
+    bool closed = false;
+    bool listening = false;
+};
+
+#endif
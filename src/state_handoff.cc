@@ -0,0 +1,615 @@
+#include "state_handoff.h"
+#include "plant_lock.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern "C" {
+    #include "repository.h"
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+    #include "master.h"
+    #include "plant.h"
+}
+
+namespace {
+
+bool send_all(int fd, const std::vector<BYTE>& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        sent += (size_t)count;
+    }
+    return true;
+}
+
+bool read_all(int fd, BYTE* data, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t count = recv(fd, data + got, size - got, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        got += (size_t)count;
+    }
+    return true;
+}
+
+bool socket_address(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+std::vector<char> c_string(const std::string& text) {
+    std::vector<char> buffer(text.begin(), text.end());
+    buffer.push_back(0);
+    return buffer;
+}
+
+}  // namespace
+
+HandoffServer::~HandoffServer() {
+    stop();
+}
+
+bool HandoffServer::start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (thread.joinable()) {
+        return path == socket_path;
+    }
+
+    sockaddr_un address;
+    if (!socket_address(path, address)) {
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // Left behind by a gateway that did not stop cleanly
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 4) != 0) {
+        close(fd);
+        return false;
+    }
+
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> changes(changes_mutex);
+        dirty.clear();
+        woken = false;
+        wake_fds[0] = pipe_fds[0];
+        wake_fds[1] = pipe_fds[1];
+    }
+    listen_fd = fd;
+    socket_path = path;
+    sent_registry = registry.version();
+    stopping = false;
+    serving = true;
+    thread = std::thread(&HandoffServer::run, this);
+    return true;
+}
+
+void HandoffServer::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!thread.joinable()) {
+        return;
+    }
+
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> changes(changes_mutex);
+        wake();
+    }
+    thread.join();
+
+    {
+        std::lock_guard<std::mutex> changes(changes_mutex);
+        close(wake_fds[0]);
+        close(wake_fds[1]);
+        wake_fds[0] = wake_fds[1] = -1;
+    }
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path.c_str());
+    serving = false;
+}
+
+// Under changes_mutex, which keeps the pipe open
+void HandoffServer::wake() {
+    if (wake_fds[1] >= 0) {
+        BYTE signal = 1;
+        ssize_t ignored = write(wake_fds[1], &signal, 1);
+        (void)ignored;
+    }
+}
+
+void HandoffServer::values_changed(DWORD device_handle) {
+    if (connected.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(changes_mutex);
+    dirty.insert(device_handle);
+    if (!woken) {
+        woken = true;
+        wake();
+    }
+}
+
+void HandoffServer::registry_changed() {
+    if (connected.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(changes_mutex);
+    if (!woken) {
+        woken = true;
+        wake();
+    }
+}
+
+void HandoffServer::run() {
+    std::vector<pollfd> fds;
+    while (!stopping) {
+        fds.clear();
+        fds.push_back({ listen_fd, POLLIN, 0 });
+        fds.push_back({ wake_fds[0], POLLIN, 0 });
+        for (const Standby& standby : clients) {
+            fds.push_back({ standby.fd, POLLIN, 0 });
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (stopping) {
+            break;
+        }
+
+        // A standby never writes, readable means it hung up
+        for (size_t i = clients.size(); i-- > 0;) {
+            if (fds[2 + i].revents != 0) {
+                drop(i);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            BYTE drain[64];
+            while (read(wake_fds[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_standby();
+        }
+
+        std::set<DWORD> changed;
+        {
+            std::lock_guard<std::mutex> lock(changes_mutex);
+            changed.swap(dirty);
+            woken = false;
+        }
+
+        DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+        if (snapshot->version != sent_registry) {
+            sent_registry = snapshot->version;
+            for (size_t i = clients.size(); i-- > 0;) {
+                if (!send_devices(clients[i], *snapshot)) {
+                    drop(i);
+                }
+            }
+        }
+        for (DWORD device_handle : changed) {
+            for (size_t i = clients.size(); i-- > 0;) {
+                if (!send_values(clients[i], device_handle)) {
+                    drop(i);
+                }
+            }
+        }
+    }
+
+    for (size_t i = clients.size(); i-- > 0;) {
+        drop(i);
+    }
+}
+
+void HandoffServer::accept_standby() {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    // A standby that stops reading must not hold up the others for long
+    timeval timeout = { 5, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Counted first: values stored from now on are sent again afterwards
+    clients.push_back({ fd, {} });
+    connected++;
+    Standby& standby = clients.back();
+
+    handoff::Message hello(handoff::HELLO);
+    hello.u32(handoff::MAGIC);
+    hello.u32(handoff::VERSION);
+    DeviceRegistry::SnapshotPtr snapshot = registry.snapshot();
+    bool ok = send_all(fd, hello.finish()) && send_devices(standby, *snapshot);
+    for (size_t i = 0; ok && i < snapshot->devices.size(); i++) {
+        ok = send_values(standby, snapshot->devices[i].handle);
+    }
+    handoff::Message synced(handoff::SYNCED);
+    if (!ok || !send_all(fd, synced.finish())) {
+        drop(clients.size() - 1);
+    }
+}
+
+bool HandoffServer::send_devices(Standby& standby, const RegistrySnapshot& snapshot) {
+    // YASDI's lists are read under the plant lock, the standby is sent to
+    // after letting go of it
+    std::vector<handoff::Message> channel_lists;
+    handoff::Message devices(handoff::DEVICES);
+    devices.u32((DWORD)snapshot.devices.size());
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        for (const RegistryDevice& device : snapshot.devices) {
+            // The raw list as the device sent it, from YASDI's channel list
+            // cache; a standby that misses one is dropped
+            if (!device.channels.empty() && standby.channel_lists.count(device.type) == 0) {
+                std::vector<char> type = c_string(device.type);
+                BYTE* list = nullptr;
+                int size = 0;
+                if (TRepository_LoadChannelList(type.data(), &list, &size) == 0) {
+                    channel_lists.emplace_back(handoff::CHANLIST);
+                    channel_lists.back().str(device.type);
+                    channel_lists.back().raw(list, (size_t)size);
+                    os_free(list);
+                    standby.channel_lists.insert(device.type);
+                }
+            }
+
+            WORD address = 0;
+            BYTE protocol = 0;
+            TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device.handle);
+            if (dev != NULL) {
+                address = TNetDevice_GetNetAddr(dev);
+                protocol = dev->prodID;
+            }
+            devices.u32(device.handle);
+            devices.u32(device.serial);
+            devices.u16(address);
+            devices.u8(protocol);
+            devices.str(device.type);
+            devices.u32((DWORD)device.channels.size());
+            for (const RegistryChannel& channel : device.channels) {
+                devices.u32(channel.handle);
+                devices.str(channel.name);
+            }
+        }
+    }
+
+    for (handoff::Message& channel_list : channel_lists) {
+        if (!send_all(standby.fd, channel_list.finish())) {
+            return false;
+        }
+    }
+    return send_all(standby.fd, devices.finish());
+}
+
+bool HandoffServer::send_values(Standby& standby, DWORD device_handle) {
+    std::vector<CachedValue> cached;
+    if (!values.load(device_handle, cached) || cached.empty()) {
+        return true;
+    }
+
+    handoff::Message message(handoff::VALUES);
+    message.u32(device_handle);
+    message.u32((DWORD)cached.size());
+    for (const CachedValue& value : cached) {
+        message.u32(value.channel);
+        message.u32(value.time);
+        message.f64(value.value);
+    }
+    return send_all(standby.fd, message.finish());
+}
+
+void HandoffServer::drop(size_t index) {
+    close(clients[index].fd);
+    clients.erase(clients.begin() + index);
+    connected--;
+}
+
+StandbyReplica::~StandbyReplica() {
+    stop();
+}
+
+void StandbyReplica::start(const std::string& path, Target replica_target) {
+    stop();
+
+    target = std::move(replica_target);
+    socket_path = path;
+    device_map.clear();
+    channel_map.clear();
+    channel_lists.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        running = true;
+        state = StandbyStatus();
+        state.active = true;
+    }
+    thread = std::thread(&StandbyReplica::run, this);
+}
+
+void StandbyReplica::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        // The message being applied is finished, the next read fails
+        if (socket_fd >= 0) {
+            shutdown(socket_fd, SHUT_RDWR);
+        }
+    }
+    wake.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    state.active = false;
+    state.connected = false;
+}
+
+bool StandbyReplica::active() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return running;
+}
+
+StandbyStatus StandbyReplica::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return state;
+}
+
+void StandbyReplica::run() {
+    sockaddr_un address;
+    bool valid = socket_address(socket_path, address);
+
+    while (true) {
+        int fd = valid ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        if (fd >= 0 && connect(fd, (sockaddr*)&address, sizeof(address)) == 0) {
+            bool stop_now;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop_now = stopping;
+                if (!stop_now) {
+                    socket_fd = fd;
+                    state.connected = true;
+                }
+            }
+            if (!stop_now) {
+                session(fd);
+                std::lock_guard<std::mutex> lock(mutex);
+                socket_fd = -1;
+                state.connected = false;
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+
+        // The active gateway may be restarting; the state applied stays
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_for(lock, std::chrono::seconds(1), [this] { return stopping; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void StandbyReplica::session(int fd) {
+    BYTE header[handoff::HEADER_SIZE];
+    std::vector<BYTE> payload;
+    bool greeted = false;
+
+    while (read_all(fd, header, handoff::HEADER_SIZE)) {
+        DWORD size = header[1] | (header[2] << 8) | (header[3] << 16) | ((DWORD)header[4] << 24);
+        if (size > handoff::MAX_MESSAGE) {
+            return;
+        }
+        payload.resize(size);
+        if (size > 0 && !read_all(fd, payload.data(), size)) {
+            return;
+        }
+
+        if (!greeted) {
+            handoff::Payload hello(payload);
+            if (header[0] != handoff::HELLO || hello.u32() != handoff::MAGIC || hello.u32() != handoff::VERSION) {
+                return;
+            }
+            greeted = true;
+            continue;
+        }
+
+        switch (header[0]) {
+            case handoff::CHANLIST:
+                apply_channel_list(payload);
+                break;
+            case handoff::DEVICES:
+                apply_devices(payload);
+                break;
+            case handoff::VALUES:
+                apply_values(payload);
+                break;
+            case handoff::SYNCED: {
+                std::lock_guard<std::mutex> lock(mutex);
+                state.synced = true;
+                break;
+            }
+        }
+    }
+}
+
+void StandbyReplica::apply_channel_list(const std::vector<BYTE>& payload) {
+    handoff::Payload in(payload);
+    std::string type = in.str();
+    if (!in.ok() || type.empty() || channel_lists.count(type) != 0) {
+        return;
+    }
+
+    // Validated, cached for the device type and given to all its devices,
+    // as after a download
+    std::vector<char> type_name = c_string(type);
+    int stored = -1;
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        stored = TPlant_StoreChanList((BYTE*)in.rest(), (DWORD)in.remaining(), type_name.data());
+    }
+    if (stored == 0) {
+        channel_lists.insert(type);
+        std::lock_guard<std::mutex> lock(mutex);
+        state.channel_lists = channel_lists.size();
+    }
+}
+
+void StandbyReplica::apply_devices(const std::vector<BYTE>& payload) {
+    struct Entry {
+        DWORD handle;
+        DWORD serial;
+        WORD address;
+        BYTE protocol;
+        std::string type;
+        std::vector<std::pair<DWORD, std::string>> channels;
+    };
+
+    handoff::Payload in(payload);
+    DWORD count = in.u32();
+    std::vector<Entry> entries;
+    std::set<DWORD> serials;
+    for (DWORD i = 0; i < count && in.ok(); i++) {
+        Entry entry;
+        entry.handle = in.u32();
+        entry.serial = in.u32();
+        entry.address = in.u16();
+        entry.protocol = in.u8();
+        entry.type = in.str();
+        DWORD channels = in.u32();
+        for (DWORD j = 0; j < channels && in.ok(); j++) {
+            DWORD handle = in.u32();
+            entry.channels.push_back({ handle, in.str() });
+        }
+        if (!in.ok() || entry.type.empty()) {
+            return;
+        }
+        serials.insert(entry.serial);
+        entries.push_back(std::move(entry));
+    }
+
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        for (const Entry& entry : entries) {
+            TNetDevice* dev = TPlant_FindSN(entry.serial);
+            if (dev == NULL) {
+                // Gets its channel list from YASDI's cache, where CHANLIST put it
+                std::vector<char> type_name = c_string(entry.type);
+                dev = TNetSWR_Constructor(type_name.data(), entry.serial, entry.address);
+                dev->prodID = entry.protocol;
+                TPlant_AddDevice(&Plant, NULL, dev);
+                TSMADataMaster_FireAPIEventDeviceDetection(YASDI_EVENT_DEVICE_ADDED, TNetDevice_GetHandle(dev), 0);
+            } else {
+                TNetDevice_SetNetAddr(dev, entry.address);
+                dev->prodID = entry.protocol;
+            }
+        }
+    }
+
+    DeviceRegistry::SnapshotPtr snapshot = target.refresh();
+    for (const RegistryDevice& device : snapshot->devices) {
+        if (serials.count(device.serial) == 0) {
+            target.remove(device.handle);
+        }
+    }
+
+    device_map.clear();
+    channel_map.clear();
+    for (const Entry& entry : entries) {
+        const RegistryDevice* own = snapshot->find_serial(entry.serial);
+        if (own == nullptr) {
+            continue;
+        }
+        device_map[entry.handle] = own->handle;
+        // Channels of a device type are shared by its devices in YASDI
+        for (const auto& channel : entry.channels) {
+            const RegistryChannel* own_channel = own->find_channel(channel.second);
+            if (own_channel != nullptr) {
+                channel_map[channel.first] = own_channel->handle;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    state.devices = device_map.size();
+    state.handles = device_map;
+}
+
+void StandbyReplica::apply_values(const std::vector<BYTE>& payload) {
+    handoff::Payload in(payload);
+    DWORD device_handle = in.u32();
+    DWORD count = in.u32();
+    auto device = device_map.find(device_handle);
+    if (!in.ok() || device == device_map.end()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> plant(plant_mutex());
+        TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device->second);
+        if (dev == NULL) {
+            return;
+        }
+        for (DWORD i = 0; i < count; i++) {
+            DWORD channel_handle = in.u32();
+            DWORD time = in.u32();
+            double value = in.f64();
+            if (!in.ok()) {
+                break;
+            }
+            auto channel = channel_map.find(channel_handle);
+            if (channel == channel_map.end()) {
+                continue;
+            }
+            TChannel* chan = (TChannel*)TObjManager_GetRef(channel->second);
+            if (chan != NULL) {
+                TChannel_SetValue(chan, dev, value);
+                TChannel_SetTimeStamp(chan, dev, time);
+            }
+        }
+    }
+    target.values(device->second);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    state.updates++;
+}
@@ -0,0 +1,266 @@
+#ifndef STATE_HANDOFF_H
+#define STATE_HANDOFF_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_registry.h"
+#include "value_cache.h"
+#include "yasdi_headers.h"
+
+// Hot standby: the active gateway streams its plant state to a standby
+// process on the same machine over a unix domain socket, so the standby
+// takes over without detection and without channel list downloads.
+//
+// A message is type[1] length[4] payload[length], all fields little endian;
+// strings are length[2] bytes:
+//   HELLO     magic[4] version[4]
+//   CHANLIST  device type (string), channel list[...] as the device sent it
+//             (CMD_GET_CINFO answer, as YASDI keeps it in its cache)
+//   DEVICES   count[4], per device: handle[4] serial[4] address[2]
+//             protocol[1] type (string) channels[4], per channel:
+//             handle[4] name (string)
+//   VALUES    device handle[4] count[4], per value: channel[4] time[4] value[8]
+//   SYNCED    no payload, the state so far is complete
+// A standby that connects gets HELLO, the channel lists, DEVICES, the values
+// of every device and SYNCED. Afterwards DEVICES follows every registry
+// change (after the channel lists the standby has not got yet) and VALUES
+// every store that changed the values of a device. Handles are the active
+// gateway's; the standby maps them to its own by serial number and channel
+// name.
+namespace handoff {
+    const DWORD MAGIC = 0x48414d53;     // "SMAH"
+    const DWORD VERSION = 1;
+
+    enum MessageType { HELLO = 1, CHANLIST = 2, DEVICES = 3, VALUES = 4, SYNCED = 5 };
+
+    const size_t HEADER_SIZE = 5;
+    const DWORD MAX_MESSAGE = 16 * 1024 * 1024;
+
+    // One message, the header is filled in by finish()
+    class Message {
+    public:
+        explicit Message(BYTE type) : bytes(HEADER_SIZE, 0) { bytes[0] = type; }
+
+        void u8(BYTE value) { bytes.push_back(value); }
+        void u16(WORD value) {
+            u8((BYTE)(value & 0xff));
+            u8((BYTE)(value >> 8));
+        }
+        void u32(DWORD value) {
+            for (int i = 0; i < 4; i++) {
+                u8((BYTE)((value >> (8 * i)) & 0xff));
+            }
+        }
+        void f64(double value) {
+            unsigned long long bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            for (int i = 0; i < 8; i++) {
+                u8((BYTE)((bits >> (8 * i)) & 0xff));
+            }
+        }
+        void str(const std::string& value) {
+            u16((WORD)value.size());
+            bytes.insert(bytes.end(), value.begin(), value.end());
+        }
+        void raw(const BYTE* data, size_t size) { bytes.insert(bytes.end(), data, data + size); }
+
+        const std::vector<BYTE>& finish() {
+            DWORD size = (DWORD)(bytes.size() - HEADER_SIZE);
+            for (int i = 0; i < 4; i++) {
+                bytes[1 + i] = (BYTE)((size >> (8 * i)) & 0xff);
+            }
+            return bytes;
+        }
+
+    private:
+        std::vector<BYTE> bytes;
+    };
+
+    // Reads a payload; past its end every field is 0 and ok() false
+    class Payload {
+    public:
+        explicit Payload(const std::vector<BYTE>& bytes) : bytes(bytes) {}
+
+        bool ok() const { return !overrun; }
+        size_t remaining() const { return bytes.size() - pos; }
+        const BYTE* rest() const { return bytes.data() + pos; }
+
+        BYTE u8() { return take(1) ? bytes[pos - 1] : 0; }
+        WORD u16() { return take(2) ? (WORD)(bytes[pos - 2] | (bytes[pos - 1] << 8)) : 0; }
+        DWORD u32() {
+            if (!take(4)) {
+                return 0;
+            }
+            DWORD value = 0;
+            for (int i = 0; i < 4; i++) {
+                value |= (DWORD)bytes[pos - 4 + i] << (8 * i);
+            }
+            return value;
+        }
+        double f64() {
+            if (!take(8)) {
+                return 0;
+            }
+            unsigned long long bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits |= (unsigned long long)bytes[pos - 8 + i] << (8 * i);
+            }
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        std::string str() {
+            WORD size = u16();
+            if (!take(size)) {
+                return std::string();
+            }
+            return std::string(bytes.begin() + (pos - size), bytes.begin() + pos);
+        }
+
+    private:
+        bool take(size_t size) {
+            if (overrun || remaining() < size) {
+                overrun = true;
+                return false;
+            }
+            pos += size;
+            return true;
+        }
+
+        const std::vector<BYTE>& bytes;
+        size_t pos = 0;
+        bool overrun = false;
+    };
+}
+
+// Active side: streams the registry, YASDI's channel lists and the value
+// cache to every standby connected. One thread accepts and writes; the
+// notifications only mark what changed, so stores never wait for a standby.
+class HandoffServer {
+public:
+    HandoffServer(const DeviceRegistry& registry, const ValueCache& values)
+        : registry(registry), values(values) {}
+    ~HandoffServer();
+
+    HandoffServer(const HandoffServer&) = delete;
+    HandoffServer& operator=(const HandoffServer&) = delete;
+
+    // Listen on a socket path, a stale socket file there is replaced.
+    // YASDI must be initialized. False if the socket cannot be bound.
+    bool start(const std::string& path);
+    void stop();
+    bool active() const { return serving.load(); }
+    size_t standbys() const { return connected.load(); }
+
+    // From any thread; nearly free while no standby is connected
+    void values_changed(DWORD device_handle);
+    void registry_changed();
+
+private:
+    struct Standby {
+        int fd;
+        std::set<std::string> channel_lists;    // device types sent
+    };
+
+    void run();
+    void wake();
+    void accept_standby();
+    // Channel lists the standby lacks, then the devices
+    bool send_devices(Standby& standby, const RegistrySnapshot& snapshot);
+    bool send_values(Standby& standby, DWORD device_handle);
+    void drop(size_t index);
+
+    const DeviceRegistry& registry;
+    const ValueCache& values;
+
+    std::mutex mutex;                   // start and stop
+    std::string socket_path;
+    int listen_fd = -1;
+    int wake_fds[2] = { -1, -1 };
+    std::thread thread;
+    std::atomic<bool> serving{ false };
+    std::atomic<bool> stopping{ false };
+    std::atomic<size_t> connected{ 0 };
+
+    std::mutex changes_mutex;
+    std::set<DWORD> dirty;              // devices whose values changed
+    bool woken = false;
+
+    // Writer thread only
+    std::vector<Standby> clients;
+    unsigned long long sent_registry = 0;
+};
+
+struct StandbyStatus {
+    bool active = false;                // applying the stream
+    bool connected = false;
+    bool synced = false;                // got the complete state at least once
+    size_t devices = 0;
+    size_t channel_lists = 0;
+    unsigned long long updates = 0;     // VALUES applied
+    std::map<DWORD, DWORD> handles;     // device handle of the active gateway to own
+};
+
+// Standby side: applies the stream of a HandoffServer to this process's
+// YASDI plant and value cache, reconnecting until stopped. Devices are
+// added to the plant with the channel lists streamed (which YASDI also
+// caches), values are set on the YASDI channels with their time stamps, so
+// reads within the max age need no bus either.
+//
+// The caller keeps the bus silent, so the master changes nothing meanwhile.
+// The replica thread changes the plant only under plant_mutex().
+class StandbyReplica {
+public:
+    // How the replica reaches the rest of the engine
+    struct Target {
+        std::function<DeviceRegistry::SnapshotPtr()> refresh;   // publish YASDI's devices
+        std::function<void(DWORD device_handle)> remove;        // device gone on the active side
+        std::function<void(DWORD device_handle)> values;        // values were set on the YASDI channels
+    };
+
+    StandbyReplica() = default;
+    ~StandbyReplica();
+
+    StandbyReplica(const StandbyReplica&) = delete;
+    StandbyReplica& operator=(const StandbyReplica&) = delete;
+
+    void start(const std::string& path, Target target);
+    // Stop applying; returns after the last message was applied
+    void stop();
+    bool active() const;
+    StandbyStatus status() const;
+
+private:
+    void run();
+    void session(int fd);
+    void apply_channel_list(const std::vector<BYTE>& payload);
+    void apply_devices(const std::vector<BYTE>& payload);
+    void apply_values(const std::vector<BYTE>& payload);
+
+    Target target;
+    std::string socket_path;
+    std::thread thread;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool running = false;
+    int socket_fd = -1;
+    StandbyStatus state;
+
+    // Replica thread only: handles of the active gateway to own ones
+    std::map<DWORD, DWORD> device_map;
+    std::map<DWORD, DWORD> channel_map;
+    std::set<std::string> channel_lists;
+};
+
+#endif
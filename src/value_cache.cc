@@ -0,0 +1,252 @@
+#include "value_cache.h"
+#include "hazard_pointers.h"
+
+#include <algorithm>
+#include <cstring>
+
+static unsigned long long to_bits(double value) {
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double from_bits(unsigned long long bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+ValueCache::DeviceValues::DeviceValues(const RegistryDevice& device)
+    : seq(0), version(0), slots(device.channels.size()) {
+    for (size_t i = 0; i < device.channels.size(); i++) {
+        channels.push_back(device.channels[i].handle);
+        index[device.channels[i].handle] = i;
+        slots[i].bits.store(0, std::memory_order_relaxed);
+        slots[i].time.store(0, std::memory_order_relaxed);
+    }
+}
+
+ValueCache::ValueCache()
+    : layout(new Layout()) {
+}
+
+ValueCache::~ValueCache() {
+    delete layout.load();
+    for (const Layout* old : replaced) {
+        delete old;
+    }
+}
+
+ValueCache::LayoutRef::LayoutRef(const ValueCache& cache)
+    : cache(cache), hazard(thread_hazard(HAZARD_VALUE_CACHE)), layout(protect(cache.layout, hazard)) {
+}
+
+ValueCache::LayoutRef::~LayoutRef() {
+    hazard.store(nullptr, std::memory_order_release);
+}
+
+ValueCache::DeviceValues* ValueCache::LayoutRef::find(DWORD device_handle) const {
+    auto it = layout->find(device_handle);
+    return it != layout->end() ? it->second.get() : nullptr;
+}
+
+bool ValueCache::LayoutRef::stale() const {
+    return cache.layout.load(std::memory_order_acquire) != layout;
+}
+
+void ValueCache::LayoutRef::renew() {
+    layout = protect(cache.layout, hazard);
+}
+
+void ValueCache::rebuild(const RegistrySnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(layout_mutex);
+
+    // Only rebuilds replace the layout, the previous one stays meanwhile
+    const Layout* previous = layout.load(std::memory_order_acquire);
+    Layout* next = new Layout();
+    std::vector<std::unique_lock<std::mutex>> old_writers;
+
+    for (const RegistryDevice& device : snapshot.devices) {
+        std::unique_ptr<DeviceValues> values(new DeviceValues(device));
+
+        auto old = previous->find(device.handle);
+        if (old != previous->end()) {
+            // Stores to the old slots wait until the new layout is published
+            old_writers.emplace_back(old->second->writer);
+            std::vector<CachedValue> kept;
+            unsigned long long kept_version = 0;
+            load(device.handle, kept, &kept_version);
+            values->version.store(kept_version, std::memory_order_relaxed);
+            for (const CachedValue& value : kept) {
+                auto it = values->index.find(value.channel);
+                if (it != values->index.end()) {
+                    values->slots[it->second].bits.store(to_bits(value.value), std::memory_order_relaxed);
+                    values->slots[it->second].time.store(value.time, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        (*next)[device.handle] = std::move(values);
+    }
+
+    layout.store(next, std::memory_order_seq_cst);
+    old_writers.clear();
+
+    // A replaced layout cannot be picked up anymore; once no reader or
+    // writer announced it, it is gone
+    replaced.push_back(previous);
+    replaced.erase(std::remove_if(replaced.begin(), replaced.end(),
+                                  [](const Layout* old) {
+                                      if (hazardous(old)) {
+                                          return false;
+                                      }
+                                      delete old;
+                                      return true;
+                                  }),
+                   replaced.end());
+}
+
+size_t ValueCache::store(DWORD device_handle, const std::vector<CachedValue>& values,
+                         unsigned long long* version) {
+    if (version) {
+        *version = 0;
+    }
+
+    size_t stored = 0;
+    bool changed = false;
+    unsigned long long current = 0;
+    {
+        LayoutRef ref(*this);
+        DeviceValues* device = ref.find(device_handle);
+        if (device == nullptr) {
+            return 0;
+        }
+
+        std::unique_lock<std::mutex> lock(device->writer);
+
+        // A rebuild copies the values while holding the writer lock; if it
+        // replaced the layout meanwhile, write to the new slots instead
+        while (ref.stale()) {
+            lock.unlock();
+            ref.renew();
+            device = ref.find(device_handle);
+            if (device == nullptr) {
+                return 0;
+            }
+            lock = std::unique_lock<std::mutex>(device->writer);
+        }
+
+        // Odd sequence: values are being written
+        unsigned start = device->seq.load(std::memory_order_relaxed);
+        device->seq.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (const CachedValue& value : values) {
+            auto it = device->index.find(value.channel);
+            if (it == device->index.end()) {
+                continue;
+            }
+            Slot& slot = device->slots[it->second];
+            unsigned long long bits = to_bits(value.value);
+            // Only this writer stores to the slot, relaxed loads see its last store
+            if (slot.time.load(std::memory_order_relaxed) == 0 || slot.bits.load(std::memory_order_relaxed) != bits) {
+                changed = true;
+            }
+            slot.bits.store(bits, std::memory_order_relaxed);
+            slot.time.store(value.time, std::memory_order_relaxed);
+            stored++;
+        }
+
+        current = device->version.load(std::memory_order_relaxed);
+        if (changed) {
+            current = last_version.fetch_add(1, std::memory_order_relaxed) + 1;
+            device->version.store(current, std::memory_order_relaxed);
+        }
+
+        device->seq.store(start + 2, std::memory_order_release);
+    }
+
+    if (version) {
+        *version = current;
+    }
+    // Without the writer lock: waiters woken here may read the device at once
+    if (changed && on_change) {
+        on_change(device_handle, current);
+    }
+    return stored;
+}
+
+unsigned long long ValueCache::version(DWORD device_handle) const {
+    LayoutRef ref(*this);
+    const DeviceValues* device = ref.find(device_handle);
+    return device ? device->version.load(std::memory_order_acquire) : 0;
+}
+
+void ValueCache::read(const DeviceValues& device, size_t index, CachedValue& value) {
+    value.channel = device.channels[index];
+    value.value = from_bits(device.slots[index].bits.load(std::memory_order_relaxed));
+    value.time = device.slots[index].time.load(std::memory_order_relaxed);
+}
+
+bool ValueCache::load(DWORD device_handle, std::vector<CachedValue>& values, unsigned long long* version) const {
+    if (version) {
+        *version = 0;
+    }
+    LayoutRef ref(*this);
+    const DeviceValues* device = ref.find(device_handle);
+    if (device == nullptr) {
+        return false;
+    }
+
+    for (;;) {
+        unsigned seq = device->seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+
+        values.clear();
+        for (size_t i = 0; i < device->channels.size(); i++) {
+            CachedValue value;
+            read(*device, i, value);
+            if (value.time != 0) {
+                values.push_back(value);
+            }
+        }
+        unsigned long long seen = device->version.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (device->seq.load(std::memory_order_relaxed) == seq) {
+            if (version) {
+                *version = seen;
+            }
+            return true;
+        }
+    }
+}
+
+bool ValueCache::load(DWORD device_handle, DWORD channel_handle, CachedValue& value) const {
+    LayoutRef ref(*this);
+    const DeviceValues* device = ref.find(device_handle);
+    if (device == nullptr) {
+        return false;
+    }
+
+    auto it = device->index.find(channel_handle);
+    if (it == device->index.end()) {
+        return false;
+    }
+
+    for (;;) {
+        unsigned seq = device->seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+
+        read(*device, it->second, value);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (device->seq.load(std::memory_order_relaxed) == seq) {
+            return value.time != 0;
+        }
+    }
+}
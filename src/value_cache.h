@@ -0,0 +1,111 @@
+#ifndef VALUE_CACHE_H
+#define VALUE_CACHE_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "device_registry.h"
+#include "mem_stats.h"
+
+struct CachedValue {
+    DWORD channel;
+    double value;
+    DWORD time;
+};
+
+// Latest channel values of every device, readable from any thread without
+// locks. Each device has its own seqlock, so a writer updating device B
+// never delays readers of device A, and writers of different devices never
+// contend. The layout (devices and channel slots) follows the registry and
+// is swapped as a whole when the registry publishes a new version; readers
+// and writers reach it through a hazard pointer (hazard_pointers.h), as
+// registry snapshots, without a lock or a reference count.
+//
+// Every device carries a version that is bumped only when a store changes
+// a value (or stores a channel's first value), so a consumer that saw a
+// version knows whether there is anything new. Versions are drawn from
+// one counter for the whole cache: they only grow, also across layout
+// rebuilds and for a device that was removed and detected again.
+class ValueCache {
+public:
+    ValueCache();
+    ~ValueCache();
+
+    ValueCache(const ValueCache&) = delete;
+    ValueCache& operator=(const ValueCache&) = delete;
+
+    // Lay out slots for all devices and channels of a registry version;
+    // values of devices that are still present are kept
+    void rebuild(const RegistrySnapshot& snapshot);
+
+    // Store the values of one device under one sequence bump, returns the
+    // number stored; version gets the device's version after the store
+    size_t store(DWORD device_handle, const std::vector<CachedValue>& values,
+                 unsigned long long* version = nullptr);
+
+    // Coherent copy of all values of a device that were stored at least
+    // once, and the version they belong to
+    bool load(DWORD device_handle, std::vector<CachedValue>& values, unsigned long long* version = nullptr) const;
+    bool load(DWORD device_handle, DWORD channel_handle, CachedValue& value) const;
+
+    // Version of a device's values, 0 if it has none or is unknown
+    unsigned long long version(DWORD device_handle) const;
+
+    // Called by the storing thread after a store changed a device's
+    // values, once it let go of the device; set before the cache is shared,
+    // must not block
+    void set_change_handler(std::function<void(DWORD device_handle, unsigned long long version)> handler) {
+        on_change = std::move(handler);
+    }
+
+private:
+    struct Slot {
+        std::atomic<unsigned long long> bits;   // double value
+        std::atomic<DWORD> time;                // 0: never stored
+    };
+
+    struct DeviceValues {
+        explicit DeviceValues(const RegistryDevice& device);
+
+        std::atomic<unsigned> seq;
+        std::atomic<unsigned long long> version;
+        std::mutex writer;                      // writers of this device only
+        std::vector<DWORD, TaggedAllocator<DWORD, MEM_CACHES>> channels;
+        std::unordered_map<DWORD, size_t> index;
+        std::vector<Slot, TaggedAllocator<Slot, MEM_CACHES>> slots;
+    };
+
+    typedef std::map<DWORD, std::unique_ptr<DeviceValues>> Layout;
+
+    // The current layout, announced in the thread's hazard slot while alive
+    class LayoutRef {
+    public:
+        explicit LayoutRef(const ValueCache& cache);
+        ~LayoutRef();
+
+        DeviceValues* find(DWORD device_handle) const;
+        // A rebuild replaced the layout since it was taken
+        bool stale() const;
+        void renew();
+
+    private:
+        const ValueCache& cache;
+        std::atomic<const void*>& hazard;
+        const Layout* layout;
+    };
+
+    static void read(const DeviceValues& device, size_t index, CachedValue& value);
+
+    std::mutex layout_mutex;                    // rebuilds only
+    std::atomic<const Layout*> layout;
+    std::vector<const Layout*> replaced;        // freed once no hazard slot names them
+    std::atomic<unsigned long long> last_version{ 0 };
+    std::function<void(DWORD, unsigned long long)> on_change;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "work_pool.h"
+
+#include <iostream>
+
+// Index of the worker running on this thread, -1 on other threads
+static thread_local int current_worker = -1;
+static thread_local const WorkPool* current_pool = nullptr;
+
+bool WorkPool::Task::done() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete;
+}
+
+WorkPool::WorkPool(size_t count) {
+    if (count == 0) {
+        count = std::thread::hardware_concurrency();
+    }
+    if (count == 0) {
+        count = 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        workers.emplace_back(new Worker);
+    }
+    for (size_t i = 0; i < count; i++) {
+        threads.emplace_back(&WorkPool::run, this, i);
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+WorkPool::TaskHandle WorkPool::submit(std::function<void()> work, const std::vector<TaskHandle>& dependencies) {
+    TaskHandle task = std::make_shared<Task>();
+    task->work = std::move(work);
+
+    // "pending" starts at 1 so the task cannot start before all
+    // dependencies are registered
+    for (const TaskHandle& dependency : dependencies) {
+        if (!dependency) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->complete) {
+            task->pending.fetch_add(1, std::memory_order_relaxed);
+            dependency->successors.push_back(task);
+        }
+    }
+
+    release(task);
+    return task;
+}
+
+void WorkPool::wait(const TaskHandle& task) {
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->finished.wait(lock, [&task] { return task->complete; });
+}
+
+void WorkPool::release(const TaskHandle& task) {
+    if (task->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        schedule(task);
+    }
+}
+
+void WorkPool::schedule(TaskHandle task) {
+    // Ready tasks stay on the worker that made them ready
+    size_t index;
+    if (current_pool == this && current_worker >= 0) {
+        index = (size_t)current_worker;
+    } else {
+        index = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued.fetch_add(1, std::memory_order_release);
+    }
+    wake.notify_one();
+}
+
+bool WorkPool::pop(size_t index, TaskHandle& task) {
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); i++) {
+        Worker& victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            stolen_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkPool::execute(const TaskHandle& task) {
+    try {
+        task->work();
+    } catch (const std::exception& e) {
+        std::cout << "Work pool task failed: " << e.what() << std::endl;
+    } catch (...) {
+        std::cout << "Work pool task failed" << std::endl;
+    }
+    task->work = nullptr;
+    executed_count.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<TaskHandle> successors;
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->complete = true;
+        successors.swap(task->successors);
+    }
+    task->finished.notify_all();
+
+    for (const TaskHandle& successor : successors) {
+        release(successor);
+    }
+}
+
+void WorkPool::run(size_t index) {
+    current_worker = (int)index;
+    current_pool = this;
+
+    for (;;) {
+        TaskHandle task;
+        if (pop(index, task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping && queued.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for CPU-bound post-processing.
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// (cache-warm, LIFO) and idle workers steal the oldest task from the front
+// of another worker's deque. Tasks may depend on other tasks; a task becomes
+// ready when all its dependencies finished and is then queued on the worker
+// that finished the last one.
+class WorkPool {
+public:
+    class Task;
+    typedef std::shared_ptr<Task> TaskHandle;
+
+    // 0 threads: one per core
+    explicit WorkPool(size_t threads = 0);
+    ~WorkPool();
+
+    TaskHandle submit(std::function<void()> work, const std::vector<TaskHandle>& dependencies = {});
+
+    // Block until a task finished
+    void wait(const TaskHandle& task);
+
+    size_t size() const { return threads.size(); }
+    unsigned long long executed() const { return executed_count.load(std::memory_order_relaxed); }
+    unsigned long long stolen() const { return stolen_count.load(std::memory_order_relaxed); }
+
+    class Task {
+    public:
+        bool done() const;
+
+    private:
+        friend class WorkPool;
+
+        std::function<void()> work;
+        std::atomic<int> pending{1};
+        mutable std::mutex mutex;
+        std::condition_variable finished;
+        std::vector<TaskHandle> successors;
+        bool complete = false;
+    };
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<TaskHandle> tasks;
+    };
+
+    void run(size_t index);
+    bool pop(size_t index, TaskHandle& task);
+    void schedule(TaskHandle task);
+    void execute(const TaskHandle& task);
+    void release(const TaskHandle& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_worker{0};
+    std::atomic<unsigned long long> executed_count{0};
+    std::atomic<unsigned long long> stolen_count{0};
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef YASDI_HEADERS_H
+#define YASDI_HEADERS_H
+
+// Include YASDI SDK headers
+extern "C" {
+    #include "libyasdi.h"
+    #include "libyasdimaster.h"
+    #include "smadata_cmd.h"
+    #include "tools.h"
+}
+
+// os_linux.h defines min/max as macros, which breaks the C++ standard library
+#undef min
+#undef max
+
+#endif
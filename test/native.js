@@ -0,0 +1,45 @@
+const assert = require("assert");
+const childProcess = require("child_process");
+const fs = require("fs");
+const path = require("path");
+
+// C++ tests of the engine, built with the addon (npm run build) into
+// build/Release/native_tests; each case runs in a process of its own.
+const root = path.join(__dirname, "..");
+const binary = ["Release", "Debug"]
+  .map((config) => path.join(root, "build", config, "native_tests"))
+  .find((file) => fs.existsSync(file));
+
+function run(args) {
+  const sdk = process.env.YASDI_SDK_PATH || path.join(root, "yasdi");
+  const libraryPath = [path.join(sdk, "lib"), process.env.LD_LIBRARY_PATH].filter(Boolean).join(path.delimiter);
+  return childProcess.spawnSync(binary, args, {
+    encoding: "utf8",
+    env: Object.assign({}, process.env, { LD_LIBRARY_PATH: libraryPath }),
+    timeout: 60000,
+  });
+}
+
+describe("native engine", function () {
+  if (!binary) {
+    it("is built", function () {
+      assert.fail("build/Release/native_tests not found, run npm run build");
+    });
+    return;
+  }
+
+  const list = run(["--list"]);
+  const names = list.status === 0 ? list.stdout.split("\n").filter(Boolean) : [];
+  it("lists its cases", function () {
+    assert.strictEqual(list.status, 0, String(list.stderr || list.error));
+    assert.ok(names.length > 0);
+  });
+
+  for (const name of names) {
+    it(name, function () {
+      this.timeout(60000);
+      const result = run([name]);
+      assert.strictEqual(result.status, 0, result.stdout + result.stderr);
+    });
+  }
+});
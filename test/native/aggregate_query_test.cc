@@ -0,0 +1,118 @@
+#include <string>
+#include <vector>
+
+#include "aggregate_query.h"
+#include "native_test.h"
+
+namespace {
+
+RegistryDevice device(DWORD handle, const std::string& name, const std::string& type, const std::string& channel) {
+    RegistryDevice result;
+    result.handle = handle;
+    result.name = name;
+    result.type = type;
+    result.channels.push_back({ handle * 10, channel, "W" });
+    return result;
+}
+
+// Two small inverters, a large one and a meter without the channel
+struct Plant {
+    Plant() : history(100), evaluator(history, values, groups) {
+        snapshot = registry.publish({
+            device(1, "WR1", "SB 3000", "Pac"),
+            device(2, "WR2", "SB 3000", "Pac"),
+            device(3, "WR3", "STP 8000", "Pac"),
+            device(4, "Meter", "SMA Meter", "Ptot"),
+        });
+        values.rebuild(*snapshot);
+    }
+
+    HistoryStore history;
+    ValueCache values;
+    DeviceGroups groups;
+    DeviceRegistry registry;
+    DeviceRegistry::SnapshotPtr snapshot;
+    QueryEvaluator evaluator;
+};
+
+}
+
+TEST(aggregate_query_combines_cached_values) {
+    Plant plant;
+    plant.values.store(1, { { 10, 1000, 100 } });
+    plant.values.store(2, { { 20, 2000, 110 } });
+    plant.values.store(3, { { 30, 5000, 105 } });
+
+    AggregateQuery query;
+    query.channel = "Pac";
+    query.functions = { AGG_SUM, AGG_AVG, AGG_MIN, AGG_MAX, AGG_COUNT };
+    AggregateResult result;
+    CHECK(plant.evaluator.run(query, *plant.snapshot, result) == YE_OK);
+
+    CHECK(result.matched == 3);
+    CHECK(result.keys.size() == 1 && result.keys[0] == "all");
+    CHECK(result.times[0] == 110);
+    CHECK(result.devices[0] == 3);
+    CHECK(result.columns[0][0] == 8000);
+    CHECK_NEAR(result.columns[1][0], 8000.0 / 3, 1e-9);
+    CHECK(result.columns[2][0] == 1000);
+    CHECK(result.columns[3][0] == 5000);
+    CHECK(result.columns[4][0] == 3);
+}
+
+TEST(aggregate_query_groups_and_filters_devices) {
+    Plant plant;
+    plant.values.store(1, { { 10, 1000, 100 } });
+    plant.values.store(2, { { 20, 2000, 110 } });
+    plant.values.store(3, { { 30, 5000, 105 } });
+
+    AggregateQuery query;
+    query.channel = "Pac";
+    query.functions = { AGG_SUM };
+    query.group_by = GROUP_BY_TYPE;
+    AggregateResult result;
+    CHECK(plant.evaluator.run(query, *plant.snapshot, result) == YE_OK);
+    CHECK(result.keys == std::vector<std::string>({ "SB 3000", "STP 8000" }));
+    CHECK(result.columns[0] == std::vector<double>({ 3000, 5000 }));
+    CHECK(result.devices == std::vector<DWORD>({ 2, 1 }));
+
+    query.group_by = GROUP_BY_DEVICE;
+    query.types = { "SB 3000" };
+    query.devices = { 2, 3 };
+    CHECK(plant.evaluator.run(query, *plant.snapshot, result) == YE_OK);
+    CHECK(result.matched == 1);
+    CHECK(result.keys == std::vector<std::string>({ "WR2" }));
+
+    query.functions.clear();
+    CHECK(plant.evaluator.run(query, *plant.snapshot, result) == YE_INVAL_ARGUMENT);
+    query.functions = { AGG_SUM };
+    query.channel.clear();
+    CHECK(plant.evaluator.run(query, *plant.snapshot, result) == YE_INVAL_ARGUMENT);
+}
+
+TEST(aggregate_query_buckets_history_per_device_first) {
+    Plant plant;
+    plant.history.append(1, "Pac", 1000, 100);
+    plant.history.append(1, "Pac", 1010, 200);
+    plant.history.append(1, "Pac", 1060, 300);
+    plant.history.append(2, "Pac", 1005, 50);
+    plant.history.append(2, "Pac", 1065, 70);
+    plant.history.append(2, "Pac", 1200, 90);     // after to
+
+    AggregateQuery query;
+    query.channel = "Pac";
+    query.functions = { AGG_SUM, AGG_COUNT, AGG_MAX };
+    query.history = true;
+    query.from = 1000;
+    query.to = 1119;
+    query.bucket = 60;
+    AggregateResult result;
+    CHECK(plant.evaluator.run(query, *plant.snapshot, result) == YE_OK);
+
+    // The mean of device 1 in the first bucket is 150, plus 50 of device 2
+    CHECK(result.times == std::vector<DWORD>({ 1000, 1060 }));
+    CHECK(result.columns[0] == std::vector<double>({ 200, 370 }));
+    CHECK(result.columns[1] == std::vector<double>({ 3, 2 }));
+    CHECK(result.columns[2] == std::vector<double>({ 200, 300 }));
+    CHECK(result.devices == std::vector<DWORD>({ 2, 2 }));
+}
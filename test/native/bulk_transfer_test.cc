@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bulk_transfer.h"
+#include "channel_codec.h"
+#include "history_store.h"
+#include "memory_plant.h"
+#include "native_test.h"
+#include "smadata_request.h"
+
+extern "C" {
+    #include "chandef.h"
+}
+
+namespace {
+
+const std::vector<std::string> CHANNELS = { "Pac", "Upv-Ist" };
+const DWORD AREA_START = 0x1000;
+
+void put16(std::vector<BYTE>& out, WORD value) {
+    out.push_back(LOBYTE(value));
+    out.push_back(HIBYTE(value));
+}
+
+void put32(std::vector<BYTE>& out, DWORD value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back((BYTE)(value >> (8 * i)));
+    }
+}
+
+void put_text(std::vector<BYTE>& out, const char* text, size_t size) {
+    size_t length = strlen(text);
+    for (size_t i = 0; i < size; i++) {
+        out.push_back(i < length ? (BYTE)text[i] : 0);
+    }
+}
+
+// time[4] and one float per recorded channel
+void put_record(std::vector<BYTE>& out, DWORD time, float pac, float upv) {
+    put32(out, time);
+    for (float value : { pac, upv }) {
+        BYTE bytes[4];
+        memcpy(bytes, &value, sizeof(bytes));
+        out.insert(out.end(), bytes, bytes + sizeof(bytes));
+    }
+}
+
+// A device recording both channels into area 1, answering the bulk
+// commands on a thread of its own as YASDI does
+class RecordingDevice {
+public:
+    explicit RecordingDevice(std::vector<BYTE> recorded) : area(std::move(recorded)), thread([this] { run(); }) {
+        SMADataScheduler::instance().set_transport([this](TIORequest* io) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(io);
+            wake.notify_one();
+        });
+    }
+
+    ~RecordingDevice() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_one();
+        }
+        thread.join();
+        SMADataScheduler::instance().set_transport(nullptr);
+    }
+
+private:
+    std::vector<BYTE> answer(const TIORequest* io) const {
+        std::vector<BYTE> out;
+        switch (io->Cmd) {
+            case CMD_GET_BINFO:
+                // Two entries and the start of a third that was cut off
+                out.push_back(1);
+                out.push_back(2);
+                put_text(out, "MEANVAL", 16);
+                put32(out, AREA_START);
+                put32(out, (DWORD)area.size());
+                out.push_back(1);
+                out.push_back(2);
+                out.push_back(1);
+                put_text(out, "EVENTS", 16);
+                put32(out, 0x8000);
+                put32(out, 64);
+                out.push_back(0);
+                out.insert(out.end(), 5, 0xee);
+                break;
+            case CMD_GET_MTIME:
+                put16(out, 300);
+                for (size_t i = 0; i < CHANNELS.size(); i++) {
+                    put16(out, CH_SPOT);
+                    out.push_back((BYTE)(i + 1));
+                }
+                break;
+            case CMD_GET_BIN: {
+                // area[1] offset[4] length[4]
+                DWORD offset = read_le_dword(&io->TxData[1]) - AREA_START;
+                DWORD length = read_le_dword(&io->TxData[5]);
+                if (io->TxData[0] == 1 && offset < area.size()) {
+                    length = std::min(length, (DWORD)area.size() - offset);
+                    out.assign(area.begin() + offset, area.begin() + offset + length);
+                }
+                break;
+            }
+        }
+        return out;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            TIORequest* io = pending.front();
+            pending.pop_front();
+            lock.unlock();
+            std::vector<BYTE> data = answer(io);
+            TOnReceiveInfo info = {};
+            info.SourceAddr = io->DestAddr;
+            info.Buffer = data.data();
+            info.BufferSize = (DWORD)data.size();
+            io->OnReceived(io, &info);
+            io->Status = RS_SUCCESS;
+            io->OnEnd(io);
+            lock.lock();
+        }
+    }
+
+    std::vector<BYTE> area;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TIORequest*> pending;
+    bool stopping = false;
+    std::thread thread;
+};
+
+}
+
+TEST(bulk_transfer_parses_binary_info) {
+    MemoryPlant plant;
+    CHECK(plant.initialized());
+    std::vector<DWORD> devices = plant.add_devices(CHANNELS, 1);
+    CHECK(devices.size() == 1);
+
+    std::vector<BinaryArea> areas;
+    {
+        RecordingDevice device(std::vector<BYTE>(48, 0));
+        BulkTransfer bulk;
+        CHECK(bulk.get_binary_info(devices[0], areas) == YE_OK);
+    }
+
+    CHECK(areas.size() == 2);
+    CHECK(areas[0].area == 1);
+    CHECK(areas[0].revision == 2);
+    CHECK(areas[0].name == "MEANVAL");
+    CHECK(areas[0].start == AREA_START);
+    CHECK(areas[0].size == 48);
+    CHECK(areas[0].mode == 1);
+    CHECK(areas[1].area == 2);
+    CHECK(areas[1].name == "EVENTS");
+    CHECK(areas[1].start == 0x8000);
+    CHECK(areas[1].size == 64);
+    CHECK(areas[1].mode == 0);
+}
+
+// Records are read in chunks that split them, empty slots and records not
+// newer than "since" are skipped
+TEST(bulk_transfer_backfills_the_records_newer_than_since) {
+    MemoryPlant plant;
+    CHECK(plant.initialized());
+    std::vector<DWORD> devices = plant.add_devices(CHANNELS, 1);
+    CHECK(devices.size() == 1);
+
+    std::vector<BYTE> area;
+    put_record(area, 0, 0, 0);
+    put_record(area, 1000, 900.0f, 300.0f);
+    put_record(area, 2000, 1500.5f, 310.25f);
+    put_record(area, 0xffffffff, 0, 0);
+    put_record(area, 2300, 1700.0f, 312.0f);
+
+    HistoryStore history;
+    BackfillResult result;
+    BackfillResult none;
+    int code;
+    int missing;
+    {
+        RecordingDevice device(area);
+        BulkTransfer bulk(16, 5);
+        code = bulk.backfill(devices[0], 1, 1500, history, result);
+        missing = bulk.backfill(devices[0], 3, 0, history, none);
+    }
+
+    CHECK(code == YE_OK);
+    CHECK(missing == YE_INVAL_ARGUMENT);
+    CHECK(result.bytes == area.size());
+    CHECK(result.records == 2);
+    CHECK(result.samples == 4);
+    CHECK(result.first_time == 2000);
+    CHECK(result.last_time == 2300);
+    std::vector<HistorySample> pac = history.query(devices[0], "Pac", 0, 0xffffffff);
+    std::vector<HistorySample> upv = history.query(devices[0], "Upv-Ist", 0, 0xffffffff);
+    CHECK(pac.size() == 2);
+    CHECK(upv.size() == 2);
+    CHECK(pac[0].time == 2000);
+    CHECK_NEAR(pac[0].value, 1500.5, 1e-9);
+    CHECK_NEAR(upv[0].value, 310.25, 1e-9);
+    CHECK(pac[1].time == 2300);
+    CHECK_NEAR(pac[1].value, 1700.0, 1e-9);
+    CHECK_NEAR(upv[1].value, 312.0, 1e-9);
+}
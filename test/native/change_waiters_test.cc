@@ -0,0 +1,123 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "change_waiters.h"
+#include "native_test.h"
+
+namespace {
+
+// Completions of waits, in the order they came
+class Outcomes {
+public:
+    ChangeWaiters::Done done(int id) {
+        return [this, id](bool changed, unsigned long long version) {
+            std::lock_guard<std::mutex> lock(mutex);
+            outcomes.push_back({ id, changed, version });
+            wake.notify_all();
+        };
+    }
+
+    bool wait_for(size_t count, double seconds) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return wake.wait_for(lock, std::chrono::duration<double>(seconds), [&]() { return outcomes.size() >= count; });
+    }
+
+    struct Outcome {
+        int id;
+        bool changed;
+        unsigned long long version;
+    };
+
+    std::vector<Outcome> all() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return outcomes;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Outcome> outcomes;
+};
+
+}
+
+TEST(change_waiters_complete_at_once_when_newer) {
+    std::atomic<unsigned long long> version{ 5 };
+    Outcomes outcomes;     // outlives the waits that stop() completes
+    ChangeWaiters waiters([&](DWORD) { return version.load(); });
+
+    waiters.wait(1, 4, 10, outcomes.done(1));
+    waiters.wait(1, 5, 0, outcomes.done(2));
+    std::vector<Outcomes::Outcome> done = outcomes.all();
+    CHECK(done.size() == 2);
+    CHECK(done[0].id == 1 && done[0].changed && done[0].version == 5);
+    CHECK(done[1].id == 2 && !done[1].changed && done[1].version == 5);
+    CHECK(waiters.waiting() == 0);
+}
+
+TEST(change_waiters_complete_on_a_newer_version) {
+    std::atomic<unsigned long long> version{ 5 };
+    Outcomes outcomes;
+    ChangeWaiters waiters([&](DWORD) { return version.load(); });
+
+    waiters.wait(1, 5, 10, outcomes.done(1));
+    waiters.wait(2, 5, 10, outcomes.done(2));
+    CHECK(waiters.waiting() == 2);
+
+    // Another device, and a version the waiter has seen, complete nothing
+    waiters.changed(3, 6);
+    waiters.changed(1, 5);
+    CHECK(outcomes.all().empty());
+
+    version = 6;
+    waiters.changed(1, 6);
+    std::vector<Outcomes::Outcome> done = outcomes.all();
+    CHECK(done.size() == 1);
+    CHECK(done[0].id == 1 && done[0].changed && done[0].version == 6);
+    CHECK(waiters.waiting() == 1);
+}
+
+TEST(change_waiters_time_out_in_deadline_order) {
+    std::atomic<unsigned long long> version{ 5 };
+    Outcomes outcomes;
+    ChangeWaiters waiters([&](DWORD) { return version.load(); });
+
+    auto started = std::chrono::steady_clock::now();
+    waiters.wait(1, 5, 0.3, outcomes.done(1));
+    waiters.wait(1, 5, 0.1, outcomes.done(2));
+    CHECK(outcomes.wait_for(2, 5));
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<Outcomes::Outcome> done = outcomes.all();
+    CHECK(done[0].id == 2 && !done[0].changed && done[0].version == 5);
+    CHECK(done[1].id == 1 && !done[1].changed);
+    CHECK(elapsed >= 0.3);
+    CHECK(waiters.waiting() == 0);
+}
+
+TEST(change_waiters_stop_completes_every_wait) {
+    std::atomic<unsigned long long> version{ 5 };
+    Outcomes outcomes;
+    ChangeWaiters waiters([&](DWORD) { return version.load(); });
+
+    for (int i = 0; i < 3; i++) {
+        waiters.wait((DWORD)i, 5, 60, outcomes.done(i));
+    }
+    waiters.stop();
+    std::vector<Outcomes::Outcome> done = outcomes.all();
+    CHECK(done.size() == 3);
+    for (const Outcomes::Outcome& outcome : done) {
+        CHECK(!outcome.changed && outcome.version == 5);
+    }
+    CHECK(waiters.waiting() == 0);
+
+    // Later waits work again
+    waiters.wait(1, 5, 60, outcomes.done(3));
+    version = 7;
+    waiters.changed(1, 7);
+    done = outcomes.all();
+    CHECK(done.size() == 4 && done[3].id == 3 && done[3].changed && done[3].version == 7);
+}
@@ -0,0 +1,79 @@
+#include "freshness_scheduler.h"
+#include "native_test.h"
+
+// A job of r requests with max age a takes 2 * r * cost / a of the bus:
+// it is refreshed every a / 2 s so that no value gets older than a.
+
+TEST(freshness_plan_admits_up_to_the_capacity) {
+    FreshnessPlan plan(0.8, 0.25);
+    double granted = 0;
+
+    CHECK(plan.admit(1, 100, 1, 10, false, 0, granted) == YE_OK);
+    CHECK(granted == 10);
+    CHECK_NEAR(plan.utilization(), 0.05, 1e-9);
+    CHECK(plan.admit(2, 100, 2, 2, false, 0, granted) == YE_OK);
+    CHECK_NEAR(plan.utilization(), 0.55, 1e-9);
+
+    // 0.5 more does not fit, the plan is unchanged
+    CHECK(plan.admit(3, 100, 1, 1, false, 0, granted) == YE_TOO_MANY_REQUESTS);
+    CHECK_NEAR(plan.utilization(), 0.55, 1e-9);
+
+    // Degraded to the max age that fills the rest
+    CHECK(plan.admit(3, 100, 1, 1, true, 0, granted) == YE_OK);
+    CHECK_NEAR(granted, 2, 1e-9);
+    CHECK_NEAR(plan.utilization(), 0.8, 1e-9);
+    std::vector<PollJobStats> stats = plan.stats(0);
+    CHECK(stats.size() == 3);
+    CHECK(stats[2].degraded && stats[2].requested_age == 1);
+
+    // A full bus takes nothing, not even degraded
+    CHECK(plan.admit(4, 100, 1, 1000, true, 0, granted) == YE_TOO_MANY_REQUESTS);
+    CHECK(plan.admit(5, 100, 0, 10, false, 0, granted) == YE_INVAL_ARGUMENT);
+    CHECK(plan.admit(5, 100, 1, 0, false, 0, granted) == YE_INVAL_ARGUMENT);
+
+    CHECK(plan.remove(3));
+    CHECK(!plan.remove(3));
+    CHECK_NEAR(plan.utilization(), 0.55, 1e-9);
+}
+
+TEST(freshness_plan_runs_the_earliest_deadline) {
+    FreshnessPlan plan(0.8, 0.01);
+    double granted = 0;
+    double next_release = 0;
+    plan.admit(1, 100, 1, 10, false, 0, granted);    // deadline 5
+    plan.admit(2, 200, 1, 4, false, 0, granted);     // deadline 2
+
+    CHECK(plan.next(0, next_release) == 2);
+    plan.completed(2, true, 1, 0.01);               // released again at 3
+    CHECK(plan.next(1, next_release) == 1);
+    CHECK(next_release == 3);
+    plan.completed(1, true, 1.5, 0.01);             // released again at 6.5
+
+    CHECK(plan.next(2, next_release) == 0);
+    CHECK(next_release == 3);
+    CHECK(plan.next(3, next_release) == 2);
+}
+
+TEST(freshness_plan_measures_cost_and_deadlines) {
+    FreshnessPlan plan(0.8, 0.25);
+    double granted = 0;
+    plan.admit(1, 7, 2, 4, false, 0, granted);      // deadline 2
+
+    plan.completed(1, true, 1, 0.2);                // 0.1 s per request, in time
+    CHECK_NEAR(plan.request_cost(7), 0.1, 1e-9);
+    CHECK_NEAR(plan.request_cost(8), 0.25, 1e-9);
+    plan.completed(1, true, 6, 0.6);                // 0.3 s per request, 5 s after the last
+    CHECK_NEAR(plan.request_cost(7), 0.15, 1e-9);
+    plan.completed(1, false, 7, 1);
+
+    std::vector<PollJobStats> stats = plan.stats(8);
+    CHECK(stats.size() == 1);
+    CHECK(stats[0].refreshes == 2);
+    CHECK(stats[0].met == 1);
+    CHECK(stats[0].missed == 1);
+    CHECK(stats[0].failures == 1);
+    CHECK_NEAR(stats[0].worst_age, 5, 1e-9);
+    CHECK_NEAR(stats[0].age, 2, 1e-9);
+    CHECK_NEAR(stats[0].cost, 0.3, 1e-9);
+    CHECK_NEAR(plan.utilization(), 2 * 0.3 / 4, 1e-9);
+}
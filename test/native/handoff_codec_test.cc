@@ -0,0 +1,72 @@
+#include <vector>
+
+#include "native_test.h"
+#include "state_handoff.h"
+
+namespace {
+
+// Payload of a finished message, as the standby reads it after the header
+std::vector<BYTE> payload(const std::vector<BYTE>& message) {
+    return std::vector<BYTE>(message.begin() + handoff::HEADER_SIZE, message.end());
+}
+
+}
+
+TEST(handoff_message_fields_round_trip) {
+    handoff::Message message(handoff::VALUES);
+    message.u8(0x7f);
+    message.u16(0xbeef);
+    message.u32(0xdeadbeef);
+    message.f64(-1.5e300);
+    message.str("E-Total");
+    message.str("");
+    const BYTE raw[] = { 1, 2, 3 };
+    message.raw(raw, sizeof(raw));
+    const std::vector<BYTE>& bytes = message.finish();
+
+    // type[1] length[4], little endian
+    CHECK(bytes[0] == handoff::VALUES);
+    DWORD length = bytes[1] | (bytes[2] << 8) | (bytes[3] << 16) | ((DWORD)bytes[4] << 24);
+    CHECK(length == bytes.size() - handoff::HEADER_SIZE);
+    CHECK(length == 1 + 2 + 4 + 8 + (2 + 7) + 2 + 3);
+
+    std::vector<BYTE> body = payload(bytes);
+    handoff::Payload in(body);
+    CHECK(in.u8() == 0x7f);
+    CHECK(in.u16() == 0xbeef);
+    CHECK(in.u32() == 0xdeadbeef);
+    CHECK(in.f64() == -1.5e300);
+    CHECK(in.str() == "E-Total");
+    CHECK(in.str().empty());
+    CHECK(in.ok());
+    CHECK(in.remaining() == 3);
+    CHECK(in.rest()[0] == 1 && in.rest()[2] == 3);
+}
+
+TEST(handoff_fields_are_little_endian) {
+    handoff::Message message(handoff::DEVICES);
+    message.u32(0x01020304);
+    message.u16(0x0506);
+    std::vector<BYTE> body = payload(message.finish());
+    CHECK(body == std::vector<BYTE>({ 0x04, 0x03, 0x02, 0x01, 0x06, 0x05 }));
+}
+
+TEST(handoff_payload_stops_at_its_end) {
+    std::vector<BYTE> body = { 0x01, 0x02, 0x03 };
+    handoff::Payload in(body);
+    CHECK(in.u32() == 0);
+    CHECK(!in.ok());
+    // Bytes left do not make it valid again
+    CHECK(in.u8() == 0);
+    CHECK(!in.ok());
+
+    // A string longer than the rest
+    std::vector<BYTE> text = { 0x05, 0x00, 'P', 'a', 'c' };
+    handoff::Payload truncated(text);
+    CHECK(truncated.str().empty());
+    CHECK(!truncated.ok());
+
+    std::vector<BYTE> empty;
+    handoff::Payload none(empty);
+    CHECK(none.f64() == 0 && !none.ok());
+}
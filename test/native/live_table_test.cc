@@ -0,0 +1,64 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "live_table.h"
+#include "native_test.h"
+
+namespace {
+
+const std::vector<std::string> COLUMNS = { "Pac", "Upv-Ist" };
+
+// Float64 slot of a row in table memory, see the layout in live_table.h
+double slot(const std::vector<double>& memory, size_t row, size_t column) {
+    size_t offset = LiveTable::HEADER_SIZE + row * (LiveTable::ROW_HEADER_SIZE + 8 * COLUMNS.size()) +
+                    LiveTable::ROW_HEADER_SIZE + 8 * column;
+    return memory[offset / sizeof(double)];
+}
+
+int32_t generation(const std::vector<double>& memory) {
+    return reinterpret_cast<const int32_t*>(memory.data())[LiveTable::GENERATION_FIELD];
+}
+
+}
+
+// Stores that changed nothing, and late stores of older values, leave the
+// row alone and publish no generation
+TEST(live_table_writes_only_newer_versions) {
+    std::vector<double> memory(LiveTable::required_size(2, COLUMNS.size()) / sizeof(double));
+    LiveTable table;
+    CHECK(table.attach(memory.data(), memory.size() * sizeof(double), 2, COLUMNS));
+    std::vector<int32_t> published;
+    table.set_publish_handler([&](int32_t generation) { published.push_back(generation); });
+
+    LiveTable::Value first[] = { { "Pac", 1000.0 }, { "Upv-Ist", 300.0 } };
+    CHECK(table.update(7, 5, 100, first, 2));
+    table.publish();
+    CHECK_NEAR(slot(memory, 0, 0), 1000.0, 1e-9);
+    CHECK_NEAR(slot(memory, 0, 1), 300.0, 1e-9);
+
+    LiveTable::Value older[] = { { "Pac", 900.0 } };
+    CHECK(!table.update(7, 5, 105, older, 1));
+    CHECK(!table.update(7, 3, 105, older, 1));
+    CHECK_NEAR(slot(memory, 0, 0), 1000.0, 1e-9);
+
+    // Channels without a column are skipped, columns without a value are NaN
+    LiveTable::Value newer[] = { { "Pac", 1100.0 }, { "Fac", 50.0 } };
+    CHECK(table.update(7, 9, 110, newer, 2));
+    table.publish();
+    CHECK_NEAR(slot(memory, 0, 0), 1100.0, 1e-9);
+    CHECK(std::isnan(slot(memory, 0, 1)));
+
+    // Versions are per row
+    CHECK(table.update(8, 2, 110, first, 2));
+    CHECK_NEAR(slot(memory, 1, 0), 1000.0, 1e-9);
+
+    CHECK(published.size() == 2);
+    CHECK(published.back() == 2);
+    CHECK(generation(memory) == 2);
+
+    table.detach();
+    CHECK(!table.update(7, 10, 120, first, 2));
+    CHECK(table.publish() == 0);
+    CHECK(published.size() == 2);
+}
@@ -0,0 +1,89 @@
+#include "memory_plant.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+extern "C" {
+    #include "chandef.h"
+    #include "netdevice.h"
+    #include "plant.h"
+}
+
+namespace {
+
+void put16(std::vector<BYTE>& out, WORD value) {
+    out.push_back((BYTE)(value & 0xff));
+    out.push_back((BYTE)(value >> 8));
+}
+
+void put_text(std::vector<BYTE>& out, const char* text, size_t size) {
+    size_t length = strlen(text);
+    for (size_t i = 0; i < size; i++) {
+        out.push_back(i < length ? (BYTE)text[i] : 0);
+    }
+}
+
+void put_float(std::vector<BYTE>& out, float value) {
+    BYTE bytes[4];
+    memcpy(bytes, &value, sizeof(bytes));
+    out.insert(out.end(), bytes, bytes + sizeof(bytes));
+}
+
+// CMD_GET_CINFO answer of an inverter with float spot channels
+std::vector<BYTE> channel_list(const std::vector<std::string>& channels) {
+    std::vector<BYTE> list;
+    for (size_t i = 0; i < channels.size(); i++) {
+        list.push_back((BYTE)(i + 1));
+        put16(list, CH_ANALOG | CH_IN | CH_SPOT);
+        put16(list, (1 << 8) | CH_FLOAT4);
+        put16(list, 0);
+        put_text(list, channels[i].c_str(), 16);
+        put_text(list, "W", 8);
+        put_float(list, 1.0f);
+        put_float(list, 0.0f);
+    }
+    return list;
+}
+
+}
+
+MemoryPlant::MemoryPlant() {
+    if (mkdtemp(cache_dir) == nullptr) {
+        return;
+    }
+    ini = std::string(cache_dir) + "/yasdi.ini";
+    FILE* file = fopen(ini.c_str(), "w");
+    if (file == nullptr) {
+        return;
+    }
+    fprintf(file, "[DriverModules]\n\n[Misc]\nChannelListDir=%s\n", cache_dir);
+    fclose(file);
+    DWORD driver_count = 0;
+    yasdiMasterInitialize(ini.c_str(), &driver_count);
+    ready = true;
+}
+
+MemoryPlant::~MemoryPlant() {
+    if (ready) {
+        yasdiMasterShutdown();
+    }
+    unlink(ini.c_str());
+    unlink((std::string(cache_dir) + "/" + TYPE + ".bin").c_str());
+    rmdir(cache_dir);
+}
+
+std::vector<DWORD> MemoryPlant::add_devices(const std::vector<std::string>& channels, int count) {
+    std::vector<BYTE> list = channel_list(channels);
+    std::vector<char> type(TYPE, TYPE + strlen(TYPE) + 1);
+    if (!ready || TPlant_StoreChanList(list.data(), (DWORD)list.size(), type.data()) != 0) {
+        return std::vector<DWORD>();
+    }
+    for (int i = 0; i < count; i++) {
+        TPlant_AddDevice(&Plant, NULL, TNetSWR_Constructor(type.data(), 2100000000u + i, (WORD)(i + 1)));
+    }
+    std::vector<DWORD> devices(count + 1);
+    devices.resize(GetDeviceHandles(devices.data(), (DWORD)devices.size()));
+    return devices;
+}
@@ -0,0 +1,35 @@
+#ifndef MEMORY_PLANT_H
+#define MEMORY_PLANT_H
+
+#include <string>
+#include <vector>
+
+#include "yasdi_headers.h"
+
+// YASDI without a driver, which it reports as an error although the plant
+// works, and its channel list cache in a directory of its own. Devices get
+// a channel list the way the standby replica applies one, so cases run the
+// engine against a real plant without a frame on the bus.
+class MemoryPlant {
+public:
+    MemoryPlant();
+    ~MemoryPlant();
+
+    MemoryPlant(const MemoryPlant&) = delete;
+    MemoryPlant& operator=(const MemoryPlant&) = delete;
+
+    bool initialized() const { return ready; }
+
+    // Inverters of one type, as detected, with float spot channels of these
+    // names (channel index 1, 2, ...); their handles
+    std::vector<DWORD> add_devices(const std::vector<std::string>& channels, int count);
+
+    static constexpr const char* TYPE = "SIM-TEST";
+
+private:
+    char cache_dir[32] = "/tmp/nativetestXXXXXX";
+    std::string ini;
+    bool ready = false;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "native_test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct TestCase {
+    const char* name;
+    TestFunction function;
+};
+
+// Filled by the static initializers of the test files
+std::vector<TestCase>& cases() {
+    static std::vector<TestCase> all;
+    return all;
+}
+
+bool failed = false;
+
+}
+
+bool register_test(const char* name, TestFunction function) {
+    cases().push_back({ name, function });
+    return true;
+}
+
+void test_failed(const char* file, int line, const char* expression) {
+    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expression);
+    failed = true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--list") == 0) {
+        for (const TestCase& test : cases()) {
+            printf("%s\n", test.name);
+        }
+        return 0;
+    }
+
+    int failures = 0;
+    int run = 0;
+    for (const TestCase& test : cases()) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc && !selected; i++) {
+            selected = strcmp(argv[i], test.name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        failed = false;
+        test.function();
+        printf("%s: %s\n", test.name, failed ? "FAILED" : "ok");
+        fflush(stdout);
+        failures += failed ? 1 : 0;
+        run++;
+    }
+
+    if (run == 0) {
+        fprintf(stderr, "no test case selected\n");
+        return 1;
+    }
+    return failures > 0 ? 1 : 0;
+}
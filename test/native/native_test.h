@@ -0,0 +1,38 @@
+#ifndef NATIVE_TEST_H
+#define NATIVE_TEST_H
+
+// Test cases of the native engine, built into the native_tests executable
+// with the addon and run by test/native.js, one case per process:
+//   native_tests --list      names of all cases
+//   native_tests [name...]   run the cases named, or all; exit code 1 if one fails
+//
+// A case stops at its first failed check:
+//   TEST(value_cache_keeps_versions) {
+//       CHECK(cache.version(1) > 0);
+//       CHECK_NEAR(value.value, 230.0, 1e-9);
+//   }
+
+#include <cmath>
+
+typedef void (*TestFunction)();
+
+bool register_test(const char* name, TestFunction function);
+void test_failed(const char* file, int line, const char* expression);
+
+#define TEST(name) \
+    static void name(); \
+    static bool name##_registered = register_test(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            test_failed(__FILE__, __LINE__, #condition); \
+            return; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    CHECK(std::fabs((double)(value) - (double)(expected)) <= (tolerance))
+
+#endif
@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include "native_test.h"
+#include "power_controller.h"
+
+namespace {
+
+PowerControllerConfig plant(std::vector<double> capacities) {
+    PowerControllerConfig config;
+    config.gain = 0.5;
+    config.refresh = 0;
+    for (size_t i = 0; i < capacities.size(); i++) {
+        config.inverters.push_back({ (DWORD)(i + 1), capacities[i] });
+    }
+    return config;
+}
+
+void write_all(PowerControlLaw& law, const std::vector<std::pair<size_t, double>>& updates) {
+    for (const auto& update : updates) {
+        law.written(update.first, update.second);
+    }
+}
+
+}
+
+TEST(power_control_law_splits_the_limit_by_capacity) {
+    PowerControlLaw law(plant({ 6000, 4000 }));
+    CHECK(law.total_capacity() == 10000);
+    CHECK(law.plant_limit() == 10000);
+
+    // 2 kW export, half of it corrected
+    size_t suppressed = 0;
+    std::vector<std::pair<size_t, double>> updates = law.step(-2000, 1, suppressed);
+    CHECK(law.plant_limit() == 9000);
+    CHECK(updates.size() == 2 && suppressed == 0);
+    CHECK(updates[0].first == 0 && updates[0].second == 5400);
+    CHECK(updates[1].first == 1 && updates[1].second == 3600);
+
+    // Never above the capacity or below 0
+    law.step(1e6, 1, suppressed);
+    CHECK(law.plant_limit() == 10000);
+    law.step(-1e6, 1, suppressed);
+    CHECK(law.plant_limit() == 0);
+}
+
+TEST(power_control_law_ramps_and_regulates_to_headroom) {
+    PowerControllerConfig config = plant({ 10000 });
+    config.ramp = 100;
+    config.headroom = 200;
+    PowerControlLaw law(config);
+    size_t suppressed = 0;
+
+    law.step(-2000, 2, suppressed);
+    CHECK(law.plant_limit() == 9800);
+    // 300 W import is 100 W above target + headroom
+    law.step(300, 1, suppressed);
+    CHECK(law.plant_limit() == 9850);
+}
+
+TEST(power_control_law_skips_changes_within_the_deadband) {
+    PowerControllerConfig config = plant({ 6000, 4000 });
+    config.deadband = 50;
+    PowerControlLaw law(config);
+    size_t suppressed = 0;
+
+    // Nothing written yet: every limit goes out
+    std::vector<std::pair<size_t, double>> updates = law.step(-2000, 1, suppressed);
+    CHECK(updates.size() == 2);
+    write_all(law, updates);
+
+    updates = law.step(-20, 1, suppressed);
+    CHECK(updates.empty() && suppressed == 2);
+
+    // 90 W less: the larger share is now 60 W off its last write, the smaller 40 W
+    updates = law.step(-180, 1, suppressed);
+    CHECK(updates.size() == 1 && suppressed == 1);
+    CHECK(updates[0].first == 0);
+}
+
+TEST(power_control_law_refreshes_unconfirmed_limits_spread_out) {
+    PowerControllerConfig config = plant({ 1000, 1000, 1000, 1000 });
+    config.deadband = 50;
+    config.refresh = 10;
+    PowerControlLaw law(config);
+    size_t suppressed = 0;
+    write_all(law, law.step(0, 1, suppressed));
+
+    for (int second = 1; second < 10; second++) {
+        CHECK(law.step(0, 1, suppressed).empty());
+        CHECK(suppressed == 4);
+    }
+
+    // Due together, but one per second: 4 inverters * 1 s / 10 s rounded up
+    std::vector<std::pair<size_t, double>> updates = law.step(0, 1, suppressed);
+    CHECK(updates.size() == 1 && suppressed == 3);
+    CHECK(updates[0].second == 1000);
+
+    // A refresh that was not confirmed sent is due again, ahead of the others
+    size_t unconfirmed = updates[0].first;
+    updates = law.step(0, 1, suppressed);
+    CHECK(updates.size() == 1 && updates[0].first == unconfirmed);
+
+    std::vector<size_t> refreshed;
+    for (int second = 0; second < 4; second++) {
+        updates = law.step(0, 1, suppressed);
+        CHECK(updates.size() == 1);
+        refreshed.push_back(updates[0].first);
+        write_all(law, updates);
+    }
+    std::sort(refreshed.begin(), refreshed.end());
+    CHECK(refreshed == std::vector<size_t>({ 0, 1, 2, 3 }));
+    CHECK(law.step(0, 1, suppressed).empty());
+}
@@ -0,0 +1,130 @@
+// Heap allocations of the steady-state read path, the automated form of
+// bench/read_path_allocs.cc. The plant lives in YASDI's memory only (see
+// MemoryPlant), and before every poll the values of a simulated answer are
+// stored on the YASDI channels, fresh, as the master does with a GET_DATA
+// answer. DeviceReader then reads without a frame on the bus, through the
+// channel values, history, value cache and live table.
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "device_reader.h"
+#include "device_registry.h"
+#include "memory_plant.h"
+#include "native_test.h"
+
+extern "C" {
+    #include "netdevice.h"
+    #include "netchannel.h"
+    #include "objman.h"
+}
+
+// Counted per thread, only the polls of the test thread are compared
+static thread_local unsigned long long allocations = 0;
+
+// Out of line: inlined into the library's deallocations, g++ would take
+// the free for one of memory from the builtin operator new
+// (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(size_t size) {
+    allocations++;
+    void* memory = std::malloc(size ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+const std::vector<std::string> CHANNELS = { "Pac", "Upv-Ist", "Iac-Ist", "E-Total" };
+const int DEVICES = 3;
+const int WARMUP_POLLS = 8;     // history rings of 4 samples are full after these
+const int POLLS = 20;
+
+// Values of one answer, stamped now + poll so that every poll is new
+void answer(DWORD device_handle, int poll) {
+    TNetDevice* dev = (TNetDevice*)TObjManager_GetRef(device_handle);
+    DWORD channels[16];
+    int count = GetChannelHandlesEx(device_handle, channels, 16, SPOTCHANNELS);
+    for (int i = 0; i < count; i++) {
+        TChannel* chan = (TChannel*)TObjManager_GetRef(channels[i]);
+        TChannel_SetValue(chan, dev, 1000.0 + 10 * i + poll);
+        TChannel_SetTimeStamp(chan, dev, (DWORD)time(NULL) + poll);
+    }
+}
+
+// As the addon does after detection
+void publish_registry(DeviceRegistry& registry, ValueCache& values, const std::vector<DWORD>& handles) {
+    std::vector<RegistryDevice> devices;
+    for (DWORD handle : handles) {
+        RegistryDevice device;
+        device.handle = handle;
+        DWORD channels[16];
+        char name[64];
+        int count = GetChannelHandlesEx(handle, channels, 16, ALLCHANNELS);
+        for (int i = 0; i < count; i++) {
+            name[0] = 0;
+            GetChannelName(channels[i], name, sizeof(name) - 1);
+            device.channels.push_back({ channels[i], name, "W" });
+        }
+        devices.push_back(device);
+    }
+    values.rebuild(*registry.publish(std::move(devices)));
+}
+
+}
+
+TEST(read_path_polls_without_allocation) {
+    MemoryPlant plant;
+    std::vector<DWORD> devices = plant.add_devices(CHANNELS, DEVICES);
+    CHECK(devices.size() == (size_t)DEVICES);
+
+    HistoryStore history(4);
+    DeviceRegistry registry;
+    ValueCache values;
+    ReceiveTimes receive_times;
+    publish_registry(registry, values, devices);
+
+    std::vector<std::string> columns = { "Pac", "E-Total" };
+    std::vector<double> table(LiveTable::required_size(devices.size(), columns.size()) / sizeof(double));
+    LiveTable live_table;
+    live_table.attach(table.data(), table.size() * sizeof(double), devices.size(), columns);
+
+    DeviceReader reader(history, values, live_table, receive_times);
+    std::vector<ChannelData> data;
+    unsigned long long last_version = 0;
+
+    for (bool text : { true, false }) {
+        unsigned long long steady = 0;
+        for (int poll = 0; poll < WARMUP_POLLS + POLLS; poll++) {
+            for (DWORD device : devices) {
+                answer(device, poll);
+                unsigned long long version = 0;
+                unsigned long long before = allocations;
+                reader.read(device, text, data, &version);
+                if (poll >= WARMUP_POLLS) {
+                    steady += allocations - before;
+                }
+                CHECK(data.size() == CHANNELS.size());
+                CHECK_NEAR(data[0].numericValue, 1000.0 + poll, 1e-3);
+                CHECK(version > last_version);
+                last_version = version;
+            }
+        }
+        printf("%s: %llu allocations in %d polls\n", text ? "with text" : "without text", steady, POLLS * DEVICES);
+        CHECK(steady == 0);
+    }
+    live_table.detach();
+}
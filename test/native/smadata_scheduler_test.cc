@@ -0,0 +1,89 @@
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memory_plant.h"
+#include "native_test.h"
+#include "smadata_request.h"
+
+namespace {
+
+// Ends every request it gets at once, on a thread of its own as YASDI does
+class InstantBus {
+public:
+    InstantBus() : thread([this] { run(); }) {
+        SMADataScheduler::instance().set_transport([this](TIORequest* io) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(io);
+            wake.notify_one();
+        });
+    }
+
+    // Returns after the last request handed over has ended
+    ~InstantBus() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_one();
+        }
+        thread.join();
+        SMADataScheduler::instance().set_transport(nullptr);
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+            TIORequest* io = pending.front();
+            pending.pop_front();
+            lock.unlock();
+            io->Status = RS_SUCCESS;
+            io->OnEnd(io);
+            lock.lock();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<TIORequest*> pending;
+    bool stopping = false;
+    std::thread thread;
+};
+
+}
+
+// A caller that keeps its request on the stack may return and submit the
+// next one at the same address before the end of the first was counted
+TEST(smadata_scheduler_frees_the_slots_of_reused_addresses) {
+    MemoryPlant plant;
+    CHECK(plant.initialized());
+
+    std::vector<int> codes(8, YE_OK);
+    {
+        InstantBus bus;
+        std::vector<std::thread> callers;
+        for (size_t i = 0; i < codes.size(); i++) {
+            callers.emplace_back([&codes, i] {
+                for (int n = 0; n < 20000 && codes[i] == YE_OK; n++) {
+                    SMADataRequest request(1, CMD_GET_NET);
+                    codes[i] = request.execute();
+                }
+            });
+        }
+        for (std::thread& caller : callers) {
+            caller.join();
+        }
+    }
+
+    for (int code : codes) {
+        CHECK(code == YE_OK);
+    }
+    CHECK(SMADataScheduler::instance().in_flight() == 0);
+    CHECK(SMADataScheduler::instance().queued() == 0);
+}
@@ -0,0 +1,132 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "device_registry.h"
+#include "native_test.h"
+#include "value_cache.h"
+
+namespace {
+
+RegistryDevice device(DWORD handle, std::vector<DWORD> channels) {
+    RegistryDevice result;
+    result.handle = handle;
+    for (DWORD channel : channels) {
+        result.channels.push_back({ channel, "channel" + std::to_string(channel), "W" });
+    }
+    return result;
+}
+
+}
+
+TEST(value_cache_versions_change_only_with_values) {
+    DeviceRegistry registry;
+    ValueCache cache;
+    cache.rebuild(*registry.publish({ device(1, { 10, 11 }), device(2, { 20 }) }));
+    int changes = 0;
+    cache.set_change_handler([&](DWORD, unsigned long long) { changes++; });
+    CHECK(cache.version(1) == 0);
+
+    unsigned long long first = 0;
+    CHECK(cache.store(1, { { 10, 100.0, 1000 }, { 11, 230.0, 1000 } }, &first) == 2);
+    CHECK(first > 0);
+    CHECK(cache.version(1) == first);
+    CHECK(changes == 1);
+
+    // Same values, also with a newer time stamp: nothing new for a consumer
+    unsigned long long same = 0;
+    cache.store(1, { { 10, 100.0, 1005 }, { 11, 230.0, 1005 } }, &same);
+    CHECK(same == first);
+    CHECK(changes == 1);
+
+    unsigned long long second = 0;
+    cache.store(1, { { 10, 101.0, 1010 } }, &second);
+    CHECK(second > first);
+    CHECK(changes == 2);
+    CHECK(cache.version(2) == 0);
+
+    std::vector<CachedValue> values;
+    unsigned long long loaded = 0;
+    CHECK(cache.load(1, values, &loaded));
+    CHECK(loaded == second);
+    CHECK(values.size() == 2);
+    CHECK(values[0].channel == 10 && values[0].value == 101.0 && values[0].time == 1010);
+
+    // Unknown devices and channels
+    unsigned long long unknown = 1;
+    CHECK(cache.store(9, { { 10, 1.0, 1 } }, &unknown) == 0);
+    CHECK(unknown == 0);
+    CachedValue value;
+    CHECK(!cache.load(1, 99, value));
+    CHECK(!cache.load(2, 20, value));
+}
+
+TEST(value_cache_keeps_values_and_versions_across_rebuilds) {
+    DeviceRegistry registry;
+    ValueCache cache;
+    cache.rebuild(*registry.publish({ device(1, { 10 }) }));
+    unsigned long long stored = 0;
+    cache.store(1, { { 10, 42.0, 1000 } }, &stored);
+
+    cache.rebuild(*registry.publish({ device(1, { 10 }), device(2, { 20 }) }));
+    CachedValue value;
+    CHECK(cache.load(1, 10, value));
+    CHECK(value.value == 42.0);
+    CHECK(cache.version(1) == stored);
+
+    // Removed and detected again: the version starts over, but above all earlier ones
+    cache.rebuild(*registry.publish({ device(2, { 20 }) }));
+    CHECK(cache.version(1) == 0);
+    CHECK(!cache.load(1, 10, value));
+    cache.rebuild(*registry.publish({ device(1, { 10 }), device(2, { 20 }) }));
+    unsigned long long again = 0;
+    cache.store(1, { { 10, 42.0, 2000 } }, &again);
+    CHECK(again > stored);
+}
+
+TEST(value_cache_loads_are_coherent_while_stored) {
+    DeviceRegistry registry;
+    ValueCache cache;
+    std::vector<DWORD> channels = { 10, 11, 12, 13, 14, 15, 16, 17 };
+    cache.rebuild(*registry.publish({ device(1, channels) }));
+
+    // Every store writes one number to all channels; a torn load mixes two
+    std::atomic<bool> done{ false };
+    std::thread writer([&]() {
+        std::vector<CachedValue> values;
+        for (int i = 1; i <= 200000; i++) {
+            values.clear();
+            for (DWORD channel : channels) {
+                values.push_back({ channel, (double)i, (DWORD)i });
+            }
+            cache.store(1, values);
+        }
+        done = true;
+    });
+
+    bool coherent = true;
+    bool ordered = true;
+    unsigned long long loads = 0;
+    unsigned long long last_version = 0;
+    double last_value = 0;
+    std::vector<CachedValue> values;
+    while (!done.load() || loads == 0) {
+        unsigned long long version = 0;
+        if (!cache.load(1, values, &version) || values.empty()) {
+            continue;
+        }
+        for (const CachedValue& value : values) {
+            coherent = coherent && value.value == values[0].value && value.time == values[0].time;
+        }
+        ordered = ordered && version >= last_version && values[0].value >= last_value;
+        last_version = version;
+        last_value = values[0].value;
+        loads++;
+    }
+    writer.join();
+
+    CHECK(coherent);
+    CHECK(ordered);
+    CHECK(cache.load(1, values));
+    CHECK(values.size() == channels.size() && values[0].value == 200000.0);
+}